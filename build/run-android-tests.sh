@@ -19,7 +19,8 @@ cp /sdcard/resip-test/bin/* /data/resip-test/bin
 chmod 0777 /data/resip-test/bin/*
 chmod 0777 /data/resip-test/lib/*
 
-RUTIL_TEST="testCoders \
+RUTIL_TEST="testAsyncLogger \
+        testCoders \
         testCountStream \
         testData \
         testDataPerformance \
@@ -27,6 +28,7 @@ RUTIL_TEST="testCoders \
         testDnsUtil \
         testFifo \
         testFileSystem \
+        testHepAgent \
         testInserter \
         testIntrusiveList \
         testLogger \
@@ -34,12 +36,15 @@ RUTIL_TEST="testCoders \
         testParseBuffer \
         testRandomHex \
         testRandomThread \
+        testRRCache \
         testThreadIf \
+        testTimerWheel \
         testXMLCursor"
 
 RESIP_TEST="testAppTimer \
         testApplicationSip \
         testConnectionBase \
+        testConnectionManager \
         testCorruption \
         testDigestAuthentication \
         testEmbedded \
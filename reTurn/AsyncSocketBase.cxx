@@ -16,7 +16,9 @@ AsyncSocketBase::AsyncSocketBase(asio::io_service& ioService) :
   mIOService(ioService),
   mReceiving(false),
   mConnected(false),
-  mAsyncSocketBaseHandler(0)
+  mAsyncSocketBaseHandler(0),
+  mSendBatchDepth(0),
+  mSendBatchIdle(false)
 {
 }
 
@@ -55,22 +57,90 @@ AsyncSocketBase::doSend(const StunTuple& destination, unsigned short channel, bo
    else
    {
       // Add Turn Framing
-      boost::shared_ptr<DataBuffer> frame = allocateBuffer(4);
       channel = htons(channel);
-      memcpy(&(*frame)[0], &channel, 2);
       unsigned short msgsize = htons((unsigned short)data->size());
-      memcpy(&(*frame)[2], (void*)&msgsize, 2);  // UDP doesn't need size - but shouldn't hurt to send it anyway
-
-      mSendDataQueue.push_back(SendData(destination, frame, data, bufferStartPos));
+      boost::shared_ptr<DataBuffer> framed;
+      if(bufferStartPos == 0)
+      {
+         if(data.use_count() == 1)
+         {
+            if(data->headroom() >= 4)
+            {
+               framed = data;
+            }
+         }
+         else if(data->size() + DataBuffer::DefaultHeadroom <= DataBuffer::PoolBlockSize)
+         {
+            // Someone else still holds data (eg. the same packet relayed to several peers), so frame a pooled
+            // copy rather than writing into a buffer they may be reading or sending
+            framed = DataBuffer::allocate(data->data(), data->size());
+         }
+      }
+      if(framed)
+      {
+         // Write the framing in front of the data, so it goes out as a single buffer
+         char* frame = framed->prepend(4);
+         memcpy(&frame[0], &channel, 2);
+         memcpy(&frame[2], (void*)&msgsize, 2);  // UDP doesn't need size - but shouldn't hurt to send it anyway
+
+         boost::shared_ptr<DataBuffer> empty;
+         mSendDataQueue.push_back(SendData(destination, empty, framed, 0, 4));
+      }
+      else
+      {
+         boost::shared_ptr<DataBuffer> frame = allocateBuffer(4);
+         memcpy(&(*frame)[0], &channel, 2);
+         memcpy(&(*frame)[2], (void*)&msgsize, 2);  // UDP doesn't need size - but shouldn't hurt to send it anyway
+
+         mSendDataQueue.push_back(SendData(destination, frame, data, bufferStartPos));
+      }
    }
-   if (!writeInProgress)
+   if (!writeInProgress && mSendBatchDepth == 0)
    {
       sendFirstQueuedData();
    }
 }
 
+void
+AsyncSocketBase::beginSendBatch()
+{
+   if(mSendBatchDepth++ == 0)
+   {
+      mSendBatchIdle = mSendDataQueue.empty();
+   }
+}
+
+void
+AsyncSocketBase::endSendBatch()
+{
+   resip_assert(mSendBatchDepth > 0);
+   // If a send was already in flight, handleSend picks up the queued data when it completes
+   if(--mSendBatchDepth == 0 && mSendBatchIdle && !mSendDataQueue.empty())
+   {
+      sendQueuedData();
+   }
+}
+
+void
+AsyncSocketBase::sendQueuedData()
+{
+   sendFirstQueuedData();
+}
+
 void 
 AsyncSocketBase::handleSend(const asio::error_code& e)
+{
+   // TODO - check if closed here, and if so don't try and send more
+   // Clear this data from the queue and see if there is more data to send
+   completeFirstQueuedData(e);
+   if (!mSendDataQueue.empty())
+   {
+      sendFirstQueuedData();
+   }
+}
+
+void
+AsyncSocketBase::completeFirstQueuedData(const asio::error_code& e)
 {
    if(!e)
    {
@@ -82,13 +152,11 @@ AsyncSocketBase::handleSend(const asio::error_code& e)
       onSendFailure(e);
    }
 
-   // TODO - check if closed here, and if so don't try and send more
-   // Clear this data from the queue and see if there is more data to send
-   mSendDataQueue.pop_front();
-   if (!mSendDataQueue.empty())
+   if(mSendDataQueue.front().mPrependedFrameSize)
    {
-      sendFirstQueuedData();
+      mSendDataQueue.front().mData->offset(mSendDataQueue.front().mPrependedFrameSize);
    }
+   mSendDataQueue.pop_front();
 }
 
 void 
@@ -164,7 +232,7 @@ AsyncSocketBase::close()
 boost::shared_ptr<DataBuffer>  
 AsyncSocketBase::allocateBuffer(unsigned int size)
 {
-   return boost::shared_ptr<DataBuffer>(new DataBuffer(size));
+   return DataBuffer::allocate(size);
 }
 
 } // namespace
@@ -21,6 +21,12 @@ namespace reTurn {
 class AsyncSocketBaseHandler;
 class AsyncSocketBaseDestroyedHandler;
 
+#ifdef SO_REUSEPORT
+/// Allows each server thread to bind its own socket to the same address and port,
+/// the kernel then spreads clients across those sockets by address hash
+typedef asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> ReusePortOption;
+#endif
+
 class AsyncSocketBase :
    public boost::enable_shared_from_this<AsyncSocketBase>
 {
@@ -32,6 +38,8 @@ public:
 
    virtual void registerAsyncSocketBaseHandler(AsyncSocketBaseHandler* handler) { mAsyncSocketBaseHandler = handler; }
 
+   asio::io_service& getIOService() { return mIOService; }
+
    /// Note:  The following API's are thread safe and queue the request to be handled by the ioService thread
    virtual asio::error_code bind(const asio::ip::address& address, unsigned short port) = 0;
    virtual void connect(const std::string& address, unsigned short port) = 0;  
@@ -55,6 +63,11 @@ public:
    virtual void doReceive();
    virtual void doFramedReceive();
 
+   /// Send batching - between beginSendBatch and endSendBatch doSend only queues data, endSendBatch then
+   /// hands everything queued to the transport at once.  Calls may nest; only the outermost end flushes.
+   void beginSendBatch();
+   void endSendBatch();
+
    /// Class override callbacks
    virtual void onConnectSuccess() { resip_assert(false); }
    virtual void onConnectFailure(const asio::error_code& e) { resip_assert(false); }
@@ -63,7 +76,7 @@ public:
    virtual void onSendSuccess() = 0;
    virtual void onSendFailure(const asio::error_code& e) = 0;
 
-   /// Utility API
+   /// Utility API - buffers are pooled, uninitialized, and leave room to prepend Turn framing
    static boost::shared_ptr<DataBuffer> allocateBuffer(unsigned int size);
 
    // Stubbed out async handlers needed by Protocol specific Subclasses of this - the requirement for these 
@@ -82,6 +95,12 @@ protected:
    virtual void handleSend(const asio::error_code& e);
    virtual void handleReceive(const asio::error_code& e, std::size_t bytesTransferred);
 
+   /// Sends the data queued during a send batch - transports that can push several datagrams with one 
+   /// system call override this, the default starts the usual one at a time asynchronous send
+   virtual void sendQueuedData();
+   /// Reports the result of sending the first queued entry to the subclass and removes it from the queue
+   void completeFirstQueuedData(const asio::error_code& e);
+
    /// The io_service used to perform asynchronous operations.
    asio::io_service& mIOService;
 
@@ -101,29 +120,33 @@ protected:
    /// just before the socket is closed
    boost::function<void(unsigned int)> mOnBeforeSocketCloseFp;
 
-private:
-   virtual void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers) = 0;
-   virtual void transportReceive() = 0;
-   virtual void transportFramedReceive() = 0;
-   virtual void transportClose() = 0;
-
-   virtual const asio::ip::address getSenderEndpointAddress() = 0;
-   virtual unsigned short getSenderEndpointPort() = 0;
-
    virtual void sendFirstQueuedData();
    class SendData
    {
    public:
-      SendData(const StunTuple& destination, boost::shared_ptr<DataBuffer>& frameData, boost::shared_ptr<DataBuffer>& data, unsigned int bufferStartPos = 0) :
-         mDestination(destination), mFrameData(frameData), mData(data), mBufferStartPos(bufferStartPos) {}
+      SendData(const StunTuple& destination, boost::shared_ptr<DataBuffer>& frameData, boost::shared_ptr<DataBuffer>& data, unsigned int bufferStartPos = 0, unsigned int prependedFrameSize = 0) :
+         mDestination(destination), mFrameData(frameData), mData(data), mBufferStartPos(bufferStartPos), mPrependedFrameSize(prependedFrameSize) {}
       StunTuple mDestination;
       boost::shared_ptr<DataBuffer> mFrameData;
       boost::shared_ptr<DataBuffer> mData;
       unsigned int mBufferStartPos;
+      unsigned int mPrependedFrameSize;  // Turn framing written into mData's headroom - stripped again once sent
    };
    /// Queue of data to send
    typedef std::deque<SendData> SendDataQueue;
    SendDataQueue mSendDataQueue;
+
+private:
+   virtual void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers) = 0;
+   virtual void transportReceive() = 0;
+   virtual void transportFramedReceive() = 0;
+   virtual void transportClose() = 0;
+
+   virtual const asio::ip::address getSenderEndpointAddress() = 0;
+   virtual unsigned short getSenderEndpointPort() = 0;
+
+   unsigned int mSendBatchDepth;
+   bool mSendBatchIdle;  // true if nothing was in flight when the outermost batch began
 };
 
 typedef boost::shared_ptr<AsyncSocketBase> ConnectionPtr;
@@ -14,7 +14,8 @@ namespace reTurn {
 AsyncUdpSocketBase::AsyncUdpSocketBase(asio::io_service& ioService) 
    : AsyncSocketBase(ioService),
      mSocket(ioService),
-     mResolver(ioService)
+     mResolver(ioService),
+     mReusePort(false)
 {
 }
 
@@ -45,6 +46,12 @@ AsyncUdpSocketBase::bind(const asio::ip::address& address, unsigned short port)
 #endif
 #endif
       mSocket.set_option(asio::ip::udp::socket::reuse_address(true), errorCode);
+#ifdef SO_REUSEPORT
+      if(mReusePort)
+      {
+         mSocket.set_option(ReusePortOption(true), errorCode);
+      }
+#endif
       mSocket.set_option(asio::socket_base::receive_buffer_size(66560));
       //mSocket.set_option(asio::socket_base::send_buffer_size(66560));
       mSocket.bind(asio::ip::udp::endpoint(address, port), errorCode);
@@ -110,6 +117,64 @@ AsyncUdpSocketBase::transportSend(const StunTuple& destination, std::vector<asio
                          boost::bind(&AsyncUdpSocketBase::handleSend, shared_from_this(), asio::placeholders::error));
 }
 
+#ifdef RETURN_HAVE_MMSG
+void
+AsyncUdpSocketBase::sendQueuedData()
+{
+   struct mmsghdr msgs[MaxSendBatch];
+   struct iovec iovs[MaxSendBatch][2];
+   asio::ip::udp::endpoint destinations[MaxSendBatch];
+
+   while(!mSendDataQueue.empty())
+   {
+      unsigned int count = 0;
+      for(SendDataQueue::iterator it = mSendDataQueue.begin(); it != mSendDataQueue.end() && count < MaxSendBatch; ++it, ++count)
+      {
+         unsigned int iovCount = 0;
+         if(it->mFrameData.get() != 0)
+         {
+            iovs[count][iovCount].iov_base = (void*)it->mFrameData->data();
+            iovs[count][iovCount++].iov_len = it->mFrameData->size();
+         }
+         iovs[count][iovCount].iov_base = (void*)(it->mData->data() + it->mBufferStartPos);
+         iovs[count][iovCount++].iov_len = it->mData->size() - it->mBufferStartPos;
+
+         destinations[count] = asio::ip::udp::endpoint(it->mDestination.getAddress(), it->mDestination.getPort());
+         memset(&msgs[count], 0, sizeof(msgs[count]));
+         msgs[count].msg_hdr.msg_name = destinations[count].data();
+         msgs[count].msg_hdr.msg_namelen = (socklen_t)destinations[count].size();
+         msgs[count].msg_hdr.msg_iov = iovs[count];
+         msgs[count].msg_hdr.msg_iovlen = iovCount;
+      }
+
+      int sent = ::sendmmsg(mSocket.native_handle(), msgs, count, MSG_DONTWAIT);
+      if(sent < 0)
+      {
+         if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+         {
+            break;  // socket buffer is full - wait for it asynchronously
+         }
+         // sendmmsg only fails outright if the first datagram failed - report it and carry on with the rest
+         completeFirstQueuedData(asio::error_code(errno, asio::error::get_system_category()));
+         continue;
+      }
+      for(int i = 0; i < sent; i++)
+      {
+         completeFirstQueuedData(asio::error_code());
+      }
+      if((unsigned int)sent < count)
+      {
+         break;
+      }
+   }
+
+   if(!mSendDataQueue.empty())
+   {
+      sendFirstQueuedData();
+   }
+}
+#endif
+
 void 
 AsyncUdpSocketBase::transportReceive()
 {
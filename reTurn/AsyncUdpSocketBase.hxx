@@ -9,6 +9,11 @@
 
 #include "AsyncSocketBase.hxx"
 
+#if defined(__linux__) && defined(MSG_WAITFORONE)
+// recvmmsg/sendmmsg are available - move several datagrams per system call
+#define RETURN_HAVE_MMSG
+#endif
+
 namespace reTurn {
 
 class AsyncUdpSocketBase : public AsyncSocketBase
@@ -20,6 +25,8 @@ public:
    virtual unsigned int getSocketDescriptor();
 
    virtual asio::error_code bind(const asio::ip::address& address, unsigned short port);
+   /// Must be called before bind - ignored on platforms without SO_REUSEPORT
+   void setReusePort(bool reusePort) { mReusePort = reusePort; }
    virtual void connect(const std::string& address, unsigned short port);  
 
    virtual void transportReceive();
@@ -33,6 +40,7 @@ public:
 protected:
    asio::ip::udp::socket mSocket;
    asio::ip::udp::resolver mResolver;
+   bool mReusePort;
 
    /// Endpoint info for current sender
    asio::ip::udp::endpoint mSenderEndpoint;
@@ -40,6 +48,14 @@ protected:
    virtual void handleUdpResolve(const asio::error_code& ec,
                                  asio::ip::udp::resolver::iterator endpoint_iterator);
 
+#ifdef RETURN_HAVE_MMSG
+   enum { MaxSendBatch = 32 };  // datagrams handed to a single sendmmsg call
+
+   /// Pushes queued datagrams out with sendmmsg without blocking, anything the socket 
+   /// does not accept right away is left to the asynchronous send path
+   virtual void sendQueuedData();
+#endif
+
 private:
 
 };
@@ -14,6 +14,8 @@ namespace reTurn {
 
 ChannelManager::ChannelManager()
 {
+   memset(mChannelPages, 0, sizeof(mChannelPages));
+
    // make starting channel number random
    int randInt = resip::Random::getRandom();
    mNextChannelNumber = MIN_CHANNEL_NUM + (unsigned short)(randInt % (MAX_CHANNEL_NUM-MIN_CHANNEL_NUM+1));
@@ -27,6 +29,36 @@ ChannelManager::~ChannelManager()
    {
       delete it->second;
    }
+   for(unsigned int i = 0; i < ChannelPageCount; i++)
+   {
+      delete [] mChannelPages[i];
+   }
+}
+
+RemotePeer*&
+ChannelManager::channelSlot(unsigned short channel)
+{
+   resip_assert(channel >= MIN_CHANNEL_NUM && channel <= MAX_CHANNEL_NUM);
+   unsigned int index = channel - MIN_CHANNEL_NUM;
+   RemotePeer**& page = mChannelPages[index >> ChannelPageBits];
+   if(!page)
+   {
+      page = new RemotePeer*[ChannelPageSize];
+      memset(page, 0, ChannelPageSize * sizeof(RemotePeer*));
+   }
+   return page[index & (ChannelPageSize - 1)];
+}
+
+void
+ChannelManager::removeRemotePeer(RemotePeer* remotePeer)
+{
+   RemotePeer*& slot = channelSlot(remotePeer->getChannel());
+   if(slot == remotePeer)
+   {
+      slot = 0;
+   }
+   mTupleRemotePeerMap.erase(remotePeer->getPeerTuple());
+   delete remotePeer;
 }
 
 unsigned short 
@@ -59,27 +91,28 @@ ChannelManager::createChannelBinding(const StunTuple& peerTuple, unsigned short
 
    // Add RemoteAddress to the appropriate maps
    mTupleRemotePeerMap[peerTuple] = remotePeer;
-   mChannelRemotePeerMap[channel] = remotePeer;
+   channelSlot(channel) = remotePeer;
    return remotePeer;
 }
 
 RemotePeer* 
 ChannelManager::findRemotePeerByChannel(unsigned short channelNumber)
 {
-   ChannelRemotePeerMap::iterator it = mChannelRemotePeerMap.find(channelNumber);
-   if(it != mChannelRemotePeerMap.end())
+   if(channelNumber < MIN_CHANNEL_NUM || channelNumber > MAX_CHANNEL_NUM)
    {
-      if(!it->second->isExpired())
-      {
-         return it->second;
-      }
-      else
+      return 0;
+   }
+   unsigned int index = channelNumber - MIN_CHANNEL_NUM;
+   RemotePeer** page = mChannelPages[index >> ChannelPageBits];
+   RemotePeer* remotePeer = page ? page[index & (ChannelPageSize - 1)] : 0;
+   if(remotePeer)
+   {
+      if(!remotePeer->isExpired())
       {
-         // cleanup expired channel binding
-         mTupleRemotePeerMap.erase(it->second->getPeerTuple());
-		 delete it->second;
-         mChannelRemotePeerMap.erase(it);
+         return remotePeer;
       }
+      // cleanup expired channel binding
+      removeRemotePeer(remotePeer);
    }
    return 0;
 }
@@ -95,13 +128,8 @@ ChannelManager::findRemotePeerByPeerAddress(const StunTuple& peerAddress)
       {
          return it->second;
       }
-      else
-      {
-         // cleanup expired channel binding
-         mChannelRemotePeerMap.erase(it->second->getChannel());
-		 delete it->second;
-         mTupleRemotePeerMap.erase(it);
-      }
+      // cleanup expired channel binding
+      removeRemotePeer(it->second);
    }
    return 0;
 }
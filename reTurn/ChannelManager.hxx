@@ -6,6 +6,7 @@
 #include <asio/ssl.hpp>
 #endif
 
+#include <rutil/HashMap.hxx>
 #include "RemotePeer.hxx"
 
 namespace reTurn {
@@ -26,9 +27,20 @@ public:
    RemotePeer* findRemotePeerByPeerAddress(const StunTuple& peerAddress);
 
 private:
-   typedef std::map<unsigned short,RemotePeer*> ChannelRemotePeerMap;
-   typedef std::map<StunTuple,RemotePeer*> TupleRemotePeerMap;
-   ChannelRemotePeerMap mChannelRemotePeerMap;
+   // Channels are looked up for every relayed ChannelData packet, so they are indexed directly
+   // by channel number.  The 0x4000-0x7FFF range is split into pages that are only allocated
+   // once a channel in them is bound, since most allocations only ever use a channel or two.
+   enum 
+   { 
+      ChannelPageBits = 8,
+      ChannelPageSize = 1 << ChannelPageBits,
+      ChannelPageCount = (MAX_CHANNEL_NUM - MIN_CHANNEL_NUM + 1) / ChannelPageSize
+   };
+   RemotePeer** mChannelPages[ChannelPageCount];
+   RemotePeer*& channelSlot(unsigned short channel);
+   void removeRemotePeer(RemotePeer* remotePeer);
+
+   typedef HashMap<StunTuple,RemotePeer*> TupleRemotePeerMap;
    TupleRemotePeerMap mTupleRemotePeerMap;
 
    unsigned short getNextChannelNumber();
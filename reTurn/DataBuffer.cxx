@@ -1,15 +1,110 @@
 #include "DataBuffer.hxx"
 #include <memory.h>
+#include <vector>
+#include <boost/make_shared.hpp>
 #include "rutil/ResipAssert.h"
+#include <rutil/ThreadIf.hxx>
 #include <rutil/WinLeakCheck.hxx>
 
 namespace reTurn {
 
+// Free list of PoolBlockSize blocks, one per thread so the io_service threads
+// never contend for it.  A block goes back to the list of the thread that
+// releases it, if
+// that thread allocates from the pool too.  Blocks beyond MaxFreeBlocks are returned to the heap, so a
+// thread only holds on to what a burst of traffic needed.
+class DataBufferPool
+{
+public:
+   enum { MaxFreeBlocks = 1024 };
+
+   ~DataBufferPool()
+   {
+      for(std::vector<char*>::iterator it = mFreeBlocks.begin(); it != mFreeBlocks.end(); it++)
+      {
+         delete [] *it;
+      }
+   }
+
+   char* get()
+   {
+      if(!mFreeBlocks.empty())
+      {
+         char* block = mFreeBlocks.back();
+         mFreeBlocks.pop_back();
+         return block;
+      }
+      return new char[DataBuffer::PoolBlockSize];
+   }
+
+   void put(char* block)
+   {
+      if(mFreeBlocks.size() < MaxFreeBlocks)
+      {
+         mFreeBlocks.push_back(block);
+         return;
+      }
+      delete [] block;
+   }
+
+   // The calling thread's pool, created on first use and deleted when the
+   // thread exits (where its TLS destructors run, see ThreadIf).  A
+   // pool is never destroyed by static destruction, so buffers still
+   // outstanding at exit can be released safely.
+   static DataBufferPool* threadPool(bool create)
+   {
+      DataBufferPool* pool = static_cast<DataBufferPool*>(resip::ThreadIf::tlsGetValue(key()));
+      if(!pool && create)
+      {
+         pool = new DataBufferPool;
+         resip::ThreadIf::tlsSetValue(key(), pool);
+      }
+      return pool;
+   }
+
+private:
+   static void freeThreadPool(void* pool)
+   {
+      delete static_cast<DataBufferPool*>(pool);
+   }
+
+   static resip::ThreadIf::TlsKey key()
+   {
+      // never deleted, so it outlives every buffer
+      static resip::ThreadIf::TlsKey* poolKey = createKey();
+      return *poolKey;
+   }
+
+   static resip::ThreadIf::TlsKey* createKey()
+   {
+      resip::ThreadIf::TlsKey* poolKey = new resip::ThreadIf::TlsKey;
+      resip::ThreadIf::tlsKeyCreate(*poolKey, freeThreadPool);
+      return poolKey;
+   }
+
+   std::vector<char*> mFreeBlocks;
+};
+
 void ArrayDeallocator(char* data)
 {
    delete [] data;
 }
 
+void PoolDeallocator(char* data)
+{
+   // a thread that never allocated, or is exiting, has no pool to return
+   // the block to
+   DataBufferPool* pool = DataBufferPool::threadPool(false /* create */);
+   if(pool)
+   {
+      pool->put(data);
+   }
+   else
+   {
+      delete [] data;
+   }
+}
+
 DataBuffer::DataBuffer(const char* data, unsigned int size, deallocator dealloc)
    : mDealloc(dealloc)
 {
@@ -37,9 +132,41 @@ DataBuffer::DataBuffer(unsigned int size, deallocator dealloc)
    mStart  = mBuffer;
 }
 
+DataBuffer::DataBuffer(char* buffer, unsigned int headroom, unsigned int size, deallocator dealloc)
+   : mBuffer(buffer),
+     mSize(size),
+     mStart(buffer + headroom),
+     mDealloc(dealloc)
+{
+}
+
 DataBuffer::~DataBuffer() 
 { 
-   mDealloc(mBuffer);
+   if(mBuffer)
+   {
+      mDealloc(mBuffer);
+   }
+}
+
+boost::shared_ptr<DataBuffer>
+DataBuffer::allocate(unsigned int size, unsigned int headroom)
+{
+   if(headroom + size <= PoolBlockSize)
+   {
+      return boost::make_shared<DataBuffer>(DataBufferPool::threadPool(true /* create */)->get(), headroom, size, PoolDeallocator);
+   }
+   return boost::make_shared<DataBuffer>(new char[headroom + size], headroom, size, ArrayDeallocator);
+}
+
+boost::shared_ptr<DataBuffer>
+DataBuffer::allocate(const char* data, unsigned int size, unsigned int headroom)
+{
+   boost::shared_ptr<DataBuffer> buffer = allocate(size, headroom);
+   if(size > 0)
+   {
+      memcpy(buffer->mStart, data, size);
+   }
+   return buffer;
 }
 
 DataBuffer* DataBuffer::own(char* data, unsigned int size, deallocator dealloc)
@@ -79,14 +206,14 @@ char&
 DataBuffer::operator[](unsigned int p) 
 { 
    resip_assert(p < mSize); 
-   return mBuffer[p]; 
+   return mStart[p]; 
 }
 
 char 
 DataBuffer::operator[](unsigned int p) const 
 { 
    resip_assert(p < mSize); 
-   return mBuffer[p]; 
+   return mStart[p]; 
 }
 
 unsigned int 
@@ -100,12 +227,21 @@ DataBuffer::truncate(unsigned int newSize)
 unsigned int 
 DataBuffer::offset(unsigned int bytes) 
 { 
-   resip_assert(bytes < mSize); 
+   resip_assert(bytes <= mSize); 
    mStart = mStart+bytes; 
    mSize = mSize-bytes; 
    return mSize;
 }
 
+char*
+DataBuffer::prepend(unsigned int bytes)
+{
+   resip_assert(bytes <= headroom());
+   mStart = mStart-bytes;
+   mSize = mSize+bytes;
+   return mStart;
+}
+
 } // namespace
 
 
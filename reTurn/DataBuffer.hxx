@@ -1,21 +1,39 @@
 #ifndef DATA_BUFFER_HXX
 #define DATA_BUFFER_HXX
 
+#include <boost/shared_ptr.hpp>
+
 namespace reTurn {
 
 void ArrayDeallocator(char* data);
+void PoolDeallocator(char* data);
 
 class DataBuffer
 {
 public:
    typedef void(*deallocator)(char*);
 
+   enum 
+   { 
+      DefaultHeadroom = 4,                      // room to prepend a TURN ChannelData header
+      PoolBlockSize = 4096 + DefaultHeadroom    // a full receive buffer plus headroom
+   };
+
    DataBuffer(const char* data, unsigned int size, deallocator dealloc=ArrayDeallocator);  
    DataBuffer(unsigned int size, deallocator dealloc=ArrayDeallocator);  
+   /// Wraps buffer, which must hold at least headroom + size bytes - data() starts headroom bytes in
+   DataBuffer(char* buffer, unsigned int headroom, unsigned int size, deallocator dealloc);
    ~DataBuffer();
 
    static DataBuffer* own(char* data, unsigned int size, deallocator dealloc=ArrayDeallocator);
 
+   /// Allocates a buffer of size bytes, with headroom bytes reserved in front of it for prepend().
+   /// Contents are not initialized.  Storage comes from the calling thread's free list when headroom + size
+   /// fits in PoolBlockSize, and the DataBuffer and its reference count are allocated together.
+   static boost::shared_ptr<DataBuffer> allocate(unsigned int size, unsigned int headroom=DefaultHeadroom);
+   /// As above, copying size bytes from data
+   static boost::shared_ptr<DataBuffer> allocate(const char* data, unsigned int size, unsigned int headroom=DefaultHeadroom);
+
    const char* data();
    unsigned int size();
    char& operator[](unsigned int p);
@@ -24,6 +42,11 @@ public:
    unsigned int truncate(unsigned int newSize);
    unsigned int offset(unsigned int bytes);
 
+   /// Bytes available in front of data() - either reserved at allocation or freed up by offset()
+   unsigned int headroom() const { return (unsigned int)(mStart - mBuffer); }
+   /// Grows the buffer into its headroom (the inverse of offset) and returns the new data()
+   char* prepend(unsigned int bytes);
+
    char* mutableData();
    unsigned int& mutableSize();
 
@@ -1403,6 +1403,7 @@ StunMessage::encodeAtrUnknown(char* ptr, const StunAtrUnknown& atr)
    {
       ptr = encode16(ptr, atr.attrType[i]);
    }
+   memset(ptr, 0, padsize);
    return ptr+padsize;
 }
 
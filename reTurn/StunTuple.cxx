@@ -1,4 +1,5 @@
 #include "StunTuple.hxx"
+#include "rutil/Data.hxx"
 #include "rutil/Logger.hxx"
 #include "ReTurnSubsystem.hxx"
 
@@ -60,6 +61,26 @@ StunTuple::operator<(const StunTuple& rhs) const
    return false;
 }
 
+size_t
+StunTuple::hash() const
+{
+   return hash(mAddress) ^ (mPort << 2) ^ mTransport;
+}
+
+size_t
+StunTuple::hash(const asio::ip::address& address)
+{
+   // Called for every relayed packet - mix the raw address words rather than hashing bytes one at a time
+   if(address.is_v4())
+   {
+      return (size_t)address.to_v4().to_ulong() * 0x9E3779B1u;
+   }
+   asio::ip::address_v6::bytes_type buf = address.to_v6().to_bytes();
+   UInt32 words[4];
+   memcpy(words, buf.data(), sizeof(words));
+   return (size_t)((words[0] ^ words[1] * 31 ^ words[2] * 961 ^ words[3]) * 0x9E3779B1u);
+}
+
 void
 StunTuple::toSockaddr(sockaddr* addr) const
 {
@@ -115,6 +136,8 @@ operator<<(EncodeStream& strm, const StunTuple& tuple)
 
 } // namespace
 
+HashValueImp(reTurn::StunTuple, data.hash());
+
 
 /* ====================================================================
 
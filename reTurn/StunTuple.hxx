@@ -12,6 +12,7 @@
 
 #include "rutil/Socket.hxx"
 #include "rutil/compat.hxx"
+#include "rutil/HashMap.hxx"
 
 
 #include <asio.hpp>
@@ -39,6 +40,8 @@ public:
    bool operator==(const StunTuple& rhs) const;
    bool operator!=(const StunTuple& rhs) const;
    bool operator<(const StunTuple& rhs) const;
+   size_t hash() const;
+   static size_t hash(const asio::ip::address& address);
 
    TransportType getTransportType() const { return mTransport; }
    void setTransportType(TransportType transport) { mTransport = transport; }
@@ -63,6 +66,8 @@ EncodeStream& operator<<(EncodeStream& strm, const StunTuple& tuple);
 
 } 
 
+HashValue(reTurn::StunTuple);
+
 #endif
 
 
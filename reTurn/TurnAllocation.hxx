@@ -1,7 +1,7 @@
 #ifndef TURNALLOCATION_HXX
 #define TURNALLOCATION_HXX
 
-#include <map>
+#include <rutil/HashMap.hxx>
 #include <boost/noncopyable.hpp>
 #include <asio.hpp>
 #ifdef USE_SSL
@@ -61,6 +61,9 @@ public:
    void sendDataToPeer(const StunTuple& peerAddress, boost::shared_ptr<DataBuffer>& data, bool isFramed);  
    // Used when Data is received from peer, to forward data to client
    void sendDataToClient(const StunTuple& peerAddress, boost::shared_ptr<DataBuffer>& data); 
+   // Bracket a burst of sendDataToClient calls, so the client socket can send them all at once
+   void beginClientSendBatch();
+   void endClientSendBatch();
 
    // Called when a ChannelBind Request is received
    bool addChannelBinding(const StunTuple& peerAddress, unsigned short channelNumber);
@@ -77,11 +80,17 @@ private:
    time_t    mExpires;
    //unsigned int mBandwidth; // future use
 
-   typedef std::map<asio::ip::address,TurnPermission*> TurnPermissionMap;
+   // Checked for every relayed packet - hashed rather than ordered
+   struct AddressHash
+   {
+      size_t operator()(const asio::ip::address& address) const { return StunTuple::hash(address); }
+   };
+   typedef HashMap<asio::ip::address,TurnPermission*,AddressHash> TurnPermissionMap;
    TurnPermissionMap mTurnPermissionMap;
 
    TurnManager& mTurnManager;
    TurnAllocationManager& mTurnAllocationManager;
+   asio::io_service& mIOService;  // io_service of the client's socket - timers and relays run on its thread
    asio::deadline_timer mAllocationTimer;
 
    AsyncSocketBase* mLocalTurnSocket;
@@ -38,9 +38,16 @@ TurnAllocationKey::operator<(const TurnAllocationKey& rhs) const
    return false;
 }
 
+size_t
+TurnAllocationKey::hash() const
+{
+   return mClientLocalTuple.hash() ^ (mClientRemoteTuple.hash() * 31);
+}
 
 } // namespace
 
+HashValueImp(reTurn::TurnAllocationKey, data.hash());
+
 
 /* ====================================================================
 
@@ -1,11 +1,11 @@
 #ifndef TURNALLOCATIONMANAGER_HXX
 #define TURNALLOCATIONMANAGER_HXX
 
-#include <map>
 #include <asio.hpp>
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
 #endif
+#include <rutil/HashMap.hxx>
 #include "TurnAllocationKey.hxx"
 #include "ReTurnConfig.hxx"
 #include "StunTuple.hxx"
@@ -29,7 +29,7 @@ public:
    void allocationExpired(const asio::error_code& e, const TurnAllocationKey& turnAllocationKey);
 
 private:
-   typedef std::map<TurnAllocationKey, TurnAllocation*> TurnAllocationMap;  // .slg. consider using hash table
+   typedef HashMap<TurnAllocationKey, TurnAllocation*> TurnAllocationMap;
    TurnAllocationMap mTurnAllocationMap;
 };
 
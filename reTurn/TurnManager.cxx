@@ -11,10 +11,9 @@ using namespace std;
 
 namespace reTurn {
 
-TurnManager::TurnManager(asio::io_service& ioService, const ReTurnConfig& config) : 
+TurnManager::TurnManager(const ReTurnConfig& config) : 
    mLastAllocatedUdpPort(config.mAllocationPortRangeMin-1),
    mLastAllocatedTcpPort(config.mAllocationPortRangeMin-1),
-   mIOService(ioService),
    mConfig(config)
 {
    // Initialize Allocation Ports
@@ -33,6 +32,7 @@ TurnManager::~TurnManager()
 unsigned short 
 TurnManager::allocateAnyPort(StunTuple::TransportType transport)
 {
+   resip::Lock lock(mMutex);
    PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
    unsigned short startPortToCheck = advanceLastAllocatedPort(transport);
    unsigned short portToCheck = startPortToCheck;
@@ -48,6 +48,7 @@ TurnManager::allocateAnyPort(StunTuple::TransportType transport)
 unsigned short 
 TurnManager::allocateEvenPort(StunTuple::TransportType transport)
 {
+   resip::Lock lock(mMutex);
    PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
    unsigned short startPortToCheck = advanceLastAllocatedPort(transport);
    // Ensure start port is even
@@ -69,6 +70,7 @@ TurnManager::allocateEvenPort(StunTuple::TransportType transport)
 unsigned short 
 TurnManager::allocateOddPort(StunTuple::TransportType transport)
 {
+   resip::Lock lock(mMutex);
    PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
    unsigned short startPortToCheck = advanceLastAllocatedPort(transport);
    // Ensure start port is odd
@@ -89,6 +91,7 @@ TurnManager::allocateOddPort(StunTuple::TransportType transport)
 unsigned short 
 TurnManager::allocateEvenPortPair(StunTuple::TransportType transport)
 {
+   resip::Lock lock(mMutex);
    PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
    unsigned short startPortToCheck = advanceLastAllocatedPort(transport);
    // Ensure start port is even and that start port + 1 is in range
@@ -112,6 +115,7 @@ TurnManager::allocateEvenPortPair(StunTuple::TransportType transport)
 bool 
 TurnManager::allocatePort(StunTuple::TransportType transport, unsigned short port, bool reserved)
 {
+   resip::Lock lock(mMutex);
    if(port >= mConfig.mAllocationPortRangeMin && port <= mConfig.mAllocationPortRangeMax)
    {
       PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
@@ -138,6 +142,7 @@ TurnManager::allocatePort(StunTuple::TransportType transport, unsigned short por
 void 
 TurnManager::deallocatePort(StunTuple::TransportType transport, unsigned short port)
 {
+   resip::Lock lock(mMutex);
    if(port >= mConfig.mAllocationPortRangeMin && port <= mConfig.mAllocationPortRangeMax)
    {
       PortAllocationMap& portAllocationMap = getPortAllocationMap(transport);
@@ -6,19 +6,19 @@
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
 #endif
+#include <rutil/Mutex.hxx>
 #include "ReTurnConfig.hxx"
 #include "StunTuple.hxx"
 
 namespace reTurn {
 
+/// Relay port allocation shared by all server threads - all methods are thread safe
 class TurnManager
 {
 public:
-   explicit TurnManager(asio::io_service& ioService, const ReTurnConfig& config);  // ioService used to start timers
+   explicit TurnManager(const ReTurnConfig& config);
    ~TurnManager();
 
-   asio::io_service& getIOService() { return mIOService; }
-
    unsigned short allocateAnyPort(StunTuple::TransportType transport);
    unsigned short allocateEvenPort(StunTuple::TransportType transport);
    unsigned short allocateOddPort(StunTuple::TransportType transport);
@@ -44,7 +44,7 @@ private:
    PortAllocationMap& getPortAllocationMap(StunTuple::TransportType transport);
    unsigned short advanceLastAllocatedPort(StunTuple::TransportType transport, unsigned int numToAdvance = 1);
 
-   asio::io_service& mIOService;
+   resip::Mutex mMutex;
    const ReTurnConfig& mConfig;
 };
 
@@ -15,6 +15,9 @@ namespace reTurn {
 
 UdpRelayServer::UdpRelayServer(asio::io_service& ioService, TurnAllocation& turnAllocation)
 : AsyncUdpSocketBase(ioService),
+#ifdef RETURN_HAVE_MMSG
+  mReceiveBatchSize(1),
+#endif
   mTurnAllocation(turnAllocation),
   mStopping(false),
   mBindSuccess(false)
@@ -67,6 +70,13 @@ UdpRelayServer::onReceiveSuccess(const asio::ip::address& address, unsigned shor
    {
       return;
    }
+   relayToClient(address, port, data);
+   doReceive();
+}
+
+void
+UdpRelayServer::relayToClient(const asio::ip::address& address, unsigned short port, boost::shared_ptr<DataBuffer>& data)
+{
    if (data->size() > 0)
    {      
       DebugLog(<< "Read " << (int)data->size() << " bytes from udp relay socket (" << address.to_string() << ":" << port << "): ");
@@ -82,8 +92,88 @@ UdpRelayServer::onReceiveSuccess(const asio::ip::address& address, unsigned shor
       // If active destination is not set, then send to client as a DataInd, otherwise send packet as is
       mTurnAllocation.sendDataToClient(StunTuple(StunTuple::UDP, address, port), data);
    }
+}
+
+#ifdef RETURN_HAVE_MMSG
+void
+UdpRelayServer::doReceive()
+{
+   if(!mReceiving)
+   {
+      mReceiving = true;
+      mSocket.async_receive(asio::null_buffers(), 
+         boost::bind(&UdpRelayServer::handleReadable, boost::static_pointer_cast<UdpRelayServer>(shared_from_this()), asio::placeholders::error));
+   }
+}
+
+void
+UdpRelayServer::handleReadable(const asio::error_code& e)
+{
+   mReceiving = false;
+   if(e)
+   {
+      DebugLog(<< "handleReadable with error: " << e);
+      onReceiveFailure(e);
+      return;
+   }
+   if(mStopping)
+   {
+      return;
+   }
+
+   // Buffers are only held for the duration of the call - the ones recvmmsg doesn't fill go back
+   // to the pool on return, so an idle allocation holds none
+   const unsigned int batchSize = mReceiveBatchSize;
+   boost::shared_ptr<DataBuffer> buffers[MaxReceiveBatch];
+   struct mmsghdr msgs[MaxReceiveBatch];
+   struct iovec iovs[MaxReceiveBatch];
+   asio::ip::udp::endpoint senders[MaxReceiveBatch];
+   for(unsigned int i = 0; i < batchSize; i++)
+   {
+      buffers[i] = allocateBuffer(RECEIVE_BUFFER_SIZE);
+      iovs[i].iov_base = buffers[i]->mutableData();
+      iovs[i].iov_len = RECEIVE_BUFFER_SIZE;
+      memset(&msgs[i], 0, sizeof(msgs[i]));
+      msgs[i].msg_hdr.msg_name = senders[i].data();
+      msgs[i].msg_hdr.msg_namelen = (socklen_t)senders[i].capacity();
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+
+   int received = ::recvmmsg(mSocket.native_handle(), msgs, batchSize, MSG_DONTWAIT, 0);
+   if(received < 0)
+   {
+      if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+      {
+         onReceiveFailure(asio::error_code(errno, asio::error::get_system_category()));
+         return;
+      }
+      received = 0;
+   }
+
+   if((unsigned int)received == batchSize)
+   {
+      mReceiveBatchSize = resip::resipMin(batchSize * 2, (unsigned int)MaxReceiveBatch);
+   }
+   else if(batchSize > 1 && (unsigned int)received * 2 < batchSize)
+   {
+      mReceiveBatchSize = batchSize / 2;
+   }
+
+   // Permission and channel lookups happen back to back for the whole batch, and the 
+   // resulting ChannelData/DataInds leave the client socket together when the batch ends
+   mTurnAllocation.beginClientSendBatch();
+   for(int i = 0; i < received; i++)
+   {
+      buffers[i]->truncate(msgs[i].msg_len);
+      senders[i].resize(msgs[i].msg_hdr.msg_namelen);
+      relayToClient(senders[i].address(), senders[i].port(), buffers[i]);
+   }
+   mTurnAllocation.endClientSendBatch();
+
    doReceive();
 }
+#endif
 
 void 
 UdpRelayServer::onReceiveFailure(const asio::error_code& e)
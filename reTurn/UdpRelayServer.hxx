@@ -32,12 +32,26 @@ public:
 private:
    /// Handle completion of a receive_from operation
    virtual void onReceiveSuccess(const asio::ip::address& address, unsigned short port, boost::shared_ptr<DataBuffer>& data);
+   void relayToClient(const asio::ip::address& address, unsigned short port, boost::shared_ptr<DataBuffer>& data);
    virtual void onReceiveFailure(const asio::error_code& e);
 
    /// Handle completion of a send operation
    virtual void onSendSuccess();
    virtual void onSendFailure(const asio::error_code& e);
 
+#ifdef RETURN_HAVE_MMSG
+   enum { MaxReceiveBatch = 32 };  // most datagrams drained by a single recvmmsg call
+
+   /// Waits for the socket to become readable instead of reading a single datagram, 
+   /// handleReadable then drains everything queued on the socket in one go
+   virtual void doReceive();
+   void handleReadable(const asio::error_code& e);
+
+   /// Datagrams the next recvmmsg call asks for.  Doubles while the calls come back full and halves
+   /// once they come back less than half full, so a quiet allocation reads one at a time.
+   unsigned int mReceiveBatchSize;
+#endif
+
    TurnAllocation& mTurnAllocation;
    bool mStopping;
    bool mBindSuccess;
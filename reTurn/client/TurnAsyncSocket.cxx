@@ -715,7 +715,7 @@ TurnAsyncSocket::handleDataInd(StunMessage& stunMessage)
       return asio::error_code(reTurn::UnknownRemoteAddress, asio::error::misc_category);
    }
 
-   boost::shared_ptr<DataBuffer> data(new DataBuffer(stunMessage.mTurnData->data(), stunMessage.mTurnData->size()));
+   boost::shared_ptr<DataBuffer> data = DataBuffer::allocate(stunMessage.mTurnData->data(), (unsigned int)stunMessage.mTurnData->size());
    if(mTurnAsyncSocketHandler) mTurnAsyncSocketHandler->onReceiveSuccess(getSocketDescriptor(), 
       remoteTuple.getAddress(), 
       remoteTuple.getPort(), 
@@ -1010,14 +1010,14 @@ TurnAsyncSocket::handleRefreshResponse(StunMessage &request, StunMessage &respon
 void
 TurnAsyncSocket::send(const char* buffer, unsigned int size)
 {
-   boost::shared_ptr<DataBuffer> data(new DataBuffer(buffer, size));
+   boost::shared_ptr<DataBuffer> data = DataBuffer::allocate(buffer, size);
    sendFramed(data);
 }
 
 void 
 TurnAsyncSocket::sendTo(const asio::ip::address& address, unsigned short port, const char* buffer, unsigned int size)
 {
-   boost::shared_ptr<DataBuffer> data(new DataBuffer(buffer, size));
+   boost::shared_ptr<DataBuffer> data = DataBuffer::allocate(buffer, size);
    sendToFramed(address, port, data);
 }
 
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <csignal>
 #include <string>
+#include <vector>
 #include <asio.hpp>
 #ifdef USE_SSL
 #include <asio/ssl.hpp>
@@ -53,6 +54,80 @@ int main(int argc, char* argv[])
    return proc.main(argc, argv);
 }
 
+static void
+stopIOServices(std::vector<boost::shared_ptr<asio::io_service> >& ioServices)
+{
+   for(unsigned int i = 0; i < ioServices.size(); i++)
+   {
+      ioServices[i]->stop();
+   }
+}
+
+reTurn::TurnServers::TurnServers(asio::io_service& ioService, RequestHandler& requestHandler, const ReTurnConfig& config, bool reusePort)
+{
+   mUdpTurnServer.reset(new UdpServer(ioService, requestHandler, config.mTurnAddress, config.mTurnPort, reusePort));
+   mTcpTurnServer.reset(new TcpServer(ioService, requestHandler, config.mTurnAddress, config.mTurnPort, reusePort));
+#ifdef USE_SSL
+   if(config.mTlsTurnPort != 0)
+   {
+      mTlsTurnServer.reset(new TlsServer(ioService, requestHandler, config.mTurnAddress, config.mTlsTurnPort, reusePort));
+   }
+#endif
+
+#ifdef USE_IPV6
+   mUdpV6TurnServer.reset(new UdpServer(ioService, requestHandler, config.mTurnV6Address, config.mTurnPort, reusePort));
+   mTcpV6TurnServer.reset(new TcpServer(ioService, requestHandler, config.mTurnV6Address, config.mTurnPort, reusePort));
+#ifdef USE_SSL
+   if(config.mTlsTurnPort != 0)
+   {
+      mTlsV6TurnServer.reset(new TlsServer(ioService, requestHandler, config.mTurnV6Address, config.mTlsTurnPort, reusePort));
+   }
+#endif
+#endif
+
+   if(config.mAltStunPort != 0) // if alt stun port is non-zero, then RFC3489 support is enabled
+   {
+      mA1p2StunUdpServer.reset(new UdpServer(ioService, requestHandler, config.mTurnAddress, config.mAltStunPort, reusePort));
+      mA2p1StunUdpServer.reset(new UdpServer(ioService, requestHandler, config.mAltStunAddress, config.mTurnPort, reusePort));
+      mA2p2StunUdpServer.reset(new UdpServer(ioService, requestHandler, config.mAltStunAddress, config.mAltStunPort, reusePort));
+      mUdpTurnServer->setAlternateUdpServers(mA1p2StunUdpServer.get(), mA2p1StunUdpServer.get(), mA2p2StunUdpServer.get());
+      mA1p2StunUdpServer->setAlternateUdpServers(mUdpTurnServer.get(), mA2p2StunUdpServer.get(), mA2p1StunUdpServer.get());
+      mA2p1StunUdpServer->setAlternateUdpServers(mA2p2StunUdpServer.get(), mUdpTurnServer.get(), mA1p2StunUdpServer.get());
+      mA2p2StunUdpServer->setAlternateUdpServers(mA2p1StunUdpServer.get(), mA1p2StunUdpServer.get(), mUdpTurnServer.get());
+   }
+}
+
+void
+reTurn::TurnServers::start()
+{
+   if(mA1p2StunUdpServer)
+   {
+      mA1p2StunUdpServer->start();
+      mA2p1StunUdpServer->start();
+      mA2p2StunUdpServer->start();
+   }
+
+   mUdpTurnServer->start();
+   mTcpTurnServer->start();
+#ifdef USE_SSL
+   if(mTlsTurnServer)
+   {
+      mTlsTurnServer->start();
+   }
+#endif
+
+#ifdef USE_IPV6
+   mUdpV6TurnServer->start();
+   mTcpV6TurnServer->start();
+#ifdef USE_SSL
+   if(mTlsV6TurnServer)
+   {
+      mTlsV6TurnServer->start();
+   }
+#endif
+#endif
+}
+
 reTurn::ReTurnServerProcess::ReTurnServerProcess()
 {
 }
@@ -102,24 +177,17 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       resip::Log::initialize(reTurnConfig.mLoggingType, reTurnConfig.mLoggingLevel, "reTurnServer", reTurnConfig.mLoggingFilename.c_str(), 0, reTurnConfig.mSyslogFacility);
       resip::Log::setMaxLineCount(reTurnConfig.mLoggingFileMaxLineCount);
 
-      // Initialize server.
-      asio::io_service ioService;                                // The one and only ioService for the stunServer
-      reTurn::TurnManager turnManager(ioService, reTurnConfig);  // The one and only Turn Manager
-
-      boost::shared_ptr<reTurn::UdpServer> udpTurnServer;  // also a1p1StunUdpServer
-      boost::shared_ptr<reTurn::TcpServer> tcpTurnServer;
-#ifdef USE_SSL
-      boost::shared_ptr<reTurn::TlsServer> tlsTurnServer;
+      unsigned int numThreads = reTurnConfig.mNumThreads > 0 ? (unsigned int)reTurnConfig.mNumThreads : 1;
+#ifndef SO_REUSEPORT
+      if(numThreads > 1)
+      {
+         WarningLog(<< "NumThreads=" << numThreads << " requires SO_REUSEPORT, which is not available on this platform - using 1 thread");
+         numThreads = 1;
+      }
 #endif
-      boost::shared_ptr<reTurn::UdpServer> a1p2StunUdpServer;
-      boost::shared_ptr<reTurn::UdpServer> a2p1StunUdpServer;
-      boost::shared_ptr<reTurn::UdpServer> a2p2StunUdpServer;
 
-#ifdef USE_IPV6
-      boost::shared_ptr<reTurn::UdpServer> udpV6TurnServer;
-      boost::shared_ptr<reTurn::TcpServer> tcpV6TurnServer;
-      boost::shared_ptr<reTurn::TlsServer> tlsV6TurnServer;
-#endif
+      // Initialize server.
+      reTurn::TurnManager turnManager(reTurnConfig);  // The one and only Turn Manager
 
       // The one and only RequestHandler - if altStunPort is non-zero, then assume RFC3489 support is enabled and pass settings to request handler
       reTurn::RequestHandler requestHandler(turnManager, 
@@ -128,57 +196,19 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mAltStunAddress : 0, 
          reTurnConfig.mAltStunPort != 0 ? &reTurnConfig.mAltStunPort : 0); 
 
-      udpTurnServer.reset(new reTurn::UdpServer(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort));
-      tcpTurnServer.reset(new reTurn::TcpServer(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTurnPort));
-#ifdef USE_SSL
-      if(reTurnConfig.mTlsTurnPort != 0)
+      // One ioService, and one set of listening sockets, per thread.  Allocations (and their relays)
+      // belong to the socket that received the Allocate request, so they stay on that thread.
+      std::vector<boost::shared_ptr<asio::io_service> > ioServices;
+      std::vector<boost::shared_ptr<reTurn::TurnServers> > turnServers;
+      for(unsigned int i = 0; i < numThreads; i++)
       {
-         tlsTurnServer.reset(new reTurn::TlsServer(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mTlsTurnPort));
+         ioServices.push_back(boost::shared_ptr<asio::io_service>(new asio::io_service));
+         turnServers.push_back(boost::shared_ptr<reTurn::TurnServers>(new reTurn::TurnServers(*ioServices.back(), requestHandler, reTurnConfig, numThreads > 1)));
       }
-#endif
-
-#ifdef USE_IPV6
-      udpV6TurnServer.reset(new reTurn::UdpServer(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort));
-      tcpV6TurnServer.reset(new reTurn::TcpServer(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTurnPort));
-      if(reTurnConfig.mTlsTurnPort != 0)
+      for(unsigned int i = 0; i < numThreads; i++)
       {
-         tlsV6TurnServer.reset(new reTurn::TlsServer(ioService, requestHandler, reTurnConfig.mTurnV6Address, reTurnConfig.mTlsTurnPort));
+         turnServers[i]->start();
       }
-#endif
-
-      if(reTurnConfig.mAltStunPort != 0) // if alt stun port is non-zero, then RFC3489 support is enabled
-      {
-         a1p2StunUdpServer.reset(new reTurn::UdpServer(ioService, requestHandler, reTurnConfig.mTurnAddress, reTurnConfig.mAltStunPort));
-         a2p1StunUdpServer.reset(new reTurn::UdpServer(ioService, requestHandler, reTurnConfig.mAltStunAddress, reTurnConfig.mTurnPort));
-         a2p2StunUdpServer.reset(new reTurn::UdpServer(ioService, requestHandler, reTurnConfig.mAltStunAddress, reTurnConfig.mAltStunPort));
-         udpTurnServer->setAlternateUdpServers(a1p2StunUdpServer.get(), a2p1StunUdpServer.get(), a2p2StunUdpServer.get());
-         a1p2StunUdpServer->setAlternateUdpServers(udpTurnServer.get(), a2p2StunUdpServer.get(), a2p1StunUdpServer.get());
-         a2p1StunUdpServer->setAlternateUdpServers(a2p2StunUdpServer.get(), udpTurnServer.get(), a1p2StunUdpServer.get());
-         a2p2StunUdpServer->setAlternateUdpServers(a2p1StunUdpServer.get(), a1p2StunUdpServer.get(), udpTurnServer.get());
-         a1p2StunUdpServer->start();
-         a2p1StunUdpServer->start();
-         a2p2StunUdpServer->start();
-      }
-
-      udpTurnServer->start();
-      tcpTurnServer->start();
-#ifdef USE_SSL
-      if(tlsTurnServer)
-      {
-         tlsTurnServer->start();
-      }
-#endif
-
-#ifdef USE_IPV6
-      udpV6TurnServer->start();
-      tcpV6TurnServer->start();
-#ifdef USE_SSL
-      if(tlsV6TurnServer)
-      {
-         tlsV6TurnServer->start();
-      }
-#endif
-#endif
 
       // Drop privileges (can do this now that sockets are bound)
       if(!reTurnConfig.mRunAsUser.empty())
@@ -187,12 +217,12 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
          dropPrivileges(reTurnConfig.mRunAsUser, reTurnConfig.mRunAsGroup);
       }
 
-      ReTurnUserFileScanner userFileScanner(ioService, reTurnConfig);
+      ReTurnUserFileScanner userFileScanner(*ioServices.front(), reTurnConfig);
       userFileScanner.start();
 
 #ifdef _WIN32
       // Set console control handler to allow server to be stopped.
-      console_ctrl_function = boost::bind(&asio::io_service::stop, &ioService);
+      console_ctrl_function = boost::bind(&stopIOServices, boost::ref(ioServices));
       SetConsoleCtrlHandler(console_ctrl_handler, TRUE);
 #else
       // Block all signals for background thread.
@@ -202,10 +232,15 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       pthread_sigmask(SIG_BLOCK, &new_mask, &old_mask);
 #endif
 
-      // Run the ioService until stopped.
+      // Run the ioServices until stopped.
       // Create a pool of threads to run all of the io_services.
-      boost::shared_ptr<asio::thread> thread(new asio::thread(
-         boost::bind(&asio::io_service::run, &ioService)));
+      std::vector<boost::shared_ptr<asio::thread> > threads;
+      for(unsigned int i = 0; i < numThreads; i++)
+      {
+         threads.push_back(boost::shared_ptr<asio::thread>(new asio::thread(
+            boost::bind(&asio::io_service::run, ioServices[i].get()))));
+      }
+      InfoLog(<< "reTurnServer running with " << numThreads << " thread(s)");
 
 #ifndef _WIN32
       // Restore previous signals.
@@ -220,11 +255,14 @@ reTurn::ReTurnServerProcess::main(int argc, char* argv[])
       pthread_sigmask(SIG_BLOCK, &wait_mask, 0);
       int sig = 0;
       sigwait(&wait_mask, &sig);
-      ioService.stop();
+      stopIOServices(ioServices);
 #endif
 
-      // Wait for thread to exit
-      thread->join();
+      // Wait for threads to exit
+      for(unsigned int i = 0; i < threads.size(); i++)
+      {
+         threads[i]->join();
+      }
    }
    catch (std::exception& e)
    {
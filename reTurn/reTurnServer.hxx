@@ -3,11 +3,46 @@
   #include "config.h"
 #endif
 
+#include <asio.hpp>
+#include <boost/shared_ptr.hpp>
 #include "rutil/ServerProcess.hxx"
 
 namespace reTurn
 {
 
+class ReTurnConfig;
+class RequestHandler;
+class UdpServer;
+class TcpServer;
+class TlsServer;
+
+/// The listening sockets served by one thread (and its io_service)
+class TurnServers
+{
+public:
+   TurnServers(asio::io_service& ioService, RequestHandler& requestHandler, const ReTurnConfig& config, bool reusePort);
+
+   void start();
+
+private:
+   boost::shared_ptr<UdpServer> mUdpTurnServer;  // also a1p1StunUdpServer
+   boost::shared_ptr<TcpServer> mTcpTurnServer;
+#ifdef USE_SSL
+   boost::shared_ptr<TlsServer> mTlsTurnServer;
+#endif
+   boost::shared_ptr<UdpServer> mA1p2StunUdpServer;
+   boost::shared_ptr<UdpServer> mA2p1StunUdpServer;
+   boost::shared_ptr<UdpServer> mA2p2StunUdpServer;
+
+#ifdef USE_IPV6
+   boost::shared_ptr<UdpServer> mUdpV6TurnServer;
+   boost::shared_ptr<TcpServer> mTcpV6TurnServer;
+#ifdef USE_SSL
+   boost::shared_ptr<TlsServer> mTlsV6TurnServer;
+#endif
+#endif
+};
+
 class ReTurnServerProcess : public resip::ServerProcess
 {
 public:
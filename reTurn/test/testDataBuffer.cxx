@@ -0,0 +1,285 @@
+// Tests pooled DataBuffer allocation and the TURN ChannelData framing done by AsyncSocketBase::doSend
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <asio.hpp>
+
+#include "../AsyncSocketBase.hxx"
+#include "../DataBuffer.hxx"
+#include "../StunTuple.hxx"
+#include <rutil/Logger.hxx>
+#include <rutil/ThreadIf.hxx>
+
+using namespace reTurn;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM resip::Subsystem::TEST
+
+// Socket that records the buffers handed to the transport instead of sending them
+class RecordingSocket : public AsyncSocketBase
+{
+public:
+   RecordingSocket(asio::io_service& ioService) : AsyncSocketBase(ioService) {}
+
+   virtual unsigned int getSocketDescriptor() { return 0; }
+   virtual asio::error_code bind(const asio::ip::address& address, unsigned short port) { return asio::error_code(); }
+   virtual void connect(const std::string& address, unsigned short port) {}
+
+   virtual void onReceiveSuccess(const asio::ip::address& address, unsigned short port, boost::shared_ptr<DataBuffer>& data) {}
+   virtual void onReceiveFailure(const asio::error_code& e) {}
+   virtual void onSendSuccess() {}
+   virtual void onSendFailure(const asio::error_code& e) {}
+
+   /// Completes the send last handed to transportSend
+   void completeSend() { handleSend(asio::error_code()); }
+
+   /// One entry per buffer of the last transportSend
+   vector<string> mSent;
+
+private:
+   virtual void transportSend(const StunTuple& destination, std::vector<asio::const_buffer>& buffers)
+   {
+      mSent.clear();
+      for(std::vector<asio::const_buffer>::iterator it = buffers.begin(); it != buffers.end(); it++)
+      {
+         mSent.push_back(string(asio::buffer_cast<const char*>(*it), asio::buffer_size(*it)));
+      }
+   }
+   virtual void transportReceive() {}
+   virtual void transportFramedReceive() {}
+   virtual void transportClose() {}
+
+   virtual const asio::ip::address getSenderEndpointAddress() { return asio::ip::address(); }
+   virtual unsigned short getSenderEndpointPort() { return 0; }
+};
+
+static string
+contents(boost::shared_ptr<DataBuffer>& data)
+{
+   return string(data->data(), data->size());
+}
+
+static void
+testPool()
+{
+   boost::shared_ptr<DataBuffer> buffer = DataBuffer::allocate(100);
+   assert(buffer->size() == 100);
+   assert(buffer->headroom() == DataBuffer::DefaultHeadroom);
+
+   // prepend and offset move the start back and forth within the same block
+   const char* start = buffer->data();
+   char* front = buffer->prepend(4);
+   assert(front == start - 4);
+   assert(buffer->size() == 104);
+   assert(buffer->headroom() == 0);
+   buffer->offset(4);
+   assert(buffer->data() == start);
+   assert(buffer->size() == 100);
+
+   // operator[] indexes from the current start
+   (*buffer)[0] = 'a';
+   (*buffer)[1] = 'b';
+   buffer->offset(1);
+   assert((*buffer)[0] == 'b');
+   assert(buffer->headroom() == DataBuffer::DefaultHeadroom + 1);
+
+   // A released block is handed out again by the next allocation that fits
+   const char* block = buffer->data() - buffer->headroom();
+   buffer.reset();
+   buffer = DataBuffer::allocate("hello", 5);
+   assert(buffer->data() - buffer->headroom() == block);
+   assert(contents(buffer) == "hello");
+   assert(buffer->headroom() == DataBuffer::DefaultHeadroom);
+
+   // Anything bigger than a block comes from the heap, with the same headroom
+   boost::shared_ptr<DataBuffer> large = DataBuffer::allocate(DataBuffer::PoolBlockSize);
+   assert(large->size() == (unsigned int)DataBuffer::PoolBlockSize);
+   assert(large->headroom() == DataBuffer::DefaultHeadroom);
+   memset(large->mutableData(), 'x', large->size());
+   large->prepend(4);
+   assert(large->size() == (unsigned int)DataBuffer::PoolBlockSize + 4);
+
+   boost::shared_ptr<DataBuffer> empty = DataBuffer::allocate(0u, 0u);
+   assert(empty->size() == 0);
+   assert(empty->headroom() == 0);
+}
+
+// Allocates and releases a buffer on a thread of its own, keeping a second one for the caller
+class PoolThread : public resip::ThreadIf
+{
+public:
+   PoolThread() : mReleased(0), mReused(false) {}
+
+   virtual void thread()
+   {
+      boost::shared_ptr<DataBuffer> buffer = DataBuffer::allocate(100);
+      mReleased = buffer->data() - buffer->headroom();
+      buffer.reset();
+      mKept = DataBuffer::allocate("kept", 4);
+      mReused = mKept->data() - mKept->headroom() == mReleased;
+   }
+
+   const char* mReleased;
+   bool mReused;
+   boost::shared_ptr<DataBuffer> mKept;
+};
+
+static void
+testThreadPool()
+{
+   boost::shared_ptr<DataBuffer> buffer = DataBuffer::allocate(100);
+   const char* block = buffer->data() - buffer->headroom();
+   buffer.reset();
+
+   // Each thread reuses what it released itself, and never sees another thread's free list
+   PoolThread thread;
+   thread.run();
+   thread.join();
+   assert(thread.mReused);
+   assert(thread.mReleased != block);
+
+   // The thread's pool went with it; a buffer it allocated can still be released here, and
+   // joins this thread's free list
+   assert(contents(thread.mKept) == "kept");
+   const char* kept = thread.mKept->data() - thread.mKept->headroom();
+   thread.mKept.reset();
+   buffer = DataBuffer::allocate(100);
+   assert(buffer->data() - buffer->headroom() == kept);
+   boost::shared_ptr<DataBuffer> next = DataBuffer::allocate(100);
+   assert(next->data() - next->headroom() == block);
+}
+
+static void
+testFraming()
+{
+   asio::io_service ioService;
+   boost::shared_ptr<RecordingSocket> socket(new RecordingSocket(ioService));
+   StunTuple destination(StunTuple::UDP, asio::ip::address::from_string("10.0.0.2"), 5001);
+   const string header("\x40\x01\x00\x05", 4);  // channel 0x4001, length 5
+
+   // Unframed data goes out as is
+   {
+      boost::shared_ptr<DataBuffer> data = DataBuffer::allocate("hello", 5);
+      socket->doSend(destination, data);
+      assert(socket->mSent.size() == 1);
+      assert(socket->mSent[0] == "hello");
+      socket->completeSend();
+   }
+
+   // A buffer nobody else holds is framed in its own headroom, and restored once sent
+   {
+      boost::shared_ptr<DataBuffer> data = DataBuffer::allocate("hello", 5);
+      const char* start = data->data();
+      socket->doSend(destination, 0x4001, data);
+      assert(socket->mSent.size() == 1);
+      assert(socket->mSent[0] == header + "hello");
+      assert(data->data() == start - 4);
+      socket->completeSend();
+      assert(data->data() == start);
+      assert(contents(data) == "hello");
+   }
+
+   // A shared buffer is left alone - a framed copy is sent instead
+   {
+      boost::shared_ptr<DataBuffer> data = DataBuffer::allocate("hello", 5);
+      boost::shared_ptr<DataBuffer> otherOwner = data;
+      const char* start = data->data();
+      socket->doSend(destination, 0x4001, data);
+      assert(socket->mSent.size() == 1);
+      assert(socket->mSent[0] == header + "hello");
+      assert(otherOwner->data() == start);
+      assert(otherOwner->headroom() == DataBuffer::DefaultHeadroom);
+      assert(contents(otherOwner) == "hello");
+      socket->completeSend();
+      assert(contents(otherOwner) == "hello");
+   }
+
+   // Without headroom the framing goes in a buffer of its own
+   {
+      boost::shared_ptr<DataBuffer> data(new DataBuffer("hello", 5));
+      socket->doSend(destination, 0x4001, data);
+      assert(socket->mSent.size() == 2);
+      assert(socket->mSent[0] == header);
+      assert(socket->mSent[1] == "hello");
+      socket->completeSend();
+      assert(contents(data) == "hello");
+   }
+
+   // As it does when resuming part way through a buffer
+   {
+      boost::shared_ptr<DataBuffer> data = DataBuffer::allocate("hello", 5);
+      socket->doSend(destination, 0x4001, data, 2);
+      assert(socket->mSent.size() == 2);
+      assert(socket->mSent[0] == header);
+      assert(socket->mSent[1] == "llo");
+      socket->completeSend();
+      assert(contents(data) == "hello");
+      assert(data->headroom() == DataBuffer::DefaultHeadroom);
+   }
+
+   // Data queued behind a send in flight is framed the same way once its turn comes
+   {
+      boost::shared_ptr<DataBuffer> first = DataBuffer::allocate("hello", 5);
+      boost::shared_ptr<DataBuffer> second = DataBuffer::allocate("world", 5);
+      boost::shared_ptr<DataBuffer> otherOwner = second;
+      socket->doSend(destination, 0x4001, first);
+      socket->doSend(destination, 0x4001, second);
+      assert(socket->mSent.size() == 1);
+      assert(socket->mSent[0] == header + "hello");
+      socket->completeSend();
+      assert(socket->mSent.size() == 1);
+      assert(socket->mSent[0] == header + "world");
+      assert(contents(otherOwner) == "world");
+      socket->completeSend();
+      assert(contents(first) == "hello");
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   resip::Log::initialize(resip::Log::Cout, resip::Log::Info, "");
+
+   testPool();
+   testThreadPool();
+   testFraming();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+
+/* ====================================================================
+
+ Copyright (c) 2007-2008, SIP Spectrum, Inc.
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are 
+ met:
+
+ 1. Redistributions of source code must retain the above copyright 
+    notice, this list of conditions and the following disclaimer. 
+
+ 2. Redistributions in binary form must reproduce the above copyright
+    notice, this list of conditions and the following disclaimer in the
+    documentation and/or other materials provided with the distribution. 
+
+ 3. Neither the name of SIP Spectrum nor the names of its contributors 
+    may be used to endorse or promote products derived from this 
+    software without specific prior written permission. 
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR 
+ A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT 
+ OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+ SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT 
+ LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, 
+ DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY 
+ THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE 
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ ==================================================================== */
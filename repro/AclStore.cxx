@@ -52,6 +52,7 @@ AclStore::AclStore(AbstractDb& db):
    } 
    mTlsPeerNameCursor = mTlsPeerNameList.begin();
    mAddressCursor = mAddressList.begin();
+   rebuildIndex();
 }
 
 AclStore::~AclStore()
@@ -114,6 +115,7 @@ AclStore::addAcl(const resip::Data& tlsPeerName,
          WriteLock lock(mMutex);
          mAddressList.push_back(addressRecord);
          mAddressCursor = mAddressList.begin();  // Put cursor back at start
+         rebuildIndex();
       }
    }
    else
@@ -125,6 +127,7 @@ AclStore::addAcl(const resip::Data& tlsPeerName,
          WriteLock lock(mMutex);
          mTlsPeerNameList.push_back(tlsPeerNameRecord); 
          mTlsPeerNameCursor = mTlsPeerNameList.begin(); // Put cursor back at start
+         rebuildIndex();
       }
    }
    return true;
@@ -311,6 +314,7 @@ AclStore::eraseAcl(const resip::Data& key)
       if(findAddressKey(key))
       {
          mAddressCursor = mAddressList.erase(mAddressCursor);
+         rebuildIndex();
       }
    }
    else
@@ -319,6 +323,7 @@ AclStore::eraseAcl(const resip::Data& key)
       if(findTlsPeerNameKey(key))
       {
          mTlsPeerNameCursor = mTlsPeerNameList.erase(mTlsPeerNameCursor);
+         rebuildIndex();
       }
    }
 }
@@ -496,16 +501,13 @@ AclStore::getAddressMask( const resip::Data& key )
 bool 
 AclStore::isTlsPeerNameTrusted(const std::list<Data>& tlsPeerNames)
 {
-   ReadLock lock(mMutex);
+   SharedPtr<AclIndex> index = getIndex();
    for(std::list<Data>::const_iterator it = tlsPeerNames.begin(); it != tlsPeerNames.end(); it++)
    {
-      for(TlsPeerNameList::iterator i = mTlsPeerNameList.begin(); i != mTlsPeerNameList.end(); i++)
+      if(index->isTlsPeerNameTrusted(*it))
       {
-         if(isEqualNoCase(i->mTlsPeerName, *it))
-         {
-            InfoLog (<< "AclStore - Tls peer name IS trusted: " << *it);
-            return true;
-         }
+         InfoLog (<< "AclStore - Tls peer name IS trusted: " << *it);
+         return true;
       }
    }
    return false;
@@ -515,18 +517,142 @@ AclStore::isTlsPeerNameTrusted(const std::list<Data>& tlsPeerNames)
 bool 
 AclStore::isAddressTrusted(const Tuple& address)
 {
-   ReadLock lock(mMutex);
-   for(AddressList::iterator i = mAddressList.begin(); i != mAddressList.end(); i++)
+   return getIndex()->isAddressTrusted(address);
+}
+
+
+void
+AclStore::rebuildIndex()
+{
+   SharedPtr<AclIndex> index(new AclIndex(mAddressList, mTlsPeerNameList));
+   Lock lock(mIndexMutex);
+   mIndex.swap(index);
+}
+
+
+SharedPtr<AclStore::AclIndex>
+AclStore::getIndex()
+{
+   Lock lock(mIndexMutex);
+   return mIndex;
+}
+
+
+AclStore::AclIndex::AclIndex(const AddressList& addresses, const TlsPeerNameList& tlsPeerNames)
+{
+   mTries[0].resize(1);
+   mTries[1].resize(1);
+   for(AddressList::const_iterator it = addresses.begin(); it != addresses.end(); it++)
    {
-      if(i->mAddressTuple.isEqualWithMask(address, i->mMask, i->mAddressTuple.getPort() == 0))
+      const unsigned char* bits;
+      unsigned int bitCount;
+      unsigned int trieNum;
+      if(!getAddressBits(it->mAddressTuple, bits, bitCount, trieNum))
       {
-         return true;
+         continue;
+      }
+      Trie& trie = mTries[trieNum];
+      unsigned int prefixLength = it->mMask < 0 ? 0 : (unsigned int)it->mMask;
+      if(prefixLength > bitCount)
+      {
+         prefixLength = bitCount;
+      }
+
+      unsigned int node = 0;
+      for(unsigned int i = 0; i < prefixLength; i++)
+      {
+         unsigned int bit = (bits[i >> 3] >> (7 - (i & 7))) & 1;
+         if(trie[node].mChild[bit] == 0)
+         {
+            trie[node].mChild[bit] = (unsigned int)trie.size();
+            trie.push_back(Node());  // invalidates references into trie, so index by number only
+         }
+         node = trie[node].mChild[bit];
       }
+      Entry entry;
+      entry.mPort = it->mAddressTuple.getPort();
+      entry.mTransport = it->mAddressTuple.getType();
+      trie[node].mEntries.push_back(entry);
    }
+
+   for(TlsPeerNameList::const_iterator it = tlsPeerNames.begin(); it != tlsPeerNames.end(); it++)
+   {
+      Data name(it->mTlsPeerName);
+      mTlsPeerNames.insert(name.lowercase());
+   }
+}
+
+
+bool
+AclStore::AclIndex::getAddressBits(const Tuple& address, const unsigned char*& bits, unsigned int& bitCount, unsigned int& trie)
+{
+   if(address.getSockaddr().sa_family == AF_INET)
+   {
+      bits = (const unsigned char*)&reinterpret_cast<const sockaddr_in&>(address.getSockaddr()).sin_addr;
+      bitCount = 32;
+      trie = 0;
+      return true;
+   }
+#ifdef USE_IPV6
+   if(address.getSockaddr().sa_family == AF_INET6)
+   {
+      bits = reinterpret_cast<const sockaddr_in6&>(address.getSockaddr()).sin6_addr.s6_addr;
+      bitCount = 128;
+      trie = 1;
+      return true;
+   }
+#endif
    return false;
 }
 
 
+bool
+AclStore::AclIndex::isAddressTrusted(const Tuple& address) const
+{
+   const unsigned char* bits;
+   unsigned int bitCount;
+   unsigned int trieNum;
+   if(!getAddressBits(address, bits, bitCount, trieNum))
+   {
+      return false;
+   }
+   const Trie& trie = mTries[trieNum];
+   int port = address.getPort();
+   TransportType transport = address.getType();
+
+   // Any ACL along the path covers the address - same test as Tuple::isEqualWithMask
+   unsigned int node = 0;
+   for(unsigned int i = 0; ; i++)
+   {
+      const std::vector<Entry>& entries = trie[node].mEntries;
+      for(std::vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); it++)
+      {
+         if(it->mTransport == transport && (it->mPort == 0 || it->mPort == port))
+         {
+            return true;
+         }
+      }
+      if(i == bitCount)
+      {
+         return false;
+      }
+      node = trie[node].mChild[(bits[i >> 3] >> (7 - (i & 7))) & 1];
+      if(node == 0)
+      {
+         return false;
+      }
+   }
+}
+
+
+bool
+AclStore::AclIndex::isTlsPeerNameTrusted(const Data& tlsPeerName) const
+{
+   Data name(tlsPeerName);
+   return mTlsPeerNames.find(name.lowercase()) != mTlsPeerNames.end();
+}
+
+
 // check the sender of the message via source IP address or identity from TLS 
 bool
 AclStore::isRequestTrusted(const SipMessage& request)
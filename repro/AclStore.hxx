@@ -2,8 +2,12 @@
 #define REPRO_ACLSTORE_HXX
 
 #include <list>
+#include <vector>
 #include "rutil/Data.hxx"
+#include "rutil/HashMap.hxx"
+#include "rutil/Mutex.hxx"
 #include "rutil/RWMutex.hxx"
+#include "rutil/SharedPtr.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/Tuple.hxx"
 #include "repro/AbstractDb.hxx"
@@ -88,6 +92,49 @@ class AclStore
       TlsPeerNameList::iterator mTlsPeerNameCursor;
       AddressList mAddressList;
       AddressList::iterator mAddressCursor;
+
+      // What isAddressTrusted() and isTlsPeerNameTrusted() consult instead of
+      // scanning the lists. Address ACLs are filed in a binary trie per IP
+      // version under their masked prefix, so one walk down the bits of the
+      // source address visits every ACL that covers it, whatever the size of
+      // the list. TLS peer names are kept lowercased in a hash set. An index
+      // is never modified: each ACL change builds a new one from the lists
+      // and swaps it in, so a request only holds mIndexMutex long enough to
+      // take a reference to the current one.
+      class AclIndex
+      {
+         public:
+            AclIndex(const AddressList& addresses, const TlsPeerNameList& tlsPeerNames);
+
+            bool isAddressTrusted(const resip::Tuple& address) const;
+            bool isTlsPeerNameTrusted(const resip::Data& tlsPeerName) const;
+
+         private:
+            class Entry
+            {
+               public:
+                  int mPort;  // 0 matches any port
+                  resip::TransportType mTransport;
+            };
+            class Node
+            {
+               public:
+                  Node() { mChild[0] = mChild[1] = 0; }
+                  unsigned int mChild[2];  // 0 for none - the root is never a child
+                  std::vector<Entry> mEntries;  // ACLs whose prefix ends here
+            };
+            typedef std::vector<Node> Trie;  // element 0 is the root
+
+            static bool getAddressBits(const resip::Tuple& address, const unsigned char*& bits, unsigned int& bitCount, unsigned int& trie);
+
+            Trie mTries[2];  // IPv4, IPv6
+            HashSet<resip::Data> mTlsPeerNames;
+      };
+      void rebuildIndex();  // call with mMutex held
+      resip::SharedPtr<AclIndex> getIndex();
+
+      resip::Mutex mIndexMutex;
+      resip::SharedPtr<AclIndex> mIndex;
 };
 
 }
@@ -1,5 +1,6 @@
 #include "rutil/ResipAssert.h"
 #include <fcntl.h>
+#include <cstring>
 
 #ifdef HAVE_CONFIG_H
 #include "config.h"
@@ -104,9 +105,19 @@ MySqlDb::MySqlDb(const resip::ConfigParse& config,
 
 MySqlDb::~MySqlDb()
 {
+   closePooledConnections();
    disconnectFromDatabase();
 }
 
+MySqlDb::MySqlConnection::~MySqlConnection()
+{
+   if(mUserAuthStmt)
+   {
+      mysql_stmt_close(mUserAuthStmt);
+   }
+   mysql_close(mConn);
+}
+
 void
 MySqlDb::initialize() const
 {
@@ -147,14 +158,24 @@ MySqlDb::connectToDatabase() const
    resip_assert(mConn == 0);
    resip_assert(isConnected() == false);
 
-   mConn = mysql_init(0);
-   if(mConn == 0)
+   int rc;
+   mConn = openConnection(rc);
+   setConnected(mConn != 0);
+   return rc;
+}
+
+MYSQL*
+MySqlDb::openConnection(int& rc) const
+{
+   MYSQL* conn = mysql_init(0);
+   if(conn == 0)
    {
       ErrLog( << "MySQL init failed: insufficient memory.");
-      return CR_OUT_OF_MEMORY;
+      rc = CR_OUT_OF_MEMORY;
+      return 0;
    }
 
-   MYSQL* ret = mysql_real_connect(mConn,
+   MYSQL* ret = mysql_real_connect(conn,
                                    mDBServer.c_str(),   // hostname
                                    mDBUser.c_str(),     // user
                                    mDBPassword.c_str(), // password
@@ -165,18 +186,48 @@ MySqlDb::connectToDatabase() const
 
    if (ret == 0)
    { 
-      int rc = mysql_errno(mConn);
-      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(mConn));
-      mysql_close(mConn); 
-      mConn = 0;
-      setConnected(false);
-      return rc;
+      rc = mysql_errno(conn);
+      ErrLog( << "MySQL connect failed: error=" << rc << ": " << mysql_error(conn));
+      mysql_close(conn); 
+      return 0;
    }
-   else
+   rc = 0;
+   return conn;
+}
+
+SqlDb::PooledConnection*
+MySqlDb::createPooledConnection() const
+{
+   initialize();
+
+   int rc;
+   MYSQL* conn = openConnection(rc);
+   if(conn == 0)
    {
-      setConnected(true);
       return 0;
    }
+   MySqlConnection* connection = new MySqlConnection(conn);
+
+   if(mCustomUserAuthQuery.empty())
+   {
+      Data command;
+      {
+         DataStream ds(command);
+         ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE user = ? AND domain = ?";
+      }
+      connection->mUserAuthStmt = mysql_stmt_init(conn);
+      if(connection->mUserAuthStmt == 0 || 
+         mysql_stmt_prepare(connection->mUserAuthStmt, command.data(), (unsigned long)command.size()) != 0)
+      {
+         ErrLog( << "MySQL prepare failed: error=" << mysql_errno(conn) << ": " << mysql_error(conn) << ", SQL Command was: " << command);
+         if(connection->mUserAuthStmt)
+         {
+            mysql_stmt_close(connection->mUserAuthStmt);
+            connection->mUserAuthStmt = 0;  // fall back to text queries on this connection
+         }
+      }
+   }
+   return connection;
 }
 
 int
@@ -254,6 +305,21 @@ int
 MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields) const
 {
    StackLog(<<"executing query: " << queryCommand);
+   {
+      PooledConnectionGuard guard(*this);
+      if(guard.get())
+      {
+         int rc = pooledSingleResultQuery(static_cast<MySqlConnection&>(*guard.get()), queryCommand, fields);
+         if(rc != CR_SERVER_GONE_ERROR && rc != CR_SERVER_LOST)
+         {
+            return rc;
+         }
+         // Drop the connection, and let the shared one (which reconnects) run the query this time
+         guard.setBroken();
+         fields.clear();
+      }
+   }
+
    MYSQL_RES* result=0;
    int rc = query(queryCommand, &result);
       
@@ -289,6 +355,136 @@ MySqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields)
    return rc;
 }
 
+int
+MySqlDb::pooledSingleResultQuery(MySqlConnection& connection, const Data& queryCommand, std::vector<Data>& fields) const
+{
+   initialize();
+
+   DebugLog( << "MySqlDb::pooledSingleResultQuery: executing query: " << queryCommand);
+
+   int rc = mysql_query(connection.mConn, queryCommand.c_str());
+   if(rc != 0)
+   {
+      rc = mysql_errno(connection.mConn);
+      ErrLog( << "MySQL query failed: error=" << rc << ": " << mysql_error(connection.mConn) << ", SQL Command was: " << queryCommand);
+      return rc;
+   }
+
+   MYSQL_RES* result = mysql_store_result(connection.mConn);
+   if(result == 0)
+   {
+      rc = mysql_errno(connection.mConn);
+      if(rc != 0)
+      {
+         ErrLog( << "MySQL store result failed: error=" << rc << ": " << mysql_error(connection.mConn));
+      }
+      return rc;
+   }
+
+   MYSQL_ROW row = mysql_fetch_row(result);
+   if(row)
+   {
+      for(unsigned int i = 0; i < result->field_count; i++)
+      {
+         fields.push_back(Data(row[i]));
+      }
+   }
+   else
+   {
+      rc = mysql_errno(connection.mConn);
+      if(rc != 0)
+      {
+         ErrLog( << "MySQL fetch row failed: error=" << rc << ": " << mysql_error(connection.mConn));
+      }
+      else
+      {
+         DebugLog(<<"singleResultQuery: no rows returned by query");
+      }
+   }
+   mysql_free_result(result);
+
+   // A stored procedure leaves a status result behind - read it off, so the connection can go back to the pool
+   while(mysql_next_result(connection.mConn) == 0)
+   {
+      MYSQL_RES* extra = mysql_store_result(connection.mConn);
+      if(extra)
+      {
+         mysql_free_result(extra);
+      }
+   }
+   return rc;
+}
+
+int
+MySqlDb::pooledUserAuthQuery(MySqlConnection& connection, const Data& user, const Data& domain, Data& passwordHash) const
+{
+   initialize();
+
+   MYSQL_STMT* stmt = connection.mUserAuthStmt;
+
+   MYSQL_BIND params[2];
+   memset(params, 0, sizeof(params));
+   unsigned long userLength = (unsigned long)user.size();
+   unsigned long domainLength = (unsigned long)domain.size();
+   params[0].buffer_type = MYSQL_TYPE_STRING;
+   params[0].buffer = (void*)user.data();
+   params[0].buffer_length = userLength;
+   params[0].length = &userLength;
+   params[1].buffer_type = MYSQL_TYPE_STRING;
+   params[1].buffer = (void*)domain.data();
+   params[1].buffer_length = domainLength;
+   params[1].length = &domainLength;
+
+   char hash[128];
+   unsigned long hashLength = 0;
+   MYSQL_BIND column;
+   memset(&column, 0, sizeof(column));
+   column.buffer_type = MYSQL_TYPE_STRING;
+   column.buffer = hash;
+   column.buffer_length = sizeof(hash);
+   column.length = &hashLength;
+
+   if(mysql_stmt_bind_param(stmt, params) != 0 ||
+      mysql_stmt_execute(stmt) != 0 ||
+      mysql_stmt_store_result(stmt) != 0 ||
+      mysql_stmt_bind_result(stmt, &column) != 0)
+   {
+      int rc = mysql_stmt_errno(stmt);
+      ErrLog( << "MySQL user auth statement failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+      mysql_stmt_free_result(stmt);
+      return rc;
+   }
+
+   int rc = mysql_stmt_fetch(stmt);
+   if(rc == 0 || rc == MYSQL_DATA_TRUNCATED)
+   {
+      if(hashLength > sizeof(hash))
+      {
+         // Longer than any A1 hash - fetch the whole column
+         column.buffer = passwordHash.getBuf((Data::size_type)hashLength);
+         column.buffer_length = hashLength;
+         rc = mysql_stmt_fetch_column(stmt, &column, 0, 0);
+      }
+      else
+      {
+         passwordHash = Data(hash, (Data::size_type)hashLength);
+         rc = 0;
+      }
+   }
+   else if(rc == MYSQL_NO_DATA)
+   {
+      DebugLog(<<"pooledUserAuthQuery: no rows returned by query");
+      rc = 0;
+   }
+   else
+   {
+      rc = mysql_stmt_errno(stmt);
+      ErrLog( << "MySQL user auth fetch failed: error=" << rc << ": " << mysql_stmt_error(stmt));
+   }
+   mysql_stmt_free_result(stmt);
+   return rc;
+}
+
 resip::Data& 
 MySqlDb::escapeString(const resip::Data& str, resip::Data& escapedStr) const
 {
@@ -376,12 +572,30 @@ MySqlDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
 { 
    std::vector<Data> ret;
 
+   Data user;
+   Data domain;
+   UserStore::getUserAndDomainFromKey(key, user, domain);
+
+   if(mCustomUserAuthQuery.empty() || domain.empty())
+   {
+      // The hot path during digest auth - use a pooled connection's prepared statement if there is one
+      PooledConnectionGuard guard(*this);
+      MySqlConnection* connection = static_cast<MySqlConnection*>(guard.get());
+      if(connection && connection->mUserAuthStmt)
+      {
+         Data passwordHash;
+         if(pooledUserAuthQuery(*connection, user, domain, passwordHash) == 0)
+         {
+            DebugLog( << "Auth password is " << passwordHash);
+            return passwordHash;
+         }
+         guard.setBroken();  // and retry below on the shared connection
+      }
+   }
+
    Data command;
    {
       DataStream ds(command);
-      Data user;
-      Data domain;
-      UserStore::getUserAndDomainFromKey(key, user, domain);
       ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE user = '" << user << "' AND domain = '" << domain << "' ";
    
       // Note: domain is empty when querying for HTTP admin user - for this special user, 
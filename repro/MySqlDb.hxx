@@ -65,6 +65,7 @@ class MySqlDb: public SqlDb
       void initialize() const;
       void disconnectFromDatabase() const;
       int connectToDatabase() const;
+      MYSQL* openConnection(int& rc) const;
       int query(const resip::Data& queryCommand, MYSQL_RES** result) const;
       virtual int query(const resip::Data& queryCommand) const;
       resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
@@ -79,6 +80,18 @@ class MySqlDb: public SqlDb
       mutable MYSQL* mConn;
       mutable MYSQL_RES* mResult[MaxTable];
 
+      class MySqlConnection : public PooledConnection
+      {
+         public:
+            MySqlConnection(MYSQL* conn) : mConn(conn), mUserAuthStmt(0) {}
+            ~MySqlConnection();
+            MYSQL* mConn;
+            MYSQL_STMT* mUserAuthStmt;  // 0 when a CustomUserAuthQuery is configured
+      };
+      virtual PooledConnection* createPooledConnection() const;
+      int pooledUserAuthQuery(MySqlConnection& connection, const resip::Data& user, const resip::Data& domain, resip::Data& passwordHash) const;
+      int pooledSingleResultQuery(MySqlConnection& connection, const resip::Data& queryCommand, std::vector<resip::Data>& fields) const;
+
       void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
       void tlsPeerIdentityWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
 };
@@ -100,9 +100,15 @@ PostgreSqlDb::PostgreSqlDb(const resip::ConfigParse& config,
 
 PostgreSqlDb::~PostgreSqlDb()
 {
+   closePooledConnections();
    disconnectFromDatabase();
 }
 
+PostgreSqlDb::PostgreSqlConnection::~PostgreSqlConnection()
+{
+   PQfinish(mConn);
+}
+
 void
 PostgreSqlDb::initialize() const
 {
@@ -144,6 +150,22 @@ PostgreSqlDb::connectToDatabase() const
    resip_assert(mConn == 0);
    resip_assert(isConnected() == false);
 
+   mConn = openConnection();
+   if (mConn == 0)
+   { 
+      setConnected(false);
+      return -1;
+   }
+   else
+   {
+      setConnected(true);
+      return 0;
+   }
+}
+
+PGconn*
+PostgreSqlDb::openConnection() const
+{
    Data connInfo(mDBConnInfo);
    if(!mDBServer.empty())
    {
@@ -169,21 +191,49 @@ PostgreSqlDb::connectToDatabase() const
    }
 
    DebugLog(<<"Trying to connect to PostgreSQL server with conninfo string: " << connInfoLogString);
-   mConn = PQconnectdb(connInfo.c_str());
+   PGconn* conn = PQconnectdb(connInfo.c_str());
 
-   int rc = PQstatus(mConn);
-   if (rc != CONNECTION_OK)
+   if (PQstatus(conn) != CONNECTION_OK)
    { 
-      ErrLog( << "PostgreSQL connect failed: " << PQerrorMessage(mConn));
-      mConn = 0;
-      setConnected(false);
-      return -1;
+      ErrLog( << "PostgreSQL connect failed: " << PQerrorMessage(conn));
+      PQfinish(conn);
+      return 0;
    }
-   else
+   return conn;
+}
+
+SqlDb::PooledConnection*
+PostgreSqlDb::createPooledConnection() const
+{
+   initialize();
+
+   PGconn* conn = openConnection();
+   if(conn == 0)
    {
-      setConnected(true);
       return 0;
    }
+   PostgreSqlConnection* connection = new PostgreSqlConnection(conn);
+
+   if(mCustomUserAuthQuery.empty())
+   {
+      Data command;
+      {
+         DataStream ds(command);
+         ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE username = $1 AND domain = $2";
+      }
+      PGresult* result = PQprepare(conn, "userAuth", command.c_str(), 2, 0);
+      if(PQresultStatus(result) == PGRES_COMMAND_OK)
+      {
+         connection->mUserAuthPrepared = true;
+      }
+      else
+      {
+         // fall back to text queries on this connection
+         ErrLog( << "PostgreSQL prepare failed: " << PQerrorMessage(conn) << ", SQL Command was: " << command);
+      }
+      PQclear(result);
+   }
+   return connection;
 }
 
 inline int pqOK(const PGresult *result)
@@ -257,12 +307,81 @@ PostgreSqlDb::query(const Data& queryCommand) const
    return query(queryCommand, 0);
 }
 
+int
+PostgreSqlDb::pooledQuery(PostgreSqlConnection& connection, const Data& queryCommand, PGresult** result) const
+{
+   initialize();
+
+   DebugLog( << "PostgreSqlDb::pooledQuery: executing query: " << queryCommand);
+
+   PGresult* _result = PQexec(connection.mConn, queryCommand.c_str());
+   int rc = pqOK(_result);
+   if(rc == 0)
+   {
+      *result = _result;
+   }
+   else
+   {
+      ErrLog( << "PostgreSQL query failed: " << PQerrorMessage(connection.mConn) << ", SQL Command was: " << queryCommand);
+      PQclear(_result);
+   }
+   return rc;
+}
+
+int
+PostgreSqlDb::pooledUserAuthQuery(PostgreSqlConnection& connection, const Data& user, const Data& domain, Data& passwordHash) const
+{
+   initialize();
+
+   const char* params[2] = { user.c_str(), domain.c_str() };
+   PGresult* result = PQexecPrepared(connection.mConn, "userAuth", 2, params, 0, 0, 0);
+   int rc = pqOK(result);
+   if(rc == 0)
+   {
+      if(PQntuples(result) > 0)
+      {
+         passwordHash = Data(PQgetvalue(result, 0, 0));
+      }
+      else
+      {
+         DebugLog(<<"pooledUserAuthQuery: no rows returned by query");
+      }
+   }
+   else
+   {
+      ErrLog( << "PostgreSQL user auth statement failed: " << PQerrorMessage(connection.mConn));
+   }
+   PQclear(result);
+   return rc;
+}
+
 int
 PostgreSqlDb::singleResultQuery(const Data& queryCommand, std::vector<Data>& fields) const
 {
    StackLog(<<"executing query: " << queryCommand);
    PGresult* result=0;
-   int rc = query(queryCommand, &result);
+   int rc = 1;
+   {
+      PooledConnectionGuard guard(*this);
+      if(guard.get())
+      {
+         PostgreSqlConnection& connection = static_cast<PostgreSqlConnection&>(*guard.get());
+         rc = pooledQuery(connection, queryCommand, &result);
+         if(rc != 0 && PQstatus(connection.mConn) != CONNECTION_OK)
+         {
+            // Drop the connection, and let the shared one (which reconnects) run the query this time
+            guard.setBroken();
+         }
+         else if(rc != 0)
+         {
+            return rc;
+         }
+      }
+   }
+   if(rc != 0)
+   {
+      rc = query(queryCommand, &result);
+   }
       
    if(rc == 0)
    {
@@ -385,12 +504,30 @@ PostgreSqlDb::getUserAuthInfo(  const AbstractDb::Key& key ) const
 { 
    std::vector<Data> ret;
 
+   Data user;
+   Data domain;
+   UserStore::getUserAndDomainFromKey(key, user, domain);
+
+   if(mCustomUserAuthQuery.empty() || domain.empty())
+   {
+      // The hot path during digest auth - use a pooled connection's prepared statement if there is one
+      PooledConnectionGuard guard(*this);
+      PostgreSqlConnection* connection = static_cast<PostgreSqlConnection*>(guard.get());
+      if(connection && connection->mUserAuthPrepared)
+      {
+         Data passwordHash;
+         if(pooledUserAuthQuery(*connection, user, domain, passwordHash) == 0)
+         {
+            DebugLog( << "Auth password is " << passwordHash);
+            return passwordHash;
+         }
+         guard.setBroken();  // and retry below on the shared connection
+      }
+   }
+
    Data command;
    {
       DataStream ds(command);
-      Data user;
-      Data domain;
-      UserStore::getUserAndDomainFromKey(key, user, domain);
       ds << "SELECT passwordHash FROM " << tableName(UserTable) << " WHERE username = '" << user << "' AND domain = '" << domain << "' ";
    
       // Note: domain is empty when querying for HTTP admin user - for this special user, 
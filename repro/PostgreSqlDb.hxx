@@ -62,6 +62,7 @@ class PostgreSqlDb: public SqlDb
       void initialize() const;
       void disconnectFromDatabase() const;
       int connectToDatabase() const;
+      PGconn* openConnection() const;
       int query(const resip::Data& queryCommand, PGresult** result) const;
       virtual int query(const resip::Data& queryCommand) const;
       resip::Data& escapeString(const resip::Data& str, resip::Data& escapedStr) const;
@@ -78,6 +79,18 @@ class PostgreSqlDb: public SqlDb
       mutable PGresult* mResult[MaxTable];
       mutable int mRow[MaxTable];
 
+      class PostgreSqlConnection : public PooledConnection
+      {
+         public:
+            PostgreSqlConnection(PGconn* conn) : mConn(conn), mUserAuthPrepared(false) {}
+            ~PostgreSqlConnection();
+            PGconn* mConn;
+            bool mUserAuthPrepared;  // false when a CustomUserAuthQuery is configured
+      };
+      virtual PooledConnection* createPooledConnection() const;
+      int pooledQuery(PostgreSqlConnection& connection, const resip::Data& queryCommand, PGresult** result) const;
+      int pooledUserAuthQuery(PostgreSqlConnection& connection, const resip::Data& user, const resip::Data& domain, resip::Data& passwordHash) const;
+
       void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
       void tlsPeerIdentityWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const;
 };
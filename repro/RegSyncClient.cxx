@@ -14,6 +14,7 @@
 
 #include "repro/RegSyncClient.hxx"
 #include "repro/RegSyncServer.hxx"
+#include "repro/RegSyncProtocol.hxx"
 
 using namespace repro;
 using namespace resip;
@@ -29,7 +30,11 @@ RegSyncClient::RegSyncClient(InMemorySyncRegDb* regDb,
    mPubDb(pubDb),
    mAddress(address),
    mPort(port),
-   mSocketDesc(0)
+   mSocketDesc(0),
+   mUseXml(false),
+   mServerEpoch(0),
+   mLastSequence(0),
+   mReconnect(false)
 {
     resip_assert(mRegDb);
 }
@@ -121,12 +126,22 @@ RegSyncClient::thread()
          continue;
       }
 
+      // If we have all the changes up to some point, ask for the ones since
+      Data resume;
+      if(!mUseXml && mServerEpoch != 0)
+      {
+         resume = "     <Epoch>" + Data(mServerEpoch) + "</Epoch>\r\n"
+                  "     <Sequence>" + Data(mLastSequence) + "</Sequence>\r\n";
+      }
       Data request(
          "<InitialSync>\r\n"
          "  <Request>\r\n"
-         "     <Version>" + Data(REGSYNC_VERSION) + "</Version>\r\n"   // For use in detecting if client/server are a compatible version
+         "     <Version>" + Data(mUseXml ? REGSYNC_XML_VERSION : REGSYNC_VERSION) + "</Version>\r\n"   // For use in detecting if client/server are a compatible version
+         + resume +
          "  </Request>\r\n"
          "</InitialSync>\r\n");   
+      mRxDataBuffer.clear();
+      mReconnect = false;
       rc = ::send(mSocketDesc, request.c_str(), (int)request.size(), 0);
       if(rc < 0) 
       {
@@ -173,11 +188,17 @@ RegSyncClient::thread()
             {
                mRxDataBuffer += Data(Data::Borrow, (const char*)&mRxBuffer, rc);   
                while(tryParse());
+               if(mReconnect)
+               {
+                  closeSocket(mSocketDesc);
+                  mSocketDesc = 0;
+                  break;
+               }
             }
          }
          else if(rc == 0) // timeout - send keepalive
          {
-            rc = ::send(mSocketDesc, Symbols::CRLFCRLF, (int)request.size(), 0);
+            rc = ::send(mSocketDesc, Symbols::CRLFCRLF, (int)strlen(Symbols::CRLFCRLF), 0);
             if(rc < 0) 
             {
                int e = getErrno();
@@ -204,6 +225,12 @@ RegSyncClient::thread()
              break;
          }
       }
+      if(mSocketDesc)
+      {
+         // Connection closed by the server
+         closeSocket(mSocketDesc);
+         mSocketDesc = 0;
+      }
    } // end while
 
    if(mSocketDesc) closeSocket(mSocketDesc);
@@ -213,41 +240,70 @@ bool
 RegSyncClient::tryParse()
 {
    ParseBuffer pb(mRxDataBuffer);
-   Data initialTag;
    const char* start = pb.position();
    pb.skipWhitespace();
-   pb.skipToChar('<');   
-   if(!pb.eof())
+   if(pb.eof())
+   {
+      return false;
+   }
+   if(*pb.position() == RegSyncProtocol::Magic0)
    {
+      // A binary event
+      start = pb.position();
+      unsigned int size = 0;
+      try
+      {
+         size = RegSyncProtocol::frameSize(start, (unsigned int)(mRxDataBuffer.data() + mRxDataBuffer.size() - start));
+      }
+      catch(BaseException& e)
+      {
+         ErrLog(<< "RegSyncClient::tryParse: " << e << ", reconnecting");
+         mServerEpoch = 0;
+         mReconnect = true;
+         return false;
+      }
+      if(size == 0)
+      {
+         return false;  // wait for the rest of it
+      }
+      handleFrame(start, size);
+      pb.skipN((int)size);
+   }
+   else
+   {
+      pb.skipToChar('<');   
+      if(pb.eof())
+      {
+         return false;
+      }
       pb.skipChar();
       const char* anchor = pb.position();
       pb.skipToChar('>');
-      if(!pb.eof())
+      if(pb.eof())
       {
-         initialTag = pb.data(anchor);
-         // Find end of initial tag
-         pb.skipToChars("</" + initialTag + ">");
-         if (!pb.eof())
-         {
-            pb.skipN((int)initialTag.size() + 3);  // Skip past </InitialTag>            
-            handleXml(pb.data(start));
-
-            // Remove processed data from RxBuffer
-            pb.skipWhitespace();
-            if(!pb.eof())
-            {
-               anchor = pb.position();
-               pb.skipToEnd();
-               mRxDataBuffer = pb.data(anchor);
-               return true;
-            }
-            else
-            {
-               mRxDataBuffer.clear();
-            }
-         }   
+         return false;
+      }
+      Data initialTag = pb.data(anchor);
+      // Find end of initial tag
+      pb.skipToChars("</" + initialTag + ">");
+      if (pb.eof())
+      {
+         return false;
       }
+      pb.skipN((int)initialTag.size() + 3);  // Skip past </InitialTag>            
+      handleXml(pb.data(start));
    }
+
+   // Remove processed data from RxBuffer
+   pb.skipWhitespace();
+   if(!pb.eof())
+   {
+      const char* anchor = pb.position();
+      pb.skipToEnd();
+      mRxDataBuffer = pb.data(anchor);
+      return !mReconnect;
+   }
+   mRxDataBuffer.clear();
    return false;
 }
 
@@ -264,7 +320,7 @@ RegSyncClient::handleXml(const Data& xmlData)
       if(isEqualNoCase(xml.getTag(), "InitialSync"))
       {
          // Must be an InitialSync response
-         InfoLog(<< "RegSyncClient::handleXml: InitialSync complete.");
+         handleInitialSyncResponse(xml);
       }
       else if(isEqualNoCase(xml.getTag(), "reginfo"))
       {
@@ -299,6 +355,83 @@ RegSyncClient::handleXml(const Data& xmlData)
    }
 }
 
+void
+RegSyncClient::handleInitialSyncResponse(resip::XMLCursor& xml)
+{
+   unsigned int resultCode = 0;
+   UInt64 epoch = 0;
+   UInt64 sequence = 0;
+   if(xml.firstChild())
+   {
+      do
+      {
+         if(isEqualNoCase(xml.getTag(), "response") && xml.firstChild())
+         {
+            do
+            {
+               if(isEqualNoCase(xml.getTag(), "result"))
+               {
+                  XMLCursor::AttributeMap::const_iterator it = xml.getAttributes().find("Code");
+                  if(it != xml.getAttributes().end())
+                  {
+                     resultCode = it->second.convertUnsignedLong();
+                  }
+               }
+               else if(isEqualNoCase(xml.getTag(), "epoch"))
+               {
+                  if(xml.firstChild())
+                  {
+                     epoch = xml.getValue().convertUInt64();
+                     xml.parent();
+                  }
+               }
+               else if(isEqualNoCase(xml.getTag(), "sequence"))
+               {
+                  if(xml.firstChild())
+                  {
+                     sequence = xml.getValue().convertUInt64();
+                     xml.parent();
+                  }
+               }
+            } while(xml.nextSibling());
+            xml.parent();
+         }
+      } while(xml.nextSibling());
+      xml.parent();
+   }
+
+   if(resultCode == 100)
+   {
+      // The server is sending everything - changes follow on from sequence
+      InfoLog(<< "RegSyncClient::handleInitialSyncResponse: InitialSync started.");
+      mServerEpoch = 0;
+      mLastSequence = sequence;
+   }
+   else if(resultCode == 200)
+   {
+      InfoLog(<< "RegSyncClient::handleInitialSyncResponse: InitialSync complete.");
+      if(!mUseXml)
+      {
+         mServerEpoch = epoch;
+         if(sequence != mLastSequence)
+         {
+            DebugLog(<< "RegSyncClient::handleInitialSyncResponse: at sequence " << mLastSequence << ", server at " << sequence);
+         }
+      }
+   }
+   else if(resultCode == 505 && !mUseXml)
+   {
+      WarningLog(<< "RegSyncClient::handleInitialSyncResponse: " << mAddress << ":" << mPort << " doesn't support RegSync version " << REGSYNC_VERSION 
+                 << ", falling back to version " << REGSYNC_XML_VERSION);
+      mUseXml = true;
+      mReconnect = true;
+   }
+   else
+   {
+      ErrLog(<< "RegSyncClient::handleInitialSyncResponse: InitialSync failed, code=" << resultCode);
+   }
+}
+
 void 
 RegSyncClient::handleRegInfoEvent(resip::XMLCursor& xml)
 {
@@ -470,6 +603,111 @@ RegSyncClient::processModify(const resip::Uri& aor, ContactList& syncContacts)
    mRegDb->unlockRecord(aor);
 }
 
+void
+RegSyncClient::handleFrame(const char* frame, unsigned int size)
+{
+   UInt64 now = Timer::getTimeSecs();
+   UInt64 sequence = 0;
+   switch(RegSyncProtocol::frameType(frame))
+   {
+   case RegSyncProtocol::Batch:
+      {
+         const char* next = frame + RegSyncProtocol::HeaderSize;
+         const char* end = frame + size;
+         while(next < end && !mReconnect)
+         {
+            unsigned int innerSize = 0;
+            try
+            {
+               innerSize = RegSyncProtocol::frameSize(next, (unsigned int)(end - next));
+            }
+            catch(BaseException& e)
+            {
+               ErrLog(<< "RegSyncClient::handleFrame: " << e);
+            }
+            if(innerSize == 0)
+            {
+               ErrLog(<< "RegSyncClient::handleFrame: bad batch, reconnecting");
+               mServerEpoch = 0;
+               mReconnect = true;
+               break;
+            }
+            handleFrame(next, innerSize);
+            next += innerSize;
+         }
+      }
+      break;
+   case RegSyncProtocol::RegInfo:
+      {
+         Uri aor;
+         ContactList contacts;
+         try
+         {
+            RegSyncProtocol::decodeRegInfo(frame, size, now, sequence, aor, contacts);
+         }
+         catch(BaseException& e)
+         {
+            // the change is lost, and the sequence number can't be trusted
+            ErrLog(<< "RegSyncClient::handleFrame: bad reginfo, reconnecting: " << e);
+            mServerEpoch = 0;
+            mReconnect = true;
+            break;
+         }
+         if(checkSequence(sequence) && mRegDb)
+         {
+            processModify(aor, contacts);
+         }
+      }
+      break;
+   case RegSyncProtocol::PubInfo:
+      {
+         PublicationPersistenceManager::PubDocument document;
+         try
+         {
+            RegSyncProtocol::decodePubInfo(frame, size, now, sequence, document);
+         }
+         catch(BaseException& e)
+         {
+            // the change is lost, and the sequence number can't be trusted
+            ErrLog(<< "RegSyncClient::handleFrame: bad pubinfo, reconnecting: " << e);
+            mServerEpoch = 0;
+            mReconnect = true;
+            break;
+         }
+         if(checkSequence(sequence))
+         {
+            processPublication(document);
+         }
+      }
+      break;
+   default:
+      WarningLog(<< "RegSyncClient::handleFrame: Ignoring frame of unknown type " << (int)RegSyncProtocol::frameType(frame));
+      break;
+   }
+}
+
+bool
+RegSyncClient::checkSequence(UInt64 sequence)
+{
+   if(sequence == 0)
+   {
+      return true;  // part of an initial sync
+   }
+   if(sequence <= mLastSequence)
+   {
+      return false;
+   }
+   if(sequence != mLastSequence + 1)
+   {
+      // Apply this one, but the ones in between are gone - start again
+      WarningLog(<< "RegSyncClient::checkSequence: missed changes " << mLastSequence + 1 << " to " << sequence - 1 << ", reconnecting for a new initial sync");
+      mServerEpoch = 0;
+      mReconnect = true;
+   }
+   mLastSequence = sequence;
+   return true;
+}
+
 void
 RegSyncClient::handlePubInfoEvent(resip::XMLCursor& xml)
 {
@@ -635,6 +873,12 @@ RegSyncClient::handlePubInfoEvent(resip::XMLCursor& xml)
    }
    xml.parent();
 
+   processPublication(document);
+}
+
+void
+RegSyncClient::processPublication(PublicationPersistenceManager::PubDocument& document)
+{
    if (mPubDb)
    {
       if (document.mExpirationTime != 0)
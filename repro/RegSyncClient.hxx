@@ -5,11 +5,18 @@
 #include <rutil/XMLCursor.hxx>
 #include <resip/dum/InMemorySyncRegDb.hxx>
 #include <resip/dum/InMemorySyncPubDb.hxx>
+#include <resip/dum/PublicationPersistenceManager.hxx>
 #include <rutil/ThreadIf.hxx>
 
 namespace repro
 {
 
+/// Keeps the local databases in sync with a peer's RegSyncServer.  The 
+/// client asks for REGSYNC_VERSION binary events, and falls back to 
+/// REGSYNC_XML_VERSION if the server doesn't support them.  It remembers 
+/// the server's epoch and the sequence number of the last change it 
+/// received, so after a reconnect the server only needs to send what was 
+/// missed.  A gap in the sequence numbers forces a new initial sync.
 class RegSyncClient : public resip::ThreadIf
 {
 public:
@@ -25,17 +32,26 @@ private:
    void delaySeconds(unsigned int seconds);
    bool tryParse();  // returns true if we processed something and there is more data in the buffer
    void handleXml(const resip::Data& xmlData);
+   void handleInitialSyncResponse(resip::XMLCursor& xml);
    void handleRegInfoEvent(resip::XMLCursor& xml);
    void handlePubInfoEvent(resip::XMLCursor& xml);
+   void handleFrame(const char* frame, unsigned int size);
+   bool checkSequence(UInt64 sequence);  // returns false if the change has already been applied
    void processModify(const resip::Uri& aor, resip::ContactList& syncContacts);
+   void processPublication(resip::PublicationPersistenceManager::PubDocument& document);
 
    resip::InMemorySyncRegDb* mRegDb;
    resip::InMemorySyncPubDb* mPubDb;
    resip::Data mAddress;
    unsigned short mPort;
-   char mRxBuffer[8000];
+   char mRxBuffer[64*1024];
    resip::Data mRxDataBuffer;
    int mSocketDesc;
+
+   bool mUseXml;           // the server only supports REGSYNC_XML_VERSION
+   UInt64 mServerEpoch;    // 0 until an initial sync has completed
+   UInt64 mLastSequence;   // of the last change received
+   bool mReconnect;        // drop the connection and start again
 };
 
 }
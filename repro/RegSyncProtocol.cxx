@@ -0,0 +1,393 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include <resip/stack/Tuple.hxx>
+#include <resip/stack/GenericPidfContents.hxx>
+#include <resip/stack/SecurityAttributes.hxx>
+#include <rutil/ParseException.hxx>
+
+#include "repro/RegSyncProtocol.hxx"
+
+using namespace repro;
+using namespace resip;
+using namespace std;
+
+namespace
+{
+
+enum
+{
+   PubHasContents = 0x01,
+   PubHasSecurityAttributes = 0x02
+};
+
+void
+writeVarint(Data& out, UInt64 value)
+{
+   char buf[10];
+   unsigned int len = 0;
+   while(value >= 0x80)
+   {
+      buf[len++] = (char)((value & 0x7f) | 0x80);
+      value >>= 7;
+   }
+   buf[len++] = (char)value;
+   out.append(buf, len);
+}
+
+void
+writeString(Data& out, const Data& value)
+{
+   writeVarint(out, value.size());
+   out.append(value.data(), value.size());
+}
+
+void
+writeHeader(Data& out, RegSyncProtocol::FrameType type, UInt32 bodySize)
+{
+   char header[RegSyncProtocol::HeaderSize] = { RegSyncProtocol::Magic0, RegSyncProtocol::Magic1, (char)type, 0,
+                                                (char)(bodySize >> 24), (char)(bodySize >> 16), (char)(bodySize >> 8), (char)bodySize };
+   out.append(header, sizeof(header));
+}
+
+void
+writeTuple(Data& out, const Tuple& tuple, bool present)
+{
+   if(present)
+   {
+      Data token;
+      Tuple::writeBinaryToken(tuple, token);
+      writeString(out, token);
+   }
+   else
+   {
+      writeVarint(out, 0);
+   }
+}
+
+// Times are written as they are held, and converted to the receiver's
+// clock from the sender's clock written in the frame.
+UInt64
+localExpires(UInt64 expires, UInt64 senderNow, UInt64 now)
+{
+   return (expires == 0 || expires <= senderNow) ? 0 : now + (expires - senderNow);
+}
+
+UInt64
+localLastUpdated(UInt64 lastUpdated, UInt64 senderNow, UInt64 now)
+{
+   UInt64 age = lastUpdated < senderNow ? senderNow - lastUpdated : 0;
+   return age < now ? now - age : 0;
+}
+
+class Reader
+{
+public:
+   Reader(const char* frame, unsigned int size) :
+      mPosition(frame + RegSyncProtocol::HeaderSize),
+      mEnd(frame + size)
+   {
+      if(size < RegSyncProtocol::HeaderSize)
+      {
+         fail("truncated frame header");
+      }
+   }
+
+   UInt64 varint()
+   {
+      UInt64 value = 0;
+      for(unsigned int shift = 0; shift < 64; shift += 7)
+      {
+         if(mPosition == mEnd)
+         {
+            fail("truncated integer");
+         }
+         unsigned char c = (unsigned char)*mPosition++;
+         value |= (UInt64)(c & 0x7f) << shift;
+         if(!(c & 0x80))
+         {
+            return value;
+         }
+      }
+      fail("integer too long");
+      return 0;
+   }
+
+   unsigned char byte()
+   {
+      if(mPosition == mEnd)
+      {
+         fail("truncated frame");
+      }
+      return (unsigned char)*mPosition++;
+   }
+
+   Data string()
+   {
+      UInt64 len = varint();
+      if(len > (UInt64)(mEnd - mPosition))
+      {
+         fail("truncated string");
+      }
+      Data value(mPosition, (Data::size_type)len);
+      mPosition += len;
+      return value;
+   }
+
+   Tuple tuple()
+   {
+      Data token(string());
+      return token.empty() ? Tuple() : Tuple::makeTupleFromBinaryToken(token);
+   }
+
+   bool atEnd() const { return mPosition == mEnd; }
+
+   void fail(const char* reason)
+   {
+      throw ParseException(Data("RegSync frame: ") + reason, "RegSyncProtocol", __FILE__, __LINE__);
+   }
+
+private:
+   const char* mPosition;
+   const char* mEnd;
+};
+
+}
+
+bool
+RegSyncProtocol::encodeRegInfo(Data& record, const Uri& aor, const ContactList& contacts)
+{
+   unsigned int count = 0;
+   for(ContactList::const_iterator it = contacts.begin(); it != contacts.end(); it++)
+   {
+      if(!it->mReceivedFrom.onlyUseExistingConnection && it->mRegExpires != NeverExpire)  // Don't sync over static registrations
+      {
+         count++;
+      }
+   }
+   if(count == 0)
+   {
+      return false;
+   }
+
+   writeString(record, Data::from(aor));
+   writeVarint(record, count);
+   for(ContactList::const_iterator it = contacts.begin(); it != contacts.end(); it++)
+   {
+      const ContactInstanceRecord& rec = *it;
+      if(rec.mReceivedFrom.onlyUseExistingConnection || rec.mRegExpires == NeverExpire)
+      {
+         continue;
+      }
+      writeString(record, Data::from(rec.mContact));
+      writeVarint(record, rec.mRegExpires);
+      writeVarint(record, rec.mLastUpdated);
+      writeTuple(record, rec.mReceivedFrom, rec.mReceivedFrom.getPort() != 0);
+      writeTuple(record, rec.mPublicAddress, rec.mPublicAddress.getType() != UNKNOWN_TRANSPORT);
+      writeVarint(record, rec.mSipPath.size());
+      for(NameAddrs::const_iterator naIt = rec.mSipPath.begin(); naIt != rec.mSipPath.end(); naIt++)
+      {
+         writeString(record, Data::from(naIt->uri()));
+      }
+      writeString(record, rec.mInstance);
+      writeVarint(record, rec.mRegId);
+      writeString(record, rec.mUserAgent);
+   }
+   return true;
+}
+
+void
+RegSyncProtocol::encodePubInfo(Data& record, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes)
+{
+   writeString(record, eventType);
+   writeString(record, documentKey);
+   writeString(record, eTag);
+   writeVarint(record, expirationTime);
+   writeVarint(record, lastUpdated);
+
+   // lingering records will have expirationTime as 0 - don't need to send contents - refreshes also have no body
+   unsigned char flags = 0;
+   if(expirationTime != 0 && contents != 0)
+   {
+      flags |= PubHasContents;
+      if(securityAttributes)
+      {
+         flags |= PubHasSecurityAttributes;
+      }
+   }
+   record += (char)flags;
+   if(flags & PubHasContents)
+   {
+      writeString(record, contents->getBodyData());
+   }
+   if(flags & PubHasSecurityAttributes)
+   {
+      // Note:  intentionally not syncing mLevel and mEncryptionPerformed from SecurityAttributes since they are for outbound messages only
+      record += (char)(securityAttributes->isEncrypted() ? 1 : 0);
+      record += (char)securityAttributes->getSignatureStatus();
+      writeString(record, securityAttributes->getSigner());
+      writeString(record, securityAttributes->getIdentity());
+      record += (char)securityAttributes->getIdentityStrength();
+   }
+}
+
+void
+RegSyncProtocol::appendFrame(Data& frames, FrameType type, UInt64 sequence, UInt64 now, const Data& record)
+{
+   Data prefix(20, Data::Preallocate);
+   writeVarint(prefix, sequence);
+   writeVarint(prefix, now);
+   writeHeader(frames, type, (UInt32)(prefix.size() + record.size()));
+   frames += prefix;
+   frames += record;
+}
+
+void
+RegSyncProtocol::appendBatch(Data& batch, const Data& frames)
+{
+   writeHeader(batch, Batch, (UInt32)frames.size());
+   batch += frames;
+}
+
+unsigned int
+RegSyncProtocol::frameSize(const char* buf, unsigned int len)
+{
+   if((len >= 1 && buf[0] != Magic0) || (len >= 2 && buf[1] != Magic1))
+   {
+      throw ParseException("RegSync frame: bad magic", "RegSyncProtocol", __FILE__, __LINE__);
+   }
+   if(len < HeaderSize)
+   {
+      return 0;
+   }
+   const unsigned char* header = (const unsigned char*)buf;
+   UInt32 bodySize = ((UInt32)header[4] << 24) | ((UInt32)header[5] << 16) | ((UInt32)header[6] << 8) | header[7];
+   if(bodySize > MaxFrameSize)
+   {
+      throw ParseException("RegSync frame: too large", "RegSyncProtocol", __FILE__, __LINE__);
+   }
+   return len - HeaderSize >= bodySize ? HeaderSize + bodySize : 0;
+}
+
+void
+RegSyncProtocol::decodeRegInfo(const char* frame, unsigned int size, UInt64 now, UInt64& sequence, Uri& aor, ContactList& contacts)
+{
+   Reader reader(frame, size);
+   sequence = reader.varint();
+   UInt64 senderNow = reader.varint();
+   aor = Uri(reader.string());
+   contacts.clear();
+   for(UInt64 count = reader.varint(); count > 0; count--)
+   {
+      ContactInstanceRecord rec;
+      rec.mContact = NameAddr(reader.string());
+      rec.mRegExpires = localExpires(reader.varint(), senderNow, now);
+      rec.mLastUpdated = localLastUpdated(reader.varint(), senderNow, now);
+      rec.mReceivedFrom = reader.tuple();
+      rec.mPublicAddress = reader.tuple();
+      for(UInt64 paths = reader.varint(); paths > 0; paths--)
+      {
+         rec.mSipPath.push_back(NameAddr(reader.string()));
+      }
+      rec.mInstance = reader.string();
+      rec.mRegId = (UInt32)reader.varint();
+      rec.mUserAgent = reader.string();
+      rec.mSyncContact = true;  // This ContactInstanceRecord came from registration sync process
+      contacts.push_back(rec);
+   }
+   if(!reader.atEnd())
+   {
+      reader.fail("trailing data");
+   }
+}
+
+void
+RegSyncProtocol::decodePubInfo(const char* frame, unsigned int size, UInt64 now, UInt64& sequence, PublicationPersistenceManager::PubDocument& document)
+{
+   Reader reader(frame, size);
+   sequence = reader.varint();
+   UInt64 senderNow = reader.varint();
+   document = PublicationPersistenceManager::PubDocument();
+   document.mEventType = reader.string();
+   document.mDocumentKey = reader.string();
+   document.mETag = reader.string();
+   document.mExpirationTime = localExpires(reader.varint(), senderNow, now);
+   document.mLingerTime = document.mExpirationTime;
+   document.mLastUpdated = localLastUpdated(reader.varint(), senderNow, now);
+   unsigned char flags = reader.byte();
+   if(flags & PubHasContents)
+   {
+      Data contentsData(reader.string());
+      HeaderFieldValue hfv(contentsData.data(), contentsData.size());
+      GenericPidfContents pidf(hfv, GenericPidfContents::getStaticType());
+      document.mContents.reset((Contents*)new GenericPidfContents(pidf));  // ensure we copy other pidf - since it shares data with contentsData
+   }
+   if(flags & PubHasSecurityAttributes)
+   {
+      document.mSecurityAttributes.reset(new SecurityAttributes);
+      if(reader.byte())
+      {
+         document.mSecurityAttributes->setEncrypted();
+      }
+      document.mSecurityAttributes->setSignatureStatus((SignatureStatus)reader.byte());
+      document.mSecurityAttributes->setSigner(reader.string());
+      document.mSecurityAttributes->setIdentity(reader.string());
+      document.mSecurityAttributes->setIdentityStrength((SecurityAttributes::IdentityStrength)reader.byte());
+   }
+   if(!reader.atEnd())
+   {
+      reader.fail("trailing data");
+   }
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * Copyright (c) 2015 SIP Spectrum, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
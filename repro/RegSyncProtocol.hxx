@@ -0,0 +1,119 @@
+#if !defined(RegSyncProtocol_hxx)
+#define RegSyncProtocol_hxx
+
+#include <rutil/Data.hxx>
+#include <resip/dum/ContactInstanceRecord.hxx>
+#include <resip/dum/PublicationPersistenceManager.hxx>
+
+namespace repro
+{
+
+/// Encodes and decodes the binary RegSync events that REGSYNC_VERSION 5
+/// peers exchange in place of the <reginfo> and <pubinfo> XML events.
+/// Requests and responses stay XML - only events are framed this way.
+///
+/// A frame is the two magic bytes 'R' 'S', a type byte, a reserved byte and
+/// the big endian 32 bit length of the body that follows.  The body of a
+/// RegInfo or PubInfo frame is the sequence number of the change (0 for a
+/// record sent as part of an initial sync), the sender's clock and the
+/// record; a Batch frame carries a run of other frames.  Integers are
+/// encoded as LEB128 varints and strings as a varint length and the bytes.
+///
+/// Records carry absolute times, and the sender's clock is written as each
+/// frame is built, so a record can sit in the change log and be replayed
+/// later without its expiry drifting.  The receiver converts the times to
+/// its own clock, as the relative times of the XML events did.
+class RegSyncProtocol
+{
+public:
+   typedef enum
+   {
+      RegInfo = 1,
+      PubInfo = 2,
+      Batch = 3
+   } FrameType;
+
+   static const char Magic0 = 'R';
+   static const char Magic1 = 'S';
+   static const unsigned int HeaderSize = 8;
+   static const unsigned int MaxFrameSize = 64*1024*1024;
+
+   /// Encodes the record part of a RegInfo frame - returns false, leaving
+   /// record untouched, if none of the contacts are to be synced (static
+   /// registrations and contacts that must use an existing connection).
+   static bool encodeRegInfo(resip::Data& record, const resip::Uri& aor, const resip::ContactList& contacts);
+   /// Encodes the record part of a PubInfo frame - an expirationTime of 0
+   /// sends a removal.
+   static void encodePubInfo(resip::Data& record, const resip::Data& eventType, const resip::Data& documentKey, const resip::Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const resip::Contents* contents, const resip::SecurityAttributes* securityAttributes);
+
+   /// Appends a RegInfo or PubInfo frame holding record to frames.
+   static void appendFrame(resip::Data& frames, FrameType type, UInt64 sequence, UInt64 now, const resip::Data& record);
+   /// Wraps frames in a Batch frame, appended to batch.
+   static void appendBatch(resip::Data& batch, const resip::Data& frames);
+
+   /// Returns the size of the frame at the start of buf, header included, or
+   /// 0 if len doesn't hold all of it yet.  Throws ParseException if buf
+   /// doesn't start with a frame header.
+   static unsigned int frameSize(const char* buf, unsigned int len);
+   static FrameType frameType(const char* frame) { return (FrameType)(unsigned char)frame[2]; }
+
+   /// Decodes the body of a RegInfo or PubInfo frame, converting times to
+   /// the local clock now.  Throws ParseException if the frame is malformed.
+   static void decodeRegInfo(const char* frame, unsigned int size, UInt64 now, UInt64& sequence, resip::Uri& aor, resip::ContactList& contacts);
+   static void decodePubInfo(const char* frame, unsigned int size, UInt64 now, UInt64& sequence, resip::PublicationPersistenceManager::PubDocument& document);
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * Copyright (c) 2015 SIP Spectrum, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -9,8 +9,10 @@
 #include <rutil/ResipAssert.h>
 #include <rutil/Data.hxx>
 #include <rutil/DnsUtil.hxx>
+#include <rutil/Lock.hxx>
 #include <rutil/Logger.hxx>
 #include <rutil/ParseBuffer.hxx>
+#include <rutil/Random.hxx>
 #include <rutil/Socket.hxx>
 #include <rutil/TransportType.hxx>
 #include <rutil/Timer.hxx>
@@ -29,19 +31,15 @@ using namespace std;
 RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              int port, 
                              IpVersion version,
-                             resip::InMemorySyncPubDb* pubDb) :
+                             resip::InMemorySyncPubDb* pubDb,
+                             unsigned int changeLogSize) :
    XmlRpcServerBase(port, version),
    mRegDb(regDb),
-   mPubDb(pubDb)
+   mPubDb(pubDb),
+   mBrokerMode(false),
+   mChangeLogSize(changeLogSize)
 {
-   if (mRegDb)
-   {
-      mRegDb->addHandler(this);
-   }
-   if (mPubDb)
-   {
-      mPubDb->addHandler(this);
-   }
+   init();
 }
 
 RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
@@ -49,8 +47,25 @@ RegSyncServer::RegSyncServer(resip::InMemorySyncRegDb* regDb,
                              resip::InMemorySyncPubDb* pubDb) :
    XmlRpcServerBase(brokerQueue),
    mRegDb(regDb),
-   mPubDb(pubDb)
+   mPubDb(pubDb),
+   mBrokerMode(true),
+   mChangeLogSize(0)
 {
+   init();
+}
+
+void
+RegSyncServer::init()
+{
+   // A peer can only resume from our change log if it is talking to the 
+   // same instance of us that it got its sequence numbers from
+   mEpoch = ((UInt64)(UInt32)Random::getRandom() << 32) | (UInt32)Random::getRandom();
+   if (mEpoch == 0)
+   {
+      mEpoch = 1;
+   }
+   mSequence = 0;
+
    if (mRegDb)
    {
       mRegDb->addHandler(this);
@@ -97,6 +112,16 @@ RegSyncServer::sendRegistrationModifiedEvent(unsigned int connectionId, const re
 
 void 
 RegSyncServer::sendRegistrationModifiedEvent(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts)
+{
+   Data event(encodeRegistrationModifiedEvent(aor, contacts));
+   if(!event.empty())
+   {
+      sendEvent(connectionId, event);
+   }
+}
+
+Data
+RegSyncServer::encodeRegistrationModifiedEvent(const resip::Uri& aor, const ContactList& contacts)
 {
    std::stringstream ss;
    bool infoFound = false;
@@ -116,14 +141,17 @@ RegSyncServer::sendRegistrationModifiedEvent(unsigned int connectionId, const re
    }
    ss << "</reginfo>" << Symbols::CRLF;
 
-   if(infoFound)
-   {
-      sendEvent(connectionId, ss.str().c_str());
-   }
+   return infoFound ? Data(ss.str()) : Data::Empty;
 }
 
 void 
 RegSyncServer::sendDocumentModifiedEvent(unsigned int connectionId, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes)
+{
+   sendEvent(connectionId, encodeDocumentModifiedEvent(eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes));
+}
+
+Data
+RegSyncServer::encodeDocumentModifiedEvent(const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes)
 {
    std::stringstream ss;
    UInt64 now = Timer::getTimeSecs();
@@ -199,11 +227,17 @@ RegSyncServer::sendDocumentModifiedEvent(unsigned int connectionId, const Data&
    }
    ss << "</pubinfo>" << Symbols::CRLF;
 
-   sendEvent(connectionId, ss.str().c_str());
+   return Data(ss.str());
 }
 
 void 
 RegSyncServer::sendDocumentRemovedEvent(unsigned int connectionId, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 lastUpdated)
+{
+   sendEvent(connectionId, encodeDocumentRemovedEvent(eventType, documentKey, eTag, lastUpdated));
+}
+
+Data
+RegSyncServer::encodeDocumentRemovedEvent(const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 lastUpdated)
 {
    std::stringstream ss;
    UInt64 now = Timer::getTimeSecs();
@@ -216,7 +250,7 @@ RegSyncServer::sendDocumentRemovedEvent(unsigned int connectionId, const Data& e
    ss << "   <lastupdate>" << now - lastUpdated << "</lastupdate>" << Symbols::CRLF;
    ss << "</pubinfo>" << Symbols::CRLF;
 
-   sendEvent(connectionId, ss.str().c_str());
+   return Data(ss.str());
 }
 
 void 
@@ -251,30 +285,82 @@ RegSyncServer::handleInitialSyncRequest(unsigned int connectionId, unsigned int
 {
    InfoLog(<< "RegSyncServer::handleInitialSyncRequest");
 
-   // Check for correct Version
+   // Check for correct Version, and see where a resuming peer is up to
    unsigned int version = 0;
+   UInt64 epoch = 0;
+   UInt64 sequence = 0;
    if(xml.firstChild())
    {
       if(isEqualNoCase(xml.getTag(), "request"))
       {
          if(xml.firstChild())
          {
-            if(isEqualNoCase(xml.getTag(), "version"))
+            do
             {
-               if(xml.firstChild())
+               if(isEqualNoCase(xml.getTag(), "version"))
                {
-                  version = xml.getValue().convertUnsignedLong();
-                  xml.parent();
+                  if(xml.firstChild())
+                  {
+                     version = xml.getValue().convertUnsignedLong();
+                     xml.parent();
+                  }
                }
-            }
+               else if(isEqualNoCase(xml.getTag(), "epoch"))
+               {
+                  if(xml.firstChild())
+                  {
+                     epoch = xml.getValue().convertUInt64();
+                     xml.parent();
+                  }
+               }
+               else if(isEqualNoCase(xml.getTag(), "sequence"))
+               {
+                  if(xml.firstChild())
+                  {
+                     sequence = xml.getValue().convertUInt64();
+                     xml.parent();
+                  }
+               }
+            } while(xml.nextSibling());
             xml.parent();
          }
       }
       xml.parent();
    }
 
-   if(version == REGSYNC_VERSION)
+   if(version == REGSYNC_VERSION && !mBrokerMode)
+   {
+      Lock lock(mSyncMutex);
+      mXmlConnections.erase(connectionId);
+      mInitialSyncs.erase(connectionId);
+      mResumes.erase(connectionId);
+      if(epoch == mEpoch && isLogged(sequence))
+      {
+         // Live changes are held back until the connection has caught up
+         InfoLog(<< "RegSyncServer::handleInitialSyncRequest: connection " << connectionId << " resuming after sequence " << sequence << ", " << mSequence - sequence << " changes to send");
+         mConnections.erase(connectionId);
+         mResumes.insert(std::make_pair(connectionId, Resume(requestId, sequence)));
+         // onSendQueueEmpty sends them from here
+      }
+      else
+      {
+         // Changes are sent to the connection from here on, alongside the sync
+         InfoLog(<< "RegSyncServer::handleInitialSyncRequest: connection " << connectionId << " needs a full sync, starting after sequence " << mSequence);
+         mConnections.insert(connectionId);
+         mInitialSyncs.insert(std::make_pair(connectionId, InitialSync(requestId, mSequence)));
+         sendResponse(connectionId, requestId, syncState(mSequence), 100, "Initial Sync Started.");
+         // onSendQueueEmpty streams it from here
+      }
+   }
+   else if(version == REGSYNC_XML_VERSION)
    {
+      {
+         Lock lock(mSyncMutex);
+         mConnections.erase(connectionId);
+         mInitialSyncs.erase(connectionId);
+         mResumes.erase(connectionId);
+         mXmlConnections.insert(connectionId);
+      }
       if (mRegDb)
       {
          mRegDb->initialSync(connectionId);
@@ -291,6 +377,189 @@ RegSyncServer::handleInitialSyncRequest(unsigned int connectionId, unsigned int
    }
 }
 
+Data
+RegSyncServer::syncState(UInt64 sequence)
+{
+   return "    <Epoch>" + Data(mEpoch) + "</Epoch>" + Symbols::CRLF +
+          "    <Sequence>" + Data(sequence) + "</Sequence>" + Symbols::CRLF;
+}
+
+void
+RegSyncServer::sendChange(RegSyncProtocol::FrameType type, const Data& record)
+{
+   // Call with mSyncMutex locked, so changes are queued in sequence order
+   UInt64 sequence = ++mSequence;
+   if(mChangeLogSize > 0)
+   {
+      mChangeLog.push_back(Change(type, record));
+      if(mChangeLog.size() > mChangeLogSize)
+      {
+         mChangeLog.pop_front();
+      }
+   }
+   if(!mConnections.empty())
+   {
+      Data frame(RegSyncProtocol::HeaderSize + 20 + record.size(), Data::Preallocate);
+      RegSyncProtocol::appendFrame(frame, type, sequence, Timer::getTimeSecs(), record);
+      for(std::set<unsigned int>::const_iterator it = mConnections.begin(); it != mConnections.end(); it++)
+      {
+         sendEvent(*it, frame);
+      }
+   }
+}
+
+bool
+RegSyncServer::isLogged(UInt64 sequence)
+{
+   // Call with mSyncMutex locked - true if the change log still has every 
+   // change after sequence
+   UInt64 first = mSequence - mChangeLog.size() + 1;  // the sequence of mChangeLog.front()
+   return sequence <= mSequence && sequence + 1 >= first;
+}
+
+void
+RegSyncServer::sendChangesAfter(unsigned int connectionId, UInt64& sequence)
+{
+   // Call with mSyncMutex locked - queues a batch of the logged changes 
+   // after sequence, and moves sequence on to the last one sent
+   UInt64 first = mSequence - mChangeLog.size() + 1;
+   UInt64 now = Timer::getTimeSecs();
+   Data frames(BatchSize + BatchSize / 4, Data::Preallocate);
+   UInt64 next = sequence + 1;
+   for(; next <= mSequence && frames.size() < BatchSize; next++)
+   {
+      const Change& change = mChangeLog[(size_t)(next - first)];
+      RegSyncProtocol::appendFrame(frames, change.mType, next, now, change.mRecord);
+   }
+   if(!frames.empty())
+   {
+      Data batch(RegSyncProtocol::HeaderSize + frames.size(), Data::Preallocate);
+      RegSyncProtocol::appendBatch(batch, frames);
+      sendEvent(connectionId, batch);
+   }
+   sequence = next - 1;
+}
+
+bool
+RegSyncServer::continueResume(unsigned int connectionId)
+{
+   ResumeMap::iterator it = mResumes.find(connectionId);
+   if(it == mResumes.end())
+   {
+      return false;
+   }
+
+   Lock lock(mSyncMutex);
+   Resume& resume = it->second;
+   if(!isLogged(resume.mSequence))
+   {
+      // Changes went out of the log faster than the connection took them
+      InfoLog(<< "RegSyncServer::continueResume: connection " << connectionId << " fell behind the change log at sequence " << resume.mSequence << ", starting a full sync after sequence " << mSequence);
+      mConnections.insert(connectionId);
+      mInitialSyncs.insert(std::make_pair(connectionId, InitialSync(resume.mRequestId, mSequence)));
+      sendResponse(connectionId, resume.mRequestId, syncState(mSequence), 100, "Initial Sync Started.");
+      mResumes.erase(it);
+      return true;
+   }
+
+   sendChangesAfter(connectionId, resume.mSequence);
+   if(resume.mSequence == mSequence)
+   {
+      // Caught up - live changes follow on from here
+      InfoLog(<< "RegSyncServer::continueResume: connection " << connectionId << " resumed at sequence " << mSequence);
+      mConnections.insert(connectionId);
+      sendResponse(connectionId, resume.mRequestId, syncState(mSequence), 200, "Initial Sync Completed.");
+      mResumes.erase(it);
+   }
+   return true;
+}
+
+void
+RegSyncServer::onSendQueueEmpty(unsigned int connectionId)
+{
+   if(continueResume(connectionId))
+   {
+      return;
+   }
+
+   InitialSyncMap::iterator it = mInitialSyncs.find(connectionId);
+   if(it == mInitialSyncs.end())
+   {
+      return;
+   }
+
+   // Sync parts of the database until a batch has been queued or there is 
+   // nothing left - we are called again once the connection has sent it
+   InitialSync& sync = it->second;
+   unsigned int batches = sync.mBatches;
+   bool done = false;
+   while(!done && sync.mBatches == batches)
+   {
+      if(mRegDb && mRegDb->initialSync(connectionId, sync.mPart))
+      {
+         sync.mPart++;
+      }
+      else if(mPubDb && !sync.mPubDbSynced)
+      {
+         mPubDb->initialSync(connectionId);
+         sync.mPubDbSynced = true;
+      }
+      else
+      {
+         done = true;
+      }
+   }
+
+   if(done)
+   {
+      flushInitialSync(connectionId, sync);
+      InfoLog(<< "RegSyncServer::onSendQueueEmpty: initial sync of connection " << connectionId << " complete, " << sync.mBatches << " batches");
+      sendResponse(connectionId, sync.mRequestId, syncState(sync.mSequence), 200, "Initial Sync Completed.");
+      mInitialSyncs.erase(it);
+   }
+}
+
+void
+RegSyncServer::onConnectionClosed(unsigned int connectionId)
+{
+   Lock lock(mSyncMutex);
+   mConnections.erase(connectionId);
+   mXmlConnections.erase(connectionId);
+   mInitialSyncs.erase(connectionId);
+   mResumes.erase(connectionId);
+}
+
+void
+RegSyncServer::appendInitialSyncRecord(unsigned int connectionId, InitialSync& sync, RegSyncProtocol::FrameType type, const Data& record)
+{
+   // Records sent in an initial sync have no sequence number
+   RegSyncProtocol::appendFrame(sync.mFrames, type, 0, Timer::getTimeSecs(), record);
+   if(sync.mFrames.size() >= BatchSize)
+   {
+      flushInitialSync(connectionId, sync);
+   }
+}
+
+void
+RegSyncServer::flushInitialSync(unsigned int connectionId, InitialSync& sync)
+{
+   if(!sync.mFrames.empty())
+   {
+      Data batch(RegSyncProtocol::HeaderSize + sync.mFrames.size(), Data::Preallocate);
+      RegSyncProtocol::appendBatch(batch, sync.mFrames);
+      sendEvent(connectionId, batch);
+      sync.mFrames.clear();
+      sync.mBatches++;
+   }
+}
+
+bool
+RegSyncServer::isXmlConnection(unsigned int connectionId)
+{
+   Lock lock(mSyncMutex);
+   return mXmlConnections.find(connectionId) != mXmlConnections.end();
+}
+
 void 
 RegSyncServer::streamContactInstanceRecord(std::stringstream& ss, const ContactInstanceRecord& rec)
 {
@@ -336,33 +605,111 @@ RegSyncServer::streamContactInstanceRecord(std::stringstream& ss, const ContactI
 void 
 RegSyncServer::onAorModified(const resip::Uri& aor, const ContactList& contacts)
 {
-   sendRegistrationModifiedEvent(0, aor, contacts);
+   if(mBrokerMode)
+   {
+      sendRegistrationModifiedEvent(0, aor, contacts);
+      return;
+   }
+
+   Data record;
+   if(!RegSyncProtocol::encodeRegInfo(record, aor, contacts))
+   {
+      return;
+   }
+   Lock lock(mSyncMutex);
+   sendChange(RegSyncProtocol::RegInfo, record);
+   if(!mXmlConnections.empty())
+   {
+      Data event(encodeRegistrationModifiedEvent(aor, contacts));
+      for(std::set<unsigned int>::const_iterator it = mXmlConnections.begin(); it != mXmlConnections.end(); it++)
+      {
+         sendEvent(*it, event);
+      }
+   }
 }
 
 void 
 RegSyncServer::onInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts)
 {
-   sendRegistrationModifiedEvent(connectionId, aor, contacts);
+   // The database calls every server's handler, so only send to our own 
+   // connections
+   InitialSyncMap::iterator it = mInitialSyncs.find(connectionId);
+   if(it != mInitialSyncs.end())
+   {
+      Data record;
+      if(RegSyncProtocol::encodeRegInfo(record, aor, contacts))
+      {
+         appendInitialSyncRecord(connectionId, it->second, RegSyncProtocol::RegInfo, record);
+      }
+   }
+   else if(isXmlConnection(connectionId))
+   {
+      sendRegistrationModifiedEvent(connectionId, aor, contacts);
+   }
 }
 
 void 
 RegSyncServer::onDocumentModified(bool sync, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes)
 {
    resip_assert(!sync);  // We register so that we don't get callbacks for sync'd documents
-   sendDocumentModifiedEvent(0, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+   if(mBrokerMode)
+   {
+      sendDocumentModifiedEvent(0, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+      return;
+   }
+
+   Data record;
+   RegSyncProtocol::encodePubInfo(record, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+   Lock lock(mSyncMutex);
+   sendChange(RegSyncProtocol::PubInfo, record);
+   if(!mXmlConnections.empty())
+   {
+      Data event(encodeDocumentModifiedEvent(eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes));
+      for(std::set<unsigned int>::const_iterator it = mXmlConnections.begin(); it != mXmlConnections.end(); it++)
+      {
+         sendEvent(*it, event);
+      }
+   }
 }
 
 void 
 RegSyncServer::onDocumentRemoved(bool sync, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 lastUpdated)
 {
    resip_assert(!sync);  // We register so that we don't get callbacks for sync'd documents
-   sendDocumentRemovedEvent(0, eventType, documentKey, eTag, lastUpdated);
+   if(mBrokerMode)
+   {
+      sendDocumentRemovedEvent(0, eventType, documentKey, eTag, lastUpdated);
+      return;
+   }
+
+   Data record;
+   RegSyncProtocol::encodePubInfo(record, eventType, documentKey, eTag, 0 /* removed */, lastUpdated, 0, 0);
+   Lock lock(mSyncMutex);
+   sendChange(RegSyncProtocol::PubInfo, record);
+   if(!mXmlConnections.empty())
+   {
+      Data event(encodeDocumentRemovedEvent(eventType, documentKey, eTag, lastUpdated));
+      for(std::set<unsigned int>::const_iterator it = mXmlConnections.begin(); it != mXmlConnections.end(); it++)
+      {
+         sendEvent(*it, event);
+      }
+   }
 }
 
 void 
 RegSyncServer::onInitialSyncDocument(unsigned int connectionId, const Data& eventType, const Data& documentKey, const Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const Contents* contents, const SecurityAttributes* securityAttributes)
 {
-   sendDocumentModifiedEvent(connectionId, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+   InitialSyncMap::iterator it = mInitialSyncs.find(connectionId);
+   if(it != mInitialSyncs.end())
+   {
+      Data record;
+      RegSyncProtocol::encodePubInfo(record, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+      appendInitialSyncRecord(connectionId, it->second, RegSyncProtocol::PubInfo, record);
+   }
+   else if(isXmlConnection(connectionId))
+   {
+      sendDocumentModifiedEvent(connectionId, eventType, documentKey, eTag, expirationTime, lastUpdated, contents, securityAttributes);
+   }
 }
 
 
@@ -1,28 +1,44 @@
 #if !defined(RegSyncServer_hxx)
 #define RegSyncServer_hxx 
 
+#include <deque>
+#include <map>
+#include <set>
 #include <rutil/Data.hxx>
+#include <rutil/Mutex.hxx>
 #include <rutil/TransportType.hxx>
 #include <rutil/XMLCursor.hxx>
 #include <resip/dum/InMemorySyncRegDb.hxx>
 #include <resip/dum/InMemorySyncPubDb.hxx>
 #include "repro/XmlRpcServerBase.hxx"
+#include "repro/RegSyncProtocol.hxx"
 
-#define REGSYNC_VERSION 4
+#define REGSYNC_VERSION 5      // binary events, resumable from the change log - see RegSyncProtocol
+#define REGSYNC_XML_VERSION 4  // XML events, still served to older peers
 
 namespace repro
 {
 class RegSyncServer;
 
+/// Each change sent to REGSYNC_VERSION peers is given a sequence number and
+/// kept in a change log of the last changeLogSize changes.  A peer that 
+/// reconnects sends the epoch (a random number identifying this instance of 
+/// the server) and the last sequence number it received, and is only sent 
+/// the changes it missed, if the log still has all of them.  Otherwise it
+/// gets an initial sync.  Both are streamed a batch at a time as the 
+/// connection drains, rather than queued up all at once.
 class RegSyncServer: public XmlRpcServerBase, 
                      public resip::InMemorySyncRegDbHandler,
                      public resip::InMemorySyncPubDbHandler
 {
 public:
+   static const unsigned int DefaultChangeLogSize = 100000;
+
    RegSyncServer(resip::InMemorySyncRegDb* regDb,
                  int port, 
                  resip::IpVersion version,
-                 resip::InMemorySyncPubDb* pubDb = 0);
+                 resip::InMemorySyncPubDb* pubDb = 0,
+                 unsigned int changeLogSize = DefaultChangeLogSize);
    RegSyncServer(resip::InMemorySyncRegDb* regDb,
                  const resip::Data& brokerQueue,
                  resip::InMemorySyncPubDb* pubDb = 0);
@@ -43,6 +59,8 @@ public:
 
 protected:
    virtual void handleRequest(unsigned int connectionId, unsigned int requestId, const resip::Data& request); 
+   virtual void onConnectionClosed(unsigned int connectionId);
+   virtual void onSendQueueEmpty(unsigned int connectionId);
 
    // InMemorySyncRegDbHandler methods
    virtual void onAorModified(const resip::Uri& aor, const resip::ContactList& contacts);
@@ -54,11 +72,73 @@ protected:
    virtual void onInitialSyncDocument(unsigned int connectionId, const resip::Data& eventType, const resip::Data& documentKey, const resip::Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const resip::Contents* contents, const resip::SecurityAttributes* securityAttributes);
 
 private: 
+   // Frames are sent in batches of about this size
+   static const unsigned int BatchSize = 64*1024;
+
+   class Change
+   {
+   public:
+      Change(RegSyncProtocol::FrameType type, const resip::Data& record) : mType(type), mRecord(record) {}
+      RegSyncProtocol::FrameType mType;
+      resip::Data mRecord;
+   };
+
+   class InitialSync
+   {
+   public:
+      InitialSync(unsigned int requestId, UInt64 sequence) : mRequestId(requestId), mSequence(sequence), mPart(0), mPubDbSynced(false), mBatches(0) {}
+      unsigned int mRequestId;
+      UInt64 mSequence;  // of the last change before the sync started
+      unsigned int mPart;  // the next part of the registration database to sync
+      bool mPubDbSynced;
+      unsigned int mBatches;  // sent so far
+      resip::Data mFrames;  // for the next batch
+   };
+
+   class Resume
+   {
+   public:
+      Resume(unsigned int requestId, UInt64 sequence) : mRequestId(requestId), mSequence(sequence) {}
+      unsigned int mRequestId;
+      UInt64 mSequence;  // of the last change sent
+   };
+
+   void init();
    void handleInitialSyncRequest(unsigned int connectionId, unsigned int requestId, resip::XMLCursor& xml);
    void streamContactInstanceRecord(std::stringstream& ss, const resip::ContactInstanceRecord& rec);
+   resip::Data encodeRegistrationModifiedEvent(const resip::Uri& aor, const resip::ContactList& contacts);
+   resip::Data encodeDocumentModifiedEvent(const resip::Data& eventType, const resip::Data& documentKey, const resip::Data& eTag, UInt64 expirationTime, UInt64 lastUpdated, const resip::Contents* contents, const resip::SecurityAttributes* securityAttributes);
+   resip::Data encodeDocumentRemovedEvent(const resip::Data& eventType, const resip::Data& documentKey, const resip::Data& eTag, UInt64 lastUpdated);
+   resip::Data syncState(UInt64 sequence);
+   void sendChange(RegSyncProtocol::FrameType type, const resip::Data& record);
+   bool isLogged(UInt64 sequence);
+   void sendChangesAfter(unsigned int connectionId, UInt64& sequence);
+   bool continueResume(unsigned int connectionId);
+   void appendInitialSyncRecord(unsigned int connectionId, InitialSync& sync, RegSyncProtocol::FrameType type, const resip::Data& record);
+   void flushInitialSync(unsigned int connectionId, InitialSync& sync);
+   bool isXmlConnection(unsigned int connectionId);
 
    resip::InMemorySyncRegDb* mRegDb;
    resip::InMemorySyncPubDb* mPubDb;
+   bool mBrokerMode;  // events are published to the broker as XML, and not logged
+
+   // Guards the change log and the connection sets, which are used by the 
+   // threads making changes as well as the server thread
+   resip::Mutex mSyncMutex;
+   UInt64 mEpoch;
+   UInt64 mSequence;  // of the last change
+   unsigned int mChangeLogSize;
+   std::deque<Change> mChangeLog;  // the changes up to mSequence
+   std::set<unsigned int> mConnections;     // sent binary events
+   std::set<unsigned int> mXmlConnections;  // sent XML events
+
+   // The initial syncs in progress, and the connections catching up from 
+   // the change log (which are not in mConnections yet) - only used from 
+   // the server thread
+   typedef std::map<unsigned int, InitialSync> InitialSyncMap;
+   InitialSyncMap mInitialSyncs;
+   typedef std::map<unsigned int, Resume> ResumeMap;
+   ResumeMap mResumes;
 };
 
 }
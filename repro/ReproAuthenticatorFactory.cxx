@@ -183,7 +183,8 @@ ReproAuthenticatorFactory::getServerAuthManager()
                                   !mProxyConfig.getConfigBool("DisableAuthInt", false) /*useAuthInt*/,
                                   mProxyConfig.getConfigBool("RejectBadNonces", false),
                                   mDigestChallengeThirdParties,
-                                  mStaticRealm));
+                                  mStaticRealm,
+                                  &mProxyConfig.getDataStore()->mUserStore));
       }
    }
    return mServerAuthManager;
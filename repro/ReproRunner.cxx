@@ -331,6 +331,14 @@ ReproRunner::run(int argc, char** argv)
                    mProxyConfig->getConfigData("LogFilename", "repro.log", true).c_str(),
                    isEqualNoCase(loggingType, "file") ? &g_ReproLogger : 0, // if logging to file then write WARNINGS, and Errors to console still
                    syslogFacilityName);
+   if(mProxyConfig->getConfigBool("LoggingAsync", false))
+   {
+      Log::enableAsync(mProxyConfig->getConfigUnsignedLong("LoggingAsyncRingBytes", 1048576 /* 1 Mb */));
+   }
+   else
+   {
+      Log::disableAsync();
+   }
 
    InfoLog( << "Starting repro version " << VersionUtils::instance().releaseVersion() << "...");
 
@@ -710,6 +718,10 @@ ReproRunner::createSipStack()
          "OpenSSLCTXSetOptions", BaseSecurity::OpenSSLCTXSetOptions);
    setOpenSSLCTXOptionsFromConfig(
          "OpenSSLCTXClearOptions", BaseSecurity::OpenSSLCTXClearOptions);
+   BaseSecurity::TlsSessionCacheSize = mProxyConfig->getConfigUnsignedLong("TlsSessionCacheSize", BaseSecurity::TlsSessionCacheSize);
+   BaseSecurity::TlsSessionTimeout = mProxyConfig->getConfigUnsignedLong("TlsSessionTimeout", BaseSecurity::TlsSessionTimeout);
+   BaseSecurity::TlsTicketKeyLifetime = mProxyConfig->getConfigUnsignedLong("TlsTicketKeyLifetime", BaseSecurity::TlsTicketKeyLifetime);
+   BaseSecurity::TlsClientSessionCacheSize = mProxyConfig->getConfigUnsignedLong("TlsClientSessionCacheSize", BaseSecurity::TlsClientSessionCacheSize);
    Security::CipherList cipherList = Security::StrongestSuite;
    Data ciphers = mProxyConfig->getConfigData("OpenSSLCipherList", Data::Empty);
    if(!ciphers.empty())
@@ -817,6 +829,11 @@ ReproRunner::createSipStack()
       int capturePort = mProxyConfig->getConfigInt("CapturePort", 9060);
       int captureAgentID = mProxyConfig->getConfigInt("CaptureAgentID", 2001);
       SharedPtr<HepAgent> agent(new HepAgent(captureHost, capturePort, captureAgentID));
+      agent->setSamplePercent(mProxyConfig->getConfigUnsignedShort("CaptureSamplePercent", 100));
+      if(mProxyConfig->getConfigBool("CaptureThread", false))
+      {
+         agent->startCaptureThread(mProxyConfig->getConfigUnsignedLong("CaptureQueueSize", 4096));
+      }
       mSipStack->setTransportSipMessageLoggingHandler(SharedPtr<HEPSipMessageLoggingHandler>(new HEPSipMessageLoggingHandler(agent)));
    }
    else if(mProxyConfig->getConfigBool("EnableSipMessageLogging", false))
@@ -1017,6 +1034,9 @@ ReproRunner::createDatastore()
       return false;
    }
    mProxyConfig->createDataStore(mAbstractDb, mRuntimeAbstractDb);
+   mProxyConfig->getDataStore()->mUserStore.setAuthCacheTTL(
+      mProxyConfig->getConfigUnsignedLong("UserAuthCacheTTL", 0),
+      mProxyConfig->getConfigUnsignedLong("UserAuthCacheSize", 100000));
 
    // Create ImMemory Registration Database
    mRegSyncPort = mProxyConfig->getConfigInt("RegSyncPort", 0);
@@ -1425,19 +1445,22 @@ ReproRunner::createRegSync()
    bool enablePublicationReplication = mProxyConfig->getConfigBool("EnablePublicationReplication", false);
    if(mRegSyncPort != 0)
    {
+      unsigned int changeLogSize = mProxyConfig->getConfigUnsignedLong("RegSyncChangeLogSize", RegSyncServer::DefaultChangeLogSize);
       std::list<RegSyncServer*> regSyncServerList;
       if(mUseV4) 
       {
          mRegSyncServerV4 = new RegSyncServer(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager), 
                                               mRegSyncPort, V4, 
-                                              enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+                                              enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0,
+                                              changeLogSize);
          regSyncServerList.push_back(mRegSyncServerV4);
       }
       if(mUseV6) 
       {
          mRegSyncServerV6 = new RegSyncServer(dynamic_cast<InMemorySyncRegDb*>(mRegistrationPersistenceManager),
                                               mRegSyncPort, V6,
-                                              enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0);
+                                              enablePublicationReplication ? dynamic_cast<InMemorySyncPubDb*>(mPublicationPersistenceManager) : 0,
+                                              changeLogSize);
          regSyncServerList.push_back(mRegSyncServerV6);
       }
       if(!regSyncServerList.empty())
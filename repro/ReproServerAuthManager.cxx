@@ -20,11 +20,13 @@ ReproServerAuthManager::ReproServerAuthManager(DialogUsageManager& dum,
                                                bool useAuthInt,
                                                bool rejectBadNonces,
                                                bool challengeThirdParties,
-                                               const Data& staticRealm):
+                                               const Data& staticRealm,
+                                               UserStore* userStore):
    ServerAuthManager(dum, dum.dumIncomingTarget(), challengeThirdParties, staticRealm),
    mDum(dum),
    mAuthRequestDispatcher(authRequestDispatcher),
    mAclDb(aclDb),
+   mUserStore(userStore),
    mUseAuthInt(useAuthInt),
    mRejectBadNonces(rejectBadNonces)
 {
@@ -69,6 +71,14 @@ ReproServerAuthManager::requestCredential(const Data& user,
 {
    // Build a UserAuthInfo object and pass to UserAuthGrabber to have a1 password filled in
    UserAuthInfo* async = new UserAuthInfo(user,realm,transactionId,&mDum);
+   Data a1;
+   if(mUserStore && mUserStore->getCachedUserAuthInfo(user, realm, a1))
+   {
+      // A1 is cached, hand it straight back to DUM
+      async->setA1(a1);
+      mDum.post(async);
+      return;
+   }
    std::auto_ptr<ApplicationMessage> app(async);
    mAuthRequestDispatcher->post(app);
 }
@@ -19,6 +19,7 @@ class DialogUsageManager;
 namespace repro
 {
 class AclStore;
+class UserStore;
 
 class ReproServerAuthManager: public resip::ServerAuthManager
 {
@@ -29,7 +30,8 @@ class ReproServerAuthManager: public resip::ServerAuthManager
                              bool useAuthInt,
                              bool rejectBadNonces,
                              bool challengeThirdParties,
-                             const resip::Data& staticRealm = resip::Data::Empty);
+                             const resip::Data& staticRealm = resip::Data::Empty,
+                             UserStore* userStore = 0);
       
       ~ReproServerAuthManager();
       
@@ -49,6 +51,7 @@ class ReproServerAuthManager: public resip::ServerAuthManager
       resip::DialogUsageManager& mDum;
       resip::Dispatcher* mAuthRequestDispatcher;
       AclStore&  mAclDb;
+      UserStore* mUserStore; // for its A1 cache, may be 0
       bool mUseAuthInt;
       bool mRejectBadNonces;
 };
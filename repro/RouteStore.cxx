@@ -1,4 +1,7 @@
 
+#include <algorithm>
+#include <string.h>
+
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/Lock.hxx"
@@ -75,6 +78,7 @@ RouteStore::RouteStore(AbstractDb& db):
 
    // Initialize cursor to the start
    mCursor = mRouteOperators.begin();
+   mIndex.build(mRouteOperators);
 }
 
 
@@ -143,6 +147,7 @@ RouteStore::addRoute(const resip::Data& method,
    {
       WriteLock lock(mMutex);
       mRouteOperators.insert( route );
+      mIndex.build(mRouteOperators);
    }
    mCursor = mRouteOperators.begin(); 
 
@@ -209,6 +214,7 @@ RouteStore::eraseRoute(const resip::Data& key )
             it++;
          }
       }
+      mIndex.build(mRouteOperators);
    }
    mCursor = mRouteOperators.begin();  // reset the cursor since it may have been on deleted route
 }
@@ -310,15 +316,25 @@ RouteStore::process(const resip::Uri& ruri,
 
    ReadLock lock(mMutex);
 
-   for (RouteOpList::iterator it = mRouteOperators.begin();
-        it != mRouteOperators.end(); it++)
+   Data uri;
+   {
+      DataStream s(uri);
+      s << ruri;
+      s.flush();
+   }
+
+   RouteIndex::CandidateList candidates;
+   mIndex.find(uri, candidates);
+
+   for (RouteIndex::CandidateList::const_iterator it = candidates.begin();
+        it != candidates.end(); it++)
    {
       DebugLog( << "Consider route " // << *it
                 << " reqUri=" << ruri
                 << " method=" << method 
                 << " event=" << event );
 
-      const AbstractDb::RouteRecord& rec = it->routeRecord;
+      const AbstractDb::RouteRecord& rec = it->route->routeRecord;
       
       if(!rec.mMethod.empty())
       {
@@ -339,22 +355,14 @@ RouteStore::process(const resip::Uri& ruri,
       }
       const Data& rewrite = rec.mRewriteExpression;
       const Data& match = rec.mMatchingPattern;
-      if ( it->preq ) 
+      Data target = rewrite;
+      if ( it->type == RouteIndex::Regex ) 
       {
          int ret;
-         // TODO - !cj! www.pcre.org looks like it has better performance
-         // !mbg! is this true now that the compiled regexp is used?
-         Data uri;
-         {
-            DataStream s(uri);
-            s << ruri;
-            s.flush();
-         }
-         
          const int nmatch=10;
          regmatch_t pmatch[nmatch];
          
-         ret = regexec(it->preq, uri.c_str(), nmatch, pmatch, 0/*eflags*/);
+         ret = regexec(it->route->preq, uri.c_str(), nmatch, pmatch, 0/*eflags*/);
          if ( ret != 0 )
          {
             // did not match 
@@ -363,7 +371,6 @@ RouteStore::process(const resip::Uri& ruri,
          }
 
          DebugLog( << "  Route matched" );
-         Data target = rewrite;
          
          if ( rewrite.find("$") != Data::npos )
          {
@@ -403,33 +410,167 @@ RouteStore::process(const resip::Uri& ruri,
                }
             }
          }
-         
-         Uri targetUri;
+      }
+      else
+      {
+         // a literal pattern has no subexpressions to substitute
+         DebugLog( << "  Route matched" );
+      }
+
+      Uri targetUri;
+      try
+      {
+         targetUri = Uri(target);
+      }
+      catch( BaseException& )
+      {
+         ErrLog( << "Routing rule transform " << rewrite << " gave invalid URI " << target );
          try
          {
-            targetUri = Uri(target);
+            targetUri = Uri( Data("sip:")+target);
          }
          catch( BaseException& )
          {
-            ErrLog( << "Routing rule transform " << rewrite << " gave invalid URI " << target );
-            try
-            {
-               targetUri = Uri( Data("sip:")+target);
-            }
-            catch( BaseException& )
-            {
-               ErrLog( << "Routing rule transform " << rewrite << " gave invalid URI sip:" << target );
-               continue;
-            }
+            ErrLog( << "Routing rule transform " << rewrite << " gave invalid URI sip:" << target );
+            continue;
          }
-         targetSet.push_back( targetUri );
       }
+      targetSet.push_back( targetUri );
    }
 
    return targetSet;
 }
   
 
+// Leading characters every match of an ERE pattern must start with, if the
+// pattern is anchored. Returns true if the whole pattern is ^literal$.
+static bool
+literalPrefix(const Data& pattern, Data& prefix)
+{
+   static const char* meta = ".[]()*+?{}|^$\\";
+
+   prefix.clear();
+   // an alternation can take the anchor away from part of the pattern
+   if (pattern.size() < 2 || pattern[0] != '^' || pattern.find("|") != Data::npos)
+   {
+      return false;
+   }
+
+   Data::size_type i = 1;
+   while (i < pattern.size())
+   {
+      char c = pattern[i];
+      Data::size_type len = 1;
+      if (c == '\\')
+      {
+         if (i + 1 >= pattern.size() || !strchr(meta, pattern[i+1]))
+         {
+            return false;
+         }
+         c = pattern[i+1];
+         len = 2;
+      }
+      else if (strchr(meta, c))
+      {
+         return c == '$' && i + 1 == pattern.size();
+      }
+
+      // a quantifier can make this character optional, so it is not part
+      // of the prefix
+      if (i + len < pattern.size() && strchr("*?{", pattern[i+len]))
+      {
+         return false;
+      }
+      prefix += c;
+      i += len;
+   }
+   return false;
+}
+
+unsigned int
+RouteStore::RouteIndex::addPath(const Data& prefix)
+{
+   unsigned int node = 0;
+   for (Data::size_type i = 0; i < prefix.size(); ++i)
+   {
+      std::map<char, unsigned int>::iterator it = mNodes[node].next.find(prefix[i]);
+      if (it == mNodes[node].next.end())
+      {
+         mNodes.push_back(Node());
+         it = mNodes[node].next.insert(std::make_pair(prefix[i], (unsigned int)(mNodes.size() - 1))).first;
+      }
+      node = it->second;
+   }
+   return node;
+}
+
+void
+RouteStore::RouteIndex::build(const RouteOpList& routes)
+{
+   mNodes.clear();
+   mNodes.push_back(Node());
+   mUnindexed.clear();
+
+   unsigned int position = 0;
+   for (RouteOpList::const_iterator it = routes.begin(); it != routes.end(); ++it, ++position)
+   {
+      if (!it->preq)
+      {
+         continue;
+      }
+
+      Candidate c;
+      c.position = position;
+      c.route = &(*it);
+      Data prefix;
+      if (literalPrefix(it->routeRecord.mMatchingPattern, prefix))
+      {
+         c.type = Exact;
+         mNodes[addPath(prefix)].exact.push_back(c);
+      }
+      else if (!prefix.empty())
+      {
+         c.type = Regex;
+         mNodes[addPath(prefix)].prefixed.push_back(c);
+      }
+      else
+      {
+         c.type = Regex;
+         mUnindexed.push_back(c);
+      }
+   }
+}
+
+void
+RouteStore::RouteIndex::find(const Data& uri, CandidateList& candidates) const
+{
+   candidates = mUnindexed;
+   if (mNodes.empty())
+   {
+      return;
+   }
+
+   unsigned int node = 0;
+   for (Data::size_type depth = 0; ; ++depth)
+   {
+      const Node& n = mNodes[node];
+      candidates.insert(candidates.end(), n.prefixed.begin(), n.prefixed.end());
+      if (depth == uri.size())
+      {
+         candidates.insert(candidates.end(), n.exact.begin(), n.exact.end());
+         break;
+      }
+      std::map<char, unsigned int>::const_iterator it = n.next.find(uri[depth]);
+      if (it == n.next.end())
+      {
+         break;
+      }
+      node = it->second;
+   }
+   std::sort(candidates.begin(), candidates.end());
+}
+
+
 RouteStore::Key 
 RouteStore::buildKey(const resip::Data& method,
                      const resip::Data& event,
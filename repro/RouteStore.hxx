@@ -7,7 +7,9 @@
 #include <regex.h>
 #endif
 
+#include <map>
 #include <set>
+#include <vector>
 
 #include "rutil/Data.hxx"
 #include "rutil/RWMutex.hxx"
@@ -80,6 +82,51 @@ class RouteStore
       typedef std::multiset<RouteOp> RouteOpList;
       RouteOpList mRouteOperators; 
       RouteOpList::iterator mCursor;
+
+      // Narrows down the routes process() has to run regexec() for. Patterns
+      // anchored with ^ are filed in a trie under their leading literal
+      // characters, so one walk of the request URI through the trie yields
+      // every route that can still match it. Patterns that are nothing but
+      // ^literal$ match on the walk alone. Rebuilt under the write lock
+      // whenever mRouteOperators changes. Routes without a (valid) pattern
+      // never match and are left out.
+      class RouteIndex
+      {
+         public:
+            enum MatchType
+            {
+               Exact,   // the walk reaching the end of the URI is the match
+               Regex    // candidate only, regexec() decides
+            };
+
+            class Candidate
+            {
+               public:
+                  unsigned int position; // in route order
+                  const RouteOp* route;
+                  MatchType type;
+                  bool operator<(const Candidate& rhs) const { return position < rhs.position; }
+            };
+            typedef std::vector<Candidate> CandidateList;
+
+            void build(const RouteOpList& routes);
+            // candidates in route order
+            void find(const resip::Data& uri, CandidateList& candidates) const;
+
+         private:
+            class Node
+            {
+               public:
+                  std::map<char, unsigned int> next;
+                  CandidateList prefixed; // Regex candidates under this prefix
+                  CandidateList exact;
+            };
+            unsigned int addPath(const resip::Data& prefix);
+
+            std::vector<Node> mNodes; // mNodes[0] is the root
+            CandidateList mUnindexed;
+      };
+      RouteIndex mIndex;
 };
 
  }
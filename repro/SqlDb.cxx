@@ -8,8 +8,10 @@
 #include "rutil/ResipAssert.h"
 #include "rutil/Data.hxx"
 #include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
+#include "rutil/Timer.hxx"
 
 #include "repro/AbstractDb.hxx"
 #include "repro/SqlDb.hxx"
@@ -21,10 +23,101 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::REPRO
 
-SqlDb::SqlDb(const resip::ConfigParse& config) : mConnected(false)
+SqlDb::SqlDb(const resip::ConfigParse& config) : 
+   mConnected(false),
+   mPooledConnections(0),
+   mConnectRetryTime(0),
+   mConnectRetryDelay(0)
 {
    mTlsPeerAuthorizationQuery = config.getConfigData("CustomTlsAuthQuery", "");
    mTableNamePrefix = config.getConfigData("TableNamePrefix", "");
+   mConnectionPoolSize = (unsigned int)config.getConfigData("ConnectionPoolSize", "0", true).convertUnsignedLong();
+}
+
+SqlDb::~SqlDb()
+{
+   resip_assert(mPooledConnections == 0);
+}
+
+SqlDb::PooledConnection*
+SqlDb::acquireConnection() const
+{
+   if(mConnectionPoolSize == 0)
+   {
+      return 0;
+   }
+
+   Lock lock(mPoolMutex);
+   while(mIdleConnections.empty())
+   {
+      if(mPooledConnections < mConnectionPoolSize)
+      {
+         if(Timer::getTimeMs() < mConnectRetryTime)
+         {
+            // The database was unreachable last time - use the shared connection until the retry is due
+            return 0;
+         }
+
+         // Connect without holding up threads that are returning connections
+         mPooledConnections++;
+         PooledConnection* connection;
+         {
+            mPoolMutex.unlock();
+            connection = createPooledConnection();
+            mPoolMutex.lock();
+         }
+         if(connection == 0)
+         {
+            mPooledConnections--;
+            mConnectRetryDelay = resipMin(mConnectRetryDelay ? mConnectRetryDelay * 2 : (unsigned int)ConnectRetryInitialDelayMs, 
+                                          (unsigned int)ConnectRetryMaxDelayMs);
+            mConnectRetryTime = Timer::getTimeMs() + mConnectRetryDelay;
+            WarningLog(<< "Could not open a pooled database connection, next attempt in " << mConnectRetryDelay << "ms");
+            mPoolCondition.signal();
+         }
+         else
+         {
+            mConnectRetryDelay = 0;
+            mConnectRetryTime = 0;
+         }
+         return connection;
+      }
+      mPoolCondition.wait(mPoolMutex);
+   }
+   PooledConnection* connection = mIdleConnections.back();
+   mIdleConnections.pop_back();
+   return connection;
+}
+
+void
+SqlDb::releaseConnection(PooledConnection* connection, bool broken) const
+{
+   if(broken)
+   {
+      delete connection;
+   }
+   Lock lock(mPoolMutex);
+   if(broken)
+   {
+      mPooledConnections--;  // the next acquire makes a new one
+   }
+   else
+   {
+      mIdleConnections.push_back(connection);
+   }
+   mPoolCondition.signal();
+}
+
+void
+SqlDb::closePooledConnections()
+{
+   Lock lock(mPoolMutex);
+   for(std::vector<PooledConnection*>::iterator it = mIdleConnections.begin(); it != mIdleConnections.end(); it++)
+   {
+      delete *it;
+   }
+   mPooledConnections -= (unsigned int)mIdleConnections.size();
+   mIdleConnections.clear();
 }
 
 void 
@@ -1,8 +1,11 @@
 #if !defined(RESIP_SQLDB_HXX)
 #define RESIP_SQLDB_HXX 
 
+#include <vector>
+#include "rutil/Condition.hxx"
 #include "rutil/ConfigParse.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
 #include "repro/AbstractDb.hxx"
 
 namespace resip
@@ -17,6 +20,7 @@ class SqlDb: public AbstractDb
 {
    public:
       SqlDb(const resip::ConfigParse& config);
+      virtual ~SqlDb();
       
       virtual bool isSane() {return mConnected;}
 
@@ -41,6 +45,42 @@ class SqlDb: public AbstractDb
 
       resip::Data tableName( Table table ) const;
 
+      // Lookups made while requests are being processed (getUserAuthInfo and
+      // singleResultQuery) can run on a pool of ConnectionPoolSize extra
+      // connections, so worker threads don't all queue on mMutex and the one
+      // connection that cursors and transactions need to stay on. Backends
+      // derive their connection (and its prepared statements) from
+      // PooledConnection and create them on demand in createPooledConnection.
+      class PooledConnection
+      {
+         public:
+            virtual ~PooledConnection() {}
+      };
+
+      // Holds a pooled connection for the lifetime of the guard. get() is 0
+      // when the pool is disabled or a new connection could not be made (or
+      // is being held off after a failure), in which case the caller uses the
+      // shared connection as before.
+      class PooledConnectionGuard
+      {
+         public:
+            PooledConnectionGuard(const SqlDb& db) : mDb(db), mConnection(db.acquireConnection()), mBroken(false) {}
+            ~PooledConnectionGuard() { if(mConnection) mDb.releaseConnection(mConnection, mBroken); }
+            PooledConnection* get() const { return mConnection; }
+            // the connection failed - close it instead of returning it to the pool
+            void setBroken() { mBroken = true; }
+
+         private:
+            const SqlDb& mDb;
+            PooledConnection* mConnection;
+            bool mBroken;
+      };
+
+      virtual PooledConnection* createPooledConnection() const { return 0; }
+      // Deletes the pooled connections - backends call this from their destructor, 
+      // while their connection types can still be closed
+      void closePooledConnections();
+
    private:
       // Db manipulation routines
       virtual void dbEraseRecord(const Table table, 
@@ -57,6 +97,21 @@ class SqlDb: public AbstractDb
       resip::Data mTlsPeerAuthorizationQuery;
       resip::Data mTableNamePrefix;
 
+      PooledConnection* acquireConnection() const;
+      void releaseConnection(PooledConnection* connection, bool broken) const;
+
+      unsigned int mConnectionPoolSize;
+      mutable resip::Mutex mPoolMutex;
+      mutable resip::Condition mPoolCondition;
+      mutable std::vector<PooledConnection*> mIdleConnections;
+      mutable unsigned int mPooledConnections;  // idle and in use
+
+      // After a failed connect, acquireConnection hands out no new connections
+      // until mConnectRetryTime, doubling the delay on each further failure
+      enum { ConnectRetryInitialDelayMs = 1000, ConnectRetryMaxDelayMs = 32000 };
+      mutable UInt64 mConnectRetryTime;
+      mutable unsigned int mConnectRetryDelay;
+
       virtual void userWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const = 0;
       virtual void tlsPeerIdentityWhereClauseToDataStream(const Key& key, resip::DataStream& ds) const = 0;
 };
@@ -7,6 +7,7 @@
 #include "rutil/DataStream.hxx"
 #include "resip/stack/Symbols.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
 #include "resip/stack/TransactionUser.hxx"
 #include "resip/dum/UserAuthInfo.hxx"
 
@@ -23,7 +24,10 @@ using namespace std;
 
 const resip::Data UserStore::SEPARATOR("@");
 
-UserStore::UserStore(AbstractDb& db ) : mDb(db)
+UserStore::UserStore(AbstractDb& db ) : 
+   mDb(db),
+   mAuthCacheTTL(0),
+   mAuthCacheShardSize(0)
 { 
 }
 
@@ -42,7 +46,110 @@ UserStore::getUserAuthInfo(  const resip::Data& user,
                              const resip::Data& realm ) const
 {
    Key key =  buildKey(user, realm);
-   return mDb.getUserAuthInfo( key );
+   if(mAuthCacheTTL == 0)
+   {
+      return mDb.getUserAuthInfo( key );
+   }
+
+   // Taken before the read, so an update that lands while we are reading
+   // stops us from caching what is now the old hash
+   unsigned long generation;
+   {
+      AuthCacheShard& shard = authCacheShard(key);
+      Lock lock(shard.mMutex);
+      generation = shard.mGeneration;
+   }
+   Data a1 = mDb.getUserAuthInfo( key );
+   if(!a1.empty())
+   {
+      cacheAuthInfo(key, a1, generation);
+   }
+   return a1;
+}
+
+void
+UserStore::setAuthCacheTTL(unsigned long ttlSecs, unsigned long maxEntries)
+{
+   mAuthCacheShardSize = maxEntries / AuthCacheShards + 1;
+   mAuthCacheTTL = ttlSecs;
+   if(ttlSecs == 0)
+   {
+      for(int i = 0; i < AuthCacheShards; ++i)
+      {
+         Lock lock(mAuthCache[i].mMutex);
+         mAuthCache[i].mEntries.clear();
+      }
+   }
+}
+
+bool
+UserStore::getCachedUserAuthInfo(const Data& user,
+                                 const Data& realm,
+                                 Data& a1) const
+{
+   if(mAuthCacheTTL == 0)
+   {
+      return false;
+   }
+   Key key = buildKey(user, realm);
+   AuthCacheShard& shard = authCacheShard(key);
+   Lock lock(shard.mMutex);
+   AuthCacheMap::iterator it = shard.mEntries.find(key);
+   if(it == shard.mEntries.end())
+   {
+      return false;
+   }
+   if(it->second.mExpires <= Timer::getTimeSecs())
+   {
+      shard.mEntries.erase(it);
+      return false;
+   }
+   a1 = it->second.mA1;
+   return true;
+}
+
+void
+UserStore::cacheAuthInfo(const Key& key, const Data& a1, unsigned long generation) const
+{
+   const UInt64 now = Timer::getTimeSecs();
+   AuthCacheShard& shard = authCacheShard(key);
+   Lock lock(shard.mMutex);
+   if(shard.mGeneration != generation)
+   {
+      // a user in this shard was changed since a1 was read
+      return;
+   }
+   if(shard.mEntries.size() >= mAuthCacheShardSize && 
+      shard.mEntries.find(key) == shard.mEntries.end())
+   {
+      for(AuthCacheMap::iterator it = shard.mEntries.begin(); it != shard.mEntries.end(); )
+      {
+         if(it->second.mExpires <= now)
+         {
+            shard.mEntries.erase(it++);
+         }
+         else
+         {
+            ++it;
+         }
+      }
+      if(shard.mEntries.size() >= mAuthCacheShardSize)
+      {
+         return;
+      }
+   }
+   AuthCacheEntry& entry = shard.mEntries[key];
+   entry.mA1 = a1;
+   entry.mExpires = now + mAuthCacheTTL;
+}
+
+void
+UserStore::invalidateAuthInfo(const Key& key)
+{
+   AuthCacheShard& shard = authCacheShard(key);
+   Lock lock(shard.mMutex);
+   shard.mEntries.erase(key);
+   ++shard.mGeneration;
 }
 
 bool 
@@ -91,13 +198,28 @@ UserStore::addUser( const Data& username,
    rec.email = emailAddress;
    rec.forwardAddress = Data::Empty;
 
-   return mDb.addUser( buildKey(username,domain), rec);
+   bool ret = mDb.addUser( buildKey(username,domain), rec);
+   // After the write, so a lookup that read the old record can't cache it
+   // again.  Lookups are keyed by user and realm, the database by user and domain.
+   invalidateAuthInfo(buildKey(username, domain));
+   invalidateAuthInfo(buildKey(username, realm));
+   return ret;
 }
 
 void 
 UserStore::eraseUser( const Key& key )
 { 
+   AbstractDb::UserRecord rec;
+   if(mAuthCacheTTL > 0)
+   {
+      rec = mDb.getUser(key);
+   }
    mDb.eraseUser( key );
+   if(mAuthCacheTTL > 0)
+   {
+      invalidateAuthInfo(buildKey(rec.user, rec.realm));
+   }
+   invalidateAuthInfo(key);
 }
 
 bool
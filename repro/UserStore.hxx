@@ -3,6 +3,8 @@
 
 #include "rutil/Data.hxx"
 #include "rutil/Fifo.hxx"
+#include "rutil/HashMap.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/Message.hxx"
 
 #include "repro/AbstractDb.hxx"
@@ -30,6 +32,19 @@ class UserStore
 
       resip::Data getUserAuthInfo( const resip::Data& user,
                                    const resip::Data& realm ) const;
+
+      /** A1 hashes read by getUserAuthInfo() are kept for ttlSecs, so that
+          digest authentication can usually skip the database and the trip
+          through the auth request dispatcher.  Users modified through this
+          UserStore are dropped from the cache at once; changes made to the
+          database by anyone else show up after at most ttlSecs.  0 (the
+          default) disables the cache.  maxEntries bounds its size. */
+      void setAuthCacheTTL(unsigned long ttlSecs, unsigned long maxEntries = 100000);
+
+      /// Safe to call from any thread; never touches the database.
+      bool getCachedUserAuthInfo( const resip::Data& user,
+                                  const resip::Data& realm,
+                                  resip::Data& a1 ) const;
       
       bool addUser( const resip::Data& user, 
                     const resip::Data& domain, 
@@ -59,9 +74,32 @@ class UserStore
       static void getUserAndDomainFromKey(const AbstractDb::Key& key, resip::Data& user, resip::Data& domain);
 
    private:
+      void cacheAuthInfo(const Key& key, const resip::Data& a1, unsigned long generation) const;
+      void invalidateAuthInfo(const Key& key);
 
       AbstractDb& mDb;
       static const resip::Data SEPARATOR;
+
+      // sharded so the auth workers and the proxy thread rarely contend
+      enum { AuthCacheShards = 16 };
+      struct AuthCacheEntry
+      {
+         resip::Data mA1;
+         UInt64 mExpires;
+      };
+      typedef HashMap<resip::Data, AuthCacheEntry> AuthCacheMap;
+      struct AuthCacheShard
+      {
+         AuthCacheShard() : mGeneration(0) {}
+         resip::Mutex mMutex;
+         AuthCacheMap mEntries;
+         unsigned long mGeneration;  // bumped whenever an entry is invalidated
+      };
+      AuthCacheShard& authCacheShard(const Key& key) const { return mAuthCache[key.hash() % AuthCacheShards]; }
+
+      volatile unsigned long mAuthCacheTTL;
+      unsigned long mAuthCacheShardSize;
+      mutable AuthCacheShard mAuthCache[AuthCacheShards];
 };
 
  }
@@ -25,7 +25,8 @@ XmlRpcConnection::XmlRpcConnection(XmlRpcServerBase& server, resip::Socket sock)
    mXmlRcpServer(server),
    mConnectionId(NextConnectionId++),
    mNextRequestId(1),
-   mSock(sock)
+   mSock(sock),
+   mTxOffset(0)
 {
 	resip_assert(mSock > 0);
 }
@@ -177,10 +178,12 @@ XmlRpcConnection::processSomeWrites()
    
    //DebugLog (<< "XmlRpcConnection::processSomeWrites: Writing " << mTxBuffer );
 
+   const char* data = mTxBuffer.data() + mTxOffset;
+   Data::size_type size = mTxBuffer.size() - mTxOffset;
 #if defined(WIN32)
-   int bytesWritten = ::send(mSock, mTxBuffer.data(), (int)mTxBuffer.size(), 0);
+   int bytesWritten = ::send(mSock, data, (int)size, 0);
 #else
-   int bytesWritten = ::write(mSock, mTxBuffer.data(), mTxBuffer.size() );
+   int bytesWritten = ::write(mSock, data, size);
 #endif
 
    if (bytesWritten == INVALID_SOCKET)
@@ -192,19 +195,27 @@ XmlRpcConnection::processSomeWrites()
       return false;
    }
    
-   if (bytesWritten == (int)mTxBuffer.size())
+   if (bytesWritten == (int)size)
    {
       DebugLog (<< "XmlRpcConnection::processSomeWrites - Wrote it all" );
-      mTxBuffer = Data::Empty;
+      mTxBuffer.clear();
+      mTxOffset = 0;
 
       //return false; // return false causes connection to close and clean up
       return true;  // keep connection up
    }
    else
    {
-      Data rest = mTxBuffer.substr(bytesWritten);
-      mTxBuffer = rest;
-      DebugLog( << "XmlRpcConnection::processSomeWrites - Wrote " << bytesWritten << " bytes - still need to do " << mTxBuffer );
+      // Move past what was written, and only shift the rest down once the 
+      // written part is most of the buffer, so a large reply is copied a 
+      // bounded number of times rather than once per write
+      mTxOffset += bytesWritten;
+      if (mTxOffset > mTxBuffer.size() / 2)
+      {
+         mTxBuffer = mTxBuffer.substr(mTxOffset);
+         mTxOffset = 0;
+      }
+      DebugLog( << "XmlRpcConnection::processSomeWrites - Wrote " << bytesWritten << " bytes - still need to do " << mTxBuffer.size() - mTxOffset << " bytes");
    }
    
    return true;
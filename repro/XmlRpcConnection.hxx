@@ -21,6 +21,7 @@ public:
    virtual ~XmlRpcConnection();
    
    unsigned int getConnectionId() const { return mConnectionId; }
+   bool isSendQueueEmpty() const { return mTxBuffer.empty(); }
    void buildFdSet(resip::FdSet& fdset);
    bool process(resip::FdSet& fdset);
 
@@ -43,6 +44,7 @@ private:
    resip::Socket mSock;
    resip::Data mRxBuffer;
    resip::Data mTxBuffer;
+   resip::Data::size_type mTxOffset;  // how much of mTxBuffer has been written
 };
 
 }
@@ -263,11 +263,16 @@ XmlRpcServerBase::process(FdSet& fdset)
       bool ok = it->second->process(fdset);
       if (!ok)
       {
+         onConnectionClosed(it->first);
          delete it->second;
          mConnections.erase(it++);
       }
       else
       {
+         if (it->second->isSendQueueEmpty())
+         {
+            onSendQueueEmpty(it->first);
+         }
          it++;
       }
    }
@@ -333,6 +338,7 @@ XmlRpcServerBase::closeOldestConnection()
          lowestConnectionIdIt = it;
       }
    }
+   onConnectionClosed(lowestConnectionIdIt->first);
    delete lowestConnectionIdIt->second;
    mConnections.erase(lowestConnectionIdIt);
 }
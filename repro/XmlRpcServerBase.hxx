@@ -80,6 +80,11 @@ protected:
    virtual void handleRequest(unsigned int connectionId, 
                               unsigned int requestId, 
                               const resip::Data& request) = 0; 
+   // called from process() when a connection goes away
+   virtual void onConnectionClosed(unsigned int connectionId) {}
+   // called from process() when everything queued for a connection has been 
+   // written to its socket - lets a server stream a large reply a piece at a time
+   virtual void onSendQueueEmpty(unsigned int connectionId) {}
       
 private:
    static const unsigned int MaxConnections = 60;   // Note:  use caution if making this any bigger, default fd_set size in windows is 64
@@ -31,6 +31,7 @@ namespace repro
       virtual processor_action_t requestUserAuthInfo(RequestContext &, const resip::Auth& auth, UserInfoMessage *userInfo);
       virtual resip::Data getRealm(RequestContext &);
       virtual bool isMyRealm(RequestContext &, const resip::Data& realm);
+      processor_action_t processUserInfo(RequestContext &, const UserInfoMessage& userInfo);
       
     protected:
       resip::Dispatcher* mAuthRequestDispatcher;
@@ -0,0 +1,275 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <iostream>
+#include <list>
+#include <map>
+#include <vector>
+#include "assert.h"
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Random.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "repro/AbstractDb.hxx"
+#include "repro/AclStore.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// Keeps the tables in memory, so AclStore can be exercised without a
+// database.
+class MemoryDb : public AbstractDb
+{
+   public:
+      virtual bool isSane() { return true; }
+
+   protected:
+      typedef map<Data, Data> Records;
+
+      virtual bool dbWriteRecord(const Table table, const Data& key, const Data& data)
+      {
+         mTables[table][key] = data;
+         return true;
+      }
+      virtual bool dbReadRecord(const Table table, const Data& key, Data& data) const
+      {
+         Records::const_iterator it = mTables[table].find(key);
+         if (it == mTables[table].end())
+         {
+            return false;
+         }
+         data = it->second;
+         return true;
+      }
+      virtual void dbEraseRecord(const Table table, const Data& key, bool isSecondaryKey=false)
+      {
+         mTables[table].erase(key);
+      }
+      virtual Data dbNextKey(const Table table, bool first=false)
+      {
+         if (first)
+         {
+            mCursor[table] = mTables[table].begin();
+         }
+         if (mCursor[table] == mTables[table].end())
+         {
+            return Data::Empty;
+         }
+         return (mCursor[table]++)->first;
+      }
+      virtual bool dbNextRecord(const Table table, const Data& key, Data& data, bool forUpdate, bool first=false)
+      {
+         return false;
+      }
+      virtual bool dbBeginTransaction(const Table table) { return true; }
+      virtual bool dbCommitTransaction(const Table table) { return true; }
+      virtual bool dbRollbackTransaction(const Table table) { return true; }
+
+   private:
+      mutable Records mTables[MaxTable];
+      Records::iterator mCursor[MaxTable];
+};
+
+static bool
+trusted(AclStore& store, const char* address, int port = 5060, TransportType type = UDP)
+{
+   return store.isAddressTrusted(Tuple(address, port, type));
+}
+
+// The old AclStore::isAddressTrusted(): isEqualWithMask against every ACL.
+class LinearMatcher
+{
+   public:
+      void add(const Tuple& tuple, short mask) { mAcls.push_back(make_pair(tuple, mask)); }
+      bool isTrusted(const Tuple& address) const
+      {
+         for (vector<pair<Tuple, short> >::const_iterator it = mAcls.begin(); it != mAcls.end(); ++it)
+         {
+            if (it->first.isEqualWithMask(address, it->second, it->first.getPort() == 0))
+            {
+               return true;
+            }
+         }
+         return false;
+      }
+
+   private:
+      vector<pair<Tuple, short> > mAcls;
+};
+
+static Data
+randomV4()
+{
+   unsigned int a = (unsigned int)Random::getRandom();
+   return Data((a >> 24) & 0xff) + "." + Data((a >> 16) & 0xff) + "." + Data((a >> 8) & 0xff) + "." + Data(a & 0xff);
+}
+
+static void
+sweep(unsigned int numAcls)
+{
+   MemoryDb db;
+   AclStore store(db);
+   LinearMatcher linear;
+
+   // carrier and customer ranges, /16 to /32
+   vector<Data> hosts;
+   for (unsigned int i = 0; i < numAcls; ++i)
+   {
+      Data address = randomV4();
+      short mask = (short)(16 + i % 17);
+      store.addAcl(Data::Empty, address, mask, 0, V4, UDP);
+      linear.add(Tuple(address, 0, UDP), mask);
+      hosts.push_back(address);
+   }
+
+   // half the sources are covered by an ACL, half are random
+   const unsigned int lookups = 20000;
+   vector<Tuple> sources;
+   for (unsigned int i = 0; i < 200; ++i)
+   {
+      sources.push_back(Tuple(i % 2 ? hosts[(i * 7919) % hosts.size()] : randomV4(), 5060, UDP));
+   }
+
+   UInt64 start = Timer::getTimeMicroSec();
+   unsigned int indexedTrusted = 0;
+   for (unsigned int i = 0; i < lookups; ++i)
+   {
+      indexedTrusted += store.isAddressTrusted(sources[i % sources.size()]) ? 1 : 0;
+   }
+   UInt64 indexed = Timer::getTimeMicroSec() - start;
+
+   start = Timer::getTimeMicroSec();
+   unsigned int linearTrusted = 0;
+   for (unsigned int i = 0; i < lookups; ++i)
+   {
+      linearTrusted += linear.isTrusted(sources[i % sources.size()]) ? 1 : 0;
+   }
+   UInt64 scanned = Timer::getTimeMicroSec() - start;
+
+   assert(indexedTrusted == linearTrusted);
+   assert(indexedTrusted >= lookups / 2);
+
+   cerr << numAcls << " ACLs: indexed " << (double)indexed / lookups << "us/request, "
+        << "isEqualWithMask every ACL " << (double)scanned / lookups << "us/request" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   {
+      MemoryDb db;
+      AclStore store(db);
+      assert(!trusted(store, "192.168.1.10"));
+
+      assert(store.addAcl("192.168.1.0/24", 0, UDP));
+      assert(store.addAcl("10.1.2.3", 5070, TCP));
+      assert(store.addAcl("172.16.0.0/12", 0, UDP));
+      assert(!store.addAcl("192.168.1.0/24", 0, UDP));  // already there
+
+      // prefix match, port 0 is any port
+      assert(trusted(store, "192.168.1.10"));
+      assert(trusted(store, "192.168.1.255", 1234));
+      assert(!trusted(store, "192.168.2.10"));
+      assert(trusted(store, "172.31.255.1"));
+      assert(!trusted(store, "172.32.0.1"));
+      // port and transport have to match too
+      assert(trusted(store, "10.1.2.3", 5070, TCP));
+      assert(!trusted(store, "10.1.2.3", 5060, TCP));
+      assert(!trusted(store, "10.1.2.3", 5070, UDP));
+      assert(!trusted(store, "192.168.1.10", 5060, TCP));
+
+#ifdef USE_IPV6
+      assert(store.addAcl("[2001:db8::]/64", 0, UDP));
+      assert(trusted(store, "2001:db8::1"));
+      assert(trusted(store, "2001:db8::ffff:1"));
+      assert(!trusted(store, "2001:db8:0:1::1"));
+      // an IPv4 ACL never covers an IPv6 source
+      assert(!trusted(store, "::ffff:192.168.1.10"));
+#endif
+
+      // the index follows erases, and is rebuilt from the db
+      store.eraseAcl(Data::Empty, "192.168.1.0", 24, 0, V4, UDP);
+      assert(!trusted(store, "192.168.1.10"));
+      AclStore reloaded(db);
+      assert(!trusted(reloaded, "192.168.1.10"));
+      assert(trusted(reloaded, "172.16.4.4"));
+      assert(trusted(reloaded, "10.1.2.3", 5070, TCP));
+
+      // TLS peer names compare without case
+      assert(store.addAcl("sbc1.example.com", 0, 0));
+      list<Data> names;
+      names.push_back("www.example.com");
+      assert(!store.isTlsPeerNameTrusted(names));
+      names.push_back("SBC1.Example.COM");
+      assert(store.isTlsPeerNameTrusted(names));
+      store.eraseAcl("sbc1.example.com", Data::Empty, 0, 0, 0, 0);
+      assert(!store.isTlsPeerNameTrusted(names));
+   }
+
+   unsigned int sizes[] = { 10, 100, 1000, 5000 };
+   for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+   {
+      sweep(sizes[i]);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,608 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+#include "assert.h"
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ParseException.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/GenericPidfContents.hxx"
+#include "resip/stack/SecurityAttributes.hxx"
+#include "resip/stack/Tuple.hxx"
+#include "resip/dum/InMemorySyncRegDb.hxx"
+#include "repro/RegSyncClient.hxx"
+#include "repro/RegSyncProtocol.hxx"
+#include "repro/RegSyncServer.hxx"
+#include "repro/RegSyncServerThread.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static ContactInstanceRecord
+makeContact(const Data& contact, UInt64 expires)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr(contact);
+   rec.mRegExpires = expires;
+   rec.mLastUpdated = Timer::getTimeSecs();
+   return rec;
+}
+
+static Uri
+aorFor(int i)
+{
+   return Uri("sip:user" + Data(i) + "@example.com");
+}
+
+static void
+testRegInfoCodec()
+{
+   UInt64 now = Timer::getTimeSecs();
+   // the sender's clock is 10 seconds behind ours
+   UInt64 senderNow = now - 10;
+
+   ContactList contacts;
+   ContactInstanceRecord rec = makeContact("<sip:alice@192.0.2.1:5060;transport=tcp>;+sip.instance=\"<urn:uuid:1>\"", senderNow + 3600);
+   rec.mLastUpdated = senderNow - 20;
+   rec.mReceivedFrom = Tuple("192.0.2.1", 5060, V4, TCP);
+   rec.mPublicAddress = Tuple("198.51.100.1", 5060, V4, UDP);
+   rec.mSipPath.push_back(NameAddr("<sip:edge.example.com;lr>"));
+   rec.mSipPath.push_back(NameAddr("<sip:core.example.com;lr>"));
+   rec.mInstance = "<urn:uuid:1>";
+   rec.mRegId = 0xffffffff;
+   rec.mUserAgent = "test agent";
+   contacts.push_back(rec);
+   ContactInstanceRecord removed = makeContact("sip:alice@192.0.2.2", 0);
+   removed.mLastUpdated = senderNow;
+   contacts.push_back(removed);
+   // static registrations aren't synced
+   contacts.push_back(makeContact("sip:alice@192.0.2.3", NeverExpire));
+
+   Data record;
+   assert(RegSyncProtocol::encodeRegInfo(record, Uri("sip:alice@example.com"), contacts));
+   Data frames;
+   RegSyncProtocol::appendFrame(frames, RegSyncProtocol::RegInfo, 7, senderNow, record);
+   unsigned int size = (unsigned int)frames.size();
+
+   // frames are only complete once all of them is there
+   assert(RegSyncProtocol::frameSize(frames.data(), 1) == 0);
+   assert(RegSyncProtocol::frameSize(frames.data(), RegSyncProtocol::HeaderSize) == 0);
+   assert(RegSyncProtocol::frameSize(frames.data(), size - 1) == 0);
+   assert(RegSyncProtocol::frameSize(frames.data(), size) == size);
+   assert(RegSyncProtocol::frameType(frames.data()) == RegSyncProtocol::RegInfo);
+
+   UInt64 sequence = 0;
+   Uri aor;
+   ContactList decoded;
+   RegSyncProtocol::decodeRegInfo(frames.data(), size, now, sequence, aor, decoded);
+   assert(sequence == 7);
+   assert(aor == Uri("sip:alice@example.com"));
+   assert(decoded.size() == 2);
+   const ContactInstanceRecord& got = decoded.front();
+   assert(got.mContact.uri() == rec.mContact.uri());
+   assert(got.mContact.exists(p_Instance));
+   assert(got.mRegExpires == now + 3600);
+   assert(got.mLastUpdated == now - 20);
+   assert(got.mReceivedFrom == rec.mReceivedFrom);
+   assert(got.mReceivedFrom.getType() == TCP);
+   assert(got.mPublicAddress == rec.mPublicAddress);
+   assert(got.mSipPath.size() == 2);
+   assert(got.mSipPath.back().uri() == rec.mSipPath.back().uri());
+   assert(got.mInstance == rec.mInstance);
+   assert(got.mRegId == rec.mRegId);
+   assert(got.mUserAgent == rec.mUserAgent);
+   assert(got.mSyncContact);
+   assert(decoded.back().mRegExpires == 0);
+   assert(decoded.back().mLastUpdated == now);
+   assert(decoded.back().mReceivedFrom.getPort() == 0);
+
+   // nothing to send if none of the contacts are synced
+   Data empty;
+   assert(!RegSyncProtocol::encodeRegInfo(empty, aor, ContactList(1, makeContact("sip:alice@192.0.2.3", NeverExpire))));
+   assert(empty.empty());
+
+   // a batch holds whole frames
+   Data more(frames);
+   RegSyncProtocol::appendFrame(more, RegSyncProtocol::RegInfo, 8, senderNow, record);
+   Data batch;
+   RegSyncProtocol::appendBatch(batch, more);
+   assert(RegSyncProtocol::frameType(batch.data()) == RegSyncProtocol::Batch);
+   assert(RegSyncProtocol::frameSize(batch.data(), (unsigned int)batch.size()) == batch.size());
+   const char* inner = batch.data() + RegSyncProtocol::HeaderSize;
+   assert(RegSyncProtocol::frameSize(inner, (unsigned int)(batch.data() + batch.size() - inner)) == size);
+   RegSyncProtocol::decodeRegInfo(inner + size, size, now, sequence, aor, decoded);
+   assert(sequence == 8);
+
+   // damaged frames are rejected
+   bool thrown = false;
+   try
+   {
+      RegSyncProtocol::frameSize("<reginfo>", 9);
+   }
+   catch(ParseException&)
+   {
+      thrown = true;
+   }
+   assert(thrown);
+   thrown = false;
+   try
+   {
+      Data truncated(frames.data(), size - 3);
+      RegSyncProtocol::decodeRegInfo(truncated.data(), (unsigned int)truncated.size(), now, sequence, aor, decoded);
+   }
+   catch(ParseException&)
+   {
+      thrown = true;
+   }
+   assert(thrown);
+}
+
+static void
+testPubInfoCodec()
+{
+   UInt64 now = Timer::getTimeSecs();
+   Data pidf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\r\n"
+             "<presence xmlns=\"urn:ietf:params:xml:ns:pidf\" entity=\"sip:bob@example.com\">\r\n"
+             "  <tuple id=\"t1\"><status><basic>open</basic></status></tuple>\r\n"
+             "</presence>\r\n");
+   HeaderFieldValue hfv(pidf.data(), (unsigned int)pidf.size());
+   GenericPidfContents contents(hfv, GenericPidfContents::getStaticType());
+   SecurityAttributes security;
+   security.setEncrypted();
+   security.setSignatureStatus(SignatureTrusted);
+   security.setSigner("sip:bob@example.com");
+   security.setIdentity("sip:bob@example.com");
+   security.setIdentityStrength(SecurityAttributes::Identity);
+
+   Data record;
+   RegSyncProtocol::encodePubInfo(record, "presence", "sip:bob@example.com", "etag1", now + 600, now - 5, &contents, &security);
+   Data frames;
+   RegSyncProtocol::appendFrame(frames, RegSyncProtocol::PubInfo, 0, now, record);
+
+   UInt64 sequence = 1;
+   PublicationPersistenceManager::PubDocument document;
+   RegSyncProtocol::decodePubInfo(frames.data(), (unsigned int)frames.size(), now, sequence, document);
+   assert(sequence == 0);
+   assert(document.mEventType == "presence");
+   assert(document.mDocumentKey == "sip:bob@example.com");
+   assert(document.mETag == "etag1");
+   assert(document.mExpirationTime == now + 600);
+   assert(document.mLingerTime == now + 600);
+   assert(document.mLastUpdated == now - 5);
+   assert(document.mContents.get());
+   assert(document.mContents->getBodyData() == contents.getBodyData());
+   assert(document.mSecurityAttributes.get());
+   assert(document.mSecurityAttributes->isEncrypted());
+   assert(document.mSecurityAttributes->getSignatureStatus() == SignatureTrusted);
+   assert(document.mSecurityAttributes->getSigner() == "sip:bob@example.com");
+   assert(document.mSecurityAttributes->getIdentity() == "sip:bob@example.com");
+   assert(document.mSecurityAttributes->getIdentityStrength() == SecurityAttributes::Identity);
+
+   // a removal carries no contents
+   record.clear();
+   frames.clear();
+   RegSyncProtocol::encodePubInfo(record, "presence", "sip:bob@example.com", "etag1", 0, now, &contents, &security);
+   RegSyncProtocol::appendFrame(frames, RegSyncProtocol::PubInfo, 3, now, record);
+   RegSyncProtocol::decodePubInfo(frames.data(), (unsigned int)frames.size(), now, sequence, document);
+   assert(sequence == 3);
+   assert(document.mExpirationTime == 0);
+   assert(!document.mContents.get());
+   assert(!document.mSecurityAttributes.get());
+}
+
+// Talks to a RegSyncServer the way a RegSyncClient would, and keeps track
+// of what it is sent
+class Peer
+{
+   public:
+      Peer(int port) : mProvisional(false), mResultCode(0), mEpoch(0), mSequence(0), mSnapshotRecords(0), mXmlEvents(0), mBatches(0)
+      {
+         mSock = ::socket(PF_INET, SOCK_STREAM, 0);
+         assert(mSock != INVALID_SOCKET);
+         Tuple server("127.0.0.1", port, V4, TCP);
+         int rc = ::connect(mSock, &server.getMutableSockaddr(), server.length());
+         assert(rc == 0);
+         timeval tv;
+         tv.tv_sec = 10;
+         tv.tv_usec = 0;
+         setsockopt(mSock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof(tv));
+      }
+      ~Peer()
+      {
+         closeSocket(mSock);
+      }
+
+      void sendInitialSync(unsigned int version, UInt64 epoch = 0, UInt64 sequence = 0)
+      {
+         Data request("<InitialSync>\r\n  <Request>\r\n     <Version>" + Data(version) + "</Version>\r\n");
+         if(epoch)
+         {
+            request += "     <Epoch>" + Data(epoch) + "</Epoch>\r\n     <Sequence>" + Data(sequence) + "</Sequence>\r\n";
+         }
+         request += "  </Request>\r\n</InitialSync>\r\n";
+         int rc = ::send(mSock, request.data(), (int)request.size(), 0);
+         assert(rc == (int)request.size());
+      }
+
+      // Reads until the final response to the InitialSync request
+      void waitForSync()
+      {
+         while(mResultCode < 200)
+         {
+            receive();
+         }
+      }
+
+      // Reads until there are count sequenced changes
+      void waitForChanges(size_t count)
+      {
+         while(mChanges.size() < count)
+         {
+            receive();
+         }
+      }
+
+      bool mProvisional;
+      unsigned int mResultCode;
+      UInt64 mEpoch;
+      UInt64 mSequence;
+      unsigned int mSnapshotRecords;
+      unsigned int mXmlEvents;
+      unsigned int mBatches;
+      vector<UInt64> mChanges;  // the sequence numbers of the changes sent
+      vector<Uri> mChangedAors;
+
+   private:
+      void receive()
+      {
+         char buf[8192];
+         int rc = ::recv(mSock, buf, sizeof(buf), 0);
+         assert(rc > 0);
+         mBuffer.append(buf, rc);
+         while(parse());
+      }
+
+      bool parse()
+      {
+         size_t start = mBuffer.find_first_not_of("\r\n ");
+         if(start == string::npos)
+         {
+            return false;
+         }
+         if(mBuffer[start] == RegSyncProtocol::Magic0)
+         {
+            unsigned int size = RegSyncProtocol::frameSize(mBuffer.data() + start, (unsigned int)(mBuffer.size() - start));
+            if(size == 0)
+            {
+               return false;
+            }
+            handleFrame(mBuffer.data() + start, size);
+            mBuffer.erase(0, start + size);
+            return true;
+         }
+         size_t end = mBuffer.find("</InitialSync>", start);
+         size_t event = mBuffer.find("</reginfo>", start);
+         if(event != string::npos && (end == string::npos || event < end))
+         {
+            mXmlEvents++;
+            mBuffer.erase(0, event + 10);
+            return true;
+         }
+         if(end == string::npos)
+         {
+            return false;
+         }
+         // the request is echoed before the response
+         string response = mBuffer.substr(start, end - start);
+         response.erase(0, response.find("<Response>"));
+         mBuffer.erase(0, end + 14);
+         unsigned int code = (unsigned int)Data(value(response, "Code=\"", "\"")).convertUnsignedLong();
+         if(code < 200)
+         {
+            mProvisional = true;
+         }
+         else
+         {
+            mResultCode = code;
+         }
+         mEpoch = Data(value(response, "<Epoch>", "<")).convertUInt64();
+         mSequence = Data(value(response, "<Sequence>", "<")).convertUInt64();
+         return true;
+      }
+
+      static string value(const string& response, const char* prefix, const char* suffix)
+      {
+         size_t pos = response.find(prefix);
+         if(pos == string::npos)
+         {
+            return "";
+         }
+         pos += strlen(prefix);
+         return response.substr(pos, response.find(suffix, pos) - pos);
+      }
+
+      void handleFrame(const char* frame, unsigned int size)
+      {
+         if(RegSyncProtocol::frameType(frame) == RegSyncProtocol::Batch)
+         {
+            mBatches++;
+            const char* end = frame + size;
+            for(const char* next = frame + RegSyncProtocol::HeaderSize; next < end; )
+            {
+               unsigned int innerSize = RegSyncProtocol::frameSize(next, (unsigned int)(end - next));
+               assert(innerSize > 0);
+               handleFrame(next, innerSize);
+               next += innerSize;
+            }
+            return;
+         }
+         assert(RegSyncProtocol::frameType(frame) == RegSyncProtocol::RegInfo);
+         UInt64 sequence = 0;
+         Uri aor;
+         ContactList contacts;
+         RegSyncProtocol::decodeRegInfo(frame, size, Timer::getTimeSecs(), sequence, aor, contacts);
+         if(sequence == 0)
+         {
+            mSnapshotRecords++;
+         }
+         else
+         {
+            mChanges.push_back(sequence);
+            mChangedAors.push_back(aor);
+         }
+      }
+
+      Socket mSock;
+      string mBuffer;
+};
+
+static int
+testPort()
+{
+   return 23000 + (int)(Timer::getTimeMs() % 2000);
+}
+
+static void
+testServer()
+{
+   const int numAors = 2000;
+   const unsigned int changeLogSize = 50;
+   int port = testPort();
+   InMemorySyncRegDb db(86400);
+   RegSyncServer server(&db, port, V4, 0, changeLogSize);
+   assert(server.isSane());
+   std::list<RegSyncServer*> servers(1, &server);
+   RegSyncServerThread thread(servers);
+   thread.run();
+
+   UInt64 now = Timer::getTimeSecs();
+   for(int i = 0; i < numAors; i++)
+   {
+      db.updateContact(aorFor(i), makeContact("sip:ua@192.0.2.1", now + 3600));
+   }
+
+   // A new peer gets everything, in more than one batch
+   UInt64 epoch = 0;
+   {
+      Peer peer(port);
+      peer.sendInitialSync(REGSYNC_VERSION);
+      peer.waitForSync();
+      assert(peer.mProvisional);
+      assert(peer.mResultCode == 200);
+      assert(peer.mSnapshotRecords == (unsigned int)numAors);
+      assert(peer.mBatches > 1);
+      assert(peer.mChanges.empty());
+      assert(peer.mEpoch != 0);
+      assert(peer.mSequence == (UInt64)numAors);
+      epoch = peer.mEpoch;
+
+      // ... and then the changes as they happen
+      db.updateContact(aorFor(5), makeContact("sip:ua@192.0.2.1", now + 7200));
+      peer.waitForChanges(1);
+      assert(peer.mChanges[0] == (UInt64)numAors + 1);
+      assert(peer.mChangedAors[0] == aorFor(5));
+   }
+
+   // A peer that reconnects only gets what it missed
+   for(int i = 0; i < 5; i++)
+   {
+      db.updateContact(aorFor(i), makeContact("sip:ua@192.0.2.2", now + 3600));
+   }
+   UInt64 sequence = 0;
+   {
+      Peer peer(port);
+      peer.sendInitialSync(REGSYNC_VERSION, epoch, numAors + 1);
+      peer.waitForSync();
+      assert(!peer.mProvisional);
+      assert(peer.mResultCode == 200);
+      assert(peer.mSnapshotRecords == 0);
+      assert(peer.mChanges.size() == 5);
+      for(int i = 0; i < 5; i++)
+      {
+         assert(peer.mChanges[i] == (UInt64)numAors + 2 + i);
+         assert(peer.mChangedAors[i] == aorFor(i));
+      }
+      assert(peer.mEpoch == epoch);
+      assert(peer.mSequence == (UInt64)numAors + 6);
+      sequence = peer.mSequence;
+   }
+
+   // ... unless the change log no longer has all of it
+   for(unsigned int i = 0; i < changeLogSize + 10; i++)
+   {
+      db.updateContact(aorFor(i), makeContact("sip:ua@192.0.2.3", now + 3600));
+   }
+   {
+      Peer peer(port);
+      peer.sendInitialSync(REGSYNC_VERSION, epoch, sequence);
+      peer.waitForSync();
+      assert(peer.mProvisional);
+      assert(peer.mSnapshotRecords == (unsigned int)numAors);
+      assert(peer.mSequence == sequence + changeLogSize + 10);
+   }
+
+   // ... or it was talking to some other instance
+   {
+      Peer peer(port);
+      peer.sendInitialSync(REGSYNC_VERSION, epoch + 1, sequence + changeLogSize + 10);
+      peer.waitForSync();
+      assert(peer.mProvisional);
+      assert(peer.mSnapshotRecords == (unsigned int)numAors);
+   }
+
+   // Older peers still get XML
+   {
+      Peer peer(port);
+      peer.sendInitialSync(REGSYNC_XML_VERSION);
+      peer.waitForSync();
+      assert(peer.mResultCode == 200);
+      assert(peer.mXmlEvents == (unsigned int)numAors);
+      assert(peer.mSnapshotRecords == 0);
+   }
+   {
+      Peer peer(port);
+      peer.sendInitialSync(3);
+      peer.waitForSync();
+      assert(peer.mResultCode == 505);
+   }
+
+   thread.shutdown();
+   thread.join();
+}
+
+static void
+testResume()
+{
+   const int numAors = 100;
+   const int numChanges = 3000;
+   int port = testPort() + 1000;
+   InMemorySyncRegDb db(86400);
+   RegSyncServer server(&db, port, V4, 0, 2 * numChanges);
+   assert(server.isSane());
+   std::list<RegSyncServer*> servers(1, &server);
+   RegSyncServerThread thread(servers);
+   thread.run();
+
+   UInt64 now = Timer::getTimeSecs();
+   UInt64 epoch = 0;
+   UInt64 sequence = 0;
+   {
+      Peer peer(port);
+      peer.sendInitialSync(REGSYNC_VERSION);
+      peer.waitForSync();
+      epoch = peer.mEpoch;
+      sequence = peer.mSequence;
+   }
+
+   for(int i = 0; i < numChanges; i++)
+   {
+      db.updateContact(aorFor(i % numAors), makeContact("sip:ua@192.0.2.1", now + 3600 + i));
+   }
+
+   // What a peer missed is sent a batch at a time, and changes made while 
+   // it catches up come after it, in order
+   {
+      Peer peer(port);
+      peer.sendInitialSync(REGSYNC_VERSION, epoch, sequence);
+      for(int i = 0; i < 100; i++)
+      {
+         db.updateContact(aorFor(i % numAors), makeContact("sip:ua@192.0.2.2", now + 3600 + i));
+      }
+      peer.waitForSync();
+      assert(!peer.mProvisional);
+      assert(peer.mResultCode == 200);
+      assert(peer.mSnapshotRecords == 0);
+      assert(peer.mBatches > 1);
+      peer.waitForChanges(numChanges + 100);
+      for(size_t i = 0; i < peer.mChanges.size(); i++)
+      {
+         assert(peer.mChanges[i] == sequence + 1 + i);
+      }
+      assert(peer.mSequence >= sequence + numChanges);
+   }
+
+   thread.shutdown();
+   thread.join();
+}
+
+static bool
+waitFor(InMemorySyncRegDb& db, const Uri& aor, UInt64 expires)
+{
+   for(int i = 0; i < 100; i++)
+   {
+      ContactList contacts;
+      db.getContacts(aor, contacts);
+      if(contacts.size() == 1 && contacts.front().mRegExpires == expires)
+      {
+         assert(contacts.front().mSyncContact);
+         return true;
+      }
+      sleepMs(100);
+   }
+   return false;
+}
+
+static void
+testClient()
+{
+   const int numAors = 1000;
+   int port = testPort() + 2000;
+   InMemorySyncRegDb serverDb(86400);
+   InMemorySyncRegDb clientDb(86400);
+   RegSyncServer server(&serverDb, port, V4);
+   assert(server.isSane());
+   std::list<RegSyncServer*> servers(1, &server);
+   RegSyncServerThread thread(servers);
+   thread.run();
+
+   UInt64 now = Timer::getTimeSecs();
+   for(int i = 0; i < numAors; i++)
+   {
+      serverDb.updateContact(aorFor(i), makeContact("sip:ua@192.0.2.1", now + 3600));
+   }
+
+   RegSyncClient client(&clientDb, "127.0.0.1", (unsigned short)port);
+   client.run();
+   assert(waitFor(clientDb, aorFor(numAors - 1), now + 3600));
+   for(int i = 0; i < numAors; i++)
+   {
+      assert(waitFor(clientDb, aorFor(i), now + 3600));
+   }
+
+   // the client only takes a contact updated later than the one it has, 
+   // to the second
+   sleepMs(1100);
+   serverDb.updateContact(aorFor(7), makeContact("sip:ua@192.0.2.1", now + 7200));
+   assert(waitFor(clientDb, aorFor(7), now + 7200));
+
+   client.shutdown();
+   client.join();
+   thread.shutdown();
+   thread.join();
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cerr, Log::Err, argv[0]);
+   initNetwork();
+
+   testRegInfoCodec();
+   testPubInfoCodec();
+   testServer();
+   testResume();
+   testClient();
+
+   cout << "testRegSync succeeded" << endl;
+   return 0;
+}
@@ -0,0 +1,310 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <iostream>
+#include <map>
+#include <vector>
+#include "assert.h"
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/Uri.hxx"
+#include "repro/AbstractDb.hxx"
+#include "repro/RouteStore.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// Keeps the tables in memory, so RouteStore can be exercised without a
+// database.
+class MemoryDb : public AbstractDb
+{
+   public:
+      virtual bool isSane() { return true; }
+
+   protected:
+      typedef map<Data, Data> Records;
+
+      virtual bool dbWriteRecord(const Table table, const Data& key, const Data& data)
+      {
+         mTables[table][key] = data;
+         return true;
+      }
+      virtual bool dbReadRecord(const Table table, const Data& key, Data& data) const
+      {
+         Records::const_iterator it = mTables[table].find(key);
+         if (it == mTables[table].end())
+         {
+            return false;
+         }
+         data = it->second;
+         return true;
+      }
+      virtual void dbEraseRecord(const Table table, const Data& key, bool isSecondaryKey=false)
+      {
+         mTables[table].erase(key);
+      }
+      virtual Data dbNextKey(const Table table, bool first=false)
+      {
+         if (first)
+         {
+            mCursor[table] = mTables[table].begin();
+         }
+         if (mCursor[table] == mTables[table].end())
+         {
+            return Data::Empty;
+         }
+         return (mCursor[table]++)->first;
+      }
+      virtual bool dbNextRecord(const Table table, const Data& key, Data& data, bool forUpdate, bool first=false)
+      {
+         return false;
+      }
+      virtual bool dbBeginTransaction(const Table table) { return true; }
+      virtual bool dbCommitTransaction(const Table table) { return true; }
+      virtual bool dbRollbackTransaction(const Table table) { return true; }
+
+   private:
+      mutable Records mTables[MaxTable];
+      Records::iterator mCursor[MaxTable];
+};
+
+static Data
+uriData(const RouteStore::UriList& list)
+{
+   Data result;
+   for (RouteStore::UriList::const_iterator it = list.begin(); it != list.end(); ++it)
+   {
+      result += " ";
+      result += Data::from(*it);
+   }
+   return result;
+}
+
+static Data
+route(RouteStore& store, const char* ruri, const char* method = "INVITE")
+{
+   return uriData(store.process(Uri(ruri), method, Data::Empty));
+}
+
+// The old RouteStore::process(): regexec() every pattern in turn.
+class LinearMatcher
+{
+   public:
+      LinearMatcher(const vector<Data>& patterns)
+      {
+         for (vector<Data>::const_iterator it = patterns.begin(); it != patterns.end(); ++it)
+         {
+            mRegs.push_back(regex_t());
+            int ret = regcomp(&mRegs.back(), it->c_str(), REG_EXTENDED);
+            assert(ret == 0);
+         }
+      }
+      ~LinearMatcher()
+      {
+         for (vector<regex_t>::iterator it = mRegs.begin(); it != mRegs.end(); ++it)
+         {
+            regfree(&(*it));
+         }
+      }
+      unsigned int count(const Uri& ruri) const
+      {
+         Data uri(Data::from(ruri));
+         unsigned int matches = 0;
+         regmatch_t pmatch[10];
+         for (vector<regex_t>::const_iterator it = mRegs.begin(); it != mRegs.end(); ++it)
+         {
+            if (regexec(&(*it), uri.c_str(), 10, pmatch, 0) == 0)
+            {
+               ++matches;
+            }
+         }
+         return matches;
+      }
+
+   private:
+      vector<regex_t> mRegs;
+};
+
+static void
+sweep(unsigned int numRoutes)
+{
+   MemoryDb db;
+   RouteStore store(db);
+   vector<Data> patterns;
+
+   // a dial plan: one route per extension, plus a few catch-alls
+   for (unsigned int i = 0; i < numRoutes; ++i)
+   {
+      Data ext(10000 + i);
+      Data pattern;
+      Data rewrite;
+      switch (i % 3)
+      {
+         case 0:
+            pattern = "^sip:" + ext + "@example\\.com$";
+            rewrite = "sip:" + ext + "@pbx.example.com";
+            break;
+         case 1:
+            pattern = "^sip:" + ext + "@(.*)$";
+            rewrite = "sip:" + ext + "@$1";
+            break;
+         default:
+            pattern = "^sip:" + ext + "[0-9]*@";
+            rewrite = "sip:" + ext + "@voicemail.example.com";
+            break;
+      }
+      store.addRoute(Data::Empty, Data::Empty, pattern, rewrite, (short)(i % 100));
+      patterns.push_back(pattern);
+   }
+   store.addRoute(Data::Empty, Data::Empty, "^sip:9(.*)@", "sip:$1@gw.example.com", 200);
+   patterns.push_back("^sip:9(.*)@");
+   store.addRoute(Data::Empty, Data::Empty, "sip:(.*)@example\\.org", "sip:$1@proxy.example.org", 201);
+   patterns.push_back("sip:(.*)@example\\.org");
+
+   const unsigned int lookups = 20000;
+   vector<Uri> uris;
+   for (unsigned int i = 0; i < 100; ++i)
+   {
+      uris.push_back(Uri("sip:" + Data(10000 + (i * 7919) % numRoutes) + "@example.com"));
+   }
+
+   UInt64 start = Timer::getTimeMicroSec();
+   unsigned int targets = 0;
+   for (unsigned int i = 0; i < lookups; ++i)
+   {
+      targets += (unsigned int)store.process(uris[i % uris.size()], "INVITE", Data::Empty).size();
+   }
+   UInt64 indexed = Timer::getTimeMicroSec() - start;
+
+   LinearMatcher linear(patterns);
+   unsigned int linearLookups = numRoutes > 2000 ? lookups / 20 : lookups;
+   unsigned int matches = 0;
+   start = Timer::getTimeMicroSec();
+   for (unsigned int i = 0; i < linearLookups; ++i)
+   {
+      matches += linear.count(uris[i % uris.size()]);
+   }
+   UInt64 scanned = Timer::getTimeMicroSec() - start;
+
+   // every URI matches exactly one extension route
+   assert(targets == lookups);
+   assert(matches == linearLookups);
+
+   cerr << numRoutes << " routes: indexed " << (double)indexed / lookups << "us/request, "
+        << "regexec every route " << (double)scanned / linearLookups << "us/request" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   {
+      MemoryDb db;
+      RouteStore store(db);
+      store.addRoute(Data::Empty, Data::Empty, "^sip:1000@example\\.com$", "sip:alice@pbx.example.com", 1);
+      store.addRoute(Data::Empty, Data::Empty, "^sip:(1...)@example\\.com$", "sip:$1@gw.example.com", 2);
+      store.addRoute("MESSAGE", Data::Empty, "^sip:1", "sip:im@example.com", 3);
+      store.addRoute(Data::Empty, Data::Empty, "^sip:12?3@", "sip:optional@example.com", 4);
+      store.addRoute(Data::Empty, Data::Empty, "^sip:\\+1(.*)@(.*)$", "sip:011$1@$2", 5);
+      store.addRoute(Data::Empty, Data::Empty, "example\\.net", "sip:net@example.com", 6);
+      store.addRoute(Data::Empty, Data::Empty, "^sip:5000@example\\.com$|^sip:6000@", "sip:either@example.com", 7);
+      store.addRoute(Data::Empty, Data::Empty, "^sip:1000@example\\.com", "sip:bob@pbx.example.com", 1);
+      store.addRoute(Data::Empty, Data::Empty, "^sip:(bad", "sip:never@example.com", 0);
+
+      // literal, then capture-group rewrite, in order; equal orders keep
+      // the order they were added in
+      assert(route(store, "sip:1000@example.com") ==
+             " sip:alice@pbx.example.com sip:bob@pbx.example.com sip:1000@gw.example.com");
+      // a literal route needs the whole URI
+      assert(route(store, "sip:1001@example.com") == " sip:1001@gw.example.com");
+      assert(route(store, "sip:1000@example.com.au") == " sip:bob@pbx.example.com");
+      // method filter
+      assert(route(store, "sip:1234@example.org", "MESSAGE") == " sip:im@example.com");
+      // a quantified character is not part of the prefix
+      assert(route(store, "sip:13@example.org") == " sip:optional@example.com");
+      assert(route(store, "sip:123@example.org") == " sip:optional@example.com");
+      // escaped metacharacter
+      assert(route(store, "sip:+15551234@example.com") == " sip:0115551234@example.com");
+      // unanchored and alternation patterns are always tried
+      assert(route(store, "sip:2000@example.net") == " sip:net@example.com");
+      assert(route(store, "sip:5000@example.com") == " sip:either@example.com");
+      assert(route(store, "sip:6000@example.com") == " sip:either@example.com");
+
+      // the index follows changes to the routes
+      store.eraseRoute(Data::Empty, Data::Empty, "^sip:1000@example\\.com$", 1);
+      assert(route(store, "sip:1000@example.com") == " sip:bob@pbx.example.com sip:1000@gw.example.com");
+      store.addRoute(Data::Empty, Data::Empty, "^sip:1000@example\\.com$", "sip:carol@pbx.example.com", 3);
+      assert(route(store, "sip:1000@example.com") == " sip:bob@pbx.example.com sip:1000@gw.example.com sip:carol@pbx.example.com");
+
+      // and is rebuilt when the routes are read back from the db
+      RouteStore reloaded(db);
+      assert(route(reloaded, "sip:1000@example.com") == " sip:bob@pbx.example.com sip:1000@gw.example.com sip:carol@pbx.example.com");
+      assert(route(reloaded, "sip:+15551234@example.com") == " sip:0115551234@example.com");
+   }
+
+   unsigned int sizes[] = { 10, 100, 1000, 5000, 20000 };
+   for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+   {
+      sweep(sizes[i]);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
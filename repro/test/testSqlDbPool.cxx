@@ -0,0 +1,287 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <iostream>
+#include <vector>
+#include "assert.h"
+
+#include "rutil/ConfigParse.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Time.hxx"
+#include "repro/SqlDb.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+class TestConfig : public ConfigParse
+{
+   public:
+      virtual void printHelpText(int argc, char **argv) {}
+};
+
+// Stands in for a database backend - its pooled connections are plain
+// objects, and connecting fails while the database is "down".
+class FakeSqlDb : public SqlDb
+{
+   public:
+      FakeSqlDb(const ConfigParse& config) :
+         SqlDb(config),
+         mDown(false),
+         mConnectAttempts(0),
+         mOpenConnections(0)
+      {
+      }
+      virtual ~FakeSqlDb()
+      {
+         releaseAll();
+         closePooledConnections();
+         assert(mOpenConnections == 0);
+      }
+
+      virtual int singleResultQuery(const Data& queryCommand, vector<Data>& fields) const { return 0; }
+
+      // Takes a connection from the pool and holds it until release() - returns
+      // the connection, or 0 if the caller would use the shared connection
+      const void* hold()
+      {
+         PooledConnectionGuard* guard = new PooledConnectionGuard(*this);
+         Lock lock(mGuardsMutex);
+         mGuards.push_back(guard);
+         return guard->get();
+      }
+      void release(bool broken = false)
+      {
+         PooledConnectionGuard* guard;
+         {
+            Lock lock(mGuardsMutex);
+            assert(!mGuards.empty());
+            guard = mGuards.front();
+            mGuards.erase(mGuards.begin());
+         }
+         if(broken)
+         {
+            guard->setBroken();
+         }
+         delete guard;
+      }
+      void releaseAll()
+      {
+         while(held() > 0)
+         {
+            release();
+         }
+      }
+      size_t held() const
+      {
+         Lock lock(mGuardsMutex);
+         return mGuards.size();
+      }
+
+      volatile bool mDown;
+      volatile unsigned int mConnectAttempts;
+      volatile unsigned int mOpenConnections;
+
+   protected:
+      class FakeConnection : public PooledConnection
+      {
+         public:
+            FakeConnection(FakeSqlDb& db) : mDb(db) { mDb.mOpenConnections++; }
+            virtual ~FakeConnection() { mDb.mOpenConnections--; }
+         private:
+            FakeSqlDb& mDb;
+      };
+
+      virtual PooledConnection* createPooledConnection() const
+      {
+         FakeSqlDb* self = const_cast<FakeSqlDb*>(this);
+         self->mConnectAttempts++;
+         if(mDown)
+         {
+            return 0;
+         }
+         return new FakeConnection(*self);
+      }
+
+   private:
+      virtual bool dbWriteRecord(const Table table, const Data& key, const Data& data) { return false; }
+      virtual bool dbReadRecord(const Table table, const Data& key, Data& data) const { return false; }
+      virtual Data dbNextKey(const Table table, bool first=false) { return Data::Empty; }
+      virtual bool dbNextRecord(const Table table, const Data& key, Data& data, bool forUpdate, bool first=false) { return false; }
+      virtual bool dbBeginTransaction(const Table table) { return false; }
+      virtual int query(const Data& queryCommand) const { return 0; }
+      virtual Data& escapeString(const Data& str, Data& escapedStr) const { return escapedStr = str; }
+      virtual void userWhereClauseToDataStream(const Key& key, DataStream& ds) const {}
+      virtual void tlsPeerIdentityWhereClauseToDataStream(const Key& key, DataStream& ds) const {}
+
+      mutable Mutex mGuardsMutex;
+      vector<PooledConnectionGuard*> mGuards;
+};
+
+// Waits for a connection from the pool on a thread of its own
+class HoldThread : public ThreadIf
+{
+   public:
+      HoldThread(FakeSqlDb& db) : mDb(db), mConnection(0), mDone(false) {}
+      virtual void thread()
+      {
+         mConnection = mDb.hold();
+         mDone = true;
+      }
+
+      FakeSqlDb& mDb;
+      const void* volatile mConnection;
+      volatile bool mDone;
+};
+
+static void
+testPoolDisabled()
+{
+   TestConfig config;
+   FakeSqlDb db(config);
+   assert(db.hold() == 0);
+   assert(db.mConnectAttempts == 0);
+}
+
+static void
+testReuse()
+{
+   TestConfig config;
+   config.insertConfigValue("ConnectionPoolSize", "2");
+   FakeSqlDb db(config);
+
+   const void* first = db.hold();
+   assert(first != 0);
+   db.release();
+   // An idle connection is handed out again rather than opening another
+   assert(db.hold() == first);
+   assert(db.mConnectAttempts == 1);
+
+   const void* second = db.hold();
+   assert(second != 0 && second != first);
+   assert(db.mOpenConnections == 2);
+
+   // A broken connection is closed, and replaced by the next acquire
+   db.release(true);
+   assert(db.mOpenConnections == 1);
+   db.releaseAll();
+   assert(db.hold() != 0);
+   assert(db.hold() != 0);
+   assert(db.mOpenConnections == 2);
+   assert(db.mConnectAttempts == 3);
+}
+
+static void
+testWaitForIdle()
+{
+   TestConfig config;
+   config.insertConfigValue("ConnectionPoolSize", "1");
+   FakeSqlDb db(config);
+
+   const void* connection = db.hold();
+   assert(connection != 0);
+
+   // With every connection in use, acquire waits for one to come back
+   HoldThread waiter(db);
+   waiter.run();
+   sleepMs(100);
+   assert(!waiter.mDone);
+
+   db.release();
+   waiter.join();
+   assert(waiter.mDone);
+   assert(waiter.mConnection == connection);
+   assert(db.mConnectAttempts == 1);
+}
+
+static void
+testReconnectBackoff()
+{
+   TestConfig config;
+   config.insertConfigValue("ConnectionPoolSize", "2");
+   FakeSqlDb db(config);
+
+   db.mDown = true;
+   assert(db.hold() == 0);
+   assert(db.mConnectAttempts == 1);
+
+   // Lookups fall back to the shared connection without trying to connect again ...
+   for(int i = 0; i < 100; i++)
+   {
+      assert(db.hold() == 0);
+   }
+   assert(db.mConnectAttempts == 1);
+
+   // ... until the retry is due, after which the delay doubles
+   sleepMs(1100);
+   assert(db.hold() == 0);
+   assert(db.mConnectAttempts == 2);
+   sleepMs(1100);
+   assert(db.hold() == 0);
+   assert(db.mConnectAttempts == 2);
+
+   // A successful connect clears the backoff
+   db.mDown = false;
+   sleepMs(1200);
+   assert(db.hold() != 0);
+   assert(db.mConnectAttempts == 3);
+   assert(db.hold() != 0);
+   assert(db.mConnectAttempts == 4);
+   db.releaseAll();
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Info, argv[0]);
+
+   testPoolDisabled();
+   testReuse();
+   testWaitForIdle();
+   testReconnectBackoff();
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ *
+ * Copyright (c) 2015 Daniel Pocock.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. Neither the name of the author(s) nor the names of any contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR(S) OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * ====================================================================
+ */
@@ -0,0 +1,273 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <iostream>
+#include <map>
+#include "assert.h"
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/MD5Stream.hxx"
+#include "rutil/Time.hxx"
+#include "repro/AbstractDb.hxx"
+#include "repro/UserStore.hxx"
+
+using namespace resip;
+using namespace repro;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// Keeps the tables in memory, and counts password hash lookups so the tests
+// can tell whether UserStore answered from its cache.
+class MemoryDb : public AbstractDb
+{
+   public:
+      MemoryDb() : mAuthReads(0), mDuringRead(0) {}
+
+      virtual bool isSane() { return true; }
+
+      virtual Data getUserAuthInfo(const Key& key) const
+      {
+         mAuthReads++;
+         Data a1 = AbstractDb::getUserAuthInfo(key);
+         if (mDuringRead)
+         {
+            // stands in for another thread changing the user while this
+            // lookup is waiting on the database
+            UserStore* store = mDuringRead;
+            mDuringRead = 0;
+            store->addUser("alice", "example.com", "example.com", "newpassword", true, "Alice", "alice@example.com");
+         }
+         return a1;
+      }
+
+      mutable unsigned int mAuthReads;
+      mutable UserStore* mDuringRead;
+
+   protected:
+      typedef map<Data, Data> Records;
+
+      virtual bool dbWriteRecord(const Table table, const Data& key, const Data& data)
+      {
+         mTables[table][key] = data;
+         return true;
+      }
+      virtual bool dbReadRecord(const Table table, const Data& key, Data& data) const
+      {
+         Records::const_iterator it = mTables[table].find(key);
+         if (it == mTables[table].end())
+         {
+            return false;
+         }
+         data = it->second;
+         return true;
+      }
+      virtual void dbEraseRecord(const Table table, const Data& key, bool isSecondaryKey=false)
+      {
+         mTables[table].erase(key);
+      }
+      virtual Data dbNextKey(const Table table, bool first=false)
+      {
+         if (first)
+         {
+            mCursor[table] = mTables[table].begin();
+         }
+         if (mCursor[table] == mTables[table].end())
+         {
+            return Data::Empty;
+         }
+         return (mCursor[table]++)->first;
+      }
+      virtual bool dbNextRecord(const Table table, const Data& key, Data& data, bool forUpdate, bool first=false)
+      {
+         return false;
+      }
+      virtual bool dbBeginTransaction(const Table table) { return true; }
+      virtual bool dbCommitTransaction(const Table table) { return true; }
+      virtual bool dbRollbackTransaction(const Table table) { return true; }
+
+   private:
+      mutable Records mTables[MaxTable];
+      Records::iterator mCursor[MaxTable];
+};
+
+static Data
+a1(const Data& user, const Data& realm, const Data& password)
+{
+   MD5Stream a1;
+   a1 << user << ":" << realm << ":" << password;
+   return a1.getHex();
+}
+
+static void
+addAlice(UserStore& store, const char* password = "secret")
+{
+   assert(store.addUser("alice", "example.com", "example.com", password, true, "Alice", "alice@example.com"));
+}
+
+static bool
+cached(UserStore& store, const Data& user = "alice")
+{
+   Data a1;
+   return store.getCachedUserAuthInfo(user, "example.com", a1);
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   const Data secretA1 = a1("alice", "example.com", "secret");
+   const Data newA1 = a1("alice", "example.com", "newpassword");
+
+   {
+      // The cache is off unless a TTL is set
+      MemoryDb db;
+      UserStore store(db);
+      addAlice(store);
+      assert(store.getUserAuthInfo("alice", "example.com") == secretA1);
+      assert(!cached(store));
+      assert(store.getUserAuthInfo("alice", "example.com") == secretA1);
+      assert(db.mAuthReads == 2);
+   }
+
+   {
+      MemoryDb db;
+      UserStore store(db);
+      store.setAuthCacheTTL(60);
+      addAlice(store);
+
+      // Only lookups that went to the database fill the cache, and unknown
+      // users are not cached
+      assert(!cached(store));
+      assert(store.getUserAuthInfo("alice", "example.com") == secretA1);
+      Data a1;
+      assert(store.getCachedUserAuthInfo("alice", "example.com", a1));
+      assert(a1 == secretA1);
+      assert(store.getUserAuthInfo("bob", "example.com").empty());
+      assert(!cached(store, "bob"));
+
+      // Changing the user through the store drops the entry
+      addAlice(store, "newpassword");
+      assert(!cached(store));
+      assert(store.getUserAuthInfo("alice", "example.com") == newA1);
+      assert(cached(store));
+
+      // as does erasing it
+      store.eraseUser(UserStore::buildKey("alice", "example.com"));
+      assert(!cached(store));
+      assert(store.getUserAuthInfo("alice", "example.com").empty());
+      assert(!cached(store));
+
+      // Turning the cache off empties it
+      addAlice(store);
+      assert(store.getUserAuthInfo("alice", "example.com") == secretA1);
+      assert(cached(store));
+      store.setAuthCacheTTL(0);
+      assert(!cached(store));
+   }
+
+   {
+      // A lookup that read the old hash before an update landed must not
+      // put it back in the cache after the update cleared it
+      MemoryDb db;
+      UserStore store(db);
+      store.setAuthCacheTTL(60);
+      addAlice(store);
+
+      db.mDuringRead = &store;
+      assert(store.getUserAuthInfo("alice", "example.com") == secretA1);
+      assert(!cached(store));
+      assert(store.getUserAuthInfo("alice", "example.com") == newA1);
+      Data a1;
+      assert(store.getCachedUserAuthInfo("alice", "example.com", a1));
+      assert(a1 == newA1);
+   }
+
+   {
+      // Entries expire after the TTL
+      MemoryDb db;
+      UserStore store(db);
+      store.setAuthCacheTTL(1);
+      addAlice(store);
+      assert(store.getUserAuthInfo("alice", "example.com") == secretA1);
+      assert(cached(store));
+      sleepMs(2100);
+      assert(!cached(store));
+   }
+
+   {
+      // The cache holds on to no more than about maxEntries users
+      MemoryDb db;
+      UserStore store(db);
+      store.setAuthCacheTTL(60, 32);
+      for (int i = 0; i < 500; ++i)
+      {
+         Data user("user" + Data(i));
+         assert(store.addUser(user, "example.com", "example.com", "secret", true, Data::Empty, Data::Empty));
+         assert(store.getUserAuthInfo(user, "example.com") == a1(user, "example.com", "secret"));
+      }
+      int hits = 0;
+      for (int i = 0; i < 500; ++i)
+      {
+         hits += cached(store, "user" + Data(i)) ? 1 : 0;
+      }
+      assert(hits > 0);
+      assert(hits <= 32 + 16);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
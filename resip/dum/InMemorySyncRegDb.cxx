@@ -1,4 +1,8 @@
+#include <vector>
+
 #include "resip/dum/InMemorySyncRegDb.hxx"
+#include "rutil/DnsUtil.hxx"
+#include "rutil/ThreadIf.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/WinLeakCheck.hxx"
@@ -53,19 +57,86 @@ contactsRemoveIfRequired(ContactList& contacts, UInt64& now,
 #endif
 }
 
-InMemorySyncRegDb::InMemorySyncRegDb(unsigned int removeLingerSecs) : 
-   mRemoveLingerSecs(removeLingerSecs)
+// When the first of contacts is due to be removed by RemoveIfRequired, or
+// 0 if the list is empty.
+static UInt64
+nextRemovalTime(const ContactList& contacts, unsigned int removeLingerSecs)
+{
+   UInt64 next = 0;
+   for(ContactList::const_iterator it = contacts.begin(); it != contacts.end(); it++)
+   {
+      UInt64 when = resipMax(it->mRegExpires, it->mLastUpdated + removeLingerSecs + 1);
+      if(next == 0 || when < next)
+      {
+         next = when;
+      }
+   }
+   return next;
+}
+
+class InMemorySyncRegDb::ExpiryThread : public ThreadIf
+{
+   public:
+      explicit ExpiryThread(InMemorySyncRegDb& regDb) : mRegDb(regDb) {}
+      virtual ~ExpiryThread() {}
+
+      virtual void thread()
+      {
+         while(!waitForShutdown(1000))
+         {
+            mRegDb.removeLingeringContacts();
+         }
+      }
+
+   private:
+      InMemorySyncRegDb& mRegDb;
+};
+
+class InMemorySyncRegDb::SweepHandler
+{
+   public:
+      SweepHandler(InMemorySyncRegDb& regDb, Shard& shard, UInt64 now) :
+         mRegDb(regDb),
+         mShard(shard),
+         mNow(now) {}
+
+      void operator()(const Data& key)
+      {
+         mRegDb.sweep(mShard, key, mNow);
+      }
+
+   private:
+      InMemorySyncRegDb& mRegDb;
+      Shard& mShard;
+      UInt64 mNow;
+};
+
+InMemorySyncRegDb::Shard::Shard() :
+   mSweeps(Timer::getTimeSecs())
+{
+}
+
+InMemorySyncRegDb::InMemorySyncRegDb(unsigned int removeLingerSecs, bool backgroundExpiry) : 
+   mRemoveLingerSecs(removeLingerSecs),
+   mExpiryThread(0)
 {
+   // Without a linger time removed contacts are deleted right away, and
+   // there is nothing to sweep.
+   if(mRemoveLingerSecs > 0 && backgroundExpiry)
+   {
+      mExpiryThread = new ExpiryThread(*this);
+      mExpiryThread->run();
+   }
 }
 
 InMemorySyncRegDb::~InMemorySyncRegDb()
 {
-   for( database_map_t::const_iterator it = mDatabase.begin();
-        it != mDatabase.end(); it++)
+   if(mExpiryThread)
    {
-      delete it->second;
+      mExpiryThread->shutdown();
+      mExpiryThread->join();
+      delete mExpiryThread;
    }
-   mDatabase.clear();
 }
 
 void 
@@ -117,94 +188,255 @@ InMemorySyncRegDb::invokeOnInitialSyncAor(unsigned int connectionId, const resip
    }
 }
 
+Data
+InMemorySyncRegDb::aorKey(const Uri& aor)
+{
+   // The fields Uri::operator< compares, with the host canonicalized the
+   // same way, so two AORs share a record exactly when neither is less 
+   // than the other.
+   Data host;
+   if(DnsUtil::isIpV6Address(aor.host()))
+   {
+      host = DnsUtil::canonicalizeIpV6Address(aor.host());
+   }
+   else
+   {
+      host = aor.host();
+      host.lowercase();
+   }
+   Data key(aor.user().size() + aor.userParameters().size() + host.size() + 8, Data::Preallocate);
+   key += aor.user();
+   key += ';';
+   key += aor.userParameters();
+   key += '@';
+   key += host;
+   key += ':';
+   key += Data(aor.port());
+   return key;
+}
+
+InMemorySyncRegDb::Shard&
+InMemorySyncRegDb::shardFor(const Data& key)
+{
+   return mShards[key.hash() % NumShards];
+}
+
+InMemorySyncRegDb::AorRecord&
+InMemorySyncRegDb::findOrCreate(Shard& shard, const Data& key, const Uri& aor)
+{
+   std::pair<RecordMap::iterator, bool> inserted = shard.mRecords.insert(RecordMap::value_type(key, AorRecord()));
+   if(inserted.second)
+   {
+      inserted.first->second.mAor = aor;
+   }
+   return inserted.first->second;
+}
+
+InMemorySyncRegDb::ContactListPtr
+InMemorySyncRegDb::getSnapshot(const Uri& aor)
+{
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   RecordMap::const_iterator i = shard.mRecords.find(key);
+   if(i == shard.mRecords.end())
+   {
+      return ContactListPtr();
+   }
+   return i->second.mContacts;
+}
+
+void
+InMemorySyncRegDb::setContacts(Shard& shard, const Data& key, AorRecord& record, const ContactListPtr& contacts)
+{
+   record.mContacts = contacts;
+   if(mRemoveLingerSecs > 0)
+   {
+      scheduleSweep(shard, key, record);
+   }
+}
+
+void
+InMemorySyncRegDb::scheduleSweep(Shard& shard, const Data& key, AorRecord& record)
+{
+   UInt64 when = record.mContacts ? nextRemovalTime(*record.mContacts, mRemoveLingerSecs) : 0;
+   if(when == record.mSweepTime)
+   {
+      return;
+   }
+   if(record.mSweepHandle)
+   {
+      shard.mSweeps.cancel(record.mSweepHandle);
+      record.mSweepHandle = 0;
+   }
+   record.mSweepTime = when;
+   if(when)
+   {
+      record.mSweepHandle = shard.mSweeps.add(when, key);
+   }
+}
+
+void
+InMemorySyncRegDb::sweep(Shard& shard, const Data& key, UInt64 now)
+{
+   RecordMap::iterator i = shard.mRecords.find(key);
+   if(i == shard.mRecords.end())
+   {
+      return;
+   }
+   AorRecord& record = i->second;
+   record.mSweepTime = 0;
+   record.mSweepHandle = 0;
+   if(!record.mContacts)
+   {
+      return;
+   }
+
+   ContactList* contacts = new ContactList(*record.mContacts);
+   ContactListPtr snapshot(contacts);
+   contactsRemoveIfRequired(*contacts, now, mRemoveLingerSecs);
+   if(contacts->empty())
+   {
+      record.mContacts.reset();
+      if(!record.mLocked)
+      {
+         shard.mRecords.erase(i);
+      }
+      // else unlockRecord() removes it
+   }
+   else
+   {
+      setContacts(shard, key, record, snapshot);
+   }
+}
+
+void
+InMemorySyncRegDb::removeLingeringContacts()
+{
+   UInt64 now = Timer::getTimeSecs();
+   for(unsigned int i = 0; i < NumShards; i++)
+   {
+      Shard& shard = mShards[i];
+      Lock g(shard.mMutex);
+      SweepHandler handler(*this, shard, now);
+      shard.mSweeps.expire(now, handler);
+   }
+}
+
 void 
 InMemorySyncRegDb::initialSync(unsigned int connectionId)
 {
-   Lock g(mDatabaseMutex);
+   for(unsigned int part = 0; initialSync(connectionId, part); part++)
+   {
+   }
+}
+
+bool
+InMemorySyncRegDb::initialSync(unsigned int connectionId, unsigned int part)
+{
+   if(part >= NumShards)
+   {
+      return false;
+   }
+
    UInt64 now = Timer::getTimeSecs();
-   for(database_map_t::iterator it = mDatabase.begin(); it != mDatabase.end(); it++)
+   std::vector<std::pair<Uri, ContactListPtr> > aors;
    {
-      if(it->second)
+      // Only hold the shard while taking its snapshots; the handlers can
+      // take their time sending them.
+      Lock g(mShards[part].mMutex);
+      aors.reserve(mShards[part].mRecords.size());
+      for(RecordMap::const_iterator it = mShards[part].mRecords.begin(); it != mShards[part].mRecords.end(); it++)
       {
-         ContactList& contacts = *(it->second);
-         if(mRemoveLingerSecs > 0) 
+         if(it->second.mContacts)
          {
-            contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
+            aors.push_back(std::make_pair(it->second.mAor, it->second.mContacts));
          }
+      }
+   }
+   for(std::vector<std::pair<Uri, ContactListPtr> >::const_iterator it = aors.begin(); it != aors.end(); it++)
+   {
+      if(mRemoveLingerSecs > 0) 
+      {
+         ContactList contacts(*it->second);
+         contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
          invokeOnInitialSyncAor(connectionId, it->first, contacts);
       }
+      else
+      {
+         invokeOnInitialSyncAor(connectionId, it->first, *it->second);
+      }
    }
+   return true;
 }
 
 void 
 InMemorySyncRegDb::addAor(const Uri& aor,
                           const ContactList& contacts)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator it = mDatabase.find(aor);
-   if(it != mDatabase.end())
-   {
-       if(it->second)
-       {
-           *(it->second) = contacts;
-       }
-       else
-       {
-           it->second = new ContactList(contacts);
-       }
-   }
-   else
+   ContactListPtr snapshot(new ContactList(contacts));
    {
-       mDatabase[aor] = new ContactList(contacts);
+      Data key(aorKey(aor));
+      Shard& shard = shardFor(key);
+      Lock g(shard.mMutex);
+      setContacts(shard, key, findOrCreate(shard, key, aor), snapshot);
    }
-   invokeOnAorModified(true /* sync? */, aor, contacts);
+   invokeOnAorModified(true /* sync? */, aor, *snapshot);
 }
 
 void 
 InMemorySyncRegDb::removeAor(const Uri& aor)
 {
-  database_map_t::iterator i;
-
-  Lock g(mDatabaseMutex);
-  i = mDatabase.find(aor);
-  //DebugLog (<< "Removing registration bindings " << aor);
-  if (i != mDatabase.end())
-  {
-     if (i->second)
-     {
-        if(mRemoveLingerSecs > 0)
-        {
-           ContactList& contacts = *(i->second);
-           UInt64 now = Timer::getTimeSecs();
-           for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
-           {
-              // Don't delete record - set expires to 0
-              it->mRegExpires = 0;
-              it->mLastUpdated = now;
-           }
-           invokeOnAorModified(true /* sync? */, aor, contacts);
-        }
-        else
-        {
-           delete i->second;
-           // Setting this to 0 causes it to be removed when we unlock the AOR.
-           i->second = 0;
-           ContactList emptyList;
-           invokeOnAorModified(true /* sync? */, aor, emptyList);
-        }
-     }
-  }
+   ContactListPtr snapshot;
+   {
+      Data key(aorKey(aor));
+      Shard& shard = shardFor(key);
+      Lock g(shard.mMutex);
+      RecordMap::iterator i = shard.mRecords.find(key);
+      //DebugLog (<< "Removing registration bindings " << aor);
+      if(i == shard.mRecords.end() || !i->second.mContacts)
+      {
+         return;
+      }
+      AorRecord& record = i->second;
+      if(mRemoveLingerSecs > 0)
+      {
+         ContactList* contacts = new ContactList(*record.mContacts);
+         snapshot = ContactListPtr(contacts);
+         UInt64 now = Timer::getTimeSecs();
+         for(ContactList::iterator it = contacts->begin(); it != contacts->end(); it++)
+         {
+            // Don't delete record - set expires to 0
+            it->mRegExpires = 0;
+            it->mLastUpdated = now;
+         }
+         setContacts(shard, key, record, snapshot);
+      }
+      else
+      {
+         snapshot = ContactListPtr(new ContactList);
+         record.mContacts.reset();
+         if(!record.mLocked)
+         {
+            shard.mRecords.erase(i);
+         }
+         // else it is removed when the AOR is unlocked
+      }
+   }
+   invokeOnAorModified(true /* sync? */, aor, *snapshot);
 }
 
 void
 InMemorySyncRegDb::getAors(InMemorySyncRegDb::UriList& container)
 {
    container.clear();
-   Lock g(mDatabaseMutex);
-   for( database_map_t::const_iterator it = mDatabase.begin();
-        it != mDatabase.end(); it++)
+   for(unsigned int i = 0; i < NumShards; i++)
    {
-      container.push_back(it->first);
+      Lock g(mShards[i].mMutex);
+      for(RecordMap::const_iterator it = mShards[i].mRecords.begin(); it != mShards[i].mRecords.end(); it++)
+      {
+         container.push_back(it->second.mAor);
+      }
    }
 }
 
@@ -217,34 +449,31 @@ InMemorySyncRegDb::aorIsRegistered(const Uri& aor)
 bool 
 InMemorySyncRegDb::aorIsRegistered(const Uri& aor, UInt64* maxExpires)
 {
-   Lock g(mDatabaseMutex);
+   ContactListPtr contacts = getSnapshot(aor);
+   if(!contacts)
+   {
+      return false;
+   }
+   if(mRemoveLingerSecs == 0 && !maxExpires)
+   {
+      return true;
+   }
+
    bool registered = false;
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i != mDatabase.end() && i->second != 0)
+   UInt64 now = Timer::getTimeSecs();
+   for(ContactList::const_iterator it = contacts->begin(); it != contacts->end(); it++)
    {
-      if (mRemoveLingerSecs > 0 || maxExpires)
+      if(it->mRegExpires > now)
       {
-         ContactList& contacts = *(i->second);
-         UInt64 now = Timer::getTimeSecs();
-         for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
+         registered = true;
+         if (maxExpires)
          {
-            if(it->mRegExpires > now)
-            {
-               registered = true;
-               if (maxExpires)
-               {
-                  *maxExpires = resipMax(*maxExpires, it->mRegExpires);
-               }
-               else
-               {
-                  break; // Not looking for maxExpires - so we can quit iterating now
-               }
-            }
+            *maxExpires = resipMax(*maxExpires, it->mRegExpires);
+         }
+         else
+         {
+            break; // Not looking for maxExpires - so we can quit iterating now
          }
-      }
-      else
-      {
-         registered = true;
       }
    }
    return registered;
@@ -253,170 +482,181 @@ InMemorySyncRegDb::aorIsRegistered(const Uri& aor, UInt64* maxExpires)
 void
 InMemorySyncRegDb::lockRecord(const Uri& aor)
 {
-   Lock g2(mLockedRecordsMutex);
-
    DebugLog(<< "InMemorySyncRegDb::lockRecord:  aor=" << aor << " threadid=" << ThreadIf::selfId());
 
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   // This forces insertion if the record does not yet exist.  The record
+   // may be removed while we wait (if the holder leaves it empty), so look
+   // it up again each time.
+   while(findOrCreate(shard, key, aor).mLocked)
    {
-      Lock g1(mDatabaseMutex);
-      // This forces insertion if the record does not yet exist.
-      mDatabase[aor];
-   }
-
-   while (mLockedRecords.count(aor))
-   {
-      mRecordUnlocked.wait(mLockedRecordsMutex);
+      shard.mRecordUnlocked.wait(shard.mMutex);
    }
-
-   mLockedRecords.insert(aor);
+   findOrCreate(shard, key, aor).mLocked = true;
 }
 
 void
 InMemorySyncRegDb::unlockRecord(const Uri& aor)
 {
-   Lock g2(mLockedRecordsMutex);
-
    DebugLog(<< "InMemorySyncRegDb::unlockRecord:  aor=" << aor << " threadid=" << ThreadIf::selfId());
 
-   {
-      Lock g1(mDatabaseMutex);
-      // If the pointer is null, we remove the record from the map.
-      database_map_t::iterator i = mDatabase.find(aor);
+   Data key(aorKey(aor));
+   Shard& shard = shardFor(key);
+   Lock g(shard.mMutex);
+   RecordMap::iterator i = shard.mRecords.find(key);
 
-      // The record must have been inserted when we locked it in the first place
-      resip_assert (i != mDatabase.end());
+   // The record must have been inserted when we locked it in the first place
+   resip_assert(i != shard.mRecords.end() && i->second.mLocked);
 
-      if (i->second == 0)
+   i->second.mLocked = false;
+   // If the record has no contacts, we remove it.
+   if(!i->second.mContacts)
+   {
+      if(i->second.mSweepHandle)
       {
-         mDatabase.erase(i);
+         shard.mSweeps.cancel(i->second.mSweepHandle);
       }
+      shard.mRecords.erase(i);
    }
-
-   mLockedRecords.erase(aor);
-   mRecordUnlocked.broadcast();
+   shard.mRecordUnlocked.broadcast();
 }
 
 RegistrationPersistenceManager::update_status_t 
 InMemorySyncRegDb::updateContact(const resip::Uri& aor, 
                                  const ContactInstanceRecord& rec) 
 {
-   ContactList *contactList = 0;
-
-   {
-      Lock g(mDatabaseMutex);
-
-      database_map_t::iterator i;
-      i = mDatabase.find(aor);
-      if (i == mDatabase.end() || i->second == 0)
-      {
-         contactList = new ContactList();
-         mDatabase[aor] = contactList;
-      }
-      else
-      {
-         contactList = i->second;
-      }
-   }
-   
-   resip_assert(contactList);
-
-   ContactList::iterator j;
-
-   // See if the contact is already present. We use URI matching rules here.
-   for (j = contactList->begin(); j != contactList->end(); j++)
+   update_status_t status = CONTACT_CREATED;
+   ContactListPtr snapshot;
    {
-      if (*j == rec)
+      Data key(aorKey(aor));
+      Shard& shard = shardFor(key);
+      Lock g(shard.mMutex);
+      AorRecord& record = findOrCreate(shard, key, aor);
+      ContactList* contacts = record.mContacts ? new ContactList(*record.mContacts) : new ContactList;
+      snapshot = ContactListPtr(contacts);
+
+      // See if the contact is already present. We use URI matching rules here.
+      ContactList::iterator j;
+      for (j = contacts->begin(); j != contacts->end(); j++)
       {
-         update_status_t status = CONTACT_UPDATED;
-         if(mRemoveLingerSecs > 0 && j->mRegExpires == 0)
+         if (*j == rec)
          {
-            // If records linger, then check if updating a lingering record, if so
-            // modify status to CREATED so that ServerRegistration will properly generate
-            // an onAdd callback, instead of onRefresh.
-            // When contacts linger, their expires time is set to 0
-            status = CONTACT_CREATED;
+            status = CONTACT_UPDATED;
+            if(mRemoveLingerSecs > 0 && j->mRegExpires == 0)
+            {
+               // If records linger, then check if updating a lingering record, if so
+               // modify status to CREATED so that ServerRegistration will properly generate
+               // an onAdd callback, instead of onRefresh.
+               // When contacts linger, their expires time is set to 0
+               status = CONTACT_CREATED;
+            }
+            *j=rec;
+            break;
          }
-         *j=rec;
-         // Only pass sync as true if this update didn't just come from an inbound sync operation
-         invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
-         return status;
       }
+      if (j == contacts->end())
+      {
+         // This is a new contact, so we add it to the list.
+         contacts->push_back(rec);
+      }
+      setContacts(shard, key, record, snapshot);
    }
 
-   // This is a new contact, so we add it to the list.
-   contactList->push_back(rec);
    // Only pass sync as true if this update didn't just come from an inbound sync operation
-   invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
-   return CONTACT_CREATED;
+   invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *snapshot);
+   return status;
 }
 
 void 
 InMemorySyncRegDb::removeContact(const Uri& aor, 
                                  const ContactInstanceRecord& rec)
 {
-   ContactList *contactList = 0;
-
+   ContactListPtr snapshot;
    {
-      Lock g(mDatabaseMutex);
-
-      database_map_t::iterator i;
-      i = mDatabase.find(aor);
-      if (i == mDatabase.end() || i->second == 0)
+      Data key(aorKey(aor));
+      Shard& shard = shardFor(key);
+      Lock g(shard.mMutex);
+      RecordMap::iterator i = shard.mRecords.find(key);
+      if (i == shard.mRecords.end() || !i->second.mContacts)
       {
          return;
       }
-      contactList = i->second;
-   }
+      AorRecord& record = i->second;
 
-   ContactList::iterator j;
+      // See if the contact is present. We use URI matching rules here.
+      ContactList::const_iterator j;
+      for (j = record.mContacts->begin(); j != record.mContacts->end(); j++)
+      {
+         if (*j == rec)
+         {
+            break;
+         }
+      }
+      if (j == record.mContacts->end())
+      {
+         return;
+      }
 
-   // See if the contact is present. We use URI matching rules here.
-   for (j = contactList->begin(); j != contactList->end(); j++)
-   {
-      if (*j == rec)
+      ContactList* contacts = new ContactList;
+      snapshot = ContactListPtr(contacts);
+      for (ContactList::const_iterator k = record.mContacts->begin(); k != record.mContacts->end(); k++)
       {
-         if(mRemoveLingerSecs > 0)
+         if (k != j)
          {
-            j->mRegExpires = 0;
-            j->mLastUpdated = Timer::getTimeSecs();
-            // Only pass sync as true if this update didn't just come from an inbound sync operation
-            invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
+            contacts->push_back(*k);
          }
-         else
+         else if(mRemoveLingerSecs > 0)
          {
-            contactList->erase(j);
-            if (contactList->empty())
-            {
-               removeAor(aor);
-            }
-            else
-            {
-               // Only pass sync as true if this update didn't just come from an inbound sync operation
-               invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *contactList);
-            }
+            contacts->push_back(*k);
+            contacts->back().mRegExpires = 0;
+            contacts->back().mLastUpdated = Timer::getTimeSecs();
          }
-         return;
       }
+
+      if (contacts->empty())
+      {
+         // the last contact is gone - remove the AOR, as removeAor() does
+         record.mContacts.reset();
+         if(!record.mLocked)
+         {
+            shard.mRecords.erase(i);
+         }
+      }
+      else
+      {
+         setContacts(shard, key, record, snapshot);
+      }
+   }
+
+   if (snapshot->empty())
+   {
+      invokeOnAorModified(true /* sync? */, aor, *snapshot);
+   }
+   else
+   {
+      // Only pass sync as true if this update didn't just come from an inbound sync operation
+      invokeOnAorModified(!rec.mSyncContact /* sync? */, aor, *snapshot);
    }
 }
 
 void
 InMemorySyncRegDb::getContacts(const Uri& aor, ContactList& container)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i == mDatabase.end() || i->second == 0)
+   ContactListPtr contacts = getSnapshot(aor);
+   if (!contacts)
    {
       container.clear();
       return;
    }
    if(mRemoveLingerSecs > 0)
    {
-      ContactList& contacts = *(i->second);
+      // lingering contacts have expired, so this leaves out any the sweep
+      // hasn't removed yet as well
       UInt64 now = Timer::getTimeSecs();
-      contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
       container.clear();
-      for(ContactList::iterator it = contacts.begin(); it != contacts.end(); it++)
+      for(ContactList::const_iterator it = contacts->begin(); it != contacts->end(); it++)
       {
          if(it->mRegExpires > now)
          {
@@ -426,27 +666,25 @@ InMemorySyncRegDb::getContacts(const Uri& aor, ContactList& container)
    }
    else
    {
-      container = *(i->second);
+      container = *contacts;
    }
 }
 
 void
 InMemorySyncRegDb::getContactsFull(const Uri& aor, ContactList& container)
 {
-   Lock g(mDatabaseMutex);
-   database_map_t::iterator i = mDatabase.find(aor);
-   if (i == mDatabase.end() || i->second == 0)
+   ContactListPtr contacts = getSnapshot(aor);
+   if (!contacts)
    {
       container.clear();
       return;
    }
-   ContactList& contacts = *(i->second);
+   container = *contacts;
    if(mRemoveLingerSecs > 0)
    {
       UInt64 now = Timer::getTimeSecs();
-      contactsRemoveIfRequired(contacts, now, mRemoveLingerSecs);
+      contactsRemoveIfRequired(container, now, mRemoveLingerSecs);
    }
-   container = contacts;
 }
 
 
@@ -1,14 +1,16 @@
 #if !defined(RESIP_INMEMORYSYNCREGDB_HXX)
 #define RESIP_INMEMORYSYNCREGDB_HXX
 
-#include <map>
-#include <set>
 #include <list>
 
 #include "resip/dum/RegistrationPersistenceManager.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/HashMap.hxx"
 #include "rutil/Mutex.hxx"
 #include "rutil/Condition.hxx"
 #include "rutil/Lock.hxx"
+#include "rutil/SharedPtr.hxx"
+#include "rutil/TimerWheel.hxx"
 
 namespace resip
 {
@@ -48,18 +50,37 @@ protected:
   transport registration bindings to a remote peer for replication.
   See the RegSyncClient and RegSyncServer implementations in the repro
   project.
+
+  AORs are spread over NumShards hash tables by their normalized form
+  (user, user parameters, canonical host and port - the fields Uri's 
+  operator< compares), each with its own lock, so a REGISTER for one AOR
+  only contends with requests that land in the same shard.  The contacts
+  of an AOR are an immutable snapshot: a change builds a new list and
+  swaps it in, and a lookup only holds the shard lock long enough to take
+  a reference to the current list, copying it after the lock is released.
+  
+  Lingering contacts are removed by removeLingeringContacts(), which a
+  background thread calls once a second (unless backgroundExpiry is false,
+  in which case the application must call it).  Each shard keeps a timer
+  wheel of when each of its AORs next has a contact to remove, so the 
+  sweep only visits those AORs.  Lookups leave out contacts that are due 
+  for removal, so they never see one the sweep hasn't got to yet.  An AOR
+  that is left with no contacts is removed from memory once unlocked.
 */
 class InMemorySyncRegDb : public RegistrationPersistenceManager
 {
    public:
 
-      InMemorySyncRegDb(unsigned int removeLingerSecs = 0);
+      InMemorySyncRegDb(unsigned int removeLingerSecs = 0, bool backgroundExpiry = true);
       virtual ~InMemorySyncRegDb();
       
       virtual void addHandler(InMemorySyncRegDbHandler* handler);
       virtual void removeHandler(InMemorySyncRegDbHandler* handler);
 
       virtual void initialSync(unsigned int connectionId);
+      /// Syncs one part (shard) of the database, so a sync can be streamed
+      /// a piece at a time; returns false once part is past the last one.
+      virtual bool initialSync(unsigned int connectionId, unsigned int part);
 
       virtual void addAor(const Uri& aor, const ContactList& contacts);
       virtual void removeAor(const Uri& aor);
@@ -79,15 +100,53 @@ class InMemorySyncRegDb : public RegistrationPersistenceManager
    
       /// return all the AOR in the DB 
       virtual void getAors(UriList& container);
+
+      /// Removes the contacts that have lingered for removeLingerSecs, and
+      /// AORs left with none.  Called by the background thread.
+      void removeLingeringContacts();
       
    protected:
-      typedef std::map<Uri,ContactList *> database_map_t;
-      database_map_t mDatabase;
-      Mutex mDatabaseMutex;
-
-      std::set<Uri> mLockedRecords;
-      Mutex mLockedRecordsMutex;
-      Condition mRecordUnlocked;
+      enum { NumShards = 64 };
+
+      typedef SharedPtr<const ContactList> ContactListPtr;
+
+      class AorRecord
+      {
+         public:
+            AorRecord() : mLocked(false), mSweepTime(0), mSweepHandle(0) {}
+
+            Uri mAor;
+            ContactListPtr mContacts;  // 0 once the AOR is removed
+            bool mLocked;
+            UInt64 mSweepTime;  // when a contact is next due for removal, 0 if none
+            TimerWheel<Data>::Handle mSweepHandle;
+      };
+      typedef HashMap<Data, AorRecord> RecordMap;
+
+      class Shard
+      {
+         public:
+            Shard();
+
+            Mutex mMutex;
+            Condition mRecordUnlocked;
+            RecordMap mRecords;
+            TimerWheel<Data> mSweeps;  // AOR keys, by mSweepTime
+      };
+      Shard mShards[NumShards];
+
+      static Data aorKey(const Uri& aor);
+      Shard& shardFor(const Data& key);
+      /// the record for aor, created if need be; call with the shard locked
+      AorRecord& findOrCreate(Shard& shard, const Data& key, const Uri& aor);
+      /// the current contacts of aor, or 0
+      ContactListPtr getSnapshot(const Uri& aor);
+      /// replaces the contacts of a record; call with the shard locked
+      void setContacts(Shard& shard, const Data& key, AorRecord& record, const ContactListPtr& contacts);
+      void scheduleSweep(Shard& shard, const Data& key, AorRecord& record);
+      void sweep(Shard& shard, const Data& key, UInt64 now);
+      class SweepHandler;
+      friend class SweepHandler;
 
       void invokeOnAorModified(bool sync, const resip::Uri& aor, const ContactList& contacts);
       void invokeOnInitialSyncAor(unsigned int connectionId, const resip::Uri& aor, const ContactList& contacts);
@@ -95,6 +154,9 @@ class InMemorySyncRegDb : public RegistrationPersistenceManager
       typedef std::list<InMemorySyncRegDbHandler*> HandlerList;
       HandlerList mHandlers;  // use list over set to preserve add order
       Mutex mHandlerMutex;
+
+      class ExpiryThread;
+      ExpiryThread* mExpiryThread;
 };
 
 }
@@ -0,0 +1,327 @@
+#include <iostream>
+#include <vector>
+#include "assert.h"
+
+#include "resip/dum/InMemorySyncRegDb.hxx"
+#include "resip/stack/NameAddr.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+class CountingHandler : public InMemorySyncRegDbHandler
+{
+   public:
+      CountingHandler(HandlerMode mode = AllChanges) : InMemorySyncRegDbHandler(mode), mModified(0), mInitialSync(0) {}
+
+      virtual void onAorModified(const Uri& aor, const ContactList& contacts)
+      {
+         mModified++;
+         mLastAor = aor;
+         mLastContacts = contacts;
+      }
+      virtual void onInitialSyncAor(unsigned int connectionId, const Uri& aor, const ContactList& contacts)
+      {
+         mInitialSync++;
+      }
+
+      int mModified;
+      int mInitialSync;
+      Uri mLastAor;
+      ContactList mLastContacts;
+};
+
+static ContactInstanceRecord
+makeContact(const char* contact, UInt64 expires)
+{
+   ContactInstanceRecord rec;
+   rec.mContact = NameAddr(contact);
+   rec.mRegExpires = expires;
+   rec.mLastUpdated = Timer::getTimeSecs();
+   return rec;
+}
+
+static size_t
+numAors(InMemorySyncRegDb& db)
+{
+   RegistrationPersistenceManager::UriList aors;
+   db.getAors(aors);
+   return aors.size();
+}
+
+static void
+testAorMatching()
+{
+   InMemorySyncRegDb db;
+   UInt64 now = Timer::getTimeSecs();
+   ContactList contacts;
+
+   db.updateContact(Uri("sip:alice@example.com"), makeContact("sip:alice@192.0.2.1:5060", now + 3600));
+   // AORs match the way Uri::operator< has them: the host is not case
+   // sensitive, and neither the scheme nor the URI parameters count
+   db.getContacts(Uri("sip:alice@EXAMPLE.com"), contacts);
+   assert(contacts.size() == 1);
+   db.getContacts(Uri("sips:alice@example.com;transport=tcp"), contacts);
+   assert(contacts.size() == 1);
+   // ... but the user and the port do
+   db.getContacts(Uri("sip:Alice@example.com"), contacts);
+   assert(contacts.empty());
+   db.getContacts(Uri("sip:alice@example.com:5062"), contacts);
+   assert(contacts.empty());
+
+   db.updateContact(Uri("sip:alice@[2001:db8:0::1]"), makeContact("sip:alice@192.0.2.2", now + 3600));
+   db.getContacts(Uri("sip:alice@[2001:DB8::1]"), contacts);
+   assert(contacts.size() == 1);
+
+   // an update replaces the matching contact, and keeps the first AOR seen
+   db.updateContact(Uri("sip:alice@EXAMPLE.COM"), makeContact("sip:alice@192.0.2.1:5060", now + 60));
+   db.getContacts(Uri("sip:alice@example.com"), contacts);
+   assert(contacts.size() == 1);
+   assert(contacts.front().mRegExpires == now + 60);
+   assert(numAors(db) == 2);
+
+   RegistrationPersistenceManager::UriList aors;
+   db.getAors(aors);
+   bool found = false;
+   for (RegistrationPersistenceManager::UriList::const_iterator it = aors.begin(); it != aors.end(); it++)
+   {
+      found = found || it->host() == "example.com";
+   }
+   assert(found);
+}
+
+static void
+testUpdateAndRemove()
+{
+   InMemorySyncRegDb db;
+   CountingHandler handler;
+   db.addHandler(&handler);
+   UInt64 now = Timer::getTimeSecs();
+   Uri aor("sip:bob@example.com");
+   ContactList contacts;
+
+   db.lockRecord(aor);
+   assert(db.updateContact(aor, makeContact("sip:bob@192.0.2.1", now + 3600)) == RegistrationPersistenceManager::CONTACT_CREATED);
+   assert(db.updateContact(aor, makeContact("sip:bob@192.0.2.2", now + 3600)) == RegistrationPersistenceManager::CONTACT_CREATED);
+   assert(db.updateContact(aor, makeContact("sip:bob@192.0.2.1", now + 7200)) == RegistrationPersistenceManager::CONTACT_UPDATED);
+   db.unlockRecord(aor);
+   assert(handler.mModified == 3);
+   assert(handler.mLastContacts.size() == 2);
+
+   UInt64 maxExpires = 0;
+   assert(db.aorIsRegistered(aor, &maxExpires));
+   assert(maxExpires == now + 7200);
+
+   // a snapshot handed out earlier doesn't change under its holder
+   db.getContacts(aor, contacts);
+   db.removeContact(aor, makeContact("sip:bob@192.0.2.1", 0));
+   assert(contacts.size() == 2);
+   db.getContacts(aor, contacts);
+   assert(contacts.size() == 1);
+   assert(handler.mLastContacts.size() == 1);
+
+   // removing the last contact removes the AOR
+   db.removeContact(aor, makeContact("sip:bob@192.0.2.2", 0));
+   assert(!db.aorIsRegistered(aor));
+   assert(handler.mLastContacts.empty());
+   assert(numAors(db) == 0);
+
+   // ... unless it is locked, in which case it goes when unlocked
+   db.addAor(aor, ContactList(1, makeContact("sip:bob@192.0.2.3", now + 3600)));
+   db.lockRecord(aor);
+   db.removeAor(aor);
+   assert(numAors(db) == 1);
+   assert(!db.aorIsRegistered(aor));
+   db.unlockRecord(aor);
+   assert(numAors(db) == 0);
+
+   db.addAor(aor, ContactList(1, makeContact("sip:bob@192.0.2.3", now + 3600)));
+   db.initialSync(1);
+   assert(handler.mInitialSync == 0);  // AllChanges handlers don't do syncs
+   db.removeHandler(&handler);
+
+   // a sync can also be done a part at a time
+   InMemorySyncRegDb syncDb;
+   CountingHandler sync(InMemorySyncRegDbHandler::SyncServer);
+   syncDb.addHandler(&sync);
+   for(int i = 0; i < 100; i++)
+   {
+      syncDb.addAor(Uri("sip:user" + Data(i) + "@example.com"), ContactList(1, makeContact("sip:ua@192.0.2.1", now + 3600)));
+   }
+   unsigned int parts = 0;
+   while(syncDb.initialSync(1, parts))
+   {
+      parts++;
+   }
+   assert(parts > 1);
+   assert(sync.mInitialSync == 100);
+   syncDb.initialSync(2);
+   assert(sync.mInitialSync == 200);
+   syncDb.removeHandler(&sync);
+}
+
+static void
+testLinger()
+{
+   const unsigned int linger = 100;
+   InMemorySyncRegDb db(linger, false /* backgroundExpiry */);
+   UInt64 now = Timer::getTimeSecs();
+   Uri aor("sip:carol@example.com");
+   ContactList contacts;
+
+   db.updateContact(aor, makeContact("sip:carol@192.0.2.1", now + 3600));
+   db.updateContact(aor, makeContact("sip:carol@192.0.2.2", now + 3600));
+   db.removeContact(aor, makeContact("sip:carol@192.0.2.1", 0));
+
+   // the removed contact lingers, for sync, but isn't registered
+   db.getContacts(aor, contacts);
+   assert(contacts.size() == 1);
+   db.getContactsFull(aor, contacts);
+   assert(contacts.size() == 2);
+
+   // a contact that has been expired for longer than the linger time is
+   // left out of lookups right away, and removed by the sweep
+   ContactInstanceRecord old = makeContact("sip:carol@192.0.2.3", now - linger - 10);
+   old.mLastUpdated = now - linger - 10;
+   db.updateContact(Uri("sip:dave@example.com"), old);
+   db.getContactsFull(Uri("sip:dave@example.com"), contacts);
+   assert(contacts.empty());
+   assert(numAors(db) == 2);
+
+   db.removeLingeringContacts();
+   assert(numAors(db) == 1);
+   db.getContactsFull(aor, contacts);
+   assert(contacts.size() == 2);
+
+   // updating a lingering contact brings it back
+   assert(db.updateContact(aor, makeContact("sip:carol@192.0.2.1", now + 3600)) == RegistrationPersistenceManager::CONTACT_CREATED);
+   db.getContacts(aor, contacts);
+   assert(contacts.size() == 2);
+
+   db.removeAor(aor);
+   assert(!db.aorIsRegistered(aor));
+   db.getContactsFull(aor, contacts);
+   assert(contacts.size() == 2);
+}
+
+// Registrars refreshing contacts while proxies look them up, as in repro
+static const int NumAors = 20000;
+
+static Uri
+aorFor(int i)
+{
+   return Uri("sip:user" + Data(i) + "@example.com");
+}
+
+class Registrar : public ThreadIf
+{
+   public:
+      Registrar(InMemorySyncRegDb& db, int first, int step) : mDb(db), mFirst(first), mStep(step), mRegistrations(0) {}
+      virtual void thread()
+      {
+         ContactList contacts;
+         for (int run = 0; run < 5; run++)
+         {
+            for (int i = mFirst; i < NumAors; i += mStep)
+            {
+               Uri aor(aorFor(i));
+               mDb.lockRecord(aor);
+               mDb.getContacts(aor, contacts);
+               mDb.updateContact(aor, makeContact("sip:ua@192.0.2.1", Timer::getTimeSecs() + 3600 + run));
+               mDb.unlockRecord(aor);
+               mRegistrations++;
+            }
+         }
+      }
+
+      InMemorySyncRegDb& mDb;
+      int mFirst;
+      int mStep;
+      int mRegistrations;
+};
+
+class Proxy : public ThreadIf
+{
+   public:
+      Proxy(InMemorySyncRegDb& db, unsigned int seed) : mDb(db), mSeed(seed), mLookups(0), mFound(0) {}
+      virtual void thread()
+      {
+         ContactList contacts;
+         while (!isShutdown())
+         {
+            mSeed = mSeed * 1103515245 + 12345;
+            mDb.getContacts(aorFor((mSeed >> 8) % NumAors), contacts);
+            assert(contacts.size() <= 1);
+            mFound += contacts.size();
+            mLookups++;
+         }
+      }
+
+      InMemorySyncRegDb& mDb;
+      unsigned int mSeed;
+      int mLookups;
+      int mFound;
+};
+
+static void
+testConcurrentAccess()
+{
+   InMemorySyncRegDb db(86400);
+   const int numRegistrars = 2;
+   const int numProxies = 4;
+   vector<Registrar*> registrars;
+   vector<Proxy*> proxies;
+   UInt64 start = Timer::getTimeMs();
+   for (int i = 0; i < numProxies; i++)
+   {
+      proxies.push_back(new Proxy(db, i));
+      proxies.back()->run();
+   }
+   for (int i = 0; i < numRegistrars; i++)
+   {
+      registrars.push_back(new Registrar(db, i, numRegistrars));
+      registrars.back()->run();
+   }
+
+   int registrations = 0;
+   for (int i = 0; i < numRegistrars; i++)
+   {
+      registrars[i]->join();
+      registrations += registrars[i]->mRegistrations;
+      delete registrars[i];
+   }
+   int lookups = 0;
+   for (int i = 0; i < numProxies; i++)
+   {
+      proxies[i]->shutdown();
+      proxies[i]->join();
+      lookups += proxies[i]->mLookups;
+      delete proxies[i];
+   }
+   UInt64 elapsed = resipMax(Timer::getTimeMs() - start, (UInt64)1);
+
+   assert(registrations == 5 * NumAors);
+   assert(numAors(db) == (size_t)NumAors);
+   ContactList contacts;
+   for (int i = 0; i < NumAors; i++)
+   {
+      db.getContacts(aorFor(i), contacts);
+      assert(contacts.size() == 1);
+   }
+   cerr << numRegistrars << " registrars, " << numProxies << " proxies: "
+        << registrations * 1000 / elapsed << " registrations/s, "
+        << lookups * 1000 / elapsed << " lookups/s" << endl;
+}
+
+int main(int argc, const char* argv[])
+{
+   testAorMatching();
+   testUpdateAndRemove();
+   testLinger();
+   testConcurrentAccess();
+
+   cout << "testInMemorySyncRegDb succeeded" << endl;
+   return 0;
+}
@@ -61,8 +61,7 @@ Auth::parse(ParseBuffer& pb)
 {
    const char* start;
    start = pb.skipWhitespace();
-   static const std::bitset<256> schemeDelimiter(Data::toBitset("\r\n\t ="));
-   pb.skipToOneOf(schemeDelimiter);
+   pb.skipToOneOf(CharClass<'\r', '\n', '\t', ' ', '='>::Table);
 
    if (!pb.eof() && *pb.position() == Symbols::EQUALS[0])
    {
@@ -118,9 +117,8 @@ Auth::parseAuthParameters(ParseBuffer& pb)
    while (!pb.eof())
    {
       const char* keyStart = pb.position();
-      static std::bitset<256> paramBegin=Data::toBitset(" \t\r\n=");
       static std::bitset<256> terminators=Data::toBitset(" \t\r\n,");
-      const char* keyEnd = pb.skipToOneOf(paramBegin);
+      const char* keyEnd = pb.skipToOneOf(CharClass<' ', '\t', '\r', '\n', '='>::Table);
       if((int)(keyEnd-keyStart) != 0)
       {
          ParameterTypes::Type type = ParameterTypes::getType(keyStart, (unsigned int)(keyEnd - keyStart));
@@ -53,7 +53,7 @@ BranchParameter::BranchParameter(ParameterTypes::Type type,
       }
       
       const char* start = pb.position();
-      static std::bitset<256> delimiter=Data::toBitset("\r\n\t ;=?>");
+      const CharTable& delimiter = CharClass<'\r', '\n', '\t', ' ', ';', '=', '?', '>'>::Table;
 
       if (mHasMagicCookie &&
           (pb.end() - start > 8) &&
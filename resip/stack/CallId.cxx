@@ -89,8 +89,7 @@ void
 CallID::parse(ParseBuffer& pb)
 {
    const char* start = pb.skipWhitespace();
-   static const std::bitset<256> wsOrSemi(Data::toBitset(ParseBuffer::Whitespace).set(Symbols::SEMI_COLON[0]));
-   pb.skipToOneOf(wsOrSemi);
+   pb.skipToOneOf(CharClass<' ', '\t', '\r', '\n', ';'>::Table);
    pb.data(mValue, start);
 
    parseParameters(pb);
@@ -31,6 +31,32 @@ volatile bool Connection::mEnablePostConnectSocketFuncCall = false;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
+// Writes the RFC 6455 header of a single, unmasked, binary frame carrying
+// size bytes of payload; returns the header length (2, 4 or 10 bytes).
+static unsigned int
+makeWebSocketFrameHeader(UInt64 size, UInt8* header)
+{
+   header[0] = 0x82;
+   if(size <= 0x7D)
+   {
+      header[1] = (UInt8)size;
+      return 2;
+   }
+   else if(size <= 0xFFFF)
+   {
+      header[1] = 0x7E;
+      header[2] = (UInt8)((size >> 8) & 0xFF);
+      header[3] = (UInt8)(size & 0xFF);
+      return 4;
+   }
+   header[1] = 0x7F;
+   for(int i = 0; i < 8; ++i)
+   {
+      header[2 + i] = (UInt8)((size >> (56 - 8 * i)) & 0xFF);
+   }
+   return 10;
+}
+
 Connection::Connection(Transport* transport,const Tuple& who, Socket socket,
                        Compression &compression,
                        bool isServer)
@@ -39,6 +65,8 @@ Connection::Connection(Transport* transport,const Tuple& who, Socket socket,
      mInWritable(false),
      mFlowTimerEnabled(false),
      mPollItemHandle(0),
+     mWsFrameHeaderSize(0),
+     mWsFrontFramed(false),
      mIsServer(isServer)
 {
    mWho.mFlowKey=(FlowKey)socket;
@@ -81,6 +109,8 @@ Connection::removeFrontOutstandingSend()
 {
    delete mOutstandingSends.front();
    mOutstandingSends.pop_front();
+   mWsFrameHeaderSize = 0;
+   mWsFrontFramed = false;
 
    if (mOutstandingSends.empty())
    {
@@ -157,63 +187,34 @@ Connection::performWrite()
    {
       mSendingTransmissionFormat = WebSocketData;
    }
-   else if(mSendingTransmissionFormat == WebSocketData)
+   else if(mSendingTransmissionFormat == WebSocketData && !mWsFrontFramed)
    {
-      SendData *dataWs, *oldSd;
+      mWsFrontFramed = true;
       const Data& dataRaw = mOutstandingSends.front()->data;
-      UInt64 dataSize = 1 + 1 + dataRaw.size();
-      UInt64 lSize = (UInt64)dataRaw.size();
-      UInt8* uBuffer;
-
-      if(lSize > 0x7D && lSize <= 0xFFFF)
+      if(supportsGatherWrite())
       {
-         dataSize += 2;
-      }
-      else if(lSize > 0xFFFF)
-      {
-         dataSize += 8;
-      }
-
-      oldSd = mOutstandingSends.front();
-      dataWs = new SendData(oldSd->destination,
-            Data(Data::Take, new char[(int)dataSize], (Data::size_type)dataSize),
-            oldSd->transactionId,
-            oldSd->sigcompId,
-            false);
-      resip_assert(dataWs && dataWs->data.data());
-      uBuffer = (UInt8*)dataWs->data.data();
-
-      uBuffer[0] = 0x82;
-      if(lSize <= 0x7D)
-      {
-         uBuffer[1] = (UInt8)lSize;
-         uBuffer = &uBuffer[2];
-      }
-      else if(lSize <= 0xFFFF)
-      {
-         uBuffer[1] = 0x7E;
-         uBuffer[2] = (UInt8)((lSize >> 8) & 0xFF);
-         uBuffer[3] = (UInt8)(lSize & 0xFF);
-         uBuffer = &uBuffer[4];
+         // header goes out as its own buffer, see performGatherWrite()
+         mWsFrameHeaderSize = makeWebSocketFrameHeader(dataRaw.size(), mWsFrameHeader);
       }
       else
       {
-         uBuffer[1] = 0x7F;
-         uBuffer[2] = (UInt8)((lSize >> 56) & 0xFF);
-         uBuffer[3] = (UInt8)((lSize >> 48) & 0xFF);
-         uBuffer[4] = (UInt8)((lSize >> 40) & 0xFF);
-         uBuffer[5] = (UInt8)((lSize >> 32) & 0xFF);
-         uBuffer[6] = (UInt8)((lSize >> 24) & 0xFF);
-         uBuffer[7] = (UInt8)((lSize >> 16) & 0xFF);
-         uBuffer[8] = (UInt8)((lSize >> 8) & 0xFF);
-         uBuffer[9] = (UInt8)(lSize & 0xFF);
-         uBuffer = &uBuffer[10];
+         UInt8 header[10];
+         unsigned int headerSize = makeWebSocketFrameHeader(dataRaw.size(), header);
+         Data::size_type dataSize = headerSize + dataRaw.size();
+
+         SendData* oldSd = mOutstandingSends.front();
+         SendData* dataWs = new SendData(oldSd->destination,
+               Data(Data::Take, new char[dataSize], dataSize),
+               oldSd->transactionId,
+               oldSd->sigcompId,
+               false);
+         resip_assert(dataWs && dataWs->data.data());
+         char* uBuffer = const_cast<char*>(dataWs->data.data());
+         memcpy(uBuffer, header, headerSize);
+         memcpy(uBuffer + headerSize, dataRaw.data(), dataRaw.size());
+         mOutstandingSends.front() = dataWs;
+         delete oldSd;
       }
-
-      memcpy(uBuffer, dataRaw.data(), dataRaw.size());
-      mOutstandingSends.front() = dataWs;
-      dataWs = 0;
-      delete oldSd;
    }
 
 #ifdef USE_SIGCOMP
@@ -259,6 +260,11 @@ Connection::performWrite()
       }
    }
 
+   if (supportsGatherWrite())
+   {
+      return performGatherWrite();
+   }
+
    const Data& data = mOutstandingSends.front()->data;
    int nBytes = write(data.data() + mSendPos,int(data.size() - mSendPos));
 
@@ -290,6 +296,81 @@ Connection::performWrite()
    }
 }
 
+int
+Connection::performGatherWrite()
+{
+   // The front send (and its WebSocket frame header, if any) always goes in.
+   // On a plain stream the sends queued behind it can follow in the same
+   // write; WebSocket and SigComp sends are transformed one at a time above,
+   // so those stop at the front.
+   WriteBuffer buffers[MaxGatherSends + 1];
+   int count = 0;
+
+   Data::size_type skip = mSendPos;
+   if (skip < mWsFrameHeaderSize)
+   {
+      buffers[count].mData = reinterpret_cast<const char*>(mWsFrameHeader) + skip;
+      buffers[count].mSize = int(mWsFrameHeaderSize - skip);
+      ++count;
+      skip = 0;
+   }
+   else
+   {
+      skip -= mWsFrameHeaderSize;
+   }
+
+   const Data& front = mOutstandingSends.front()->data;
+   if (skip < front.size())
+   {
+      buffers[count].mData = front.data() + skip;
+      buffers[count].mSize = int(front.size() - skip);
+      ++count;
+   }
+
+   if (mSendingTransmissionFormat == Uncompressed)
+   {
+      std::list<SendData*>::const_iterator it = mOutstandingSends.begin();
+      for (++it; it != mOutstandingSends.end() && count < MaxGatherSends; ++it)
+      {
+         // commands are handled one at a time from the front
+         if ((*it)->command != SendData::NoCommand)
+         {
+            break;
+         }
+         buffers[count].mData = (*it)->data.data();
+         buffers[count].mSize = int((*it)->data.size());
+         ++count;
+      }
+   }
+
+   resip_assert(count > 0);
+   int nBytes = writeGather(buffers, count);
+
+   if (nBytes < 0)
+   {
+      InfoLog(<< "Write failed on socket: " << this->getSocket() << ", closing connection");
+      return -1;
+   }
+
+   // Retire every send that went out completely; the first one that did not
+   // becomes the new front with mSendPos marking how far it got.
+   Data::size_type written = static_cast<Data::size_type>(nBytes);
+   while (written > 0)
+   {
+      Data::size_type remaining = mWsFrameHeaderSize
+                                  + mOutstandingSends.front()->data.size()
+                                  - mSendPos;
+      if (written < remaining)
+      {
+         mSendPos += written;
+         break;
+      }
+      written -= remaining;
+      mSendPos = 0;
+      removeFrontOutstandingSend();
+   }
+   return nBytes;
+}
 
 bool 
 Connection::performWrites(unsigned int max)
@@ -109,6 +109,19 @@ class Connection : public ConnectionBase,
       virtual int read(char* /* buffer */, const int /* count */) { return 0; }
       /// pure virtual, but need concrete Connection for book-ends of lists
       virtual int write(const char* /* buffer */, const int /* count */) { return 0; }
+
+      struct WriteBuffer
+      {
+         const char* mData;
+         int mSize;
+      };
+      /// true if the socket can take several buffers in one call, see writeGather()
+      virtual bool supportsGatherWrite() const { return false; }
+      /** Writes the buffers, in order, with a single system call. Same return
+          convention as write(): bytes written, 0 if the socket is backed up,
+          -1 on error. Only called when supportsGatherWrite() is true.
+      */
+      virtual int writeGather(const WriteBuffer* /* buffers */, int /* count */) { return 0; }
       virtual void onDoubleCRLF();
       virtual void onSingleCRLF();
 
@@ -120,9 +133,21 @@ class Connection : public ConnectionBase,
    private:
       ConnectionManager& getConnectionManager() const;
       void removeFrontOutstandingSend();
+      int performGatherWrite();
       bool mInWritable;
       bool mFlowTimerEnabled;
       FdPollItemHandle mPollItemHandle;
+
+      /// most sends gathered into one writeGather() call
+      static const int MaxGatherSends = 16;
+      /// WebSocket frame header of the front send when it is framed on the
+      /// fly by performGatherWrite(); mSendPos counts these bytes too
+      UInt8 mWsFrameHeader[10];
+      unsigned int mWsFrameHeaderSize;
+      /// the front send has been given its WebSocket frame header; cleared
+      /// when it is removed, so a write that made no progress doesn't frame
+      /// it twice
+      bool mWsFrontFramed;
       
       /// no default c'tor
       Connection();
@@ -818,6 +818,7 @@ ConnectionBase::wsProcessData(int bytesRead)
       {
          // sending a keep alive reply now
          StackLog(<<"got a SIP ping embedded in WebSocket frame, replying");
+         delete [] msg->data();
          onDoubleCRLF();
          msg = mWsFrameExtractor.processBytes(0, 0, dropConnection);
          continue;
@@ -57,19 +57,19 @@ ConnectionManager::findConnection(const Tuple& addr)
 {
    if (addr.mFlowKey != 0)
    {
-      IdMap::iterator i = mIdMap.find(addr.mFlowKey);
-      if (i != mIdMap.end())
+      Connection* conn = findById(addr.mFlowKey);
+      if (conn)
       {
-         if(i->second->who() == addr)
+         if(conn->who() == addr)
          {
             DebugLog(<<"Found fd " << addr.mFlowKey);
-            return i->second;
+            return conn;
          }
          else
          {
             DebugLog(<<"fd " << addr.mFlowKey 
                      << " exists, but does not match the destination. FD -> "
-                     << i->second->who() << ", tuple -> " << addr);
+                     << conn->who() << ", tuple -> " << addr);
          }
       }
       else
@@ -99,19 +99,19 @@ ConnectionManager::findConnection(const Tuple& addr) const
 {
    if (addr.mFlowKey != 0)
    {
-      IdMap::const_iterator i = mIdMap.find(addr.mFlowKey);
-      if (i != mIdMap.end())
+      Connection* conn = findById(addr.mFlowKey);
+      if (conn)
       {
-         if(i->second->who()==addr)
+         if(conn->who()==addr)
          {
             DebugLog(<<"Found fd " << addr.mFlowKey);
-            return i->second;
+            return conn;
          }
          else
          {
             DebugLog(<<"fd " << addr.mFlowKey 
                      << " exists, but does not match the destination. FD -> "
-                     << i->second->who() << ", tuple -> " << addr);
+                     << conn->who() << ", tuple -> " << addr);
          }
       }
       else
@@ -131,6 +131,48 @@ ConnectionManager::findConnection(const Tuple& addr) const
    return 0;
 }
 
+Connection*
+ConnectionManager::findById(FlowKey id) const
+{
+#if defined(WIN32)
+   IdMap::const_iterator i = mIdMap.find(id);
+   return i == mIdMap.end() ? 0 : i->second;
+#else
+   if (id >= mIdMap.size())
+   {
+      return 0;
+   }
+   return mIdMap[id];
+#endif
+}
+
+void
+ConnectionManager::addId(FlowKey id, Connection* connection)
+{
+#if defined(WIN32)
+   mIdMap[id] = connection;
+#else
+   if (id >= mIdMap.size())
+   {
+      mIdMap.resize(resipMax(IdMap::size_type(id) + 1, mIdMap.size() * 2), 0);
+   }
+   mIdMap[id] = connection;
+#endif
+}
+
+void
+ConnectionManager::removeId(FlowKey id)
+{
+#if defined(WIN32)
+   mIdMap.erase(id);
+#else
+   if (id < mIdMap.size())
+   {
+      mIdMap[id] = 0;
+   }
+#endif
+}
+
 void
 ConnectionManager::buildFdSet(FdSet& fdset)
 {
@@ -184,10 +226,10 @@ ConnectionManager::addConnection(Connection* connection)
 {
    resip_assert(mAddrMap.find(connection->who())==mAddrMap.end());
 
-   DebugLog (<< "ConnectionManager::addConnection() " << connection->mWho.mFlowKey  << ":" << connection->who() << ", totalConnections=" << mIdMap.size());
+   DebugLog (<< "ConnectionManager::addConnection() " << connection->mWho.mFlowKey  << ":" << connection->who() << ", totalConnections=" << mAddrMap.size());
    
    mAddrMap[connection->who()] = connection;
-   mIdMap[connection->who().mFlowKey] = connection;
+   addId(connection->who().mFlowKey, connection);
 
    if ( mPollGrp ) 
    {
@@ -216,7 +258,7 @@ ConnectionManager::removeConnection(Connection* connection)
 {
    DebugLog (<< "ConnectionManager::removeConnection()");
 
-   mIdMap.erase(connection->mWho.mFlowKey);
+   removeId(connection->mWho.mFlowKey);
    mAddrMap.erase(connection->mWho);
 
    if ( mPollGrp ) 
@@ -1,7 +1,7 @@
 #ifndef RESIP_ConnectionMgr_hxx
 #define RESIP_ConnectionMgr_hxx 
 
-#include <map>
+#include <vector>
 #include "rutil/HashMap.hxx"
 #include "resip/stack/Connection.hxx"
 
@@ -53,8 +53,18 @@ class ConnectionManager
       void addToWritable(Connection* conn); // add the specified conn to end
       void removeFromWritable(Connection* conn); // remove the current mWriteMark
 
-      typedef std::map<Tuple, Connection*> AddrMap;
-      typedef std::map<Socket, Connection*> IdMap;
+      typedef HashMap<Tuple, Connection*> AddrMap;
+#if defined(WIN32)
+      typedef HashMap<Socket, Connection*> IdMap;
+#else
+      /// descriptors are small and allocated lowest first, so the flow key
+      /// (the connection's socket) indexes straight into a vector
+      typedef std::vector<Connection*> IdMap;
+#endif
+
+      Connection* findById(FlowKey id) const;
+      void addId(FlowKey id, Connection* connection);
+      void removeId(FlowKey id);
 
       void addConnection(Connection* connection);
       void removeConnection(Connection* connection);
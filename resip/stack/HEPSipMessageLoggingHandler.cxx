@@ -34,6 +34,12 @@ HEPSipMessageLoggingHandler::outboundMessage(const Tuple &source, const Tuple &d
    sendToHOMER(source, destination, msg);
 }
 
+void
+HEPSipMessageLoggingHandler::outboundMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg, const Data& encoded)
+{
+   capture(source, destination, msg, encoded);
+}
+
 void
 HEPSipMessageLoggingHandler::outboundRetransmit(const Tuple &source, const Tuple &destination, const SendData &data)
 {
@@ -43,7 +49,13 @@ HEPSipMessageLoggingHandler::outboundRetransmit(const Tuple &source, const Tuple
 void
 HEPSipMessageLoggingHandler::inboundMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg)
 {
-   sendToHOMER(source, destination, msg);
+   // nothing has been parsed yet, so this is a copy of the received text
+   Data encoded;
+   {
+      DataStream str(encoded);
+      msg.encode(str);
+   }
+   capture(source, destination, msg, encoded);
 }
 
 void
@@ -55,6 +67,15 @@ HEPSipMessageLoggingHandler::sendToHOMER(const Tuple& source, const Tuple& desti
       msg.exists(h_CallId) ? msg.header(h_CallId).value() : Data::Empty);
 }
 
+void
+HEPSipMessageLoggingHandler::capture(const Tuple& source, const Tuple& destination, const SipMessage &msg, const Data& encoded)
+{
+   mHepAgent->capture(source.getType(),
+      source.toGenericIPAddress(), destination.toGenericIPAddress(),
+      HepAgent::SIP, encoded,
+      msg.exists(h_CallId) ? msg.header(h_CallId).value() : Data::Empty);
+}
+
 /* ====================================================================
  *
  * Copyright 2016 Daniel Pocock http://danielpocock.com  All rights reserved.
@@ -17,10 +17,14 @@ class HEPSipMessageLoggingHandler : public Transport::SipMessageLoggingHandler
       HEPSipMessageLoggingHandler(SharedPtr<HepAgent> agent);
       virtual ~HEPSipMessageLoggingHandler();
       virtual void outboundMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg);
+      virtual void outboundMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg, const Data& encoded);
       virtual void outboundRetransmit(const Tuple &source, const Tuple &destination, const SendData &data);
       virtual void inboundMessage(const Tuple& source, const Tuple& destination, const SipMessage &msg);
    protected:
       virtual void sendToHOMER(const Tuple& source, const Tuple& destination, const SipMessage &msg);
+      /// Hands the wire form of msg to HepAgent::capture(), which queues it
+      /// for its capture thread if one was started.
+      virtual void capture(const Tuple& source, const Tuple& destination, const SipMessage &msg, const Data& encoded);
    private:
       SharedPtr<HepAgent> mHepAgent;
 };
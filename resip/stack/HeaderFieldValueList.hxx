@@ -65,6 +65,10 @@ class HeaderFieldValueList
       */
       void push_back(const char* buffer, size_t length, bool own) 
       {
+         if(!mHeaders.empty() && mHeaders.size() == mHeaders.capacity())
+         {
+            grow();
+         }
          mHeaders.push_back(HeaderFieldValue::Empty); 
          mHeaders.back().init(buffer,length,own);
       }
@@ -94,6 +98,21 @@ class HeaderFieldValueList
       const_iterator end() const {return mHeaders.end();}
 
    private:
+      // Makes room for more values without copying them; if the vector
+      // reallocated on its own, it would copy (and so heap allocate) every
+      // field.
+      void grow()
+      {
+         ListImpl grown(mHeaders.get_allocator());
+         grown.reserve(2*mHeaders.size());
+         for(iterator i=mHeaders.begin(); i!=mHeaders.end(); ++i)
+         {
+            grown.push_back(HeaderFieldValue::Empty);
+            grown.back().swap(*i);
+         }
+         mHeaders.swap(grown);
+      }
+
       ListImpl mHeaders;
       PoolBase* mPool;
       ParserContainerBase* mParserContainer;
@@ -700,6 +700,84 @@ Helper::makeNonce(const SipMessage& request, const Data& timestamp)
 }
 
 static Data noBody = MD5Stream().getHex();
+
+// Computes the hex digest response into out without going through
+// std::ostream; only the auth-int entity body is still streamed.
+static void
+responseMD5WithA1(char out[MD5Hash::HexLength],
+                  const Data& a1,
+                  const Data& method, const Data& digestUri, const Data& nonce,
+                  const Data& qop, const Data& cnonce, const Data& cnonceCount,
+                  const Contents* entityBody)
+{
+   MD5Hash a2;
+   a2.update(method);
+   a2.update(Symbols::COLON[0]);
+   a2.update(digestUri);
+
+   if (qop == Symbols::authInt)
+   {
+      a2.update(Symbols::COLON[0]);
+      if (entityBody)
+      {
+         MD5Stream eStream;
+         eStream << *entityBody;
+         a2.update(eStream.getHex());
+      }
+      else
+      {
+         a2.update(noBody);
+      }
+   }
+
+   MD5Hash r;
+   r.update(a1);
+   r.update(Symbols::COLON[0]);
+   r.update(nonce);
+   r.update(Symbols::COLON[0]);
+
+   if (!qop.empty())
+   {
+      r.update(cnonceCount);
+      r.update(Symbols::COLON[0]);
+      r.update(cnonce);
+      r.update(Symbols::COLON[0]);
+      r.update(qop);
+      r.update(Symbols::COLON[0]);
+   }
+
+   char ha2[MD5Hash::HexLength];
+   a2.getHex(ha2);
+   r.update(ha2, sizeof(ha2));
+   r.getHex(out);
+}
+
+// Compares a received digest response against the expected one without
+// materializing the expected value as a Data.
+static bool
+responseMatches(const Data& response,
+                const Data& a1,
+                const Data& method, const Data& digestUri, const Data& nonce,
+                const Data& qop = Data::Empty, const Data& cnonce = Data::Empty,
+                const Data& cnonceCount = Data::Empty,
+                const Contents* entityBody = 0)
+{
+#ifdef RESIP_DIGEST_LOGGING
+   return response == Helper::makeResponseMD5WithA1(a1, method, digestUri, nonce,
+                                                    qop, cnonce, cnonceCount,
+                                                    entityBody);
+#else
+   if (response.size() != MD5Hash::HexLength)
+   {
+      return false;
+   }
+   char expected[MD5Hash::HexLength];
+   responseMD5WithA1(expected, a1, method, digestUri, nonce, qop, cnonce,
+                     cnonceCount, entityBody);
+   return memcmp(response.data(), expected, sizeof(expected)) == 0;
+#endif
+}
+
 Data 
 Helper::makeResponseMD5WithA1(const Data& a1,
                               const Data& method, const Data& digestUri, const Data& nonce,
@@ -709,9 +787,6 @@ Helper::makeResponseMD5WithA1(const Data& a1,
 #ifdef RESIP_DIGEST_LOGGING
    Data _a2;
    DataStream a2(_a2);
-#else
-   MD5Stream a2;
-#endif
    a2 << method
       << Symbols::COLON
       << digestUri;
@@ -723,25 +798,17 @@ Helper::makeResponseMD5WithA1(const Data& a1,
          MD5Stream eStream;
          eStream << *entityBody;
          a2 << Symbols::COLON << eStream.getHex();
-#ifdef RESIP_DIGEST_LOGGING
          StackLog(<<"auth-int, body length = " << eStream.bytesTaken());
-#endif
       }
       else
       {
          a2 << Symbols::COLON << noBody;
-#ifdef RESIP_DIGEST_LOGGING
          StackLog(<<"auth-int, no body");
-#endif
       }
    }
    
-#ifdef RESIP_DIGEST_LOGGING
    Data _r;
    DataStream r(_r);
-#else
-   MD5Stream r;
-#endif
    r << a1
      << Symbols::COLON
      << nonce
@@ -756,7 +823,6 @@ Helper::makeResponseMD5WithA1(const Data& a1,
         << qop
         << Symbols::COLON;
    }
-#ifdef RESIP_DIGEST_LOGGING
    a2.flush();
    StackLog(<<"A2 = " << _a2);
    MD5Stream a2md5;
@@ -768,9 +834,10 @@ Helper::makeResponseMD5WithA1(const Data& a1,
    rmd5 << _r;
    return rmd5.getHex();
 #else
-   r << a2.getHex();
-
-   return r.getHex();
+   char response[MD5Hash::HexLength];
+   responseMD5WithA1(response, a1, method, digestUri, nonce, qop, cnonce,
+                     cnonceCount, entityBody);
+   return Data(response, sizeof(response));
 #endif
 }
 
@@ -781,12 +848,12 @@ Helper::makeResponseMD5(const Data& username, const Data& password, const Data&
                         const Data& qop, const Data& cnonce, const Data& cnonceCount,
                         const Contents *entity)
 {
-   MD5Stream a1;
-   a1 << username
-      << Symbols::COLON
-      << realm
-      << Symbols::COLON
-      << password;
+   MD5Hash a1;
+   a1.update(username);
+   a1.update(Symbols::COLON[0]);
+   a1.update(realm);
+   a1.update(Symbols::COLON[0]);
+   a1.update(password);
  
    return makeResponseMD5WithA1(a1.getHex(), method, digestUri, nonce, qop, 
                                 cnonce, cnonceCount, entity);
@@ -891,14 +958,15 @@ Helper::advancedAuthenticateRequest(const SipMessage& request,
                {
                   if(i->exists(p_uri) && i->exists(p_cnonce) && i->exists(p_nc))
                   {
-                     if (i->param(p_response) == makeResponseMD5WithA1(a1,
-                                                               getMethodName(request.header(h_RequestLine).getMethod()),
-                                                               i->param(p_uri),
-                                                               i->param(p_nonce),
-                                                               i->param(p_qop),
-                                                               i->param(p_cnonce),
-                                                               i->param(p_nc),
-                                                               request.getContents()))
+                     if (responseMatches(i->param(p_response),
+                                         a1,
+                                         getMethodName(request.header(h_RequestLine).getMethod()),
+                                         i->param(p_uri),
+                                         i->param(p_nonce),
+                                         i->param(p_qop),
+                                         i->param(p_cnonce),
+                                         i->param(p_nc),
+                                         request.getContents()))
                      {
                         if(i->exists(p_username))
                         {
@@ -920,10 +988,11 @@ Helper::advancedAuthenticateRequest(const SipMessage& request,
             }
             else if(i->exists(p_uri))
             {
-               if (i->param(p_response) == makeResponseMD5WithA1(a1,
-                                                               getMethodName(request.header(h_RequestLine).getMethod()),
-                                                               i->param(p_uri),
-                                                               i->param(p_nonce)))
+               if (responseMatches(i->param(p_response),
+                                   a1,
+                                   getMethodName(request.header(h_RequestLine).getMethod()),
+                                   i->param(p_uri),
+                                   i->param(p_nonce)))
                {
                   if(i->exists(p_username))
                   {
@@ -1207,14 +1276,15 @@ Helper::authenticateRequestWithA1(const SipMessage& request,
             {
                if(i->exists(p_uri) && i->exists(p_cnonce) && i->exists(p_nc))
                {
-                  if (i->param(p_response) == makeResponseMD5WithA1(hA1, 
-                                                                  getMethodName(request.header(h_RequestLine).getMethod()),
-                                                                  i->param(p_uri),
-                                                                  i->param(p_nonce),
-                                                                  i->param(p_qop),
-                                                                  i->param(p_cnonce),
-                                                                  i->param(p_nc),
-                                                                  request.getContents()))
+                  if (responseMatches(i->param(p_response),
+                                      hA1,
+                                      getMethodName(request.header(h_RequestLine).getMethod()),
+                                      i->param(p_uri),
+                                      i->param(p_nonce),
+                                      i->param(p_qop),
+                                      i->param(p_cnonce),
+                                      i->param(p_nc),
+                                      request.getContents()))
                   {
                      return Authenticated;
                   }
@@ -1232,10 +1302,11 @@ Helper::authenticateRequestWithA1(const SipMessage& request,
          }
          else if(i->exists(p_uri))
          {
-            if (i->param(p_response) == makeResponseMD5WithA1(hA1,
-                                                                  getMethodName(request.header(h_RequestLine).getMethod()),
-                                                                  i->param(p_uri),
-                                                                  i->param(p_nonce)))
+            if (responseMatches(i->param(p_response),
+                                hA1,
+                                getMethodName(request.header(h_RequestLine).getMethod()),
+                                i->param(p_uri),
+                                i->param(p_nonce)))
             {
                return Authenticated;
             }
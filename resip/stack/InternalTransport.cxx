@@ -36,7 +36,10 @@ InternalTransport::InternalTransport(Fifo<TransactionMessage>& rxFifo,
    mTxFifoOutBuffer(mTxFifo),
    mPollGrp(NULL),
    mPollItemHandle(NULL)
-{}
+{
+   // the stack (or its shards) post here while the transport thread drains
+   mTxFifo.enableLockFreeAdd(TxRingSize);
+}
 
 InternalTransport::~InternalTransport()
 {
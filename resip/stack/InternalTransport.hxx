@@ -95,6 +95,8 @@ class InternalTransport : public Transport
       SelectInterruptor mSelectInterruptor;
       FdPollItemHandle mInterruptorHandle;
 
+      // Producers add through a lock-free ring of this many entries.
+      static const unsigned int TxRingSize = 1024;
       Fifo<SendData> mTxFifo; // owned by the transport
       ConsumerFifoBuffer<SendData> mTxFifoOutBuffer;
       FdPollGrp *mPollGrp;      // not owned by transport, just used
@@ -120,16 +120,14 @@ void
 Mime::parse(ParseBuffer& pb)
 {
    const char* anchor = pb.skipWhitespace();
-   static std::bitset<256> delimiter1=Data::toBitset("\r\n\t /");
-   pb.skipToOneOf(delimiter1);
+   pb.skipToOneOf(CharClass<'\r', '\n', '\t', ' ', '/'>::Table);
    pb.data(mType, anchor);
 
    pb.skipWhitespace();
    pb.skipChar(Symbols::SLASH[0]);
 
    anchor = pb.skipWhitespace();
-   static std::bitset<256> delimiter2=Data::toBitset("\r\n\t ;");
-   pb.skipToOneOf(delimiter2);
+   pb.skipToOneOf(CharClass<'\r', '\n', '\t', ' ', ';'>::Table);
    pb.data(mSubType, anchor);
 
    pb.skipWhitespace();
@@ -5,11 +5,20 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdio.h>
+
 #include "resip/stack/HeaderTypes.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/MsgHeaderScanner.hxx"
+#include "rutil/Simd.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
+// Runs of characters are skipped a vector at a time where the build allows
+// it; the debug build traces every character, so it always scans one at a
+// time.
+#if defined(RESIP_SIMD_SSE2) && !defined(RESIP_MSG_HEADER_SCANNER_DEBUG)
+#define MSG_SCANNER_SKIP_RUNS
+#endif
+
 namespace resip 
 {
 
@@ -412,6 +421,169 @@ static void initStateMachine()
                   sMsgStart); // Arbitrary but possibly handy.
 }
 
+///////////////////////////////////////////////////////////////////////////////
+//   Most header characters leave the state machine where it is, with no
+//   action: the bulk of a value (in or out of quotes or angle brackets) and
+//   the status line.  For those states, runs of such characters are skipped
+//   a block at a time, stopping at the first character that could do
+//   anything else.  The stop characters, and the characters with text
+//   properties, are taken from the tables above, so skipping a run has
+//   exactly the effect of scanning it one character at a time.
+
+enum { maxNumRunStopChars = 6, maxNumRunPropChars = 8 };
+
+struct RunInfo
+{
+      unsigned char numStopChars;    // 0 if runs are not skipped in the state
+      char stopChars[maxNumRunStopChars];
+      unsigned char numPropChars;    // characters that have text properties
+      char propChars[maxNumRunPropChars];
+      MsgHeaderScanner::TextPropBitMask propBitMasks[maxNumRunPropChars];
+};
+
+static RunInfo runInfoArray[numStates];
+
+static void initRunInfoArray()
+{
+   for (int state = 0; state < numStates; ++state)
+   {
+      RunInfo& runInfo = runInfoArray[state];
+      runInfo.numStopChars = 0;
+      runInfo.numPropChars = 0;
+      const TransitionInfo& otherTransition = stateMachine[state][ccOther];
+      if (otherTransition.action != taNone || otherTransition.nextState != state)
+      {
+         continue;
+      }
+      bool isRunState = true;
+      unsigned char numStopChars = 0;
+      for (unsigned int charIndex = 0; charIndex <= UCHAR_MAX; ++charIndex)
+      {
+         const CharInfo& charInfo = charInfoArray[charIndex];
+         const TransitionInfo& transition = stateMachine[state][c2i(charInfo.category)];
+         if (transition.action != taNone || transition.nextState != state)
+         {
+            if (numStopChars == maxNumRunStopChars)
+            {
+               isRunState = false;
+               break;
+            }
+            runInfo.stopChars[numStopChars++] = (char)charIndex;
+         }
+         else if (charInfo.textPropBitMask)
+         {
+            if (runInfo.numPropChars == maxNumRunPropChars)
+            {
+               isRunState = false;
+               break;
+            }
+            runInfo.propChars[runInfo.numPropChars] = (char)charIndex;
+            runInfo.propBitMasks[runInfo.numPropChars++] = charInfo.textPropBitMask;
+         }
+      }
+      if (!isRunState)
+      {
+         runInfo.numPropChars = 0;
+         continue;
+      }
+      // Unused stop slots repeat a stop character, so every slot can be tested.
+      for (unsigned char i = numStopChars; i < maxNumRunStopChars; ++i)
+      {
+         runInfo.stopChars[i] = runInfo.stopChars[0];
+      }
+      runInfo.numStopChars = numStopChars;
+   }
+}
+
+#if defined(MSG_SCANNER_SKIP_RUNS)
+
+//   Returns the first character at or after "charPtr" that ends a run in the
+//   state described by "runInfo", looking only at whole blocks that end at or
+//   before "termCharPtr"; if there is none, returns the start of the partial
+//   block, for the caller to scan one character at a time.  The text
+//   properties of the skipped characters are added to "textPropBitMask".
+static char* skipRun(char* charPtr,
+                     const char* termCharPtr,
+                     const RunInfo& runInfo,
+                     MsgHeaderScanner::TextPropBitMask& textPropBitMask)
+{
+#if defined(RESIP_SIMD_AVX2)
+   if (termCharPtr - charPtr >= 32)
+   {
+      __m256i stops[maxNumRunStopChars];
+      for (int i = 0; i < maxNumRunStopChars; ++i)
+      {
+         stops[i] = _mm256_set1_epi8(runInfo.stopChars[i]);
+      }
+      do
+      {
+         __m256i block = _mm256_loadu_si256((const __m256i*)charPtr);
+         __m256i isStop = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, stops[0]),
+                                            _mm256_cmpeq_epi8(block, stops[1])),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(block, stops[2]),
+                                            _mm256_cmpeq_epi8(block, stops[3]))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(block, stops[4]),
+                            _mm256_cmpeq_epi8(block, stops[5])));
+         unsigned int stopBits = (unsigned int)_mm256_movemask_epi8(isStop);
+         unsigned int runBits = stopBits ? (stopBits & (0u - stopBits)) - 1 : 0xFFFFFFFFu;
+         for (unsigned char i = 0; i < runInfo.numPropChars; ++i)
+         {
+            if (!(textPropBitMask & runInfo.propBitMasks[i]) &&
+                ((unsigned int)_mm256_movemask_epi8(
+                   _mm256_cmpeq_epi8(block, _mm256_set1_epi8(runInfo.propChars[i]))) & runBits))
+            {
+               textPropBitMask |= runInfo.propBitMasks[i];
+            }
+         }
+         if (stopBits)
+         {
+            return charPtr + lowestBitIndex(stopBits);
+         }
+         charPtr += 32;
+      } while (termCharPtr - charPtr >= 32);
+   }
+#endif
+   if (termCharPtr - charPtr >= 16)
+   {
+      __m128i stops[maxNumRunStopChars];
+      for (int i = 0; i < maxNumRunStopChars; ++i)
+      {
+         stops[i] = _mm_set1_epi8(runInfo.stopChars[i]);
+      }
+      do
+      {
+         __m128i block = _mm_loadu_si128((const __m128i*)charPtr);
+         __m128i isStop = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, stops[0]),
+                                      _mm_cmpeq_epi8(block, stops[1])),
+                         _mm_or_si128(_mm_cmpeq_epi8(block, stops[2]),
+                                      _mm_cmpeq_epi8(block, stops[3]))),
+            _mm_or_si128(_mm_cmpeq_epi8(block, stops[4]),
+                         _mm_cmpeq_epi8(block, stops[5])));
+         unsigned int stopBits = (unsigned int)_mm_movemask_epi8(isStop);
+         unsigned int runBits = stopBits ? (stopBits & (0u - stopBits)) - 1 : 0xFFFFu;
+         for (unsigned char i = 0; i < runInfo.numPropChars; ++i)
+         {
+            if (!(textPropBitMask & runInfo.propBitMasks[i]) &&
+                ((unsigned int)_mm_movemask_epi8(
+                   _mm_cmpeq_epi8(block, _mm_set1_epi8(runInfo.propChars[i]))) & runBits))
+            {
+               textPropBitMask |= runInfo.propBitMasks[i];
+            }
+         }
+         if (stopBits)
+         {
+            return charPtr + lowestBitIndex(stopBits);
+         }
+         charPtr += 16;
+      } while (termCharPtr - charPtr >= 16);
+   }
+   return charPtr;
+}
+
+#endif // defined(MSG_SCANNER_SKIP_RUNS)
+
 // Debug follows
 #if defined(RESIP_MSG_HEADER_SCANNER_DEBUG)  
 
@@ -950,7 +1122,18 @@ MsgHeaderScanner::scanChunk(char * chunk,
       printStateTransition(localState, *charPtr, transitionAction);
 #endif
       localState = transitionInfo->nextState;
-      if (transitionAction == taNone) continue;
+      if (transitionAction == taNone)
+      {
+#if defined(MSG_SCANNER_SKIP_RUNS)
+         const RunInfo& runInfo = runInfoArray[(unsigned)localState];
+         if (runInfo.numStopChars && termCharPtr - charPtr > 16)
+         {
+            // The loop advances "charPtr" first, so stop just before the run's end.
+            charPtr = skipRun(charPtr + 1, termCharPtr, runInfo, localTextPropBitMask) - 1;
+         }
+#endif
+         continue;
+      }
       // END message header character scan block END
       // The loop remainder is executed about 4-5 times per message header line.
       switch (transitionAction)
@@ -1067,6 +1250,7 @@ MsgHeaderScanner::initialize()
 {
    initCharInfoArray();
    initStateMachine();
+   initRunInfoArray();
    return true;
 }
 
@@ -221,8 +221,7 @@ ParserCategory::parseParameters(ParseBuffer& pb)
          // extract the key
          pb.skipChar();
          const char* keyStart = pb.skipWhitespace();
-         static std::bitset<256> terminators1=Data::toBitset(" \t\r\n;=?>"); //!dlb! @ here?
-         const char* keyEnd = pb.skipToOneOf(terminators1);  
+         const char* keyEnd = pb.skipToOneOf(CharClass<' ', '\t', '\r', '\n', ';', '=', '?', '>'>::Table); //!dlb! @ here?
 
          if((int)(keyEnd-keyStart) != 0)
          {
@@ -87,7 +87,12 @@ SipMessage::~SipMessage()
 #ifdef DINKYPOOL_PROFILING
    if (mPool.getHeapBytes() > 0)
    {
-       InfoLog(<< "SipMessage mPool filled up and used " << mPool.getHeapBytes() << " bytes on the heap, consider increasing the mPool size (sizeof SipMessage is " << sizeof(SipMessage) << " bytes): msg="
+       InfoLog(<< "SipMessage mPool filled up and used " << mPool.getChunkCount() << " chunks (" << mPool.getChunkBytes() << " bytes) and " << mPool.getHeapBytes() << " bytes on the heap, consider increasing the mPool size (sizeof SipMessage is " << sizeof(SipMessage) << " bytes): msg="
+           << std::endl << *this);
+   }
+   else if (mPool.getChunkCount() > 0)
+   {
+       InfoLog(<< "SipMessage mPool filled up and used " << mPool.getChunkCount() << " chunks (" << mPool.getChunkBytes() << " bytes), consider increasing the mPool size (sizeof SipMessage is " << sizeof(SipMessage) << " bytes): msg="
            << std::endl << *this);
    }
    else
@@ -21,7 +21,7 @@
 #include "resip/stack/WsCookieContext.hxx"
 #include "rutil/BaseException.hxx"
 #include "rutil/Data.hxx"
-#include "rutil/DinkyPool.hxx"
+#include "rutil/ArenaPool.hxx"
 #include "rutil/StlPoolAllocator.hxx"
 #include "rutil/Timer.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
@@ -663,11 +663,13 @@ class SipMessage : public TransactionMessage
       // generated request), set by the Transport and setFromTu and setFromExternal APIs
       bool mIsExternal;
 
-      // Sizing so that average SipMessages don't need to allocate heap memory
-      // To profile current sizing, enable DINKYPOOL_PROFILING in SipMessage.cxx 
-      // and look for DebugLog message in SipMessage destructor to know when heap
-      // allocations are occuring and how much of the pool is used.
-      DinkyPool<3732> mPool;
+      // Sizing so that average SipMessages don't need to allocate heap memory;
+      // bigger ones grow the pool in 4KB chunks, which are all released with
+      // the message. To profile current sizing, enable DINKYPOOL_PROFILING in
+      // SipMessage.cxx and look for the InfoLog message in the SipMessage
+      // destructor to know when chunks are taken and how much of the pool is
+      // used.
+      ArenaPool<3732> mPool;
 
       typedef std::vector<HeaderFieldValueList*, 
                            StlPoolAllocator<HeaderFieldValueList*, 
@@ -34,6 +34,7 @@
 #include "resip/stack/TransactionUser.hxx"
 #include "resip/stack/TransactionUserMessage.hxx"
 #include "resip/stack/TransactionControllerThread.hxx"
+#include "resip/stack/TransportThread.hxx"
 #include "resip/stack/TransportSelectorThread.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
@@ -202,7 +203,8 @@ SipStack::init(const SipStackOptions& options)
 
    // WATCHOUT: the transaction controller constructor will
    // grab the security, DnsStub, compression and statsManager
-   mTransactionController = new TransactionController(*this, mAsyncProcessHandler, options.mUseDnsVip);
+   mTransactionController = new TransactionController(*this, mAsyncProcessHandler, options.mUseDnsVip,
+                                                      options.mTransactionControllerShards);
    mTransactionController->transportSelector().setPollGrp(mPollGrp);
    mTransactionControllerThread = 0;
    mTransportSelectorThread = 0;
@@ -228,8 +230,20 @@ SipStack::~SipStack()
    mDnsThread=0;
    delete mTransactionControllerThread;
    mTransactionControllerThread=0;
+   for(std::vector<TransactionControllerThread*>::iterator i = mTransactionShardThreads.begin(); 
+       i != mTransactionShardThreads.end(); ++i)
+   {
+      delete *i;
+   }
+   mTransactionShardThreads.clear();
    delete mTransportSelectorThread;
    mTransportSelectorThread=0;
+   for(ReusePortTransportMap::iterator i = mReusePortTransports.begin(); 
+       i != mReusePortTransports.end(); ++i)
+   {
+      delete i->second.second;
+   }
+   mReusePortTransports.clear();
 
    delete mTransactionController;
 #ifdef USE_SSL
@@ -269,9 +283,28 @@ SipStack::run()
    mTransactionControllerThread=new TransactionControllerThread(*mTransactionController);
    mTransactionControllerThread->run();
 
+   for(std::vector<TransactionControllerThread*>::iterator i = mTransactionShardThreads.begin(); 
+       i != mTransactionShardThreads.end(); ++i)
+   {
+      delete *i;
+   }
+   mTransactionShardThreads.clear();
+   for(unsigned int i = 1; i < mTransactionController->getNumShards(); ++i)
+   {
+      TransactionControllerThread* t = new TransactionControllerThread(mTransactionController->getShard(i));
+      mTransactionShardThreads.push_back(t);
+      t->run();
+   }
+
    delete mTransportSelectorThread;
    mTransportSelectorThread=new TransportSelectorThread(mTransactionController->transportSelector());
    mTransportSelectorThread->run();
+
+   for(ReusePortTransportMap::iterator i = mReusePortTransports.begin(); 
+       i != mReusePortTransports.end(); ++i)
+   {
+      startReusePortThread(i->second);
+   }
 }
 
 void
@@ -303,11 +336,28 @@ SipStack::shutdownAndJoinThreads()
       mTransactionControllerThread->join();
    }
 
+   for(std::vector<TransactionControllerThread*>::iterator i = mTransactionShardThreads.begin(); 
+       i != mTransactionShardThreads.end(); ++i)
+   {
+      (*i)->shutdown();
+      (*i)->join();
+   }
+
    if(mTransportSelectorThread)
    {
       mTransportSelectorThread->shutdown();
       mTransportSelectorThread->join();
    }
+
+   for(ReusePortTransportMap::iterator i = mReusePortTransports.begin(); 
+       i != mReusePortTransports.end(); ++i)
+   {
+      if(i->second.second)
+      {
+         i->second.second->shutdown();
+         i->second.second->join();
+      }
+   }
    mInternalThreadsRunning=false;
 }
 
@@ -341,10 +391,25 @@ SipStack::addTransport( TransportType protocol,
                         bool useEmailAsSIP,
                         SharedPtr<WsConnectionValidator> wsConnectionValidator,
                         SharedPtr<WsCookieContextFactory> wsCookieContextFactory,
-                        const Data& netNs)
+                        const Data& netNs,
+                        unsigned int reusePortFanout)
 {
    resip_assert(!mShuttingDown);
 
+   if(reusePortFanout > 1)
+   {
+      if(protocol == UDP)
+      {
+         transportFlags |= RESIP_TRANSPORT_FLAG_REUSEPORT | RESIP_TRANSPORT_FLAG_OWNTHREAD;
+      }
+      else
+      {
+         WarningLog(<< "SO_REUSEPORT fan-out is only supported for UDP, ignoring it for "
+                    << Tuple::toData(protocol) << " " << port);
+         reusePortFanout = 1;
+      }
+   }
+
    // If address is specified, ensure it is valid
    if(!ipInterface.empty())
    {
@@ -484,6 +549,31 @@ SipStack::addTransport( TransportType protocol,
       throw;
    }
    addTransport(std::auto_ptr<Transport>(transport));
+   if(reusePortFanout <= 1)
+   {
+      return transport;
+   }
+
+   // The rest of the fan-out binds to the port the first one ended up with,
+   // in case that was chosen by the OS.
+   addReusePortTransport(transport);
+   for(unsigned int i = 1; i < reusePortFanout; ++i)
+   {
+      try
+      {
+         Transport* sharing = new UdpTransport(stateMacFifo, transport->port(), version, stun, ipInterface,
+                                               mSocketFunc, *mCompression, transportFlags);
+         addTransport(std::auto_ptr<Transport>(sharing));
+         addReusePortTransport(sharing);
+      }
+      catch (BaseException& e)
+      {
+         ErrLog(<< "Failed to create SO_REUSEPORT transport " << i + 1 << " of " << reusePortFanout
+                << " for " << (version == V4 ? "V4" : "V6") << " UDP " << transport->port()
+                << ": " << e << "; continuing with " << i);
+         break;
+      }
+   }
    return transport;
 }
 
@@ -497,14 +587,19 @@ SipStack::addTransport(std::auto_ptr<Transport> transport)
                transport->ipVersion(), transport->transport(),
                Data::Empty, // target domain
                transport->netNs());
+   // True for a second or later transport serving the same port through
+   // SO_REUSEPORT; the aliases were added with the first one
+   bool sharesPort = false;
    if(!isSecure(transport->transport()))
    {
-      if(mNonSecureTransports.count(tuple) == 0)
+      NonSecureTransportMap::const_iterator existing = mNonSecureTransports.find(tuple);
+      sharesPort = existing != mNonSecureTransports.end() && transport->sharesPortWith(*existing->second);
+      if(existing == mNonSecureTransports.end() || sharesPort)
       {
          // All is good - assign key to transport then add to mNonSecureTransports list
          transport->setKey(mNextTransportKey++);
          tuple.mTransportKey = transport->getKey();
-         mNonSecureTransports[tuple] = transport.get();
+         mNonSecureTransports.insert(NonSecureTransportMap::value_type(tuple, transport.get()));
       }
       else
       {
@@ -534,25 +629,28 @@ SipStack::addTransport(std::auto_ptr<Transport> transport)
       }
    }
 
-   if (!transport->interfaceName().empty())
+   if (!sharesPort)
    {
-      addAlias(transport->interfaceName(), transport->port());
-   }
-   else
-   {
-      // Using INADDR_ANY, get all IP interfaces
-      std::list<std::pair<Data, Data> > ipIfs(DnsUtil::getInterfaces());
-      if(transport->ipVersion()==V4)
+      if (!transport->interfaceName().empty())
       {
-         ipIfs.push_back(std::make_pair<Data,Data>("lo0","127.0.0.1"));
+         addAlias(transport->interfaceName(), transport->port());
       }
-      while(!ipIfs.empty())
+      else
       {
-         if(DnsUtil::isIpV4Address(ipIfs.back().second) == (transport->ipVersion()==V4))
+         // Using INADDR_ANY, get all IP interfaces
+         std::list<std::pair<Data, Data> > ipIfs(DnsUtil::getInterfaces());
+         if(transport->ipVersion()==V4)
          {
-            addAlias(ipIfs.back().second, transport->port());
+            ipIfs.push_back(std::make_pair<Data,Data>("lo0","127.0.0.1"));
+         }
+         while(!ipIfs.empty())
+         {
+            if(DnsUtil::isIpV4Address(ipIfs.back().second) == (transport->ipVersion()==V4))
+            {
+               addAlias(ipIfs.back().second, transport->port());
+            }
+            ipIfs.pop_back();
          }
-         ipIfs.pop_back();
       }
    }
    { 
@@ -584,6 +682,27 @@ SipStack::addTransport(std::auto_ptr<Transport> transport)
    }
 }
 
+void
+SipStack::addReusePortTransport(Transport* transport)
+{
+   ReusePortTransport& entry = mReusePortTransports[transport->getKey()];
+   entry.first = transport;
+   entry.second = 0;
+   if(mInternalThreadsRunning)
+   {
+      startReusePortThread(entry);
+   }
+}
+
+void
+SipStack::startReusePortThread(ReusePortTransport& entry)
+{
+   // a thread that has been shut down can't be run again
+   delete entry.second;
+   entry.second = new TransportThread(*entry.first);
+   entry.second->run();
+}
+
 void 
 SipStack::removeTransport(unsigned int transportKey)
 {
@@ -629,6 +748,11 @@ SipStack::removeTransport(unsigned int transportKey)
       mUri.host().clear();
       mUri.port() = 0;
    }
+   else if(mNonSecureTransports.count(removeTuple) != 0)
+   {
+      // another transport still serves this port through SO_REUSEPORT,
+      // leave the aliases in place
+   }
    else if(!transportToRemove->interfaceName().empty())
    {
       removeAlias(transportToRemove->interfaceName(), transportToRemove->port());
@@ -668,6 +792,18 @@ SipStack::removeTransport(unsigned int transportKey)
       }
    }
 
+   ReusePortTransportMap::iterator itT = mReusePortTransports.find(transportKey);
+   if(itT != mReusePortTransports.end())
+   {
+      if(itT->second.second)
+      {
+         itT->second.second->shutdown();
+         itT->second.second->join();
+         delete itT->second.second;
+      }
+      mReusePortTransports.erase(itT);
+   }
+
    if(mProcessingHasStarted)
    {
        // Stack is running.  Need to queue remove request for TransactionController Thread
@@ -1066,7 +1202,12 @@ SipStack::processTimers()
 {
    if(!mTransactionControllerThread)
    {
-      mTransactionController->process();
+      // Without internal threads, every shard gets its cycles from here; the
+      // primary (shard 0) goes first so work it routes is picked up at once.
+      for(unsigned int i = 0; i < mTransactionController->getNumShards(); ++i)
+      {
+         mTransactionController->getShard(i).process();
+      }
    }
 
    if(!mDnsThread)
@@ -1112,8 +1253,14 @@ SipStack::getTimeTillNextProcessMS()
 
    unsigned int dnsNextProcess = (mDnsThread ? 
                            INT_MAX : mDnsStub->getTimeTillNextProcessMS());
-   unsigned int tcNextProcess = mTransactionControllerThread ? INT_MAX : 
-                           mTransactionController->getTimeTillNextProcessMS();
+   unsigned int tcNextProcess = INT_MAX;
+   if(!mTransactionControllerThread)
+   {
+      for(unsigned int i = 0; i < mTransactionController->getNumShards(); ++i)
+      {
+         tcNextProcess = resipMin(tcNextProcess, mTransactionController->getShard(i).getTimeTillNextProcessMS());
+      }
+   }
    unsigned int tsNextProcess = mTransportSelectorThread ? INT_MAX : mTransactionController->transportSelector().getTimeTillNextProcessMS();
 
    return resipMin(Timer::getMaxSystemTimeWaitMs(),
@@ -44,6 +44,7 @@ class Tuple;
 class Uri;
 class TransactionControllerThread;
 class TransportSelectorThread;
+class TransportThread;
 class TransactionUser;
 class AsyncProcessHandler;
 class Compression;
@@ -101,6 +102,16 @@ class FdPollGrp;
            Set to true to enable Whitelisting of DNS entries.  A feature
            that usually desired by UA's that want to stick to a known
            good server / dns result.
+
+        mTransactionControllerShards
+           Number of transaction controller shards.  Default 1.  With more
+           than one, transactions are spread over that many independent
+           state machines (fifo, transaction maps and timer queue each),
+           selected by a hash of the transaction id.  With the internal
+           threads started by SipStack::run(), each extra shard runs on a
+           thread of its own.  Otherwise processTimers() processes every
+           shard in turn on the caller's thread, which keeps the
+           transactions apart but doesn't add any parallelism.
 **/
 class SipStackOptions
 {
@@ -109,7 +120,7 @@ class SipStackOptions
          : mSecurity(0), mExtraNameserverList(0),
            mAsyncProcessHandler(0), mStateless(false),
            mSocketFunc(0), mCompression(0), mPollGrp(0),
-           mUseDnsVip(false)
+           mUseDnsVip(false), mTransactionControllerShards(1)
       {
       }
 
@@ -121,6 +132,7 @@ class SipStackOptions
       Compression *mCompression;
       FdPollGrp* mPollGrp;
       bool mUseDnsVip;
+      unsigned int mTransactionControllerShards;
 };
 
 
@@ -351,6 +363,20 @@ class SipStack : public FdSetIOObserver
          @param netNs                 Set the network namespace (netns) in which the Transport is
                                       to bind the the given address and port.
 
+         @param reusePortFanout       UDP only: open this many sockets on the same address and
+                                      port with SO_REUSEPORT, each served by its own UdpTransport
+                                      and TransportThread, so the kernel spreads incoming traffic
+                                      over that many threads. All of them feed the same
+                                      TransactionController. Implies RESIP_TRANSPORT_FLAG_REUSEPORT
+                                      and RESIP_TRANSPORT_FLAG_OWNTHREAD when greater than 1.
+                                      The stack owns all of these threads, including the one
+                                      for the transport returned, and starts them from run()
+                                      (right away if run() has already been called); do not
+                                      run a TransportThread of your own for any of them.
+                                      Fan-out therefore needs a stack driven by run(). The
+                                      first transport is returned; it is also the one picked
+                                      for outbound requests.
+
       */
       Transport* addTransport(TransportType protocol,
                               int port,
@@ -366,7 +392,8 @@ class SipStack : public FdSetIOObserver
                               bool useEmailAsSIP = false,
                               SharedPtr<WsConnectionValidator> = SharedPtr<WsConnectionValidator>(),
                               SharedPtr<WsCookieContextFactory> = SharedPtr<WsCookieContextFactory>(),
-                              const Data& netns = Data::Empty
+                              const Data& netns = Data::Empty,
+                              unsigned int reusePortFanout = 1
                              );
 
       /**
@@ -963,7 +990,7 @@ class SipStack : public FdSetIOObserver
       */
       void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
-         mTransactionController->mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         mTransactionController->setFixBadDialogIdentifiers(pFixBadDialogIdentifiers);
       }
 
       inline bool getFixBadCSeqNumbers() const
@@ -1156,7 +1183,16 @@ class SipStack : public FdSetIOObserver
       TransactionController* mTransactionController;
 
       TransactionControllerThread* mTransactionControllerThread;
+      // threads for TransactionController shards 1..n-1
+      std::vector<TransactionControllerThread*> mTransactionShardThreads;
       TransportSelectorThread* mTransportSelectorThread;
+      /// the transports of a SO_REUSEPORT fan-out, by transport key, with
+      /// the thread serving each; the thread is 0 until run() starts it
+      typedef std::pair<Transport*, TransportThread*> ReusePortTransport;
+      typedef std::map<unsigned int, ReusePortTransport> ReusePortTransportMap;
+      ReusePortTransportMap mReusePortTransports;
+      void addReusePortTransport(Transport* transport);
+      void startReusePortThread(ReusePortTransport& entry);
       bool mInternalThreadsRunning;
       bool mProcessingHasStarted; 
 
@@ -1177,7 +1213,9 @@ class SipStack : public FdSetIOObserver
       // TransportSelector if add will be valid and introduce locking
       // Note:  We could add a Mutex here and add thread safe accesor methods to transport pointers 
       //        as a convience to API users
-      typedef std::map<Tuple, Transport*> NonSecureTransportMap;
+      /// a multimap, since transports using RESIP_TRANSPORT_FLAG_REUSEPORT
+      /// can share a tuple
+      typedef std::multimap<Tuple, Transport*> NonSecureTransportMap;
       NonSecureTransportMap mNonSecureTransports;
       typedef std::map<TransportSelector::TlsTransportKey, Transport*> SecureTransportMap;
       SecureTransportMap mSecureTransports;
@@ -3,10 +3,14 @@
 #endif
 
 #include "rutil/Logger.hxx"
+#include "rutil/Lock.hxx"
 #include "resip/stack/StatisticsManager.hxx"
 #include "resip/stack/SipMessage.hxx"
 #include "resip/stack/TransactionController.hxx"
 #include "resip/stack/SipStack.hxx"
+#ifdef USE_SSL
+#include "resip/stack/ssl/Security.hxx"
+#endif
 
 using namespace resip;
 using std::vector;
@@ -19,13 +23,26 @@ StatisticsManager::StatisticsManager(SipStack& stack, unsigned long intervalSecs
      mInterval(intervalSecs*1000),
      mNextPoll(Timer::getTimeMs() + mInterval),
      mExternalHandler(NULL),
-     mPublicPayload(NULL)
+     mPublicPayload(NULL),
+     mMergedPayload(NULL)
 {}
 
 StatisticsManager::~StatisticsManager()
 {
    if ( mPublicPayload )
        delete mPublicPayload;
+   delete mMergedPayload;
+   for(std::vector<ShardCounts*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      delete *i;
+   }
+}
+
+StatisticsManager::ShardCounts*
+StatisticsManager::addShard()
+{
+   mShards.push_back(new ShardCounts);
+   return mShards.back();
 }
 
 void 
@@ -44,6 +61,25 @@ StatisticsManager::poll()
    activeTimers = mStack.mTransactionController->getTimerQueueSize();
    activeClientTransactions = mStack.mTransactionController->getNumClientTransactions();
    activeServerTransactions = mStack.mTransactionController->getNumServerTransactions();
+   mStack.mTransactionController->sumTransportBatchStats(transportRxBatches,
+                                                         transportRxBatchedMsgs,
+                                                         transportTxBatches,
+                                                         transportTxBatchedMsgs);
+   const RRCache::Stats& dnsStats = mStack.mDnsStub->getDnsCacheStats();
+   dnsCacheHits = dnsStats.hits;
+   dnsCacheNegativeHits = dnsStats.negativeHits;
+   dnsCacheMisses = dnsStats.misses;
+   dnsCachePrefetches = dnsStats.prefetches;
+#ifdef USE_SSL
+   if(mStack.mSecurity)
+   {
+      BaseSecurity::TlsSessionStats tlsStats = mStack.mSecurity->getTlsSessionStats();
+      tlsServerHandshakes = (unsigned int)tlsStats.mServerHandshakes;
+      tlsServerResumed = (unsigned int)tlsStats.mServerResumed;
+      tlsClientHandshakes = (unsigned int)tlsStats.mClientHandshakes;
+      tlsClientResumed = (unsigned int)tlsStats.mClientResumed;
+   }
+#endif
 
    // .kw. At last check payload was > 146kB, which seems too large
    // to alloc on stack. Also, the post'd message has reference
@@ -54,7 +90,24 @@ StatisticsManager::poll()
        mPublicPayload = new StatisticsMessage::AtomicPayload;
        // re-used each time, free'd in destructor
    }
-   mPublicPayload->loadIn(*this);
+   if(mShards.empty())
+   {
+      mPublicPayload->loadIn(*this);
+   }
+   else
+   {
+      if(mMergedPayload==NULL)
+      {
+         mMergedPayload = new StatisticsMessage::Payload;
+      }
+      *mMergedPayload = *this;
+      for(std::vector<ShardCounts*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+      {
+         Lock lock((*i)->mMutex);
+         addCounts(*mMergedPayload, (*i)->mCounts);
+      }
+      mPublicPayload->loadIn(*mMergedPayload);
+   }
 
    bool postToStack = true;
    StatisticsMessage msg(*mPublicPayload);
@@ -91,14 +144,73 @@ StatisticsManager::process()
 }
 
 bool
-StatisticsManager::sent(SipMessage* msg)
+StatisticsManager::sent(SipMessage* msg, ShardCounts* shard)
+{
+   if(shard)
+   {
+      Lock lock(shard->mMutex);
+      countSent(shard->mCounts, msg);
+   }
+   else
+   {
+      countSent(*this, msg);
+   }
+   return false;
+}
+
+bool 
+StatisticsManager::retransmitted(MethodTypes met, 
+                                 bool request, 
+                                 unsigned int code,
+                                 ShardCounts* shard)
+{
+   if(shard)
+   {
+      Lock lock(shard->mMutex);
+      countRetransmitted(shard->mCounts, met, request, code);
+   }
+   else
+   {
+      countRetransmitted(*this, met, request, code);
+   }
+   return false;
+}
+
+bool
+StatisticsManager::received(SipMessage* msg, ShardCounts* shard)
+{
+   if(shard)
+   {
+      Lock lock(shard->mMutex);
+      countReceived(shard->mCounts, msg);
+   }
+   else
+   {
+      countReceived(*this, msg);
+   }
+   return false;
+}
+
+void
+StatisticsManager::zeroOut()
+{
+   StatisticsMessage::Payload::zeroOut();
+   for(std::vector<ShardCounts*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      Lock lock((*i)->mMutex);
+      (*i)->mCounts.zeroOut();
+   }
+}
+
+void
+StatisticsManager::countSent(StatisticsMessage::Payload& counts, SipMessage* msg)
 {
    MethodTypes met = msg->method();
 
    if (msg->isRequest())
    {
-      ++requestsSent;
-      ++requestsSentByMethod[met];
+      ++counts.requestsSent;
+      ++counts.requestsSentByMethod[met];
    }
    else if (msg->isResponse())
    {
@@ -108,56 +220,83 @@ StatisticsManager::sent(SipMessage* msg)
          code = 0;
       }
 
-      ++responsesSent;
-      ++responsesSentByMethod[met];
-      ++responsesSentByMethodByCode[met][code];
+      ++counts.responsesSent;
+      ++counts.responsesSentByMethod[met];
+      ++counts.responsesSentByMethodByCode[met][code];
    }
-   
-   return false;
 }
 
-bool 
-StatisticsManager::retransmitted(MethodTypes met, 
-                                 bool request, 
-                                 unsigned int code)
+void
+StatisticsManager::countRetransmitted(StatisticsMessage::Payload& counts,
+                                      MethodTypes met, 
+                                      bool request, 
+                                      unsigned int code)
 {
    if(request)
    {
-      ++requestsRetransmitted;
-      ++requestsRetransmittedByMethod[met];
+      ++counts.requestsRetransmitted;
+      ++counts.requestsRetransmittedByMethod[met];
    }
    else
    {
-      ++responsesRetransmitted;
-      ++responsesRetransmittedByMethod[met];
-      ++responsesRetransmittedByMethodByCode[met][code];
+      ++counts.responsesRetransmitted;
+      ++counts.responsesRetransmittedByMethod[met];
+      ++counts.responsesRetransmittedByMethodByCode[met][code];
    }
-   return false;
 }
 
-bool
-StatisticsManager::received(SipMessage* msg)
+void
+StatisticsManager::countReceived(StatisticsMessage::Payload& counts, SipMessage* msg)
 {
    MethodTypes met = msg->header(h_CSeq).method();
 
    if (msg->isRequest())
    {
-      ++requestsReceived;
-      ++requestsReceivedByMethod[met];
+      ++counts.requestsReceived;
+      ++counts.requestsReceivedByMethod[met];
    }
    else if (msg->isResponse())
    {
-      ++responsesReceived;
-      ++responsesReceivedByMethod[met];
+      ++counts.responsesReceived;
+      ++counts.responsesReceivedByMethod[met];
       int code = msg->const_header(h_StatusLine).statusCode();
       if (code < 0 || code >= MaxCode)
       {
          code = 0;
       }
-      ++responsesReceivedByMethodByCode[met][code];
+      ++counts.responsesReceivedByMethodByCode[met][code];
    }
+}
 
-   return false;
+void
+StatisticsManager::addCounts(StatisticsMessage::Payload& to, const StatisticsMessage::Payload& from)
+{
+   to.requestsSent += from.requestsSent;
+   to.responsesSent += from.responsesSent;
+   to.requestsRetransmitted += from.requestsRetransmitted;
+   to.responsesRetransmitted += from.responsesRetransmitted;
+   to.requestsReceived += from.requestsReceived;
+   to.responsesReceived += from.responsesReceived;
+
+   for (int c = 0; c < MaxCode; ++c)
+   {
+      to.responsesByCode[c] += from.responsesByCode[c];
+   }
+   for (int m = 0; m < MAX_METHODS; ++m)
+   {
+      to.requestsSentByMethod[m] += from.requestsSentByMethod[m];
+      to.requestsRetransmittedByMethod[m] += from.requestsRetransmittedByMethod[m];
+      to.requestsReceivedByMethod[m] += from.requestsReceivedByMethod[m];
+      to.responsesSentByMethod[m] += from.responsesSentByMethod[m];
+      to.responsesRetransmittedByMethod[m] += from.responsesRetransmittedByMethod[m];
+      to.responsesReceivedByMethod[m] += from.responsesReceivedByMethod[m];
+      for (int c = 0; c < MaxCode; ++c)
+      {
+         to.responsesSentByMethodByCode[m][c] += from.responsesSentByMethodByCode[m][c];
+         to.responsesRetransmittedByMethodByCode[m][c] += from.responsesRetransmittedByMethodByCode[m][c];
+         to.responsesReceivedByMethodByCode[m][c] += from.responsesReceivedByMethodByCode[m][c];
+      }
+   }
 }
 
 /* ====================================================================
@@ -1,8 +1,11 @@
 #ifndef RESIP_StatisticsManager_hxx
 #define RESIP_StatisticsManager_hxx
 
+#include <vector>
+
 #include "rutil/Timer.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/StatisticsMessage.hxx"
 #include "resip/stack/StatisticsHandler.hxx"
 
@@ -52,11 +55,34 @@ class StatisticsManager : public StatisticsMessage::Payload
 
    private:
       friend class TransactionState;
-      bool sent(SipMessage* msg);
-      bool retransmitted(MethodTypes type, bool request, unsigned int code);
-      bool received(SipMessage* msg);
+      friend class TransactionController;
+
+      /**
+         What one TransactionController shard has counted.  Only the shard's
+         thread counts into it, so shards don't race on our counters; poll()
+         and zeroOut() take mMutex to add it in or clear it.
+      */
+      class ShardCounts
+      {
+         public:
+            StatisticsMessage::Payload mCounts;
+            Mutex mMutex;
+      };
+      /// counters for a new shard; owned by the StatisticsManager
+      ShardCounts* addShard();
+
+      // shard is 0 for the primary TransactionController, which counts
+      // straight into this
+      bool sent(SipMessage* msg, ShardCounts* shard);
+      bool retransmitted(MethodTypes type, bool request, unsigned int code, ShardCounts* shard);
+      bool received(SipMessage* msg, ShardCounts* shard);
+      static void countSent(StatisticsMessage::Payload& counts, SipMessage* msg);
+      static void countRetransmitted(StatisticsMessage::Payload& counts, MethodTypes type, bool request, unsigned int code);
+      static void countReceived(StatisticsMessage::Payload& counts, SipMessage* msg);
+      static void addCounts(StatisticsMessage::Payload& to, const StatisticsMessage::Payload& from);
 
       void poll(); // force an update
+      void zeroOut();
 
       SipStack& mStack;
       UInt64 mInterval;
@@ -69,6 +95,10 @@ class StatisticsManager : public StatisticsMessage::Payload
       // published thru both ExternalHandler and posted to stack as message.
       // This payload is mutex protected.
       StatisticsMessage::AtomicPayload *mPublicPayload;
+
+      std::vector<ShardCounts*> mShards;
+      // what poll() publishes when there are shards: ours plus theirs
+      StatisticsMessage::Payload *mMergedPayload;
 };
 
 }
@@ -121,6 +121,18 @@ StatisticsMessage::Payload::zeroOut()
    activeClientTransactions = 0;
    activeServerTransactions = 0;
    pendingDnsQueries = 0;
+   transportRxBatches = 0;
+   transportRxBatchedMsgs = 0;
+   transportTxBatches = 0;
+   transportTxBatchedMsgs = 0;
+   dnsCacheHits = 0;
+   dnsCacheNegativeHits = 0;
+   dnsCacheMisses = 0;
+   dnsCachePrefetches = 0;
+   tlsServerHandshakes = 0;
+   tlsServerResumed = 0;
+   tlsClientHandshakes = 0;
+   tlsClientResumed = 0;
    requestsSent = 0;
    responsesSent = 0;
    requestsRetransmitted = 0;
@@ -154,6 +166,21 @@ StatisticsMessage::Payload::operator=(const StatisticsMessage::Payload& rhs)
       activeServerTransactions = rhs.activeServerTransactions;
       pendingDnsQueries = rhs.pendingDnsQueries;
 
+      transportRxBatches = rhs.transportRxBatches;
+      transportRxBatchedMsgs = rhs.transportRxBatchedMsgs;
+      transportTxBatches = rhs.transportTxBatches;
+      transportTxBatchedMsgs = rhs.transportTxBatchedMsgs;
+
+      dnsCacheHits = rhs.dnsCacheHits;
+      dnsCacheNegativeHits = rhs.dnsCacheNegativeHits;
+      dnsCacheMisses = rhs.dnsCacheMisses;
+      dnsCachePrefetches = rhs.dnsCachePrefetches;
+
+      tlsServerHandshakes = rhs.tlsServerHandshakes;
+      tlsServerResumed = rhs.tlsServerResumed;
+      tlsClientHandshakes = rhs.tlsClientHandshakes;
+      tlsClientResumed = rhs.tlsClientResumed;
+
       requestsSent = rhs.requestsSent;
       responsesSent = rhs.responsesSent;
       requestsRetransmitted = rhs.requestsRetransmitted;
@@ -221,6 +248,18 @@ resip::operator<<(EncodeStream& strm, const StatisticsMessage::Payload& stats)
         << " SERVERTX " << stats.activeServerTransactions
         << " TIMERS " << stats.activeTimers
         << std::endl
+        << "Transport batches: rx " << stats.transportRxBatches << "/" << stats.transportRxBatchedMsgs
+        << " tx " << stats.transportTxBatches << "/" << stats.transportTxBatchedMsgs
+        << std::endl
+        << "DNS cache: hit " << stats.dnsCacheHits
+        << " (negative " << stats.dnsCacheNegativeHits << ")"
+        << " miss " << stats.dnsCacheMisses
+        << " prefetch " << stats.dnsCachePrefetches
+        << std::endl
+        << "TLS sessions: server " << stats.tlsServerResumed << "/" << stats.tlsServerHandshakes
+        << " client " << stats.tlsClientResumed << "/" << stats.tlsClientHandshakes
+        << " resumed"
+        << std::endl
         << "Transaction summary: reqi " << stats.requestsReceived
         << " reqo " << stats.requestsSent
         << " rspi " << stats.responsesReceived
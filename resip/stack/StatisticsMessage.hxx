@@ -36,6 +36,25 @@ class StatisticsMessage : public ApplicationMessage
             unsigned int activeServerTransactions;
             unsigned int pendingDnsQueries; // .dlb. not implemented
 
+            // batched datagram I/O (RESIP_TRANSPORT_FLAG_MMSG), summed
+            // over all transports
+            unsigned int transportRxBatches;
+            unsigned int transportRxBatchedMsgs;
+            unsigned int transportTxBatches;
+            unsigned int transportTxBatchedMsgs;
+
+            // DNS cache, counted by the DnsStub since startup
+            unsigned int dnsCacheHits; // includes dnsCacheNegativeHits
+            unsigned int dnsCacheNegativeHits;
+            unsigned int dnsCacheMisses;
+            unsigned int dnsCachePrefetches;
+
+            // TLS handshakes completed since startup (USE_SSL only)
+            unsigned int tlsServerHandshakes; // includes tlsServerResumed
+            unsigned int tlsServerResumed;
+            unsigned int tlsClientHandshakes; // includes tlsClientResumed
+            unsigned int tlsClientResumed;
+
             unsigned int requestsSent; // includes retransmissions
             unsigned int responsesSent; // includes retransmissions
             unsigned int requestsRetransmitted; // counts each retransmission
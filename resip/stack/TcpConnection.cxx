@@ -7,6 +7,10 @@
 #include "resip/stack/TcpConnection.hxx"
 #include "resip/stack/Tuple.hxx"
 
+#if !defined(WIN32)
+#include <sys/uio.h>
+#endif
+
 using namespace resip;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
@@ -108,6 +112,55 @@ TcpConnection::write( const char* buf, const int count )
    return bytesWritten;
 }
 
+bool
+TcpConnection::supportsGatherWrite() const
+{
+#if defined(WIN32)
+   return false;
+#else
+   return true;
+#endif
+}
+
+int
+TcpConnection::writeGather(const WriteBuffer* buffers, int count)
+{
+#if defined(WIN32)
+   resip_assert(0);
+   return -1;
+#else
+   resip_assert(buffers);
+   resip_assert(count > 0);
+
+   struct iovec iov[32];
+   if (count > int(sizeof(iov) / sizeof(iov[0])))
+   {
+      count = int(sizeof(iov) / sizeof(iov[0]));
+   }
+   for (int i = 0; i < count; ++i)
+   {
+      iov[i].iov_base = const_cast<char*>(buffers[i].mData);
+      iov[i].iov_len = buffers[i].mSize;
+   }
+
+   int bytesWritten = int(::writev(getSocket(), iov, count));
+
+   if (bytesWritten == INVALID_SOCKET)
+   {
+      int e = getErrno();
+      if (e == EAGAIN || e == EWOULDBLOCK)
+      {
+          return 0;
+      }
+      InfoLog (<< "Failed writev on " << getSocket() << " " << strerror(e));
+      Transport::error(e);
+      return -1;
+   }
+
+   return bytesWritten;
+#endif
+}
+
 bool 
 TcpConnection::hasDataToRead()
 {
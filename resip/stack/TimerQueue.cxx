@@ -33,52 +33,45 @@ DtlsTimerQueue::DtlsTimerQueue( Fifo<DtlsMessage>& fifo )
 
 DtlsTimerQueue::~DtlsTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   clear();
 }
 
 #endif
 
-UInt64
+TransactionTimerQueue::Handle
 TransactionTimerQueue::add(Timer::Type type, const Data& transactionId, unsigned long msOffset)
 {
-   TransactionTimer t(msOffset, type, transactionId);
-   mTimers.push(t);
    DebugLog (<< "Adding timer: " << Timer::toData(type) << " tid=" << transactionId << " ms=" << msOffset);
-   return mTimers.top().getWhen();
+   return addTimer(TransactionTimer(msOffset, type, transactionId));
 }
 
 #ifdef USE_DTLS
 
-UInt64
+DtlsTimerQueue::Handle
 DtlsTimerQueue::add( SSL *ssl, unsigned long msOffset )
 {
-   TimerWithPayload t( msOffset, new DtlsMessage( ssl ) ) ;
-   mTimers.push( t ) ;
-   return mTimers.top().getWhen();
+   return addTimer( TimerWithPayload( msOffset, new DtlsMessage( ssl ) ) ) ;
 }
 
 #endif
 
 BaseTimeLimitTimerQueue::~BaseTimeLimitTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   clear();
 }
 
-UInt64
+BaseTimeLimitTimerQueue::Handle
 BaseTimeLimitTimerQueue::add(unsigned int timeMs,Message* payload)
 {
    resip_assert(payload);
    DebugLog(<< "Adding application timer: " << payload->brief() << " ms=" << timeMs);
-   mTimers.push(TimerWithPayload(timeMs,payload));
-   return mTimers.top().getWhen();
+   return addTimer(TimerWithPayload(timeMs,payload));
+}
+
+void
+BaseTimeLimitTimerQueue::discardTimer(const TimerWithPayload& timer)
+{
+   delete timer.getMessage();
 }
 
 void
@@ -110,20 +103,21 @@ TuSelectorTimerQueue::TuSelectorTimerQueue(TuSelector& sel) : mFifoSelector(sel)
 
 TuSelectorTimerQueue::~TuSelectorTimerQueue()
 {
-   while(!mTimers.empty())
-   {
-      delete mTimers.top().getMessage();
-      mTimers.pop();
-   }
+   clear();
 }
 
-UInt64
+TuSelectorTimerQueue::Handle
 TuSelectorTimerQueue::add(unsigned int timeMs,Message* payload)
 {
    resip_assert(payload);
    DebugLog(<< "Adding application timer: " << payload->brief() << " ms=" << timeMs);
-   mTimers.push(TimerWithPayload(timeMs,payload));
-   return mTimers.top().getWhen();
+   return addTimer(TimerWithPayload(timeMs,payload));
+}
+
+void
+TuSelectorTimerQueue::discardTimer(const TimerWithPayload& timer)
+{
+   delete timer.getMessage();
 }
 
 void
@@ -141,6 +135,12 @@ DtlsTimerQueue::processTimer(const TimerWithPayload& timer)
    mFifo.add( (DtlsMessage *)timer.getMessage() ) ;
 }
 
+void
+DtlsTimerQueue::discardTimer(const TimerWithPayload& timer)
+{
+   delete timer.getMessage();
+}
+
 #endif
 
 /* ====================================================================
@@ -5,19 +5,13 @@
   #include "config.h"
 #endif
 
-#include <functional>
-#include <queue>
-#include <set>
 #include <iosfwd>
 #include "resip/stack/TimerMessage.hxx"
 #include "resip/stack/DtlsMessage.hxx"
 #include "rutil/Fifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "rutil/Timer.hxx"
-
-// .dlb. 
-// to do: timer wheel for transaction-bound timers and a heap for
-// everything longer.
+#include "rutil/TimerWheel.hxx"
 
 namespace resip
 {
@@ -32,26 +26,45 @@ class TuSelector;
   * When using this in the main loop, call process() on this.
   * During Transaction processing, TimerMessages and SIP messages are generated.
   * 
-    @todo .dlb. timer wheel for transaction-bound timers and a heap for 
-      everything longer.
+  * Timers are kept in a TimerWheel, so adding and cancelling are O(1) and
+  * process() fires everything that is due in one pass.
   */
 template <class T>
 class TimerQueue
 {
    public:
+      /// returned by add() in subclasses; pass to cancel()
+      typedef typename TimerWheel<T>::Handle Handle;
+
+      TimerQueue() : mTimers(Timer::getTimeMs()) {}
+
       // This is the logic that runs when a timer goes off. This is the only
       // thing subclasses must implement.
       virtual void processTimer(const T& timer)=0;
 
-      /// @brief deletes the message associated with the timer as well.
       virtual ~TimerQueue()
       {
-         //xkd-2004-11-4
-         // delete the message associated with the timer
-         while (!mTimers.empty())
+      }
+
+      /// @brief removes a timer that has not fired yet, as if it had never
+      /// been added (discardTimer() is called for it)
+      /// @retval false if the timer already fired or was cancelled before
+      bool cancel(Handle handle)
+      {
+         const T* timer = mTimers.find(handle);
+         if (!timer)
          {
-            mTimers.pop();
+            return false;
          }
+         discardTimer(*timer);
+         mTimers.cancel(handle);
+         return true;
+      }
+
+      /// @retval true if the timer has neither fired nor been cancelled
+      bool isPending(Handle handle) const
+      {
+         return mTimers.find(handle) != 0;
       }
 
       /// @brief provides the time in milliseconds before the next timer will fire
@@ -63,7 +76,7 @@ class TimerQueue
       {
          if (!mTimers.empty())
          {
-            UInt64 next = mTimers.top().getWhen();
+            UInt64 next = mTimers.nextExpiry();
             UInt64 now = Timer::getTimeMs();
             if (now > next) 
             {
@@ -95,16 +108,12 @@ class TimerQueue
       {
          if (!mTimers.empty())
          {
-            UInt64 now=Timer::getTimeMs();
-            while (!mTimers.empty() && !(mTimers.top().getWhen() > now))
-            {
-               processTimer(mTimers.top());
-               mTimers.pop();
-            }
+            Dispatcher dispatcher(*this);
+            mTimers.expire(Timer::getTimeMs(), dispatcher);
 
             if(!mTimers.empty())
             {
-               return mTimers.top().getWhen();
+               return mTimers.nextExpiry();
             }
          }
          return 0;
@@ -125,7 +134,7 @@ class TimerQueue
          if(mTimers.size() > 0)
          {
             return str << "TimerQueue[ size =" << mTimers.size() 
-                       << " top=" << mTimers.top() << "]" ;
+                       << " top=" << *mTimers.top() << "]" ;
          }
          else
          {
@@ -139,7 +148,7 @@ class TimerQueue
          if(mTimers.size() > 0)
          {
             return str << "TimerQueue[ size =" << mTimers.size() 
-                       << " top=" << mTimers.top() << "]" ;
+                       << " top=" << *mTimers.top() << "]" ;
          }
          else
          {
@@ -149,8 +158,43 @@ class TimerQueue
 #endif
 
    protected:
-      typedef std::vector<T, std::allocator<T> > TimerVector;
-      std::priority_queue<T, TimerVector, std::greater<T> > mTimers;
+      // Called for a timer that is dropped without firing, by cancel() and
+      // clear(). Subclasses that own a payload release it here.
+      virtual void discardTimer(const T& timer) {}
+
+      /// @brief drops all pending timers; subclasses that override
+      /// discardTimer() must call this from their destructor
+      void clear()
+      {
+         Discarder discarder(*this);
+         mTimers.clear(discarder);
+      }
+
+      Handle addTimer(const T& timer)
+      {
+         return mTimers.add(timer.getWhen(), timer);
+      }
+
+      TimerWheel<T> mTimers;
+
+   private:
+      class Dispatcher
+      {
+         public:
+            Dispatcher(TimerQueue& queue) : mQueue(queue) {}
+            void operator()(const T& timer) { mQueue.processTimer(timer); }
+         private:
+            TimerQueue& mQueue;
+      };
+
+      class Discarder
+      {
+         public:
+            Discarder(TimerQueue& queue) : mQueue(queue) {}
+            void operator()(const T& timer) { mQueue.discardTimer(timer); }
+         private:
+            TimerQueue& mQueue;
+      };
 };
 
 /**
@@ -160,10 +204,11 @@ class BaseTimeLimitTimerQueue : public TimerQueue<TimerWithPayload>
 {
    public:
       ~BaseTimeLimitTimerQueue();
-      UInt64 add(unsigned int timeMs,Message* payload);
+      Handle add(unsigned int timeMs,Message* payload);
       virtual void processTimer(const TimerWithPayload& timer);
    protected:
       virtual void addToFifo(Message*, TimeLimitFifo<Message>::DepthUsage)=0;      
+      virtual void discardTimer(const TimerWithPayload& timer);
 };
 
 
@@ -189,8 +234,10 @@ class TuSelectorTimerQueue : public TimerQueue<TimerWithPayload>
    public:
       TuSelectorTimerQueue(TuSelector& sel);
       ~TuSelectorTimerQueue();
-      UInt64 add(unsigned int timeMs,Message* payload);
+      Handle add(unsigned int timeMs,Message* payload);
       virtual void processTimer(const TimerWithPayload& timer);
+   protected:
+      virtual void discardTimer(const TimerWithPayload& timer);
    private:
       TuSelector& mFifoSelector;
 };
@@ -203,7 +250,7 @@ class TransactionTimerQueue : public TimerQueue<TransactionTimer>
 {
    public:
       TransactionTimerQueue(Fifo<TimerMessage>& fifo);
-      UInt64 add(Timer::Type type, const Data& transactionId, unsigned long msOffset);
+      Handle add(Timer::Type type, const Data& transactionId, unsigned long msOffset);
       virtual void processTimer(const TransactionTimer& timer);
    private:
       Fifo<TimerMessage>& mFifo;
@@ -221,9 +268,12 @@ class DtlsTimerQueue : public TimerQueue<TimerWithPayload>
    public:
       DtlsTimerQueue(Fifo<DtlsMessage>& fifo);
       ~DtlsTimerQueue();
-      UInt64 add(SSL *, unsigned long msOffset);
+      Handle add(SSL *, unsigned long msOffset);
       virtual void processTimer(const TimerWithPayload& timer) ;
       
+   protected:
+      virtual void discardTimer(const TimerWithPayload& timer);
+
    private:
       Fifo<DtlsMessage>& mFifo ;
 };
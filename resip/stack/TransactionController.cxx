@@ -11,6 +11,9 @@
 #include "resip/stack/TerminateFlow.hxx"
 #include "resip/stack/EnableFlowTimer.hxx"
 #include "resip/stack/InvokeAfterSocketCreationFunc.hxx"
+#include "resip/stack/KeepAliveMessage.hxx"
+#include "resip/stack/KeepAlivePong.hxx"
+#include "resip/stack/ConnectionTerminated.hxx"
 #include "resip/stack/ZeroOutStatistics.hxx"
 #include "resip/stack/PollStatistics.hxx"
 #include "resip/stack/ShutdownMessage.hxx"
@@ -39,7 +42,8 @@ unsigned int TransactionController::MaxTUFifoTimeDepthSecs = 0;
 
 TransactionController::TransactionController(SipStack& stack, 
                                              AsyncProcessHandler* handler,
-                                             bool useDnsVip) :
+                                             bool useDnsVip,
+                                             unsigned int numShards) :
    mStack(stack),
    mDiscardStrayResponses(true),
    mFixBadDialogIdentifiers(true),
@@ -48,17 +52,52 @@ TransactionController::TransactionController(SipStack& stack,
    mStateMacFifoOutBuffer(mStateMacFifo),
    mCongestionManager(0),
    mTuSelector(stack.mTuSelector),
-   mTransportSelector(mStateMacFifo,
-                      stack.getSecurity(),
-                      stack.getDnsStub(),
-                      stack.getCompression(),
-                      useDnsVip),
+   mOwnedTransportSelector(new TransportSelector(mStateMacFifo,
+                                                stack.getSecurity(),
+                                                stack.getDnsStub(),
+                                                stack.getCompression(),
+                                                useDnsVip)),
+   mTransportSelector(*mOwnedTransportSelector),
    mTimers(mTimerFifo),
    mShuttingDown(false),
    mStatsManager(stack.mStatsManager),
-   mHostname(DnsUtil::getLocalHostName())
+   mShardStats(0),
+   mHostname(DnsUtil::getLocalHostName()),
+   mPrimary(0)
 {
    mStateMacFifo.setDescription("TransactionController::mStateMacFifo");
+   // transports and the TU post here from their own threads
+   mStateMacFifo.enableLockFreeAdd(StateMacRingSize);
+   if(numShards > 1)
+   {
+      InfoLog(<< "Creating " << numShards << " transaction controller shards");
+      mTransportSelector.enableSharedAccess();
+      for(unsigned int i = 1; i < numShards; ++i)
+      {
+         mShards.push_back(new TransactionController(*this));
+      }
+   }
+}
+
+TransactionController::TransactionController(TransactionController& primary) :
+   mStack(primary.mStack),
+   mDiscardStrayResponses(primary.mDiscardStrayResponses),
+   mFixBadDialogIdentifiers(primary.mFixBadDialogIdentifiers),
+   mFixBadCSeqNumbers(primary.mFixBadCSeqNumbers),
+   mStateMacFifo(0),
+   mStateMacFifoOutBuffer(mStateMacFifo),
+   mCongestionManager(0),
+   mTuSelector(primary.mTuSelector),
+   mTransportSelector(primary.mTransportSelector),
+   mTimers(mTimerFifo),
+   mShuttingDown(false),
+   mStatsManager(primary.mStatsManager),
+   mShardStats(primary.mStatsManager.addShard()),
+   mHostname(primary.mHostname),
+   mPrimary(&primary)
+{
+   mStateMacFifo.setDescription("TransactionController::mStateMacFifo(shard)");
+   mStateMacFifo.enableLockFreeAdd(StateMacRingSize);
 }
 
 #if defined(WIN32) && !defined(__GNUC__)
@@ -76,6 +115,60 @@ TransactionController::~TransactionController()
    {
       WarningLog(<< "On shutdown, there are Server TransactionStates remaining!");
    }
+
+   for(std::vector<TransactionController*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      delete *i;
+   }
+}
+
+TransactionController&
+TransactionController::getShard(unsigned int index)
+{
+   resip_assert(index < getNumShards());
+   return index == 0 ? *this : *mShards[index-1];
+}
+
+TransactionController*
+TransactionController::selectShard(TransactionMessage* message)
+{
+   if(mShards.empty())
+   {
+      return this;
+   }
+
+   // Flow, transport and statistics control messages have no transaction id
+   // (some assert if asked for one) and operate on the TransportSelector or
+   // the StatisticsManager, so they stay on the primary.
+   if(dynamic_cast<KeepAliveMessage*>(message) ||
+      dynamic_cast<KeepAlivePong*>(message) ||
+      dynamic_cast<ConnectionTerminated*>(message) ||
+      dynamic_cast<ApplicationMessage*>(message))
+   {
+      return this;
+   }
+
+   // .bwc. Note that the "cancel" suffix used for CANCEL transactions is not
+   // part of this, so a CANCEL always lands on the same shard as the INVITE
+   // it refers to.
+   size_t hash;
+   try
+   {
+      const Data& tid = message->getTransactionId();
+      if(tid.empty())
+      {
+         return this;
+      }
+      hash = tid.hash();
+   }
+   catch(resip::BaseException&)
+   {
+      // TransactionState::process() will drop it
+      return this;
+   }
+
+   unsigned int index = (unsigned int)(hash % getNumShards());
+   return index == 0 ? this : mShards[index-1];
 }
 
 
@@ -92,6 +185,41 @@ TransactionController::shutdown()
    mTransportSelector.shutdown();
 }
 
+void
+TransactionController::setCongestionManager(CongestionManager* manager)
+{
+   if(isPrimary())
+   {
+      mTransportSelector.setCongestionManager(manager);
+   }
+   if(mCongestionManager)
+   {
+      mCongestionManager->unregisterFifo(&mStateMacFifo);
+   }
+   mCongestionManager=manager;
+   if(mCongestionManager)
+   {
+      mCongestionManager->registerFifo(&mStateMacFifo);
+   }
+   for(std::vector<TransactionController*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      (*i)->setCongestionManager(manager);
+   }
+}
+
+bool
+TransactionController::shardsIdle() const
+{
+   for(std::vector<TransactionController*>::const_iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      if((*i)->mStateMacFifo.messageAvailable())
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
 void
 TransactionController::process(int timeout)
 {
@@ -99,6 +227,7 @@ TransactionController::process(int timeout)
        //mTimers.empty() && 
        !mStateMacFifoOutBuffer.messageAvailable() && // !dcm! -- see below 
        !mStack.mTUFifo.messageAvailable() &&
+       shardsIdle() &&
        mTransportSelector.isFinished())
 // !dcm! -- why would one wait for the Tu's fifo to be empty before delivering a
 // shutdown message?
@@ -118,7 +247,7 @@ TransactionController::process(int timeout)
 
       // Check if Statistics Manager needs to be polled - note:  all statistic manager polls should happen from the 
       // TransactionController thread / process loop
-      if(mStack.mStatisticsManagerEnabled)
+      if(mStack.mStatisticsManagerEnabled && isPrimary())
       {
          mStatsManager.process();
       }
@@ -150,7 +279,15 @@ TransactionController::process(int timeout)
          int runs=16;
          while(message)
          {
-            TransactionState::process(*this, message);
+            TransactionController* shard = selectShard(message);
+            if(shard == this)
+            {
+               TransactionState::process(*this, message);
+            }
+            else
+            {
+               shard->mStateMacFifo.add(message);
+            }
             if(--runs==0)
             {
                break;
@@ -204,30 +341,57 @@ TransactionController::sumTransportFifoSizes() const
    return mTransportSelector.sumTransportFifoSizes();
 }
 
+void
+TransactionController::sumTransportBatchStats(unsigned int& rxBatches, unsigned int& rxBatchedMsgs,
+                                              unsigned int& txBatches, unsigned int& txBatchedMsgs) const
+{
+   mTransportSelector.sumTransportBatchStats(rxBatches, rxBatchedMsgs, txBatches, txBatchedMsgs);
+}
+
 unsigned int 
 TransactionController::getTransactionFifoSize() const
 {
    // Should we include the stuff in mStateMacFifoOutBuffer here too? This is
    // likely to be called from other threads...
-   return mStateMacFifo.size();
+   unsigned int size = mStateMacFifo.size();
+   for(std::vector<TransactionController*>::const_iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      size += (*i)->mStateMacFifo.size();
+   }
+   return size;
 }
 
 unsigned int 
 TransactionController::getNumClientTransactions() const
 {
-   return mClientTransactionMap.size();
+   unsigned int num = mClientTransactionMap.size();
+   for(std::vector<TransactionController*>::const_iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      num += (*i)->mClientTransactionMap.size();
+   }
+   return num;
 }
 
 unsigned int 
 TransactionController::getNumServerTransactions() const
 {
-   return mServerTransactionMap.size();
+   unsigned int num = mServerTransactionMap.size();
+   for(std::vector<TransactionController*>::const_iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      num += (*i)->mServerTransactionMap.size();
+   }
+   return num;
 }
 
 unsigned int 
 TransactionController::getTimerQueueSize() const
 {
-   return mTimers.size();
+   unsigned int size = mTimers.size();
+   for(std::vector<TransactionController*>::const_iterator i = mShards.begin(); i != mShards.end(); ++i)
+   {
+      size += (*i)->mTimers.size();
+   }
+   return size;
 }
 
 void 
@@ -5,17 +5,19 @@
 #include "resip/stack/TransactionMap.hxx"
 #include "resip/stack/TransportSelector.hxx"
 #include "resip/stack/TimerQueue.hxx"
+#include "resip/stack/StatisticsManager.hxx"
 #include "rutil/CongestionManager.hxx"
 
 #include "rutil/ConsumerFifoBuffer.hxx"
 
+#include <vector>
+
 namespace resip
 {
 
 class TransactionMessage;
 class TimerMessage;
 class ApplicationMessage;
-class StatisticsManager;
 class SipStack;
 class Compression;
 class FdPollGrp;
@@ -27,7 +29,17 @@ class TransactionController
       static unsigned int MaxTUFifoSize;
       static unsigned int MaxTUFifoTimeDepthSecs;
 
-      TransactionController(SipStack& stack, AsyncProcessHandler* handler, bool useDnsVip);
+      /**
+         @param numShards If greater than 1, this controller becomes the
+            primary of numShards transaction shards. Each shard owns its own
+            state machine fifo, transaction maps and timer queue; the primary
+            routes every message to a shard by hashing its transaction id.
+            The extra shards must be given cycles too, by threads of their
+            own (SipStack::run()) or by the primary's caller (see
+            SipStack::processTimers()); the TransportSelector stays with the
+            primary.
+      */
+      TransactionController(SipStack& stack, AsyncProcessHandler* handler, bool useDnsVip, unsigned int numShards=1);
       ~TransactionController();
 
       void process(int timeout=0);
@@ -45,6 +57,8 @@ class TransactionController
 
       unsigned int getTuFifoSize() const;
       unsigned int sumTransportFifoSizes() const;
+      void sumTransportBatchStats(unsigned int& rxBatches, unsigned int& rxBatchedMsgs,
+                                  unsigned int& txBatches, unsigned int& txBatchedMsgs) const;
       unsigned int getTransactionFifoSize() const;
       unsigned int getNumClientTransactions() const;
       unsigned int getNumServerTransactions() const;
@@ -52,19 +66,7 @@ class TransactionController
       void zeroOutStatistics();
       void pollStatistics();
       
-      void setCongestionManager( CongestionManager *manager ) 
-      { 
-         mTransportSelector.setCongestionManager(manager);
-         if(mCongestionManager)
-         {
-            mCongestionManager->unregisterFifo(&mStateMacFifo);
-         }
-         mCongestionManager=manager;
-         if(mCongestionManager)
-         {
-            mCongestionManager->registerFifo(&mStateMacFifo);
-         }
-      }
+      void setCongestionManager( CongestionManager *manager );
 
       CongestionManager::RejectionBehavior getRejectionBehavior() const
       {
@@ -86,12 +88,20 @@ class TransactionController
       inline void setFixBadDialogIdentifiers(bool pFixBadDialogIdentifiers) 
       {
          mFixBadDialogIdentifiers = pFixBadDialogIdentifiers;
+         for(std::vector<TransactionController*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+         {
+            (*i)->setFixBadDialogIdentifiers(pFixBadDialogIdentifiers);
+         }
       }
 
       inline bool getFixBadCSeqNumbers() const { return mFixBadCSeqNumbers;} 
       inline void setFixBadCSeqNumbers(bool pFixBadCSeqNumbers)
       {
          mFixBadCSeqNumbers = pFixBadCSeqNumbers;
+         for(std::vector<TransactionController*>::iterator i = mShards.begin(); i != mShards.end(); ++i)
+         {
+            (*i)->setFixBadCSeqNumbers(pFixBadCSeqNumbers);
+         }
       }
 
       void abandonServerTransaction(const Data& tid);
@@ -105,9 +115,24 @@ class TransactionController
 
       void invokeAfterSocketCreationFunc(TransportType type);
 
+      /// total number of shards, including this (primary) controller
+      unsigned int getNumShards() const { return (unsigned int)mShards.size() + 1; }
+      /// shard 0 is this controller; shards 1..getNumShards()-1 must also
+      /// have process() called on them, from their own threads or in turn
+      TransactionController& getShard(unsigned int index);
+
    private:
       TransactionController(const TransactionController& rhs);
       TransactionController& operator=(const TransactionController& rhs);
+
+      // creates a secondary shard that shares everything but its fifo, maps
+      // and timers with primary
+      explicit TransactionController(TransactionController& primary);
+
+      TransactionController* selectShard(TransactionMessage* message);
+      bool shardsIdle() const;
+      bool isPrimary() const { return mPrimary == 0; }
+
       SipStack& mStack;
       
       // If true, indicate to the Transaction to ignore responses for which
@@ -123,6 +148,8 @@ class TransactionController
       // messages (requests and responses), timers (used by state machines),
       // asynchronous dns responses, transport errors from the underlying
       // transports, etc. 
+      // Producers add through a lock-free ring of this many entries.
+      static const unsigned int StateMacRingSize = 4096;
       Fifo<TransactionMessage> mStateMacFifo;
       ConsumerFifoBuffer<TransactionMessage> mStateMacFifoOutBuffer;
       CongestionManager* mCongestionManager;
@@ -139,22 +166,33 @@ class TransactionController
       // from the sipstack (for convenience)
       TuSelector& mTuSelector;
 
-      // Used to decide which transport to send a sip message on. 
-      TransportSelector mTransportSelector;
+      // Used to decide which transport to send a sip message on. Owned by the
+      // primary controller and shared with all shards.
+      std::auto_ptr<TransportSelector> mOwnedTransportSelector;
+      TransportSelector& mTransportSelector;
+
+      // timers associated with the transactions. When a timer fires, it is
+      // placed in the mStateMacFifo. Declared ahead of the transaction maps,
+      // since the TransactionStates they delete cancel their timers.
+      TransactionTimerQueue  mTimers;
 
       // stores all of the transactions that are currently active in this stack 
       TransactionMap mClientTransactionMap;
       TransactionMap mServerTransactionMap;
 
-      // timers associated with the transactions. When a timer fires, it is
-      // placed in the mStateMacFifo
-      TransactionTimerQueue  mTimers;
-
       bool mShuttingDown;
       
       StatisticsManager& mStatsManager;
+      // where a secondary shard counts; 0 on the primary, which counts
+      // straight into mStatsManager
+      StatisticsManager::ShardCounts* mShardStats;
       
       Data mHostname;
+
+      // 0 for the primary controller
+      TransactionController* mPrimary;
+      // secondary shards (primary only); the primary itself is shard 0
+      std::vector<TransactionController*> mShards;
       
       friend class SipStack; // for debug only
       friend class StatelessHandler;
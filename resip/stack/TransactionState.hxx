@@ -3,9 +3,11 @@
 
 #include <iosfwd>
 #include <memory>
+#include <vector>
 #include "rutil/dns/DnsHandler.hxx"
 #include "resip/stack/MethodTypes.hxx"
 #include "resip/stack/SipMessage.hxx"
+#include "resip/stack/TimerQueue.hxx"
 #include "resip/stack/Transport.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
 
@@ -120,6 +122,9 @@ class TransactionState : public DnsHandler
       void terminateServerTransaction(const Data& tid); 
       const Data& tid(SipMessage* sip) const;
 
+      // adds a timer for this transaction; ~TransactionState cancels it if
+      // it is still pending
+      void startTimer(Timer::Type type, unsigned long msOffset);
       void startServerNonInviteTimerTrying(SipMessage& sip, const Data& tid);
 
       static TransactionState* makeCancelTransaction(TransactionState* tran, Machine machine, const Data& tid);
@@ -193,6 +198,8 @@ class TransactionState : public DnsHandler
       TransportFailure::FailureReason mFailureReason;      
       int mFailureSubCode;
       bool mTcpConnectTimerStarted;
+      // the timers started by startTimer() that may not have fired yet
+      std::vector<TransactionTimerQueue::Handle> mPendingTimers;
 
       static UInt32 StatelessIdCounter;
       
@@ -398,6 +398,16 @@ Transport::stampReceived(SipMessage* message)
    StackLog (<< endl << endl << *message);
 }
 
+bool
+Transport::sharesPortWith(const Transport& other) const
+{
+   return (mTransportFlags & RESIP_TRANSPORT_FLAG_REUSEPORT) != 0 &&
+          (other.mTransportFlags & RESIP_TRANSPORT_FLAG_REUSEPORT) != 0 &&
+          transport() == other.transport() &&
+          mInterface == other.mInterface &&
+          mTuple == other.mTuple;
+}
+
 bool
 Transport::basicCheck(const SipMessage& msg)
 {
@@ -52,6 +52,20 @@ class FdPollGrp;
  *    Specifies whether this Transport object has its own thread (ie; if
  *    set, the TransportSelector should not run the select/poll loop for
  *    this transport, since that is another thread's job)
+ * MMSG:
+ *    Datagram transports drain the socket with recvmmsg() and flush the
+ *    transmit queue with sendmmsg(), moving a batch of datagrams per
+ *    system call. Receive buffers are kept in a ring for the lifetime of
+ *    the transport. Only has effect on platforms providing these calls
+ *    (Linux); elsewhere the flag is ignored, and a warning is logged when
+ *    the transport is created. Usually combined with RXALL and TXALL.
+ * REUSEPORT:
+ *    Sets SO_REUSEPORT on the socket before binding, so that several UDP
+ *    transports can listen on the same address and port and have the
+ *    kernel spread incoming datagrams across them. Transports that all
+ *    carry this flag may be added to one stack for the same tuple; see
+ *    the reusePortFanout argument of SipStack::addTransport(). Ignored,
+ *    with a warning logged, where the platform has no SO_REUSEPORT.
  */
 #define RESIP_TRANSPORT_FLAG_NOBIND      (1<<0)
 #define RESIP_TRANSPORT_FLAG_RXALL       (1<<1)
@@ -59,6 +73,8 @@ class FdPollGrp;
 #define RESIP_TRANSPORT_FLAG_KEEP_BUFFER (1<<3)
 #define RESIP_TRANSPORT_FLAG_TXNOW       (1<<4)
 #define RESIP_TRANSPORT_FLAG_OWNTHREAD   (1<<5)
+#define RESIP_TRANSPORT_FLAG_MMSG        (1<<6)
+#define RESIP_TRANSPORT_FLAG_REUSEPORT   (1<<7)
 
 /**
    @brief The base class for Transport classes.
@@ -79,6 +95,13 @@ class Transport : public FdSetIOObserver
       public:
           virtual ~SipMessageLoggingHandler(){}
           virtual void outboundMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg) = 0;
+          // Called for each outbound message with msg as it was encoded for the wire; the default
+          // just calls the outboundMessage() above.  Handlers that only need the bytes should
+          // override this one and save themselves encoding msg again.
+          virtual void outboundMessage(const Tuple &source, const Tuple &destination, const SipMessage &msg, const Data& encoded)
+          {
+             outboundMessage(source, destination, msg);
+          }
           // Note:  retranmissions store already encoded messages, so callback doesn't send SipMessage it sends
           //        the encoded version of the SipMessage instead.  If you need a SipMessage you will need to
           //        re-parse back into a SipMessage in the callback handler.
@@ -269,6 +292,15 @@ class Transport : public FdSetIOObserver
       /// @return net namespace in which Transport is bound
       const Data& netNs() const { return(mTuple.getNetNs()); }
 
+      unsigned getTransportFlags() const { return mTransportFlags; }
+
+      /**
+         @return true if this transport and other were both created with
+         RESIP_TRANSPORT_FLAG_REUSEPORT on the same tuple, and so serve
+         that port together.
+      */
+      bool sharesPortWith(const Transport& other) const;
+
       /**
          @return true here if the subclass has a specific contact
          value that it wishes the TransportSelector to use.
@@ -346,6 +378,11 @@ class Transport : public FdSetIOObserver
       //# queued messages on this transport
       virtual unsigned int getFifoSize() const=0;
 
+      // adds this transport's batched I/O counters (see
+      // RESIP_TRANSPORT_FLAG_MMSG) to the running totals passed in
+      virtual void addBatchStats(unsigned int& rxBatches, unsigned int& rxBatchedMsgs,
+                                 unsigned int& txBatches, unsigned int& txBatchedMsgs) const {}
+
       void callSocketFunc(Socket sock);
       virtual void invokeAfterSocketCreationFunc() const = 0;  //used to invoke the after socket creation func immeidately for all existing sockets - can be used to modify QOS settings at runtime
 
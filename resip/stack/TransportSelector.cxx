@@ -32,6 +32,7 @@
 #include "rutil/DataStream.hxx"
 #include "rutil/DnsUtil.hxx"
 #include "rutil/Inserter.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
 #include "rutil/Socket.hxx"
 #include "rutil/FdPoll.hxx"
@@ -163,9 +164,20 @@ TransportSelector::isFinished() const
    return true;
 }
 
+void
+TransportSelector::enableSharedAccess()
+{
+   if(!mTransportsMutex.get())
+   {
+      mTransportsMutex.reset(new RWMutex);
+      mSourceInterfaceMutex.reset(new Mutex);
+   }
+}
+
 void
 TransportSelector::addTransport(std::auto_ptr<Transport> autoTransport, bool isStackRunning)
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_WRITELOCK);
    Transport* transport = autoTransport.release();
 
    // !bwc! This is a multimap from TransportType/IpVersion to Transport*.
@@ -213,28 +225,27 @@ TransportSelector::addTransport(std::auto_ptr<Transport> autoTransport, bool isS
                transport->netNs());
    tuple.mTransportKey = transport->getKey();
 
+   // Set when another transport already serves this tuple through
+   // SO_REUSEPORT. Only the first one goes into the tuple maps, so outbound
+   // selection stays deterministic; the others are reached by transport key
+   // (responses go back out through the transport that received the request).
+   bool sharesPort = false;
+
    if(!isSecure(transport->transport()))
    {
-      if(mExactTransports.find(tuple) == mExactTransports.end() &&
-         mAnyInterfaceTransports.find(tuple) == mAnyInterfaceTransports.end())
+      ExactTupleMap::const_iterator exact = mExactTransports.find(tuple);
+      AnyInterfaceTupleMap::const_iterator any = mAnyInterfaceTransports.find(tuple);
+      if(exact == mExactTransports.end() &&
+         any == mAnyInterfaceTransports.end())
       {
          DebugLog (<< "Adding transport: " << tuple);
-
-         // Store the transport in the ANY interface maps if the tuple specifies ANY
-         // interface. Store the transport in the specific interface maps if the tuple
-         // specifies an interface. See TransportSelector::findTransport.
-         if (transport->interfaceName().empty() ||
-             transport->getTuple().isAnyInterface() ||
-             transport->hasSpecificContact() )
-         {
-            mAnyInterfaceTransports[tuple] = transport;
-            mAnyPortAnyInterfaceTransports[tuple] = transport;
-         }
-         else
-         {
-            mExactTransports[tuple] = transport;
-            mAnyPortTransports[tuple] = transport;
-         }
+         addToTupleMaps(tuple, transport);
+      }
+      else if((exact != mExactTransports.end() && transport->sharesPortWith(*exact->second)) ||
+              (any != mAnyInterfaceTransports.end() && transport->sharesPortWith(*any->second)))
+      {
+         DebugLog (<< "Adding transport sharing its port through SO_REUSEPORT: " << tuple);
+         sharesPort = true;
       }
       else
       {
@@ -286,7 +297,10 @@ TransportSelector::addTransport(std::auto_ptr<Transport> autoTransport, bool isS
       mHasOwnProcessTransports.back()->startOwnProcessing();
    }
 
-   mTypeToTransportMap.insert(TypeToTransportMap::value_type(tuple,transport));
+   if(!sharesPort)
+   {
+      mTypeToTransportMap.insert(TypeToTransportMap::value_type(tuple,transport));
+   }
    mDns.addTransportType(transport->transport(), transport->ipVersion());
    mTransports[transport->getKey()] = transport;
 
@@ -296,6 +310,7 @@ TransportSelector::addTransport(std::auto_ptr<Transport> autoTransport, bool isS
 void
 TransportSelector::removeTransport(unsigned int transportKey)
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_WRITELOCK);
    Transport* transportToRemove = 0;
 
    // Find transport in global map and remove it
@@ -316,9 +331,40 @@ TransportSelector::removeTransport(unsigned int transportKey)
 
       if(!isSecure(transportToRemove->transport()))
       {
-         // Ensure transport is removed from all containers
-         mExactTransports.erase(transportToRemove->getTuple());
-         mAnyInterfaceTransports.erase(transportToRemove->getTuple());
+         // Ensure transport is removed from all containers.  A transport
+         // sharing its port with others is only in these maps if it was the
+         // first one added; then a remaining one takes its place.
+         bool wasInTupleMaps = false;
+         ExactTupleMap::iterator exact = mExactTransports.find(transportToRemove->getTuple());
+         if(exact != mExactTransports.end() && exact->second == transportToRemove)
+         {
+            mExactTransports.erase(exact);
+            wasInTupleMaps = true;
+         }
+         AnyInterfaceTupleMap::iterator any = mAnyInterfaceTransports.find(transportToRemove->getTuple());
+         if(any != mAnyInterfaceTransports.end() && any->second == transportToRemove)
+         {
+            mAnyInterfaceTransports.erase(any);
+            wasInTupleMaps = true;
+         }
+         if(wasInTupleMaps)
+         {
+            for(TransportKeyMap::iterator it = mTransports.begin(); it != mTransports.end(); ++it)
+            {
+               if(it->second->sharesPortWith(*transportToRemove))
+               {
+                  Transport* sharing = it->second;
+                  Tuple tuple(sharing->interfaceName(), sharing->port(),
+                              sharing->ipVersion(), sharing->transport(),
+                              Data::Empty, // Domain
+                              sharing->netNs());
+                  tuple.mTransportKey = sharing->getKey();
+                  addToTupleMaps(tuple, sharing);
+                  mTypeToTransportMap.insert(TypeToTransportMap::value_type(tuple, sharing));
+                  break;
+               }
+            }
+         }
 
          // In the AnyPort maps 2 transports can end up overwriting each other in these maps - then when we remove one, there may be none left - even though we should have an
          // entry.  The rebuilt method will dig through all transports again and rebuild these maps.
@@ -371,6 +417,26 @@ TransportSelector::removeTransport(unsigned int transportKey)
    }
 }
 
+void
+TransportSelector::addToTupleMaps(const Tuple& tuple, Transport* transport)
+{
+   // Store the transport in the ANY interface maps if the tuple specifies ANY
+   // interface. Store the transport in the specific interface maps if the tuple
+   // specifies an interface. See TransportSelector::findTransport.
+   if (transport->interfaceName().empty() ||
+       transport->getTuple().isAnyInterface() ||
+       transport->hasSpecificContact() )
+   {
+      mAnyInterfaceTransports[tuple] = transport;
+      mAnyPortAnyInterfaceTransports[tuple] = transport;
+   }
+   else
+   {
+      mExactTransports[tuple] = transport;
+      mAnyPortTransports[tuple] = transport;
+   }
+}
+
 void
 TransportSelector::rebuildAnyPortTransportMaps()
 {
@@ -532,6 +598,7 @@ TransportSelector::checkTransportAddRemoveQueue()
 void 
 TransportSelector::poke()
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
    for(TransportList::iterator it = mHasOwnProcessTransports.begin(); it != mHasOwnProcessTransports.end(); it++)
    {
       try
@@ -570,6 +637,7 @@ TransportSelector::hasDataToSend() const
 DnsResult*
 TransportSelector::createDnsResult(DnsHandler* handler)
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
    return mDns.createDnsResult(handler);
 }
 
@@ -577,6 +645,9 @@ void
 TransportSelector::dnsResolve(DnsResult* result,
                               SipMessage* msg)
 {
+   // mDns's supported transport set is updated by addTransport()
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
+
    // Picking the target destination:
    //   - for request, use forced target if set
    //     otherwise use loose routing behaviour (route or, if none, request-uri)
@@ -787,6 +858,7 @@ TransportSelector::determineSourceInterface(SipMessage* msg, const Tuple& target
 
       // this process will determine which interface the kernel would use to
       // send a packet to the target by making a connect call on a udp socket.
+      PtrLock lock(mSourceInterfaceMutex.get());
       Socket tmp = INVALID_SOCKET;
       Data netNs = target.getNetNs();
       // One IPV4 and IPV6 socket per namespace.  Even if we do not support netns,
@@ -927,6 +999,7 @@ TransportSelector::TransmitState
 TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 {
    resip_assert(msg);
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
 
    if(msg->mIsDecorated)
    {
@@ -1305,18 +1378,13 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
          // Call back anyone who wants to perform outbound decoration
          msg->callOutboundDecorators(source, target,remoteSigcompId);
 
-         Transport::SipMessageLoggingHandler* handler = transport->getSipMessageLoggingHandler();
-         if(handler)
-         {
-            handler->outboundMessage(source, target, *msg);
-         }
-
          std::auto_ptr<SendData> send(new SendData(target,
                                                    resip::Data::Empty,
                                                    msg->getTransactionId(),
                                                    remoteSigcompId));
 
-         send->data.reserve(mAvgBufferSize + mAvgBufferSize/4);
+         int avgBufferSize = mAvgBufferSize;
+         send->data.reserve(avgBufferSize + avgBufferSize/4);
 
          DataStream str(send->data);
          msg->encode(str);
@@ -1325,7 +1393,13 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
          // !bwc! Moving average of message size. (Used to intelligently
          // predict how much space to reserve in the buffer, to minimize
          // dynamic resizing.)
-         mAvgBufferSize = (255*mAvgBufferSize + send->data.size()+128)/256;
+         mAvgBufferSize = (int)((255*avgBufferSize + send->data.size()+128)/256);
+
+         Transport::SipMessageLoggingHandler* handler = transport->getSipMessageLoggingHandler();
+         if(handler)
+         {
+            handler->outboundMessage(source, target, *msg, send->data);
+         }
 
          resip_assert(!send->data.empty());
          DebugLog (<< "Transmitting to " << target
@@ -1360,6 +1434,7 @@ TransportSelector::transmit(SipMessage* msg, Tuple& target, SendData* sendData)
 void
 TransportSelector::retransmit(const SendData& data)
 {
+   PtrLock lock(mTransportsMutex.get(), VOCAL_READLOCK);
    resip_assert(data.destination.mTransportKey);
    Transport* transport = findTransportByDest(data.destination);
 
@@ -1425,6 +1500,17 @@ TransportSelector::sumTransportFifoSizes() const
    return sum;
 }
 
+void
+TransportSelector::sumTransportBatchStats(unsigned int& rxBatches, unsigned int& rxBatchedMsgs,
+                                          unsigned int& txBatches, unsigned int& txBatchedMsgs) const
+{
+   rxBatches = rxBatchedMsgs = txBatches = txBatchedMsgs = 0;
+   for(TransportKeyMap::const_iterator it = mTransports.begin(); it != mTransports.end(); it++)
+   {
+      it->second->addBatchStats(rxBatches, rxBatchedMsgs, txBatches, txBatchedMsgs);
+   }
+}
+
 void 
 TransportSelector::terminateFlow(const resip::Tuple& flow)
 {
@@ -15,6 +15,8 @@
 #include "resip/stack/Transport.hxx"
 #include "resip/stack/DnsInterface.hxx"
 #include "rutil/SelectInterruptor.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/RWMutex.hxx"
 
 
 #include "resip/stack/SecurityTypes.hxx"
@@ -55,6 +57,9 @@ to provide cycles to the actual transports for sending data in their Fifo's and
 receiving data from the wire.  The mSharedProcessTransports list is one member that
 is expected to be accessed from TransportSelector processing loop only , all other 
 members are accessed from the TransactionController processing loop.
+When the TransactionController is sharded, several controller threads transmit
+concurrently; enableSharedAccess() then makes the transport maps and the
+source-interface lookup socket safe for that.
 */
 class TransportSelector
 {
@@ -122,6 +127,8 @@ class TransportSelector
       void closeConnection(const Tuple& peer);
 
       unsigned int sumTransportFifoSizes() const;
+      void sumTransportBatchStats(unsigned int& rxBatches, unsigned int& rxBatchedMsgs,
+                                  unsigned int& txBatches, unsigned int& txBatchedMsgs) const;
 
       unsigned int getTimeTillNextProcessMS();
       Fifo<TransactionMessage>& stateMacFifo() { return mStateMacFifo; }
@@ -155,6 +162,12 @@ class TransportSelector
 
       void invokeAfterSocketCreationFunc(TransportType type);
 
+      /**
+         Called once, before the stack is running, if more than one
+         TransactionController thread will use this TransportSelector.
+      */
+      void enableSharedAccess();
+
       /**
          @internal - public only for stream operator access
       */
@@ -203,6 +216,7 @@ class TransportSelector
       Transport* findTlsTransport(const Data& domain,TransportType type,IpVersion ipv) const;
       Tuple determineSourceInterface(SipMessage* msg, const Tuple& dest) const;
       void rebuildAnyPortTransportMaps(void);
+      void addToTupleMaps(const Tuple& tuple, Transport* transport);
 
       DnsInterface mDns;
       Fifo<TransactionMessage>& mStateMacFifo;
@@ -252,7 +266,21 @@ class TransportSelector
       // epoll support, for sharedprocess transports
       FdPollGrp* mPollGrp;
 
+      // transmit() updates this from every shard's thread after
+      // enableSharedAccess()
+#ifdef RESIP_HAS_STD_ATOMIC
+      std::atomic<int> mAvgBufferSize;
+#else
       int mAvgBufferSize;
+#endif
+
+      // Only allocated by enableSharedAccess(). The RWMutex protects the
+      // transport maps (written by add/removeTransport, read when sending);
+      // the Mutex serializes use of the mSockets/mSocket6s route lookup
+      // sockets in determineSourceInterface().
+      std::auto_ptr<RWMutex> mTransportsMutex;
+      std::auto_ptr<Mutex> mSourceInterfaceMutex;
+
       Fifo<Transport> mTransportsToAddRemove;
       std::auto_ptr<SelectInterruptor> mSelectInterruptor;
       FdPollItemHandle mInterruptorHandle;
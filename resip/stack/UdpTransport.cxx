@@ -22,11 +22,93 @@
 #include <osc/SigcompMessage.h>
 #endif
 
+#if defined(HAVE_RECVMMSG) && defined(HAVE_SENDMMSG)
+#define RESIP_UDP_USE_MMSG
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
 using namespace std;
 using namespace resip;
 
+// The batch counters have one writer, so a relaxed load and store is enough
+// to keep addBatchStats() from racing with it
+#ifdef RESIP_HAS_STD_ATOMIC
+template <class Counter>
+static void
+countBatch(Counter& counter, unsigned int n)
+{
+   counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+template <class Counter>
+static unsigned int
+batchCount(const Counter& counter)
+{
+   return counter.load(std::memory_order_relaxed);
+}
+#else
+template <class Counter>
+static void
+countBatch(Counter& counter, unsigned int n)
+{
+   counter += n;
+}
+
+template <class Counter>
+static unsigned int
+batchCount(const Counter& counter)
+{
+   return counter;
+}
+#endif
+
+/**
+ * Per-transport buffers for RESIP_TRANSPORT_FLAG_MMSG. The receive side is
+ * a ring of MmsgBatchSize datagram buffers; a slot is only re-allocated
+ * once its buffer has been handed over to a SipMessage, so keep-alives,
+ * STUN and garbage never cost an allocation. The transmit side just holds
+ * the headers/iovecs for one sendmmsg() and the SendData they point into.
+ */
+class UdpTransport::MmsgState
+{
+   public:
+#ifdef RESIP_UDP_USE_MMSG
+      MmsgState()
+      {
+         memset(mRxHdrs, 0, sizeof(mRxHdrs));
+         memset(mTxHdrs, 0, sizeof(mTxHdrs));
+         for (int i = 0; i < MmsgBatchSize; ++i)
+         {
+            mRxBuffers[i] = 0;
+            mRxHdrs[i].msg_hdr.msg_iov = &mRxIov[i];
+            mRxHdrs[i].msg_hdr.msg_iovlen = 1;
+            mTxHdrs[i].msg_hdr.msg_iov = &mTxIov[i];
+            mTxHdrs[i].msg_hdr.msg_iovlen = 1;
+            mTxPending[i] = 0;
+         }
+      }
+      ~MmsgState()
+      {
+         for (int i = 0; i < MmsgBatchSize; ++i)
+         {
+            delete [] mRxBuffers[i];
+         }
+      }
+
+      char* mRxBuffers[MmsgBatchSize];
+      Tuple mRxSenders[MmsgBatchSize];
+      struct mmsghdr mRxHdrs[MmsgBatchSize];
+      struct iovec mRxIov[MmsgBatchSize];
+
+      SendData* mTxPending[MmsgBatchSize];
+      struct mmsghdr mTxHdrs[MmsgBatchSize];
+      struct iovec mTxIov[MmsgBatchSize];
+#endif
+};
+
 UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
                            int portNum,
                            IpVersion version,
@@ -38,17 +120,48 @@ UdpTransport::UdpTransport(Fifo<TransactionMessage>& fifo,
    : InternalTransport(fifo, portNum, version, pinterface, socketFunc, compression, transportFlags),
      mSigcompStack(0),
      mRxBuffer(0),
+     mMmsg(0),
      mExternalUnknownDatagramHandler(0),
      mInWritable(false)
 {
    mPollEventCnt = 0;
    mTxTryCnt = mTxMsgCnt = mTxFailCnt = 0;
    mRxTryCnt = mRxMsgCnt = mRxKeepaliveCnt = mRxTransactionCnt = 0;
+   mRxBatchCnt = 0;
+   mRxBatchMsgCnt = 0;
+   mTxBatchCnt = 0;
+   mTxBatchMsgCnt = 0;
    mTuple.setType(UDP);
    mFd = InternalTransport::socket(transport(), version);
    mTuple.mFlowKey=(FlowKey)mFd;
+
+   if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_REUSEPORT) != 0 )
+   {
+#if defined(SO_REUSEPORT)
+      int on = 1;
+      if ( ::setsockopt(mFd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) )
+      {
+         int e = getErrno();
+         InfoLog (<< "Couldn't set sockoptions SO_REUSEPORT: " << strerror(e));
+         error(e);
+         throw Exception("Failed setsockopt", __FILE__,__LINE__);
+      }
+#else
+      WarningLog(<< "SO_REUSEPORT not available, ignoring RESIP_TRANSPORT_FLAG_REUSEPORT");
+#endif
+   }
+
    bind();      // also makes it non-blocking
 
+   if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_MMSG) != 0 )
+   {
+#ifdef RESIP_UDP_USE_MMSG
+      mMmsg = new MmsgState;
+#else
+      WarningLog(<< "recvmmsg/sendmmsg not available, ignoring RESIP_TRANSPORT_FLAG_MMSG");
+#endif
+   }
+
    InfoLog (<< "Creating UDP transport host=" << pinterface
             << " port=" << mTuple.getPort()
             << " ipv4=" << bool(version==V4) );
@@ -83,6 +196,8 @@ UdpTransport::~UdpTransport()
            <<" rxmsg="<<mRxMsgCnt
            <<" rxka="<<mRxKeepaliveCnt
            <<" rxtr="<<mRxTransactionCnt
+           <<" rxbatch="<<batchCount(mRxBatchCnt)<<"/"<<batchCount(mRxBatchMsgCnt)
+           <<" txbatch="<<batchCount(mTxBatchCnt)<<"/"<<batchCount(mTxBatchMsgCnt)
            );
 #ifdef USE_SIGCOMP
    delete mSigcompStack;
@@ -91,6 +206,7 @@ UdpTransport::~UdpTransport()
    {
       delete[] mRxBuffer;
    }
+   delete mMmsg;
    setPollGrp(0);
 }
 
@@ -224,6 +340,12 @@ UdpTransport::process(FdSet& fdset)
 void
 UdpTransport::processTxAll()
 {
+   if ( mMmsg )
+   {
+      processTxAllMmsg();
+      return;
+   }
+
    SendData *msg;
    ++mTxTryCnt;
    while ( (msg=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != NULL )
@@ -319,6 +441,12 @@ UdpTransport::processTxOne(SendData *data)
 void
 UdpTransport::processRxAll()
 {
+   if ( mMmsg )
+   {
+      processRxAllMmsg();
+      return;
+   }
+
    char *buffer = mRxBuffer;
    mRxBuffer = NULL;
    ++mRxTryCnt;
@@ -353,6 +481,168 @@ UdpTransport::processRxAll()
    }
 }
 
+/**
+ * RESIP_TRANSPORT_FLAG_MMSG variant of processTxAll(): pulls up to
+ * MmsgBatchSize messages from the transmit fifo and hands them to the
+ * kernel with a single sendmmsg(). SigComp and command messages are
+ * still sent one at a time via processTxOne().
+ */
+void
+UdpTransport::processTxAllMmsg()
+{
+#ifdef RESIP_UDP_USE_MMSG
+   MmsgState& st = *mMmsg;
+   ++mTxTryCnt;
+   for (;;)
+   {
+      int num = 0;
+      SendData *msg;
+      while ( num < MmsgBatchSize &&
+              (msg=mTxFifoOutBuffer.getNext(RESIP_FIFO_NOWAIT)) != NULL )
+      {
+         if ( msg->command != SendData::NoCommand
+#ifdef USE_SIGCOMP
+              || (mSigcompStack && msg->sigcompId.size() > 0 && !msg->isAlreadyCompressed)
+#endif
+            )
+         {
+            processTxOne(msg);
+            continue;
+         }
+         resip_assert( msg->destination.getPort() != 0 );
+         st.mTxPending[num] = msg;
+         st.mTxIov[num].iov_base = const_cast<char*>(msg->data.data());
+         st.mTxIov[num].iov_len = msg->data.size();
+         st.mTxHdrs[num].msg_hdr.msg_name = const_cast<sockaddr*>(&msg->destination.getSockaddr());
+         st.mTxHdrs[num].msg_hdr.msg_namelen = msg->destination.length();
+         st.mTxHdrs[num].msg_len = 0;
+         ++num;
+      }
+      if ( num == 0 )
+      {
+         break;
+      }
+
+      countBatch(mTxBatchCnt, 1);
+      countBatch(mTxBatchMsgCnt, num);
+      mTxMsgCnt += num;
+
+      int done = 0;
+      while ( done < num )
+      {
+         int count = sendmmsg(mFd, &st.mTxHdrs[done], num - done, 0);
+         if ( count == SOCKET_ERROR )
+         {
+            // sendmmsg() only reports an error if the first datagram of
+            // the (remaining) batch could not be sent; fail that one and
+            // carry on with the rest
+            int e = getErrno();
+            error(e);
+            InfoLog (<< "Failed (" << e << ") sending to " << st.mTxPending[done]->destination);
+            fail(st.mTxPending[done]->transactionId);
+            ++mTxFailCnt;
+            ++done;
+            continue;
+         }
+         for (int i = done; i < done + count; ++i)
+         {
+            if ( st.mTxHdrs[i].msg_len != st.mTxIov[i].iov_len )
+            {
+               ErrLog (<< "UDPTransport - send buffer full" );
+               fail(st.mTxPending[i]->transactionId);
+            }
+         }
+         done += count;
+      }
+
+      for (int i = 0; i < num; ++i)
+      {
+         delete st.mTxPending[i];
+         st.mTxPending[i] = 0;
+      }
+
+      if ( (mTransportFlags & RESIP_TRANSPORT_FLAG_TXALL)==0 )
+      {
+         break;
+      }
+   }
+#endif
+}
+
+/**
+ * RESIP_TRANSPORT_FLAG_MMSG variant of processRxAll(): reads up to
+ * MmsgBatchSize datagrams per recvmmsg() into the buffer ring. Without
+ * RXALL a single batch is read per call; with it the socket is drained.
+ */
+void
+UdpTransport::processRxAllMmsg()
+{
+#ifdef RESIP_UDP_USE_MMSG
+   MmsgState& st = *mMmsg;
+   ++mRxTryCnt;
+   for (;;)
+   {
+      for (int i = 0; i < MmsgBatchSize; ++i)
+      {
+         if ( st.mRxBuffers[i] == 0 )
+         {
+            st.mRxBuffers[i] = MsgHeaderScanner::allocateBuffer(MaxBufferSize);
+         }
+         st.mRxSenders[i] = mTuple;
+         st.mRxIov[i].iov_base = st.mRxBuffers[i];
+         st.mRxIov[i].iov_len = MaxBufferSize;
+         st.mRxHdrs[i].msg_hdr.msg_name = &st.mRxSenders[i].getMutableSockaddr();
+         st.mRxHdrs[i].msg_hdr.msg_namelen = st.mRxSenders[i].length();
+         st.mRxHdrs[i].msg_hdr.msg_flags = 0;
+         st.mRxHdrs[i].msg_len = 0;
+      }
+
+      int count = recvmmsg(mFd, st.mRxHdrs, MmsgBatchSize, 0, 0);
+      if ( count == SOCKET_ERROR )
+      {
+         int err = getErrno();
+         if ( err != EAGAIN && err != EWOULDBLOCK )
+         {
+            error( err );
+         }
+         break;
+      }
+      if ( count <= 0 )
+      {
+         break;
+      }
+
+      countBatch(mRxBatchCnt, 1);
+      countBatch(mRxBatchMsgCnt, count);
+      for (int i = 0; i < count; ++i)
+      {
+         int len = (int)st.mRxHdrs[i].msg_len;
+         if ( len+1 >= MaxBufferSize || (st.mRxHdrs[i].msg_hdr.msg_flags & MSG_TRUNC) )
+         {
+            InfoLog(<<"Datagram exceeded max length "<<MaxBufferSize);
+            continue;
+         }
+         if ( len == 0 )
+         {
+            continue;
+         }
+         ++mRxMsgCnt;
+         if ( processRxParse(st.mRxBuffers[i], len, st.mRxSenders[i]) )
+         {
+            // buffer now owned by the SipMessage
+            st.mRxBuffers[i] = 0;
+         }
+      }
+
+      if ( count < MmsgBatchSize ||
+           (mTransportFlags & RESIP_TRANSPORT_FLAG_RXALL) == 0 )
+      {
+         break;
+      }
+   }
+#endif
+}
+
 /*
  * Receive from socket and store results into {buffer}. Updates
  * {buffer} with actual buffer (in case allocation required),
@@ -762,6 +1052,16 @@ UdpTransport::setRcvBufLen(int buflen)
    setSocketRcvBufLen(mFd, buflen);
 }
 
+void
+UdpTransport::addBatchStats(unsigned int& rxBatches, unsigned int& rxBatchedMsgs,
+                            unsigned int& txBatches, unsigned int& txBatchedMsgs) const
+{
+   rxBatches += batchCount(mRxBatchCnt);
+   rxBatchedMsgs += batchCount(mRxBatchMsgCnt);
+   txBatches += batchCount(mTxBatchCnt);
+   txBatchedMsgs += batchCount(mTxBatchMsgCnt);
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0
  *
@@ -6,6 +6,7 @@
 #include "resip/stack/MsgHeaderScanner.hxx"
 #include "rutil/HeapInstanceCounter.hxx"
 #include "resip/stack/Compression.hxx"
+#include "rutil/MpscRing.hxx" // RESIP_HAS_STD_ATOMIC
 
 namespace osc { class Stack; }
 
@@ -81,6 +82,9 @@ public:
    virtual void processPollEvent(FdPollEventMask mask);
 
    static const int MaxBufferSize = 8192;
+   /// max datagrams moved per recvmmsg()/sendmmsg() call when
+   /// RESIP_TRANSPORT_FLAG_MMSG is set
+   static const int MmsgBatchSize = 32;
 
    // STUN client functionality
    bool stunSendTest(const Tuple& dest);
@@ -89,6 +93,9 @@ public:
    /// Installs a handler for the unknown datagrams arriving on the udp transport.
    void setExternalUnknownDatagramHandler(ExternalUnknownDatagramHandler *handler);
 
+   virtual void addBatchStats(unsigned int& rxBatches, unsigned int& rxBatchedMsgs,
+                              unsigned int& txBatches, unsigned int& txBatchedMsgs) const;
+
 protected:
 
    void processRxAll();
@@ -96,6 +103,8 @@ protected:
    bool processRxParse(char *buffer, int len, Tuple& sender);
    void processTxAll();
    void processTxOne(SendData *data);
+   void processRxAllMmsg();
+   void processTxAllMmsg();
    void updateEvents();
 
    osc::Stack *mSigcompStack;
@@ -109,8 +118,23 @@ protected:
    unsigned mRxMsgCnt;
    unsigned mRxKeepaliveCnt;
    unsigned mRxTransactionCnt;
+   // only the transport's thread updates these, but addBatchStats() reads
+   // them from the statistics thread
+#ifdef RESIP_HAS_STD_ATOMIC
+   typedef std::atomic<unsigned> BatchCounter;
+#else
+   typedef unsigned BatchCounter; // may be read stale by addBatchStats()
+#endif
+   BatchCounter mRxBatchCnt;
+   BatchCounter mRxBatchMsgCnt;
+   BatchCounter mTxBatchCnt;
+   BatchCounter mTxBatchMsgCnt;
 private:
    char* mRxBuffer;
+   // recvmmsg/sendmmsg state; only allocated when RESIP_TRANSPORT_FLAG_MMSG
+   // is set and the platform supports it
+   class MmsgState;
+   MmsgState* mMmsg;
    MsgHeaderScanner mMsgHeaderScanner;
    mutable resip::Mutex  myMutex;
    Tuple mStunMappedAddress;
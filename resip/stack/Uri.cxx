@@ -1023,8 +1023,7 @@ Uri::parse(ParseBuffer& pb)
    if (mScheme==Symbols::Tel)
    {
       const char* anchor = pb.position();
-      static std::bitset<256> delimiter=Data::toBitset("\r\n\t ;>");
-      pb.skipToOneOf(delimiter);
+      pb.skipToOneOf(CharClass<'\r', '\n', '\t', ' ', ';', '>'>::Table);
       pb.data(mUser, anchor);
       if (!pb.eof() && *pb.position() == Symbols::SEMI_COLON[0])
       {
@@ -1036,7 +1035,7 @@ Uri::parse(ParseBuffer& pb)
    }
    
    start = pb.position();
-   static std::bitset<256> userPortOrPasswordDelim(Data::toBitset("@:\""));
+   const CharTable& userPortOrPasswordDelim = CharClass<'@', ':', '"'>::Table;
    // stop at double-quote to prevent matching an '@' in a quoted string param. 
    pb.skipToOneOf(userPortOrPasswordDelim);
    if (!pb.eof())
@@ -1096,7 +1095,7 @@ Uri::parse(ParseBuffer& pb)
    }
 
    mHostCanonicalized=false;
-   static std::bitset<256> hostDelimiter(Data::toBitset("\r\n\t :;?>"));
+   const CharTable& hostDelimiter = CharClass<'\r', '\n', '\t', ' ', ':', ';', '?', '>'>::Table;
    if (*start == '[')
    {
       start = pb.skipChar();
@@ -1157,7 +1156,7 @@ Uri::clone(void* location) const
 ParserCategory*
 Uri::clone(PoolBase* pool) const
 {
-   return new (pool) Uri(*this);
+   return new (pool) Uri(*this, pool);
 }
 
 void Uri::setUriUserEncoding(unsigned char c, bool encode) 
@@ -164,7 +164,7 @@ Via::parse(ParseBuffer& pb)
 {
    const char* startMark;
    startMark = pb.skipWhitespace();
-   static std::bitset<256> wos=Data::toBitset("\r\n\t /");
+   const CharTable& wos = CharClass<'\r', '\n', '\t', ' ', '/'>::Table;
    pb.skipToOneOf(wos);
    pb.data(mProtocolName, startMark);
    pb.skipToChar('/');
@@ -206,8 +206,7 @@ Via::parse(ParseBuffer& pb)
    else
    {
       // .bwc. If we hit whitespace, we have the host.
-      static std::bitset<256> delimiter=Data::toBitset(";: \t\r\n");
-      pb.skipToOneOf(delimiter);
+      pb.skipToOneOf(CharClass<';', ':', ' ', '\t', '\r', '\n'>::Table);
       pb.data(mSentHost, startMark);
    }
 
@@ -217,8 +216,7 @@ Via::parse(ParseBuffer& pb)
    {
       startMark = pb.skipChar(':');
       mSentPort = pb.integer();
-      static std::bitset<256> delimiter=Data::toBitset("; \t\r\n");
-      pb.skipToOneOf(delimiter);
+      pb.skipToOneOf(CharClass<';', ' ', '\t', '\r', '\n'>::Table);
    }
    else
    {
@@ -1,6 +1,9 @@
 
+#include <string.h>
+
 #include "rutil/Logger.hxx"
 #include "resip/stack/WsFrameExtractor.hxx"
+#include "rutil/Simd.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
 using namespace resip;
@@ -12,9 +15,12 @@ const int WsFrameExtractor::mMaxHeaderLen = 14;
 
 WsFrameExtractor::WsFrameExtractor(Data::size_type maxMessage)
    : mMaxMessage(maxMessage),
+     mBuffer(0),
+     mBufferCapacity(0),
      mMessageSize(0),
      mHaveHeader(false),
-     mHeaderLen(0)
+     mHeaderLen(0),
+     mPayloadPos(0)
 {
    // we re-use this for multiple messages throughout
    // the lifetime of this parser object
@@ -23,16 +29,9 @@ WsFrameExtractor::WsFrameExtractor(Data::size_type maxMessage)
 
 WsFrameExtractor::~WsFrameExtractor()
 {
-   // FIXME - delete any objects left in the queues
    delete [] mWsHeader;
+   delete [] mBuffer;
 
-   while(!mFrames.empty()) 
-   {
-      delete [] mFrames.front()->data();
-      delete mFrames.front();
-      mFrames.pop();
-   }
-      
    while(!mMessages.empty())
    {
       delete [] mMessages.front()->data();
@@ -50,12 +49,19 @@ WsFrameExtractor::processBytes(UInt8 *input, Data::size_type len, bool& dropConn
    Data::size_type pos = 0;
    while(input != 0 && pos < len)
    {
-      while(!mHaveHeader && pos < len)
+      // parse again once the last byte is in, even if it was the last of
+      // the input: an empty frame has nothing after its header
+      while(!mHaveHeader)
       {
          StackLog(<<"Need a header, parsing bytes...");
          // Append bytes to the header buffer
          int needed = parseHeader();
-         if(mHeaderLen >= mMaxHeaderLen)
+         if(needed < 0)
+         {
+            dropConnection = true;
+            return ret;
+         }
+         if(mHeaderLen + needed > mMaxHeaderLen)
          {
             WarningLog(<<"WS Frame header too long");
             dropConnection = true;
@@ -75,20 +81,11 @@ WsFrameExtractor::processBytes(UInt8 *input, Data::size_type len, bool& dropConn
       {
          StackLog(<<"have header, parsing payload data...");
          // Process input bytes to output buffer, unmasking if necessary
-         if(mMessageSize + mPayloadLength > mMaxMessage)
+         // (parseHeader has checked the payload fits in mMaxMessage)
+         if(mPayloadPos == 0)
          {
-            WarningLog(<<"WS frame header describes a payload size bigger than messageSizeMax, max = " << mMaxMessage 
-                 << ", dropping connection");
-            dropConnection = true;
-            return ret;
-         }
-
-         if(mPayload == 0)
-         {
-            StackLog(<<"starting new frame buffer");
             // Include an extra byte at the end for null terminator
-            mPayload = (UInt8*)new char[mPayloadLength + 1];
-            mPayloadPos = 0;
+            reserve(mMessageSize + mPayloadLength + 1);
          }
 
          Data::size_type takeBytes = len - pos;
@@ -97,33 +94,33 @@ WsFrameExtractor::processBytes(UInt8 *input, Data::size_type len, bool& dropConn
             takeBytes = mPayloadLength - mPayloadPos;
          }
 
+         UInt8* out = (UInt8*)mBuffer + mMessageSize + mPayloadPos;
          if(mMasked)
          {
-            Data::size_type endOffset = mPayloadPos + takeBytes;
-            for( ; mPayloadPos < endOffset; mPayloadPos++)
-            {
-               mPayload[mPayloadPos] = (input[pos++] ^ mWsMaskKey[(mPayloadPos & 3)]);
-            }
+            unmask(out, &input[pos], takeBytes, mWsMaskKey, mPayloadPos);
          }
          else
          {
-            memmove(&mPayload[mPayloadPos], &input[pos], takeBytes);
-            pos += takeBytes;
-            mPayloadPos += takeBytes;
+            memcpy(out, &input[pos], takeBytes);
          }
+         pos += takeBytes;
+         mPayloadPos += takeBytes;
 
          if(mPayloadPos == mPayloadLength)
          {
-            StackLog(<<"Got a whole frame, queueing it");
+            StackLog(<<"Got a whole frame");
             mMessageSize += mPayloadLength;
-            Data *mFrame = new Data(Data::Borrow, (char *)mPayload, mPayloadLength, mPayloadLength + 1);
-            mFrames.push(mFrame);
             mHaveHeader = false;
             mHeaderLen = 0;
-            mPayload = 0;
             if(mFinalFrame)
             {
-               joinFrames();
+               // MsgHeaderScanner expects space for an extra byte at the end:
+               mBuffer[mMessageSize] = 0;
+               mMessages.push(new Data(Data::Borrow, mBuffer, mMessageSize, mBufferCapacity));
+               // the buffer goes with the message; start the next one afresh
+               mBuffer = 0;
+               mBufferCapacity = 0;
+               mMessageSize = 0;
             }
          }
       }
@@ -139,6 +136,90 @@ WsFrameExtractor::processBytes(UInt8 *input, Data::size_type len, bool& dropConn
    return ret;
 }
 
+void
+WsFrameExtractor::reserve(Data::size_type size)
+{
+   if(size <= mBufferCapacity)
+   {
+      return;
+   }
+   // Most messages are a single frame and get a buffer of exactly their
+   // size.  Fragmented ones grow geometrically, up to the largest message
+   // allowed, so continuation frames rarely move what is already there.
+   Data::size_type capacity = size;
+   if(mBuffer)
+   {
+      capacity = mBufferCapacity * 2;
+      if(capacity > mMaxMessage + 1)
+      {
+         capacity = mMaxMessage + 1;
+      }
+      if(capacity < size)
+      {
+         capacity = size;
+      }
+   }
+   char* buffer = new char[capacity];
+   if(mBuffer)
+   {
+      memcpy(buffer, mBuffer, mMessageSize);
+      delete [] mBuffer;
+   }
+   mBuffer = buffer;
+   mBufferCapacity = capacity;
+}
+
+void
+WsFrameExtractor::unmask(UInt8* dst, const UInt8* src, Data::size_type len,
+                         const UInt8 key[4], Data::size_type keyOffset)
+{
+   // the key as it lines up with dst[0]
+   UInt8 k[4];
+   for(int i = 0; i < 4; i++)
+   {
+      k[i] = key[(keyOffset + i) & 3];
+   }
+   Data::size_type i = 0;
+
+#if defined(RESIP_SIMD_SSE2)
+   int k32;
+   memcpy(&k32, k, 4);
+#endif
+#if defined(RESIP_SIMD_AVX2)
+   const __m256i k256 = _mm256_set1_epi32(k32);
+   for( ; i + 32 <= len; i += 32)
+   {
+      __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+      _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(v, k256));
+   }
+#endif
+#if defined(RESIP_SIMD_SSE2)
+   const __m128i k128 = _mm_set1_epi32(k32);
+   for( ; i + 16 <= len; i += 16)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+      _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, k128));
+   }
+#endif
+
+   // a word at a time; the key repeats every 4 bytes, so i stays aligned
+   // with it as long as we step by a multiple of 4
+   UInt8 k8[8] = { k[0], k[1], k[2], k[3], k[0], k[1], k[2], k[3] };
+   UInt64 k64;
+   memcpy(&k64, k8, 8);
+   for( ; i + 8 <= len; i += 8)
+   {
+      UInt64 v;
+      memcpy(&v, src + i, 8);
+      v ^= k64;
+      memcpy(dst + i, &v, 8);
+   }
+   for( ; i < len; i++)
+   {
+      dst[i] = src[i] ^ k[i & 3];
+   }
+}
+
 int
 WsFrameExtractor::parseHeader()
 {
@@ -159,28 +240,38 @@ WsFrameExtractor::parseHeader()
       // do not exit
    }
 
-   mPayloadLength = mWsHeader[1] & 0x7F;
-   if(mPayloadLength == 126)
+   UInt64 payloadLength = mWsHeader[1] & 0x7F;
+   if(payloadLength == 126)
    {
       if(mHeaderLen < 4)
       {
          StackLog(<< "Too short to contain ws data [1]");
          return (4 - mHeaderLen) + (mMasked ? 4 : 0);
       }
-      mPayloadLength = (mWsHeader[hdrPos] << 8 | mWsHeader[hdrPos + 1]);
+      payloadLength = (mWsHeader[hdrPos] << 8 | mWsHeader[hdrPos + 1]);
       hdrPos += 2;
    }
-   else if(mPayloadLength == 127)
+   else if(payloadLength == 127)
    {
-      if(mHeaderLen < 8)
+      if(mHeaderLen < 10)
       {
          StackLog(<< "Too short to contain ws data [2]");
-         return (8 - mHeaderLen) + (mMasked ? 4 : 0);
+         return (10 - mHeaderLen) + (mMasked ? 4 : 0);
       }
-      mPayloadLength = (((UInt64)mWsHeader[hdrPos]) << 56 | ((UInt64)mWsHeader[hdrPos + 1]) << 48 | ((UInt64)mWsHeader[hdrPos + 2]) << 40 | ((UInt64)mWsHeader[hdrPos + 3]) << 32 | ((UInt64)mWsHeader[hdrPos + 4]) << 24 | ((UInt64)mWsHeader[hdrPos + 5]) << 16 | ((UInt64)mWsHeader[hdrPos + 6]) << 8 || ((UInt64)mWsHeader[hdrPos + 7]));
+      payloadLength = (((UInt64)mWsHeader[hdrPos]) << 56 | ((UInt64)mWsHeader[hdrPos + 1]) << 48 | ((UInt64)mWsHeader[hdrPos + 2]) << 40 | ((UInt64)mWsHeader[hdrPos + 3]) << 32 | ((UInt64)mWsHeader[hdrPos + 4]) << 24 | ((UInt64)mWsHeader[hdrPos + 5]) << 16 | ((UInt64)mWsHeader[hdrPos + 6]) << 8 | ((UInt64)mWsHeader[hdrPos + 7]));
       hdrPos += 8;
    }
 
+   // mMessageSize never exceeds mMaxMessage, so the subtraction can't wrap;
+   // this also keeps a 64 bit length from being truncated below
+   if(payloadLength > mMaxMessage - mMessageSize)
+   {
+      WarningLog(<<"WS frame header describes a payload size bigger than messageSizeMax, max = " << mMaxMessage 
+           << ", dropping connection");
+      return -1;
+   }
+   mPayloadLength = (Data::size_type)payloadLength;
+
    if(mMasked)
    {
       if((mHeaderLen - hdrPos) < 4)
@@ -199,57 +290,10 @@ WsFrameExtractor::parseHeader()
             << ", masked = "<< mMasked << ", final frame = "<< mFinalFrame);
 
    mHaveHeader = true;
-   mPayload = 0;
+   mPayloadPos = 0;
    return 0;
 }
 
-void
-WsFrameExtractor::joinFrames()
-{
-   StackLog(<<"trying to join frames");
-   if(mFrames.empty())
-   {
-      ErrLog(<<"No frames to join!");
-      return;
-   }
-
-   Data *msg = mFrames.front();
-   mFrames.pop();
-   if(!mFrames.empty())
-   {
-      // must expand buffer because there are multiple frames
-      // can't use Data::reserve() to increase the buffer, because the
-      // ShareEnum will change to Take when expanded
-      char *_msg = (char *)msg->data();
-      Data::size_type frameSize = msg->size();
-      delete msg;
-
-      // allow extra byte for null terminator
-      char *newBuf = new char [mMessageSize + 1]; 
-      memcpy(newBuf, _msg, frameSize);
-
-      msg = new Data(Data::Borrow, newBuf, frameSize, mMessageSize + 1);
-   }
-   while(!mFrames.empty())
-   {
-      Data *mFrame = mFrames.front();
-      mFrames.pop();
-      msg->append(mFrame->data(), mFrame->size());
-      delete [] mFrame->data();
-      delete mFrame;
-   }
-
-   // It is safe to cast because we used Borrow:
-   char *_msg = (char *)msg->data();
-   // MsgHeaderScanner expects space for an extra byte at the end:
-   _msg[mMessageSize] = 0;
-
-   mMessages.push(msg);
-
-   // Ready to start examinging first frame of next message...
-   mMessageSize = 0;
-}
-
 /* ====================================================================
  *
  * Copyright 2013 Daniel Pocock.  All rights reserved.
@@ -16,18 +16,31 @@ class WsFrameExtractor
 
       WsFrameExtractor(Data::size_type maxMessage);
       ~WsFrameExtractor();
+      /** Returns the next complete message, if any. The returned Data borrows
+          a buffer allocated with new[] (with a null byte after the message,
+          for MsgHeaderScanner) that the caller must delete[], usually by
+          handing it to SipMessage::addBuffer(). */
       std::auto_ptr<Data> processBytes(UInt8 *input, Data::size_type len, bool& dropConnection);
 
+      /** XORs len bytes of src with the 4 byte WebSocket masking key into
+          dst (which may be src), starting at byte keyOffset of the key.
+          Uses AVX2 or SSE2 when the build targets them. */
+      static void unmask(UInt8* dst, const UInt8* src, Data::size_type len,
+                         const UInt8 key[4], Data::size_type keyOffset);
+
    private:
 
       static const int mMaxHeaderLen;
 
       Data::size_type mMaxMessage;
 
-      std::queue<Data*> mFrames;
       std::queue<Data*> mMessages;
-      // for tracking the cumulative size of all full frames
-      // not yet assembled into a message:
+
+      // The message being assembled: the payloads of its frames are
+      // unmasked straight into mBuffer, back to back.
+      char* mBuffer;
+      Data::size_type mBufferCapacity;
+      // size of the complete frames in mBuffer
       Data::size_type mMessageSize;
 
       bool mHaveHeader;
@@ -38,12 +51,13 @@ class WsFrameExtractor
       bool mMasked;
       UInt8 mWsMaskKey[4];
       Data::size_type mPayloadLength;
-
-      UInt8 *mPayload;
+      // bytes of the current frame's payload received so far
       Data::size_type mPayloadPos;
 
+      // returns the header bytes still needed, 0 once the header is
+      // complete, or -1 if the frame would make the message too big
       int parseHeader();
-      void joinFrames();
+      void reserve(Data::size_type size);
 
 };
 
@@ -56,6 +56,17 @@
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
 #include <openssl/ssl.h>
+#include <openssl/rand.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(LIBRESSL_VERSION_NUMBER)
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#define RESIP_TICKET_KEY_EVP_CB
+typedef EVP_MAC_CTX TicketMacCtx;
+#else
+#include <openssl/hmac.h>
+typedef HMAC_CTX TicketMacCtx;
+#endif
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 
@@ -71,6 +82,152 @@ using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::SIP
 
+namespace resip
+{
+
+/**
+   Session ticket keys shared by all the contexts of one BaseSecurity.  The
+   current key encrypts new tickets; the previous one is kept for one more
+   lifetime so tickets issued before the last rotation can still be
+   decrypted, and are then renewed with the current key.
+*/
+class TlsTicketKeys
+{
+   public:
+      TlsTicketKeys(unsigned long lifetimeSecs);
+      ~TlsTicketKeys();
+
+      // see SSL_CTX_set_tlsext_ticket_key_cb(3)
+      int process(unsigned char* keyName, unsigned char* iv,
+                  EVP_CIPHER_CTX* cipherCtx, TicketMacCtx* macCtx, int enc,
+                  bool singleUse);
+
+   private:
+      enum { NameLength = 16, KeyLength = 32 };
+      struct Key
+      {
+         unsigned char mName[NameLength];
+         unsigned char mAesKey[KeyLength];
+         unsigned char mHmacKey[KeyLength];
+         UInt64 mCreated;
+      };
+      bool rotate(UInt64 now);
+
+      Mutex mMutex;
+      const UInt64 mLifetime;
+      Key mKeys[2]; // current, previous
+      unsigned int mValidKeys;
+};
+
+}
+
+static bool
+initTicketMac(TicketMacCtx* macCtx, const unsigned char* key, int keyLen)
+{
+#ifdef RESIP_TICKET_KEY_EVP_CB
+   OSSL_PARAM params[3];
+   params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, (void*)key, keyLen);
+   params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, (char*)"SHA256", 0);
+   params[2] = OSSL_PARAM_construct_end();
+   return EVP_MAC_CTX_set_params(macCtx, params) == 1;
+#elif OPENSSL_VERSION_NUMBER < 0x10000000L
+   HMAC_Init_ex(macCtx, key, keyLen, EVP_sha256(), 0);
+   return true;
+#else
+   return HMAC_Init_ex(macCtx, key, keyLen, EVP_sha256(), 0) == 1;
+#endif
+}
+
+TlsTicketKeys::TlsTicketKeys(unsigned long lifetimeSecs) :
+   mLifetime((UInt64)lifetimeSecs * 1000),
+   mValidKeys(0)
+{
+}
+
+TlsTicketKeys::~TlsTicketKeys()
+{
+   OPENSSL_cleanse(mKeys, sizeof(mKeys));
+}
+
+bool
+TlsTicketKeys::rotate(UInt64 now)
+{
+   Key key;
+   if(RAND_bytes(key.mName, NameLength) != 1 ||
+      RAND_bytes(key.mAesKey, KeyLength) != 1 ||
+      RAND_bytes(key.mHmacKey, KeyLength) != 1)
+   {
+      ErrLog(<< "unable to generate a TLS session ticket key");
+      return false;
+   }
+   key.mCreated = now;
+   mKeys[1] = mKeys[0];
+   mKeys[0] = key;
+   OPENSSL_cleanse(&key, sizeof(key));
+   if(mValidKeys < 2)
+   {
+      ++mValidKeys;
+   }
+   DebugLog(<< "new TLS session ticket key");
+   return true;
+}
+
+int
+TlsTicketKeys::process(unsigned char* keyName, unsigned char* iv,
+                       EVP_CIPHER_CTX* cipherCtx, TicketMacCtx* macCtx, int enc,
+                       bool singleUse)
+{
+   Lock lock(mMutex);
+   const UInt64 now = Timer::getTimeMs();
+   const bool currentDue = mValidKeys == 0 || now - mKeys[0].mCreated >= mLifetime;
+
+   if(enc)
+   {
+      if(currentDue && !rotate(now))
+      {
+         return -1;
+      }
+      const Key& key = mKeys[0];
+      memcpy(keyName, key.mName, NameLength);
+      if(RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1 ||
+         EVP_EncryptInit_ex(cipherCtx, EVP_aes_256_cbc(), 0, key.mAesKey, iv) != 1 ||
+         !initTicketMac(macCtx, key.mHmacKey, KeyLength))
+      {
+         return -1;
+      }
+      return 1;
+   }
+
+   for(unsigned int i = 0; i < mValidKeys; ++i)
+   {
+      const Key& key = mKeys[i];
+      if(memcmp(keyName, key.mName, NameLength) != 0)
+      {
+         continue;
+      }
+      // the previous key stops being accepted one lifetime after it was replaced
+      if(i == 1 && currentDue)
+      {
+         break;
+      }
+      if(EVP_DecryptInit_ex(cipherCtx, EVP_aes_256_cbc(), 0, key.mAesKey, iv) != 1 ||
+         !initTicketMac(macCtx, key.mHmacKey, KeyLength))
+      {
+         return -1;
+      }
+      // 2 asks OpenSSL to issue a fresh ticket with the current key
+      return (i == 0 && !currentDue && !singleUse) ? 1 : 2;
+   }
+   return 0; // unknown or expired key, fall back to a full handshake
+}
+
+static int
+ticketKeysExIndex()
+{
+   static int index = SSL_CTX_get_ex_new_index(0, 0, 0, 0, 0);
+   return index;
+}
+
 static const Data PEM(".pem");
 
 static const Data rootCert("root_cert_");
@@ -133,6 +290,25 @@ verifyCallback(int iInCode, X509_STORE_CTX *pInStore)
  
    return iInCode;
 }
+
+static int
+ticketKeyCallback(SSL* ssl, unsigned char* keyName, unsigned char* iv,
+                  EVP_CIPHER_CTX* cipherCtx, TicketMacCtx* macCtx, int enc)
+{
+   TlsTicketKeys* keys = static_cast<TlsTicketKeys*>(
+      SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticketKeysExIndex()));
+   if(keys == 0)
+   {
+      return enc ? -1 : 0;
+   }
+   // TLS 1.3 clients use each ticket once, so always send them another
+#if defined(TLS1_3_VERSION)
+   const bool singleUse = SSL_version(ssl) == TLS1_3_VERSION;
+#else
+   const bool singleUse = false;
+#endif
+   return keys->process(keyName, iv, cipherCtx, macCtx, enc, singleUse);
+}
  
 }
 
@@ -156,6 +332,11 @@ BaseSecurity::CipherList BaseSecurity::StrongestSuite("HIGH:-COMPLEMENTOFDEFAULT
 long BaseSecurity::OpenSSLCTXSetOptions = SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3;
 long BaseSecurity::OpenSSLCTXClearOptions = 0;
 
+unsigned long BaseSecurity::TlsSessionCacheSize = 20480;
+unsigned long BaseSecurity::TlsSessionTimeout = 3600;
+unsigned long BaseSecurity::TlsTicketKeyLifetime = 3600;
+unsigned long BaseSecurity::TlsClientSessionCacheSize = 1024;
+
 Security::Security(const CipherList& cipherSuite, const Data& defaultPrivateKeyPassPhrase, const Data& dHParamsFilename) :
    BaseSecurity(cipherSuite, defaultPrivateKeyPassPhrase, dHParamsFilename)
 {
@@ -401,6 +582,7 @@ Security::createDomainCtx(const SSL_METHOD* method, const Data& domain, const Da
    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER|SSL_VERIFY_CLIENT_ONCE, verifyCallback);
    SSL_CTX_set_cipher_list(ctx, mCipherList.cipherList().c_str());
    setDHParams(ctx);
+   setSessionResumption(ctx, domain);
    SSL_CTX_set_options(ctx, BaseSecurity::OpenSSLCTXSetOptions);
    SSL_CTX_clear_options(ctx, BaseSecurity::OpenSSLCTXClearOptions);
 
@@ -962,7 +1144,12 @@ BaseSecurity::addPrivateKeyPEM( PEMType type,
          char buffer[120];
          unsigned long err = ERR_get_error();
          ERR_error_string(err, buffer);
+         // OpenSSL 3 no longer records the function an error came from
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
          if(ERR_GET_LIB(err) == ERR_LIB_EVP && ERR_GET_FUNC(err) == EVP_F_EVP_DECRYPTFINAL_EX && ERR_GET_REASON(err) == EVP_R_BAD_DECRYPT)
+#else
+         if(ERR_GET_LIB(err) == ERR_LIB_EVP && ERR_GET_REASON(err) == EVP_R_BAD_DECRYPT)
+#endif
          {
             ErrLog(<< "Could not read private key (error=" << buffer << ") - likely incorrect password provided, may load correctly when transports are added with appropriate password");
          }
@@ -1155,12 +1342,15 @@ BaseSecurity::BaseSecurity (const CipherList& cipherSuite, const Data& defaultPr
    mDefaultPrivateKeyPassPhrase(defaultPrivateKeyPassPhrase),
    mDHParamsFilename(dHParamsFilename),
    mRootTlsCerts(0),
-   mRootSslCerts(0)
+   mRootSslCerts(0),
+   mTicketKeys(0)
 { 
    DebugLog(<< "BaseSecurity::BaseSecurity");
    
    int ret;
    initialize(); 
+
+   mTicketKeys = new TlsTicketKeys(TlsTicketKeyLifetime);
    
    mRootTlsCerts = X509_STORE_new();
    mRootSslCerts = X509_STORE_new();
@@ -1185,6 +1375,7 @@ BaseSecurity::BaseSecurity (const CipherList& cipherSuite, const Data& defaultPr
    ret = SSL_CTX_set_cipher_list(mTlsCtx, cipherSuite.cipherList().c_str());
    resip_assert(ret);
    setDHParams(mTlsCtx);
+   setSessionResumption(mTlsCtx, Data::Empty);
    SSL_CTX_set_options(mTlsCtx, BaseSecurity::OpenSSLCTXSetOptions);
    SSL_CTX_clear_options(mTlsCtx, BaseSecurity::OpenSSLCTXClearOptions);
    
@@ -1196,6 +1387,7 @@ BaseSecurity::BaseSecurity (const CipherList& cipherSuite, const Data& defaultPr
    ret = SSL_CTX_set_cipher_list(mSslCtx,cipherSuite.cipherList().c_str());
    resip_assert(ret);
    setDHParams(mSslCtx);
+   setSessionResumption(mSslCtx, Data::Empty);
    SSL_CTX_set_options(mSslCtx, BaseSecurity::OpenSSLCTXSetOptions);
    SSL_CTX_clear_options(mSslCtx, BaseSecurity::OpenSSLCTXClearOptions);
 }
@@ -1243,7 +1435,7 @@ BaseSecurity::~BaseSecurity ()
    {
       SSL_CTX_free(mSslCtx);mSslCtx=0;  // This free's X509_STORE (mRootSslCerts)
    }
-
+   delete mTicketKeys;mTicketKeys=0;
 }
 
 void
@@ -2615,6 +2807,39 @@ BaseSecurity::getSslCtx ()
    return   mSslCtx;
 }
 
+BaseSecurity::TlsSessionStats
+BaseSecurity::getTlsSessionStats() const
+{
+   Lock lock(mTlsSessionMutex);
+   return mTlsSessionStats;
+}
+
+void
+BaseSecurity::onTlsHandshake(bool server, bool offered, bool resumed)
+{
+   Lock lock(mTlsSessionMutex);
+   if(server)
+   {
+      ++mTlsSessionStats.mServerHandshakes;
+      if(resumed)
+      {
+         ++mTlsSessionStats.mServerResumed;
+      }
+   }
+   else
+   {
+      ++mTlsSessionStats.mClientHandshakes;
+      if(offered)
+      {
+         ++mTlsSessionStats.mClientOffered;
+      }
+      if(resumed)
+      {
+         ++mTlsSessionStats.mClientResumed;
+      }
+   }
+}
+
 void 
 BaseSecurity::getCertNames(X509 *cert, std::list<PeerName> &peerNames,
                            bool useEmailAsSIP) 
@@ -3191,6 +3416,44 @@ BaseSecurity::setDHParams(SSL_CTX* ctx)
    }
 }
 
+void
+BaseSecurity::setSessionResumption(SSL_CTX* ctx, const Data& domain)
+{
+   // A server that verifies its peers refuses to resume sessions without a
+   // session ID context; it also keeps sessions created for one domain
+   // from being resumed on the context of another.
+   Data sidContext("resip-tls:" + domain);
+   unsigned char md[EVP_MAX_MD_SIZE];
+   unsigned int mdLen = 0;
+   EVP_Digest(sidContext.data(), sidContext.size(), md, &mdLen, EVP_sha256(), 0);
+   SSL_CTX_set_session_id_context(ctx, md, resipMin(mdLen, (unsigned int)SSL_MAX_SID_CTX_LENGTH));
+
+   SSL_CTX_set_timeout(ctx, TlsSessionTimeout);
+   if(TlsSessionCacheSize > 0)
+   {
+      SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+      SSL_CTX_sess_set_cache_size(ctx, TlsSessionCacheSize);
+   }
+   else
+   {
+      SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+   }
+
+   if(TlsTicketKeyLifetime > 0)
+   {
+      SSL_CTX_set_ex_data(ctx, ticketKeysExIndex(), mTicketKeys);
+#ifdef RESIP_TICKET_KEY_EVP_CB
+      SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, ticketKeyCallback);
+#else
+      SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticketKeyCallback);
+#endif
+   }
+   else
+   {
+      SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+   }
+}
+
 #endif
 
 
@@ -12,6 +12,7 @@
 
 #include "rutil/Socket.hxx"
 #include "rutil/BaseException.hxx"
+#include "rutil/Mutex.hxx"
 #include "resip/stack/SecurityTypes.hxx"
 #include "resip/stack/SecurityAttributes.hxx"
 
@@ -39,6 +40,7 @@ class Pkcs7Contents;
 class Security;
 class MultipartSignedContents;
 class SipMessage;
+class TlsTicketKeys;
 
 
 class BaseSecurity
@@ -90,6 +92,39 @@ class BaseSecurity
       static long OpenSSLCTXSetOptions;
       static long OpenSSLCTXClearOptions;
 
+      /**
+       * TLS session resumption, applied to each SSL_CTX when it is created,
+       * so like the options above these must be set before instantiating
+       * resip::Security.
+       *
+       * TlsSessionCacheSize bounds the server side session ID cache of each
+       * context, 0 turns it off.  TlsSessionTimeout is the lifetime of a
+       * session or ticket in seconds.  Session tickets are encrypted with a
+       * key that is replaced every TlsTicketKeyLifetime seconds; tickets
+       * made with the previous key are still accepted, and renewed.  0 turns
+       * tickets off.  TlsClientSessionCacheSize is the number of
+       * destinations for which each TLS transport remembers the last session
+       * and offers it on the next connection, 0 turns client side
+       * resumption off.
+       */
+      static unsigned long TlsSessionCacheSize;
+      static unsigned long TlsSessionTimeout;
+      static unsigned long TlsTicketKeyLifetime;
+      static unsigned long TlsClientSessionCacheSize;
+
+      /// Completed TLS handshakes since startup, see getTlsSessionStats().
+      class TlsSessionStats
+      {
+         public:
+            TlsSessionStats() : mServerHandshakes(0), mServerResumed(0),
+                                mClientHandshakes(0), mClientOffered(0), mClientResumed(0) {}
+            UInt64 mServerHandshakes; // includes mServerResumed
+            UInt64 mServerResumed;
+            UInt64 mClientHandshakes; // includes mClientResumed
+            UInt64 mClientOffered;    // a cached session was offered to the server
+            UInt64 mClientResumed;
+      };
+
       BaseSecurity(const CipherList& cipherSuite = StrongestSuite, const Data& defaultPrivateKeyPassPhrase = Data::Empty, const Data& dHParamsFilename = Data::Empty);
       virtual ~BaseSecurity();
 
@@ -198,6 +233,10 @@ class BaseSecurity
    public:
       SSL_CTX*       getTlsCtx ();
       SSL_CTX*       getSslCtx ();
+
+      TlsSessionStats getTlsSessionStats() const;
+      // called by TlsConnection once a handshake has completed
+      void onTlsHandshake(bool server, bool offered, bool resumed);
       
       X509*     getDomainCert( const Data& domain );
       EVP_PKEY* getDomainKey(  const Data& domain );
@@ -261,6 +300,11 @@ class BaseSecurity
       static bool mAllowWildcardCertificates;
 
       void setDHParams(SSL_CTX* ctx);
+      void setSessionResumption(SSL_CTX* ctx, const Data& domain);
+
+      TlsTicketKeys* mTicketKeys;
+      mutable Mutex mTlsSessionMutex;
+      TlsSessionStats mTlsSessionStats;
 };
 
 class Security : public BaseSecurity
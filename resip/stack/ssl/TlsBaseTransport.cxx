@@ -6,6 +6,7 @@
 
 #include <memory>
 #include <stdexcept>
+#include <time.h>
 
 #include "rutil/compat.hxx"
 #include "rutil/Data.hxx"
@@ -70,6 +71,15 @@ TlsBaseTransport::TlsBaseTransport(Fifo<TransactionMessage>& fifo,
          throw invalid_argument("Unrecognised SecurityTypes::SSLType value");
       }
    }
+
+   if(BaseSecurity::TlsClientSessionCacheSize > 0)
+   {
+      // New sessions (and TLS 1.3 tickets, which only arrive after the
+      // handshake) are handed to TlsConnection::onNewSession
+      SSL_CTX* ctx = getCtx();
+      SSL_CTX_set_session_cache_mode(ctx, SSL_CTX_get_session_cache_mode(ctx) | SSL_SESS_CACHE_CLIENT);
+      SSL_CTX_sess_set_new_cb(ctx, TlsConnection::onNewSession);
+   }
 }
 
 
@@ -79,6 +89,10 @@ TlsBaseTransport::~TlsBaseTransport()
    {
       SSL_CTX_free(mDomainCtx);mDomainCtx=0;
    }
+   for(ClientSessionMap::iterator it = mClientSessions.begin(); it != mClientSessions.end(); ++it)
+   {
+      SSL_SESSION_free(it->second);
+   }
 }
 
 void
@@ -124,6 +138,60 @@ TlsBaseTransport::setPeerCertificateVerificationCallback(
    return true;
 }
 
+SSL_SESSION*
+TlsBaseTransport::findClientSession(const Data& destination) const
+{
+   ClientSessionMap::const_iterator it = mClientSessions.find(destination);
+   return it == mClientSessions.end() ? 0 : it->second;
+}
+
+void
+TlsBaseTransport::storeClientSession(const Data& destination, SSL_SESSION* session)
+{
+   ClientSessionMap::iterator it = mClientSessions.find(destination);
+   if(it != mClientSessions.end())
+   {
+      SSL_SESSION_free(it->second);
+      it->second = session;
+      return;
+   }
+
+   if(mClientSessions.size() >= BaseSecurity::TlsClientSessionCacheSize)
+   {
+      // drop expired sessions first, then an arbitrary one
+      const long now = (long)time(0);
+      for(it = mClientSessions.begin(); it != mClientSessions.end(); )
+      {
+         if(SSL_SESSION_get_time(it->second) + SSL_SESSION_get_timeout(it->second) <= now)
+         {
+            SSL_SESSION_free(it->second);
+            mClientSessions.erase(it++);
+         }
+         else
+         {
+            ++it;
+         }
+      }
+      if(mClientSessions.size() >= BaseSecurity::TlsClientSessionCacheSize)
+      {
+         SSL_SESSION_free(mClientSessions.begin()->second);
+         mClientSessions.erase(mClientSessions.begin());
+      }
+   }
+   mClientSessions[destination] = session;
+}
+
+void
+TlsBaseTransport::removeClientSession(const Data& destination)
+{
+   ClientSessionMap::iterator it = mClientSessions.find(destination);
+   if(it != mClientSessions.end())
+   {
+      SSL_SESSION_free(it->second);
+      mClientSessions.erase(it);
+   }
+}
+
 Connection* 
 TlsBaseTransport::createConnection(const Tuple& who, Socket fd, bool server)
 {
@@ -12,6 +12,7 @@
 #include "resip/stack/Compression.hxx"
 
 #include <openssl/ssl.h>
+#include <map>
 
 namespace resip
 {
@@ -76,6 +77,15 @@ class TlsBaseTransport : public TcpBaseTransport
          void *func,
          void *arg);
 
+      /** Client side session resumption, see
+          BaseSecurity::TlsClientSessionCacheSize.  Sessions are keyed by
+          destination and only touched by the thread processing this
+          transport's connections. */
+      SSL_SESSION* findClientSession(const Data& destination) const;
+      /// takes over the reference to session
+      void storeClientSession(const Data& destination, SSL_SESSION* session);
+      void removeClientSession(const Data& destination);
+
    protected:
       Connection* createConnection(const Tuple& who, Socket fd, bool server=false);
 
@@ -90,6 +100,9 @@ class TlsBaseTransport : public TcpBaseTransport
       const Data mCertificateFilename;
       const Data mPrivateKeyFilename;
       const Data mPrivateKeyPassPhrase;
+
+      typedef std::map<Data, SSL_SESSION*> ClientSessionMap;
+      ClientSessionMap mClientSessions;
 };
 
 }
@@ -56,6 +56,13 @@ inline bool handleOpenSSLErrorQueue(int ret, unsigned long err, const char* op)
    return hadReason;
 }
 
+static int
+connectionExIndex()
+{
+   static int index = SSL_get_ex_new_index(0, 0, 0, 0, 0);
+   return index;
+}
+
 TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple, 
                               Socket fd, Security* security, 
                               bool server, Data domain,  SecurityTypes::SSLType sslType ,
@@ -64,7 +71,8 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
    mServer(server),
    mSecurity(security),
    mSslType( sslType ),
-   mDomain(domain)
+   mDomain(domain),
+   mSessionOffered(false)
 {
 #if defined(USE_SSL)
    InfoLog (<< "Creating TLS connection for domain " 
@@ -135,6 +143,11 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
    
    SSL_set_bio( mSsl, mBio, mBio );
 
+   if (!mServer && BaseSecurity::TlsClientSessionCacheSize > 0)
+   {
+      SSL_set_ex_data(mSsl, connectionExIndex(), this);
+   }
+
    mTlsState = Initial;
    mHandShakeWantsRead = false;
 
@@ -144,6 +157,7 @@ TlsConnection::TlsConnection( Transport* transport, const Tuple& tuple,
 TlsConnection::~TlsConnection()
 {
 #if defined(USE_SSL)
+   SSL_set_ex_data(mSsl, connectionExIndex(), 0);
    ERR_clear_error();
    int ret = SSL_shutdown(mSsl);
    if(ret < 0)
@@ -183,6 +197,25 @@ TlsConnection::fromState(TlsConnection::TlsState s)
    return "????";
 }
 
+int
+TlsConnection::onNewSession(SSL* ssl, SSL_SESSION* session)
+{
+#if defined(USE_SSL)
+   TlsConnection* conn = static_cast<TlsConnection*>(SSL_get_ex_data(ssl, connectionExIndex()));
+   if (conn == 0 || conn->mServer || conn->mSessionDestination.empty())
+   {
+      return 0;
+   }
+   TlsBaseTransport *t = dynamic_cast<TlsBaseTransport*>(conn->transport());
+   resip_assert(t);
+   StackLog( << "Caching TLS session for " << conn->mSessionDestination );
+   t->storeClientSession(conn->mSessionDestination, session);
+   return 1; // the transport keeps the reference
+#else
+   return 0;
+#endif // USE_SSL
+}
+
 TlsConnection::TlsState
 TlsConnection::checkState()
 {
@@ -214,6 +247,18 @@ TlsConnection::checkState()
             DebugLog ( << "TLS SNI extension in Client Hello: " << who().getTargetDomain());
             SSL_set_tlsext_host_name(mSsl,who().getTargetDomain().c_str()); // set the SNI hostname
 #endif
+         if (BaseSecurity::TlsClientSessionCacheSize > 0)
+         {
+            TlsBaseTransport *t = dynamic_cast<TlsBaseTransport*>(transport());
+            resip_assert(t);
+            mSessionDestination = who().getTargetDomain() + " " + Tuple::inet_ntop(who()) + ":" + Data(who().getPort());
+            SSL_SESSION* session = t->findClientSession(mSessionDestination);
+            if (session && SSL_set_session(mSsl, session) == 1)
+            {
+               DebugLog( << "Offering cached TLS session for " << mSessionDestination );
+               mSessionOffered = true;
+            }
+         }
          SSL_set_connect_state(mSsl);
          mTlsState = Handshaking;
       }
@@ -328,6 +373,13 @@ TlsConnection::checkState()
             }
             ErrLog( << "TLS handshake failed ");
             handleOpenSSLErrorQueue(ok, err, "SSL_do_handshake");
+            if (mSessionOffered)
+            {
+               // don't offer a session the peer may be choking on again
+               TlsBaseTransport *t = dynamic_cast<TlsBaseTransport*>(transport());
+               resip_assert(t);
+               t->removeClientSession(mSessionDestination);
+            }
             mBio = NULL;
             mTlsState = Broken;
             return mTlsState;
@@ -338,6 +390,28 @@ TlsConnection::checkState()
       InfoLog( << "TLS connected" );
    }
 
+   const bool resumed = SSL_session_reused(mSsl) == 1;
+   DebugLog( << "TLS session " << (resumed ? "resumed" : "established") );
+   mSecurity->onTlsHandshake(mServer, mSessionOffered, resumed);
+   if (resumed && !mServer && !mSessionDestination.empty())
+   {
+      // a TLS 1.2 server may renew the ticket of a resumed session, OpenSSL
+      // doesn't hand that session to onNewSession
+      TlsBaseTransport *t = dynamic_cast<TlsBaseTransport*>(transport());
+      resip_assert(t);
+      SSL_SESSION* session = SSL_get_session(mSsl);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L && !defined(LIBRESSL_VERSION_NUMBER)
+      if (session && !SSL_SESSION_is_resumable(session))
+      {
+         session = 0;
+      }
+#endif
+      if (session && session != t->findClientSession(mSessionDestination))
+      {
+         t->storeClientSession(mSessionDestination, SSL_get1_session(mSsl));
+      }
+   }
+
    // force peer name to get checked and perhaps cert loaded
    computePeerName();
 
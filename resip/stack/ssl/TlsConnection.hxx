@@ -53,6 +53,9 @@ class TlsConnection : public Connection
       
       typedef enum TlsState { Initial, Broken, Handshaking, Up } TlsState;
       static const char * fromState(TlsState);
+
+      /// SSL_CTX_sess_set_new_cb() callback, stores client sessions in the transport
+      static int onNewSession(SSL* ssl, SSL_SESSION* session);
    
    private:
       /// No default c'tor
@@ -69,6 +72,9 @@ class TlsConnection : public Connection
       TlsState mTlsState;
       bool mHandShakeWantsRead;
 
+      Data mSessionDestination; // client side session cache key
+      bool mSessionOffered;
+
       SSL* mSsl;
       BIO* mBio;
       std::list<BaseSecurity::PeerName> mPeerNames;
@@ -0,0 +1,182 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <iostream>
+#include <vector>
+
+#include "resip/stack/ConnectionManager.hxx"
+#include "resip/stack/TcpTransport.hxx"
+#include "resip/stack/TransactionMessage.hxx"
+#include "rutil/Fifo.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// Enough connections to make a std::map walk show up against a hash lookup.
+static const unsigned int NumConnections = 100000;
+// The connections never get a real socket; their flow keys are picked well
+// above anything this process has open, so closing them is harmless.
+static const Socket FirstFakeSocket = 65536;
+
+static Tuple
+clientTuple(unsigned int i)
+{
+   Data addr("10.");
+   addr += Data((i >> 16) & 0xFF);
+   addr += ".";
+   addr += Data((i >> 8) & 0xFF);
+   addr += ".";
+   addr += Data(i & 0xFF);
+   return Tuple(addr, 5060 + (i % 7), V4, TCP);
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   Fifo<TransactionMessage> rxFifo;
+   TcpTransport transport(rxFifo, 0, V4, "127.0.0.1");
+   ConnectionManager& manager = transport.getConnectionManager();
+
+   vector<Tuple> tuples;
+   tuples.reserve(NumConnections);
+   for (unsigned int i = 0; i < NumConnections; ++i)
+   {
+      tuples.push_back(clientTuple(i));
+   }
+
+   UInt64 start = Timer::getTimeMs();
+   for (unsigned int i = 0; i < NumConnections; ++i)
+   {
+      new Connection(&transport, tuples[i], FirstFakeSocket + i, Compression::Disabled, true);
+   }
+   UInt64 inserted = Timer::getTimeMs();
+
+   unsigned int found = 0;
+   for (int pass = 0; pass < 10; ++pass)
+   {
+      for (unsigned int i = 0; i < NumConnections; ++i)
+      {
+         if (manager.findConnection(tuples[i]))
+         {
+            ++found;
+         }
+      }
+   }
+   UInt64 byAddr = Timer::getTimeMs();
+   assert(found == 10 * NumConnections);
+
+   found = 0;
+   for (int pass = 0; pass < 10; ++pass)
+   {
+      for (unsigned int i = 0; i < NumConnections; ++i)
+      {
+         Tuple t(tuples[i]);
+         t.mFlowKey = FirstFakeSocket + i;
+         t.onlyUseExistingConnection = true;
+         Connection* conn = manager.findConnection(t);
+         if (conn && conn->getSocket() == Socket(FirstFakeSocket + i))
+         {
+            ++found;
+         }
+      }
+   }
+   UInt64 byId = Timer::getTimeMs();
+   assert(found == 10 * NumConnections);
+
+   // a flow key that is not in use, or belongs to a different peer, misses
+   {
+      Tuple t(tuples[0]);
+      t.mFlowKey = FirstFakeSocket + NumConnections + 1;
+      t.onlyUseExistingConnection = true;
+      assert(manager.findConnection(t) == 0);
+      t.mFlowKey = FirstFakeSocket + 1;
+      assert(manager.findConnection(t) == 0);
+      assert(manager.findConnection(clientTuple(NumConnections + 1)) == 0);
+   }
+
+   // Let every connection age past the threshold, then have the next new
+   // connection sweep them all off the LRU list.
+   while (Timer::getTimeMs() < byId + 5)
+   {
+   }
+   ConnectionManager::MinimumGcAge = 1;
+   ConnectionManager::EnableAgressiveGc = true;
+   UInt64 gcStart = Timer::getTimeMs();
+   Connection* last = new Connection(&transport, clientTuple(NumConnections), FirstFakeSocket + NumConnections,
+                                     Compression::Disabled, true);
+   UInt64 gcDone = Timer::getTimeMs();
+   ConnectionManager::EnableAgressiveGc = false;
+
+   for (unsigned int i = 0; i < NumConnections; i += 997)
+   {
+      assert(manager.findConnection(tuples[i]) == 0);
+   }
+   assert(manager.findConnection(clientTuple(NumConnections)) == last);
+   delete last;
+   assert(manager.findConnection(clientTuple(NumConnections)) == 0);
+
+   cerr << NumConnections << " connections: insert " << (inserted - start) << "ms, "
+        << 10 * NumConnections << " lookups by tuple " << (byAddr - inserted) << "ms, "
+        << 10 * NumConnections << " lookups by flow key " << (byId - byAddr) << "ms, "
+        << "LRU gc of all " << (gcDone - gcStart) << "ms" << endl;
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,399 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <climits>
+#include <iostream>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "resip/stack/SendData.hxx"
+#include "resip/stack/TcpConnection.hxx"
+#include "resip/stack/TcpTransport.hxx"
+#include "resip/stack/TransactionMessage.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Fifo.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// A TcpConnection whose writes can be held to a few bytes per call, or made
+// to write nothing every other call (as when the socket would block), and
+// which counts what performGatherWrite() hands it.
+class ShortWriteConnection : public TcpConnection
+{
+   public:
+      ShortWriteConnection(Transport* transport, const Tuple& who, Socket fd) :
+         TcpConnection(transport, who, fd, Compression::Disabled, false),
+         mMaxWrite(0),
+         mNoGather(false),
+         mStall(false),
+         mStalled(false),
+         mGatherCalls(0),
+         mMostBuffers(0),
+         mShortWrites(0)
+      {
+      }
+
+      void useWebSocketFraming() { mSendingTransmissionFormat = WebSocketData; }
+      bool idle() const { return mOutstandingSends.empty(); }
+
+      unsigned int mMaxWrite;  // if not 0, no write call writes more than this
+      bool mNoGather;  // send one buffer at a time through write()
+      bool mStall;  // every other write call writes nothing
+      bool mStalled;
+      int mGatherCalls;
+      int mMostBuffers;
+      int mShortWrites;  // calls that wrote less than they were handed
+
+   protected:
+      virtual bool supportsGatherWrite() const
+      {
+         return !mNoGather;
+      }
+
+      virtual int write(const char* buffer, const int count)
+      {
+         if (stall())
+         {
+            return 0;
+         }
+         int size = count;
+         if (mMaxWrite && size > int(mMaxWrite))
+         {
+            size = int(mMaxWrite);
+         }
+         return TcpConnection::write(buffer, size);
+      }
+
+      virtual int writeGather(const WriteBuffer* buffers, int count)
+      {
+         if (stall())
+         {
+            return 0;
+         }
+         ++mGatherCalls;
+         if (count > mMostBuffers)
+         {
+            mMostBuffers = count;
+         }
+
+         WriteBuffer capped[32] = { { 0, 0 } };
+         int cappedCount = 0;
+         int totalSize = 0;
+         int budget = mMaxWrite ? int(mMaxWrite) : INT_MAX;
+         for (int i = 0; i < count; ++i)
+         {
+            totalSize += buffers[i].mSize;
+            if (budget > 0 && cappedCount < 32)
+            {
+               capped[cappedCount] = buffers[i];
+               if (capped[cappedCount].mSize > budget)
+               {
+                  capped[cappedCount].mSize = budget;
+               }
+               budget -= capped[cappedCount].mSize;
+               ++cappedCount;
+            }
+         }
+
+         int written = TcpConnection::writeGather(capped, cappedCount);
+         if (written > 0 && written < totalSize)
+         {
+            ++mShortWrites;
+         }
+         return written;
+      }
+
+   private:
+      bool stall()
+      {
+         mStalled = mStall && !mStalled;
+         return mStalled;
+      }
+};
+
+static Data
+readAvailable(Socket fd, size_t max)
+{
+   Data result;
+   char buffer[8192];
+   while (result.size() < max)
+   {
+      size_t want = max - result.size();
+      if (want > sizeof(buffer))
+      {
+         want = sizeof(buffer);
+      }
+      int n = (int)::recv(fd, buffer, want, 0);
+      if (n <= 0)
+      {
+         break;
+      }
+      result.append(buffer, n);
+   }
+   return result;
+}
+
+// Queues messages on conn, and writes them out while reading at most
+// readChunk bytes from the other end between writes; returns what arrived.
+static Data
+sendAll(ShortWriteConnection* conn, Socket peer, const vector<Data>& messages, size_t readChunk)
+{
+   for (vector<Data>::const_iterator it = messages.begin(); it != messages.end(); ++it)
+   {
+      conn->requestWrite(new SendData(Tuple(), *it, Data::Empty, Data::Empty));
+   }
+
+   Data received;
+   while (!conn->idle())
+   {
+      int n = conn->performWrite();
+      assert(n >= 0);
+      received += readAvailable(peer, readChunk);
+   }
+   received += readAvailable(peer, (size_t)-1);
+   return received;
+}
+
+static vector<Data>
+makeMessages(const unsigned int* sizes, int count)
+{
+   vector<Data> messages;
+   for (int i = 0; i < count; ++i)
+   {
+      Data message(Data::Take, new char[sizes[i]], sizes[i]);
+      for (unsigned int c = 0; c < sizes[i]; ++c)
+      {
+         const_cast<char*>(message.data())[c] = char('a' + (i + c / 100) % 26);
+      }
+      messages.push_back(message);
+   }
+   return messages;
+}
+
+// RFC 6455 header of an unmasked, final, binary frame
+static Data
+wsFrameHeader(UInt64 size)
+{
+   Data header;
+   header += char(0x82);
+   if (size <= 125)
+   {
+      header += char(size);
+   }
+   else if (size <= 0xFFFF)
+   {
+      header += char(126);
+      header += char((size >> 8) & 0xFF);
+      header += char(size & 0xFF);
+   }
+   else
+   {
+      header += char(127);
+      for (int i = 7; i >= 0; --i)
+      {
+         header += char((size >> (8 * i)) & 0xFF);
+      }
+   }
+   return header;
+}
+
+static void
+makeSocketPair(Socket fds[2], int sendBufferSize)
+{
+   int rc = socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+   assert(rc == 0);
+   makeSocketNonBlocking(fds[0]);
+   makeSocketNonBlocking(fds[1]);
+   if (sendBufferSize)
+   {
+      rc = setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize));
+      assert(rc == 0);
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   Fifo<TransactionMessage> rxFifo;
+   TcpTransport transport(rxFifo, 0, V4, "127.0.0.1");
+
+   {
+      // Plain stream: a backlog of messages is gathered into writev calls,
+      // and a small send buffer cuts those short at arbitrary points
+      vector<unsigned int> sizes;
+      for (int i = 0; i < 200; ++i)
+      {
+         sizes.push_back((i * 977) % 3000 + 1);
+      }
+      vector<Data> messages = makeMessages(&sizes[0], (int)sizes.size());
+      Data expected;
+      for (vector<Data>::const_iterator it = messages.begin(); it != messages.end(); ++it)
+      {
+         expected += *it;
+      }
+
+      Socket fds[2];
+      makeSocketPair(fds, 4096);
+      ShortWriteConnection* conn = new ShortWriteConnection(&transport, Tuple("127.0.0.1", 5061, V4, TCP), fds[0]);
+      Data received = sendAll(conn, fds[1], messages, 1500);
+
+      assert(received == expected);
+      assert(conn->mMostBuffers > 1);
+      assert(conn->mShortWrites > 0);
+      cerr << "plain: " << messages.size() << " messages, " << received.size() << " bytes in "
+           << conn->mGatherCalls << " writev calls, " << conn->mShortWrites << " short" << endl;
+
+      delete conn;
+      closeSocket(fds[1]);
+   }
+
+   {
+      // With room in the socket, queued sends go out 16 to a writev
+      const unsigned int size = 100;
+      vector<unsigned int> sizes(200, size);
+      vector<Data> messages = makeMessages(&sizes[0], (int)sizes.size());
+      Data expected;
+      for (vector<Data>::const_iterator it = messages.begin(); it != messages.end(); ++it)
+      {
+         expected += *it;
+      }
+
+      Socket fds[2];
+      makeSocketPair(fds, 0);
+      ShortWriteConnection* conn = new ShortWriteConnection(&transport, Tuple("127.0.0.1", 5062, V4, TCP), fds[0]);
+      Data received = sendAll(conn, fds[1], messages, (size_t)-1);
+
+      assert(received == expected);
+      assert(conn->mMostBuffers == 16);
+      assert(conn->mGatherCalls == 13);
+      assert(conn->mShortWrites == 0);
+
+      delete conn;
+      closeSocket(fds[1]);
+   }
+
+   // WebSocket frame sizes on either side of each header length change
+   const unsigned int wsSizes[] = { 1, 125, 126, 300, 65535, 65536, 70000, 10, 2000 };
+   const int wsCount = sizeof(wsSizes) / sizeof(wsSizes[0]);
+   vector<Data> wsMessages = makeMessages(wsSizes, wsCount);
+   Data wsExpected;
+   for (vector<Data>::const_iterator it = wsMessages.begin(); it != wsMessages.end(); ++it)
+   {
+      wsExpected += wsFrameHeader(it->size());
+      wsExpected += *it;
+   }
+
+   {
+      // WebSocket: the frame header goes out as its own iovec in front of the payload
+      Socket fds[2];
+      makeSocketPair(fds, 4096);
+      ShortWriteConnection* conn = new ShortWriteConnection(&transport, Tuple("127.0.0.1", 5063, V4, TCP), fds[0]);
+      conn->useWebSocketFraming();
+      Data received = sendAll(conn, fds[1], wsMessages, 1500);
+
+      assert(received == wsExpected);
+      assert(conn->mMostBuffers == 2);
+      assert(conn->mShortWrites > 0);
+
+      delete conn;
+      closeSocket(fds[1]);
+   }
+
+   for (unsigned int maxWrite = 1; maxWrite <= 13; maxWrite += 4)
+   {
+      // Writes of a few bytes at a time end inside the frame headers too,
+      // and the rest of the header must still go out before the payload
+      Socket fds[2];
+      makeSocketPair(fds, 0);
+      ShortWriteConnection* conn = new ShortWriteConnection(&transport, Tuple("127.0.0.1", 5064 + maxWrite, V4, TCP), fds[0]);
+      conn->useWebSocketFraming();
+      conn->mMaxWrite = maxWrite;
+      Data received = sendAll(conn, fds[1], wsMessages, (size_t)-1);
+
+      assert(received == wsExpected);
+      assert(conn->mGatherCalls >= int(wsExpected.size() / maxWrite));
+
+      delete conn;
+      closeSocket(fds[1]);
+   }
+
+   for (int gather = 0; gather < 2; ++gather)
+   {
+      // A write that gets nothing out must not frame the message again
+      Socket fds[2];
+      makeSocketPair(fds, 0);
+      ShortWriteConnection* conn = new ShortWriteConnection(&transport, Tuple("127.0.0.1", 5080 + gather, V4, TCP), fds[0]);
+      conn->useWebSocketFraming();
+      conn->mNoGather = !gather;
+      conn->mStall = true;
+      conn->mMaxWrite = 7;
+      Data received = sendAll(conn, fds[1], wsMessages, (size_t)-1);
+
+      assert(received == wsExpected);
+
+      delete conn;
+      closeSocket(fds[1]);
+   }
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,317 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "assert.h"
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/MsgHeaderScanner.hxx"
+#include "resip/stack/SipMessage.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+#define CRLF "\r\n"
+
+// Message headers as they arrive from real user agents and proxies, plus a
+// few that exercise the scanner's quote, angle bracket, escape and line
+// folding states across long values.
+static const char* corpus[] =
+{
+   "INVITE sip:bob@biloxi.example.com SIP/2.0" CRLF
+   "Via: SIP/2.0/TLS client.atlanta.example.com:5061;branch=z9hG4bK74bf9;received=192.0.2.101;rport=5061" CRLF
+   "Via: SIP/2.0/UDP 192.168.2.15:5100;branch=z9hG4bK-c87542-579667358-1--c87542-;rport=5100;received=192.168.2.15" CRLF
+   "Max-Forwards: 70" CRLF
+   "From: \"Alice, the \\\"first\\\" caller\" <sip:alice@atlanta.example.com;transport=tls>;tag=9fxced76sl" CRLF
+   "To: Bob <sip:bob@biloxi.example.com>" CRLF
+   "Call-ID: 3848276298220188511@atlanta.example.com" CRLF
+   "CSeq: 1 INVITE" CRLF
+   "Contact: <sip:alice@client.atlanta.example.com;transport=tls;ob>;+sip.instance=\"<urn:uuid:f81d4fae-7dec-11d0-a765-00a0c91e6bf6>\";reg-id=1" CRLF
+   "Record-Route: <sip:proxy1.example.com;lr;ftag=9fxced76sl>,<sip:proxy2.example.com:5080;transport=tcp;lr>" CRLF
+   "Supported: replaces, outbound, gruu, path, timer" CRLF
+   "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY, MESSAGE, SUBSCRIBE, INFO, UPDATE" CRLF
+   "User-Agent: Example Softphone 4.2.1 (Linux; x86_64) build 2211" CRLF
+   "Content-Type: application/sdp" CRLF
+   "Content-Length: 0" CRLF
+   CRLF,
+
+   "SIP/2.0 200 OK" CRLF
+   "Via: SIP/2.0/UDP 192.168.2.220:5060;branch=z9hG4bK-c87542-da4d3e6a.0-1--c87542-;rport=5060;received=192.168.2.220;stid=579667358" CRLF
+   "Via: SIP/2.0/UDP 192.168.2.15:5100;branch=z9hG4bK-c87542-579667358-1--c87542-;rport=5100;received=192.168.2.15" CRLF
+   "Record-Route: <sip:proxy@192.168.2.220:5060;lr>" CRLF
+   "From: Jason Fischl<sip:jason_AT_meet2talk.com@whistler.gloo.net>;tag=ba1aee2d" CRLF
+   "To: <sip:yiwen_AT_meet2talk.com@whistler.gloo.net>;tag=8321234356" CRLF
+   "Call-ID: 6c64b42fce01b007" CRLF
+   "CSeq: 2 INVITE" CRLF
+   "Contact: <sip:192.168.2.92:5100;q=1>" CRLF
+   "Server: Example PBX (3.1.4)" CRLF
+   "Content-Length: 0" CRLF
+   CRLF,
+
+   "REGISTER sip:registrar.biloxi.example.com SIP/2.0" CRLF
+   "Via: SIP/2.0/WSS df7jal23ls0d.invalid;branch=z9hG4bKasudf;rport" CRLF
+   "Max-Forwards: 70" CRLF
+   "To: <sip:bob@biloxi.example.com>" CRLF
+   "From: <sip:bob@biloxi.example.com>;tag=456248" CRLF
+   "Call-ID: 843817637684230@998sdasdh09" CRLF
+   "CSeq: 1826 REGISTER" CRLF
+   "Contact: <sip:bob@192.0.2.4:5060;transport=udp>;expires=3600;q=0.8," CRLF
+   "  <sips:bob@[2001:db8::10]:5061>;expires=1800;q=0.5" CRLF
+   "Authorization: Digest username=\"bob\", realm=\"biloxi.example.com\", nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\"," CRLF
+   "\turi=\"sip:registrar.biloxi.example.com\", response=\"245f23415f11432b3434341c022\", algorithm=MD5" CRLF
+   "Path: <sip:pcscf.example.com;lr>" CRLF
+   "Content-Length: 0" CRLF
+   CRLF,
+
+   // long values, escapes, comments and an empty header
+   "OPTIONS sip:user%20name@example.com;maddr=192.0.2.1 SIP/2.0" CRLF
+   "To: \"A very long display name that is certainly longer than one block, with commas, and <angle> brackets\" <sip:user@example.com>" CRLF
+   "From: sip:caller@example.net;tag=323" CRLF
+   "Via: SIP/2.0/TCP host1.example.com;branch=z9hG4bK-escaped-%41%42%43;comment=(not, a, list)" CRLF
+   "Call-ID: lwsdisp.1234abcd@funky.example.com" CRLF
+   "CSeq: 60 OPTIONS" CRLF
+   "Subject:" CRLF
+   "Accept: application/sdp;level=1, application/x-private, text/html;q=0.5, */*;q=0.1" CRLF
+   "Warning: 399 biloxi.example.com \"Incompatible network protocol; try \\\\ again later, or not\"" CRLF
+   "Contact: <sip:caller@u1.example.net;a=b,c=d>, \"x\" <sip:y@example.net>" CRLF
+   "l: 0" CRLF
+   CRLF,
+};
+
+struct ScanResult
+{
+      MsgHeaderScanner::ScanChunkResult result;
+      size_t offset;     // of *unprocessedCharPtr within the message text
+      unsigned int numHeaders;
+      Data encoded;
+};
+
+// Scans text the way ConnectionBase does, handing the scanner firstChunk
+// characters and then chunkSize more at a time, with the unprocessed tail of
+// each chunk copied to the start of the next.
+static ScanResult
+scan(const Data& text, size_t firstChunk, size_t chunkSize)
+{
+   ScanResult r;
+   vector<char*> buffers;  // the message's headers point into these
+   SipMessage* msg = new SipMessage;
+   MsgHeaderScanner scanner;
+   scanner.prepareForMessage(msg);
+
+   Data saved;
+   size_t pos = 0;
+   size_t len = firstChunk;
+   for (;;)
+   {
+      if (len > text.size() - pos)
+      {
+         len = text.size() - pos;
+      }
+      size_t total = saved.size() + len;
+      char* buffer = MsgHeaderScanner::allocateBuffer((int)total);
+      buffers.push_back(buffer);
+      memcpy(buffer, saved.data(), saved.size());
+      memcpy(buffer + saved.size(), text.data() + pos, len);
+      pos += len;
+
+      char* unprocessed;
+      r.result = scanner.scanChunk(buffer, (unsigned int)total, &unprocessed);
+      r.offset = pos - (buffer + total - unprocessed);
+      if (r.result != MsgHeaderScanner::scrNextChunk || pos == text.size())
+      {
+         break;
+      }
+      saved = Data(unprocessed, (Data::size_type)(buffer + total - unprocessed));
+      len = chunkSize;
+   }
+
+   r.numHeaders = scanner.getHeaderCount();
+   if (r.result == MsgHeaderScanner::scrEnd)
+   {
+      r.encoded = Data::from(*msg);
+   }
+   delete msg;
+   for (size_t i = 0; i < buffers.size(); ++i)
+   {
+      delete [] buffers[i];
+   }
+   return r;
+}
+
+static void
+assertSame(const ScanResult& expected, const ScanResult& got)
+{
+   assert(got.result == expected.result);
+   assert(got.offset == expected.offset);
+   assert(got.numHeaders == expected.numHeaders);
+   assert(got.encoded == expected.encoded);
+}
+
+// A chunk of one character is scanned one character at a time; any longer
+// chunk may skip runs of value characters a block at a time.  Every way of
+// cutting up the text must scan it the same.
+static void
+testChunking(const Data& text)
+{
+   ScanResult reference = scan(text, 1, 1);
+   assertSame(reference, scan(text, text.size(), 0));
+   for (size_t first = 1; first < text.size(); ++first)
+   {
+      assertSame(reference, scan(text, first, text.size()));
+   }
+   static const size_t sizes[] = { 2, 3, 7, 15, 16, 17, 31, 32, 33, 64, 100 };
+   for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i)
+   {
+      assertSame(reference, scan(text, sizes[i], sizes[i]));
+   }
+}
+
+static void
+testCorpus()
+{
+   for (size_t i = 0; i < sizeof(corpus) / sizeof(*corpus); ++i)
+   {
+      Data text(corpus[i]);
+      ScanResult r = scan(text, text.size(), 0);
+      assert(r.result == MsgHeaderScanner::scrEnd);
+      assert(r.offset == text.size());
+      testChunking(text);
+   }
+}
+
+static void
+testMalformed()
+{
+   Data text(corpus[0]);
+
+   // a stray line feed in the middle of a long value
+   Data lf(text);
+   Data::size_type at = lf.find("z9hG4bK74bf9") + 5;
+   lf[at] = '\n';
+   ScanResult r = scan(lf, lf.size(), 0);
+   assert(r.result == MsgHeaderScanner::scrError);
+   assert(r.offset == at);
+   testChunking(lf);
+
+   // nul characters in values are ordinary characters
+   Data nul(text);
+   nul[nul.find("9fxced76sl") + 2] = '\0';
+   nul[nul.find("Softphone") + 40] = '\0';
+   r = scan(nul, nul.size(), 0);
+   assert(r.result == MsgHeaderScanner::scrEnd);
+   testChunking(nul);
+
+   // the header doesn't end
+   Data truncated(text.data(), text.size() - 4);
+   r = scan(truncated, truncated.size(), 0);
+   assert(r.result == MsgHeaderScanner::scrNextChunk);
+   testChunking(truncated);
+}
+
+static void
+benchmark(int runs)
+{
+   size_t numChunks = sizeof(corpus) / sizeof(*corpus);
+   vector<char*> chunks;
+   vector<size_t> lengths;
+   size_t bytes = 0;
+   for (size_t i = 0; i < numChunks; ++i)
+   {
+      size_t len = strlen(corpus[i]);
+      char* chunk = MsgHeaderScanner::allocateBuffer((int)len);
+      memcpy(chunk, corpus[i], len);
+      chunks.push_back(chunk);
+      lengths.push_back(len);
+      bytes += len;
+   }
+
+   MsgHeaderScanner scanner;
+   UInt64 start = Timer::getTimeMicroSec();
+   for (int run = 0; run < runs; ++run)
+   {
+      for (size_t i = 0; i < numChunks; ++i)
+      {
+         SipMessage msg;
+         scanner.prepareForMessage(&msg);
+         char* unprocessed;
+         MsgHeaderScanner::ScanChunkResult result = scanner.scanChunk(chunks[i], (unsigned int)lengths[i], &unprocessed);
+         assert(result == MsgHeaderScanner::scrEnd);
+      }
+   }
+   UInt64 elapsed = Timer::getTimeMicroSec() - start;
+   if (elapsed == 0)
+   {
+      elapsed = 1;
+   }
+   cerr << "scanned " << runs * numChunks << " message headers ("
+        << (double)bytes * runs / elapsed << " MB/s, "
+        << (UInt64)((double)runs * numChunks * 1000000 / elapsed) << " headers/s)" << endl;
+
+   for (size_t i = 0; i < numChunks; ++i)
+   {
+      delete [] chunks[i];
+   }
+}
+
+int
+main(int argc, char** argv)
+{
+   Log::initialize(Log::Cout, Log::Warning, argv[0]);
+
+   testCorpus();
+   testMalformed();
+   benchmark(argc > 1 ? atoi(argv[1]) : 20000);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
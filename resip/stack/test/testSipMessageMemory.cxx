@@ -4,10 +4,65 @@
 
 #include <iostream>
 #include <memory>
+#include <new>
+#include <stdlib.h>
 
 using namespace resip;
 using namespace std;
 
+// Count every trip to the global heap, so we can see how much of a parsed
+// message ends up outside of the SipMessage's own pool.
+static unsigned long heapAllocations = 0;
+
+void* operator new(size_t size)
+{
+   ++heapAllocations;
+   void* p = malloc(size ? size : 1);
+   if (!p)
+   {
+      throw std::bad_alloc();
+   }
+   return p;
+}
+
+void operator delete(void* p) throw()
+{
+   free(p);
+}
+
+static unsigned long
+parseAllocations(const Data& txt)
+{
+   const unsigned long start = heapAllocations;
+   auto_ptr<SipMessage> msg(TestSupport::makeMessage(txt));
+
+   // touch everything, so the whole parse tree gets built
+   for (Vias::iterator i = msg->header(h_Vias).begin(); i != msg->header(h_Vias).end(); ++i)
+   {
+      assert(!i->param(p_branch).getTransactionId().empty());
+   }
+   for (NameAddrs::iterator i = msg->header(h_RecordRoutes).begin(); i != msg->header(h_RecordRoutes).end(); ++i)
+   {
+      assert(i->uri().exists(p_lr));
+   }
+   for (NameAddrs::iterator i = msg->header(h_Routes).begin(); i != msg->header(h_Routes).end(); ++i)
+   {
+      assert(i->uri().exists(p_lr));
+   }
+   assert(msg->header(h_Contacts).front().exists(p_expires));
+   assert(msg->header(h_From).exists(p_tag));
+   assert(msg->header(h_To).uri().user() == "bob");
+   assert(msg->header(h_CSeq).sequence() == 314159);
+   assert(!msg->header(h_CallId).value().empty());
+   assert(msg->header(h_MaxForwards).value() == 70);
+   assert(msg->header(h_Supporteds).size() == 3);
+   assert(msg->header(h_Allows).size() == 7);
+   assert(msg->header(h_ContentType).type() == "application");
+   assert(msg->header(h_UserAgent).value() == "testSipMessageMemory");
+
+   return heapAllocations - start;
+}
+
 int
 main()
 {
@@ -69,6 +124,41 @@ main()
       assert(message1->getRawHeader(Headers::CSeq)->getParserContainer());
    }
 
+   {
+      resipCerr << "Counting heap allocations per parsed message" << endl;
+
+      const Data txt("INVITE sip:bob@biloxi.example.com SIP/2.0\r\n"
+                     "Via: SIP/2.0/UDP proxy2.example.com:5060;branch=z9hG4bK721e418c4.1;received=192.0.2.3\r\n"
+                     "Via: SIP/2.0/TCP proxy1.example.com:5060;branch=z9hG4bK2d4790.1;received=192.0.2.2\r\n"
+                     "Via: SIP/2.0/TCP client.atlanta.example.com:5060;branch=z9hG4bK74bf9;received=192.0.2.101;rport=5060\r\n"
+                     "Max-Forwards: 70\r\n"
+                     "Record-Route: <sip:proxy2.example.com;lr>\r\n"
+                     "Record-Route: <sip:proxy1.example.com;lr;transport=tcp>\r\n"
+                     "Route: <sip:proxy3.example.com;lr>, <sip:proxy4.example.com;lr;ftag=9fxced76sl>\r\n"
+                     "From: \"Alice\" <sip:alice@atlanta.example.com>;tag=9fxced76sl\r\n"
+                     "To: \"Bob\" <sip:bob@biloxi.example.com>\r\n"
+                     "Call-ID: 3848276298220188511@atlanta.example.com\r\n"
+                     "CSeq: 314159 INVITE\r\n"
+                     "Contact: <sip:alice@client.atlanta.example.com;transport=tcp>;expires=3600;+sip.instance=\"<urn:uuid:00000000-0000-1000-8000-000A95A0E128>\"\r\n"
+                     "Supported: replaces, outbound, gruu\r\n"
+                     "Allow: INVITE, ACK, CANCEL, OPTIONS, BYE, REFER, NOTIFY\r\n"
+                     "User-Agent: testSipMessageMemory\r\n"
+                     "Content-Type: application/sdp\r\n"
+                     "Content-Length: 0\r\n\r\n");
+
+      // warm up anything that is allocated once per process
+      parseAllocations(txt);
+
+      const unsigned long runs = 1000;
+      unsigned long total = 0;
+      for (unsigned long i = 0; i < runs; ++i)
+      {
+         total += parseAllocations(txt);
+      }
+      resipCerr << "Heap allocations per message: " << total / runs
+                << " (sizeof(SipMessage) is " << sizeof(SipMessage) << " bytes)" << endl;
+   }
+
    resipCout << "All OK" << endl;
    return 0;
 }
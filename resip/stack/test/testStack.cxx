@@ -155,7 +155,8 @@ class SipStackAndThread
    public:
       SipStackAndThread(const char *tType,
         AsyncProcessHandler *notifyDn=0,
-        AsyncProcessHandler *notifyUp=0);
+        AsyncProcessHandler *notifyUp=0,
+        unsigned int tcShards=1);
          ~SipStackAndThread() {
          destroy();
       }
@@ -203,7 +204,8 @@ class SipStackAndThread
 
 
 SipStackAndThread::SipStackAndThread(const char *tType,
- AsyncProcessHandler *notifyDn, AsyncProcessHandler *notifyUp)
+ AsyncProcessHandler *notifyDn, AsyncProcessHandler *notifyUp,
+ unsigned int tcShards)
   : mStack(0), 
       mThread(0), 
       mSelIntr(0), 
@@ -249,6 +251,7 @@ SipStackAndThread::SipStackAndThread(const char *tType,
    options.mAsyncProcessHandler = mEventIntr?mEventIntr
       :(mSelIntr?mSelIntr:notifyDn);
    options.mPollGrp = mPollGrp;
+   options.mTransactionControllerShards = tcShards;
    mStack = new SipStack(options);
    
    mStack->setFallbackPostNotify(notifyUp);
@@ -594,6 +597,8 @@ main(int argc, char* argv[])
    int sendSleepMs = 0;
    int cManager=0;
    int statisticsInterval=60;
+   int tcShards=1;
+   int udpFanout=1;
 
 #if defined(HAVE_POPT_H)
 
@@ -620,6 +625,8 @@ main(int argc, char* argv[])
       {"sleep",       0,   POPT_ARG_INT,    &sendSleepMs,0, "time (ms) to sleep after each sent request", 0},
       {"use-congestion-manager",0, POPT_ARG_NONE, &cManager ,   0, "use a CongestionManager", 0},
       {"statistics-interval",       0,   POPT_ARG_INT,    &statisticsInterval,0, "time in seconds between statistics logging", 0},
+      {"tc-shards",   0,   POPT_ARG_INT,    &tcShards,  0, "number of TransactionController shards", 0},
+      {"udp-fanout",  0,   POPT_ARG_INT,    &udpFanout, 0, "number of SO_REUSEPORT sockets for the registrar's UDP port", 0},
       POPT_AUTOHELP
       { NULL, 0, 0, NULL, 0 }
    };
@@ -646,8 +653,17 @@ main(int argc, char* argv[])
      <<" bindIf="<<bindIfAddr
      <<" listen="<<doListen
      <<" tf="<<tpFlags
+     <<" tcshards="<<tcShards
+     <<" udpfanout="<<udpFanout
      <<"." << endl;
 
+   if ( udpFanout > 1 && strcmp(threadType,"multithreadedstack")!=0 )
+   {
+      // the fan-out threads are started by SipStack::run()
+      cerr << "--udp-fanout needs --thread-type=multithreadedstack" << endl;
+      return 1;
+   }
+
    const char *eachThreadType = threadType;
    SelectInterruptor *commonIntr = NULL;
    AsyncProcessHandler *notifyUp = NULL;
@@ -678,8 +694,8 @@ main(int argc, char* argv[])
    {
       notifyUp = &sharedUp;
    }
-   SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp);
-   SipStackAndThread sender(eachThreadType, commonIntr, notifyUp);
+   SipStackAndThread receiver(eachThreadType, commonIntr, notifyUp, tcShards);
+   SipStackAndThread sender(eachThreadType, commonIntr, notifyUp, tcShards);
    receiver.getStack().setStatisticsInterval(statisticsInterval);
    sender.getStack().setStatisticsInterval(statisticsInterval);
 
@@ -734,7 +750,9 @@ main(int argc, char* argv[])
 
       // NOTE: we could also bind receive to bindIfAddr, but existing code
       // doesn't do this. Responses are sent from here, so why don't we?
-      transports.push_back(receiver->addTransport(UDP, 
+      // The stack runs the threads of a fan-out itself, so a fanned-out
+      // transport is left out of the OWNTHREAD threads started below
+      Transport* registrarUdp = receiver->addTransport(UDP, 
                              registrarPort+idx, 
                              version, 
                              StunDisabled,
@@ -742,7 +760,18 @@ main(int argc, char* argv[])
                              /*sipDomain*/Data::Empty, 
                              /*keypass*/Data::Empty, 
                              SecurityTypes::TLSv1,
-                             tpFlags));
+                             tpFlags,
+                             /*cert*/Data::Empty, /*key*/Data::Empty,
+                             SecurityTypes::None,
+                             /*useEmailAsSIP*/false,
+                             SharedPtr<WsConnectionValidator>(),
+                             SharedPtr<WsCookieContextFactory>(),
+                             /*netns*/Data::Empty,
+                             udpFanout);
+      if ( udpFanout <= 1 )
+      {
+         transports.push_back(registrarUdp);
+      }
 
       transports.push_back(receiver->addTransport(TCP, 
                              registrarPort+idx, 
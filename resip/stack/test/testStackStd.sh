@@ -13,9 +13,17 @@ echo "Running TCP REGISTER test (threaded stack)"
 ./testStack --protocol=tcp --thread-type=multithreadedstack
 echo "Running TCP REGISTER test (threaded stack, threaded transports)"
 ./testStack --protocol=tcp --thread-type=multithreadedstack --tf=32
+echo "Running TCP REGISTER test (threaded stack, 4 transaction shards)"
+./testStack --protocol=tcp --thread-type=multithreadedstack --tc-shards=4
 echo "Running UDP REGISTER test"
 ./testStack --protocol=udp
+echo "Running UDP REGISTER test (batched recvmmsg/sendmmsg)"
+./testStack --protocol=udp --tf=70
+echo "Running UDP REGISTER test (4 SO_REUSEPORT registrar sockets)"
+./testStack --protocol=udp --udp-fanout=4
 echo "Running TCP REGISTER test with 50 ports"
 ./testStack --protocol=tcp --numports=50
 echo "Running TCP INVITE test"
 ./testStack --protocol=tcp --invite
+echo "Running TCP INVITE test (threaded stack, 4 transaction shards)"
+./testStack --protocol=tcp --invite --thread-type=multithreadedstack --tc-shards=4
@@ -0,0 +1,431 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "resip/stack/SendData.hxx"
+#include "resip/stack/TransactionMessage.hxx"
+#include "resip/stack/ssl/Security.hxx"
+#include "resip/stack/ssl/TlsTransport.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Fifo.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Time.hxx"
+#include "testPortOffset.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static const Data domain("example.test");
+
+// Writes a self-signed certificate for domain, with its key, to the
+// directories of the server and of the clients that are to trust it.
+static void
+makeCertificate(const Data& serverDir, const Data& clientDir)
+{
+   EVP_PKEY* key = 0;
+   EVP_PKEY_CTX* keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, 0);
+   assert(keyCtx);
+   assert(EVP_PKEY_keygen_init(keyCtx) == 1);
+   assert(EVP_PKEY_CTX_set_rsa_keygen_bits(keyCtx, 2048) == 1);
+   assert(EVP_PKEY_keygen(keyCtx, &key) == 1);
+   EVP_PKEY_CTX_free(keyCtx);
+
+   X509* cert = X509_new();
+   assert(cert);
+   X509_set_version(cert, 2);
+   ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+   X509_gmtime_adj(X509_get_notBefore(cert), -60);
+   X509_gmtime_adj(X509_get_notAfter(cert), 60*60*24);
+   X509_NAME* name = X509_get_subject_name(cert);
+   X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_UTF8, (const unsigned char*)domain.c_str(), -1, -1, 0);
+   X509_set_issuer_name(cert, name);
+   X509_set_pubkey(cert, key);
+
+   const Data altName("DNS:" + domain);
+   X509_EXTENSION* ext = X509V3_EXT_conf_nid(0, 0, NID_subject_alt_name, (char*)altName.c_str());
+   assert(ext);
+   X509_add_ext(cert, ext, -1);
+   X509_EXTENSION_free(ext);
+   ext = X509V3_EXT_conf_nid(0, 0, NID_basic_constraints, (char*)"critical,CA:TRUE");
+   assert(ext);
+   X509_add_ext(cert, ext, -1);
+   X509_EXTENSION_free(ext);
+   assert(X509_sign(cert, key, EVP_sha256()));
+
+   const Data files[] = { serverDir + "/domain_cert_" + domain + ".pem",
+                          serverDir + "/domain_key_" + domain + ".pem",
+                          clientDir + "/root_cert_" + domain + ".pem" };
+   for (int i = 0; i < 3; ++i)
+   {
+      FILE* fp = fopen(files[i].c_str(), "w");
+      assert(fp);
+      if (i == 1)
+      {
+         assert(PEM_write_PrivateKey(fp, key, 0, 0, 0, 0, 0));
+      }
+      else
+      {
+         assert(PEM_write_X509(fp, cert));
+      }
+      fclose(fp);
+   }
+
+   X509_free(cert);
+   EVP_PKEY_free(key);
+}
+
+static void
+removeDirectory(const Data& dir)
+{
+   unlink((dir + "/domain_cert_" + domain + ".pem").c_str());
+   unlink((dir + "/domain_key_" + domain + ".pem").c_str());
+   unlink((dir + "/root_cert_" + domain + ".pem").c_str());
+   rmdir(dir.c_str());
+}
+
+static Data
+makeDirectory()
+{
+   char dir[] = "/tmp/testTlsResumption.XXXXXX";
+   assert(mkdtemp(dir));
+   return Data(dir);
+}
+
+class TlsResumptionTest
+{
+   public:
+      TlsResumptionTest(Security& serverSecurity, Security& clientSecurity, int port) :
+         mClientSecurity(clientSecurity),
+         mServerSecurity(serverSecurity),
+         mServer(mServerFifo, port, V4, "127.0.0.1", serverSecurity, domain, SecurityTypes::SSLv23),
+         mDestination("127.0.0.1", port, V4, TLS),
+         mSessionKey(domain + " 127.0.0.1:" + Data(port)),
+         mRequests(0)
+      {
+         mDestination.setTargetDomain(domain);
+      }
+
+      ~TlsResumptionTest()
+      {
+         for (vector<TlsTransport*>::iterator it = mClients.begin(); it != mClients.end(); ++it)
+         {
+            delete *it;
+         }
+      }
+
+      // Each client transport keeps a session cache of its own
+      TlsTransport& addClient()
+      {
+         mClients.push_back(new TlsTransport(mClientFifo, 0, V4, "127.0.0.1", mClientSecurity, Data::Empty, SecurityTypes::SSLv23));
+         return *mClients.back();
+      }
+
+      SSL_SESSION* session(TlsTransport& client) const
+      {
+         return client.findClientSession(mSessionKey);
+      }
+
+      // Sends a request from client over a connection of its own, and waits
+      // for it to arrive, and for any session ticket that comes after the
+      // handshake; then closes the connection.  Returns whether the client
+      // resumed a session.
+      bool connect(TlsTransport& client)
+      {
+         const BaseSecurity::TlsSessionStats clientBefore = mClientSecurity.getTlsSessionStats();
+         const BaseSecurity::TlsSessionStats serverBefore = mServerSecurity.getTlsSessionStats();
+         SSL_SESSION* sessionBefore = session(client);
+
+         ++mRequests;
+         Data request("OPTIONS sip:" + domain + " SIP/2.0\r\n"
+                      "Via: SIP/2.0/TLS 127.0.0.1:5061;branch=z9hG4bK-" + Data(mRequests) + "\r\n"
+                      "Max-Forwards: 70\r\n"
+                      "To: <sip:" + domain + ">\r\n"
+                      "From: <sip:client@" + domain + ">;tag=" + Data(mRequests) + "\r\n"
+                      "Call-ID: " + Data(mRequests) + "\r\n"
+                      "CSeq: 1 OPTIONS\r\n"
+                      "Content-Length: 0\r\n"
+                      "\r\n");
+         client.send(client.makeSendData(mDestination, request, Data(mRequests)));
+
+         bool received = false;
+         const UInt64 deadline = Timer::getTimeMs() + 5000;
+         UInt64 settled = 0;
+         while (!settled || Timer::getTimeMs() < settled)
+         {
+            assert(Timer::getTimeMs() < deadline);
+            process(client);
+            while (mServerFifo.messageAvailable())
+            {
+               delete mServerFifo.getNext();
+               received = true;
+            }
+            if (!settled && received)
+            {
+               // a TLS 1.3 server sends its tickets once the handshake is done
+               settled = Timer::getTimeMs() + (session(client) != sessionBefore ? 20 : 200);
+            }
+         }
+
+         Connection* conn = client.getConnectionManager().findConnection(mDestination);
+         assert(conn);
+         delete conn;
+         for (int i = 0; i < 10; ++i)
+         {
+            process(client);
+         }
+
+         const BaseSecurity::TlsSessionStats clientAfter = mClientSecurity.getTlsSessionStats();
+         const BaseSecurity::TlsSessionStats serverAfter = mServerSecurity.getTlsSessionStats();
+         assert(clientAfter.mClientHandshakes == clientBefore.mClientHandshakes + 1);
+         assert(serverAfter.mServerHandshakes == serverBefore.mServerHandshakes + 1);
+         // a session is offered whenever the client has one for the server
+         assert(clientAfter.mClientOffered == clientBefore.mClientOffered + (sessionBefore ? 1 : 0));
+         const bool resumed = clientAfter.mClientResumed > clientBefore.mClientResumed;
+         assert(serverAfter.mServerResumed == serverBefore.mServerResumed + (resumed ? 1 : 0));
+         assert(!resumed || sessionBefore);
+         // and the client comes away with a session to offer next time
+         assert(session(client));
+         return resumed;
+      }
+
+      SSL_CTX* serverCtx() const
+      {
+         return mServer.getCtx();
+      }
+
+   private:
+      void process(TlsTransport& client)
+      {
+         FdSet fdset;
+         mServer.buildFdSet(fdset);
+         client.buildFdSet(fdset);
+         fdset.selectMilliSeconds(5);
+         mServer.process(fdset);
+         client.process(fdset);
+         while (mClientFifo.messageAvailable())
+         {
+            delete mClientFifo.getNext();
+         }
+      }
+
+      Fifo<TransactionMessage> mServerFifo;
+      Fifo<TransactionMessage> mClientFifo;
+      Security& mClientSecurity;
+      Security& mServerSecurity;
+      TlsTransport mServer;
+      Tuple mDestination;
+      Data mSessionKey;
+      vector<TlsTransport*> mClients;
+      unsigned int mRequests;
+};
+
+static void
+limitVersion(SSL_CTX* ctx, int maxVersion)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+   SSL_CTX_set_max_proto_version(ctx, maxVersion);
+#endif
+}
+
+// With a ticket key lifetime of 1 second
+static void
+testTicketRotation(const Data& serverDir, const Data& clientDir, int port, int maxVersion)
+{
+   Security serverSecurity(serverDir);
+   Security clientSecurity(clientDir);
+   clientSecurity.preload();
+   TlsResumptionTest test(serverSecurity, clientSecurity, port);
+   limitVersion(test.serverCtx(), maxVersion);
+
+   TlsTransport& a = test.addClient();
+   TlsTransport& b = test.addClient();
+   TlsTransport& c = test.addClient();
+
+   // The first connection is a full handshake, later ones resume
+   assert(!test.connect(a));
+   assert(test.connect(a));
+   assert(test.connect(a));
+   assert(!test.connect(c));
+
+   // a and c hold tickets under the first key; once that is due, the next
+   // ticket issued (to b) is made with a new one
+   sleepMs(1100);
+   assert(!test.connect(b));
+   // Tickets made with the previous key are still good ...
+   assert(test.connect(a));
+   // ... until the current key is due in turn
+   sleepMs(1100);
+   assert(!test.connect(c));
+   // and then the renewed ticket works again
+   assert(test.connect(c));
+   assert(test.connect(a));
+}
+
+// With tickets off, sessions are resumed from the server's session cache
+static void
+testSessionCache(const Data& serverDir, const Data& clientDir, int port, int maxVersion)
+{
+   Security serverSecurity(serverDir);
+   Security clientSecurity(clientDir);
+   clientSecurity.preload();
+   TlsResumptionTest test(serverSecurity, clientSecurity, port);
+   assert(SSL_CTX_get_options(test.serverCtx()) & SSL_OP_NO_TICKET);
+   limitVersion(test.serverCtx(), maxVersion);
+
+   TlsTransport& a = test.addClient();
+   assert(!test.connect(a));
+   assert(test.connect(a));
+   assert(test.connect(a));
+}
+
+// The client session cache holds one session per destination, up to
+// TlsClientSessionCacheSize of them
+static void
+testClientSessionCache(const Data& clientDir)
+{
+   Security clientSecurity(clientDir);
+   Fifo<TransactionMessage> fifo;
+   TlsTransport client(fifo, 0, V4, "127.0.0.1", clientSecurity, Data::Empty, SecurityTypes::SSLv23);
+
+   const unsigned long cacheSize = BaseSecurity::TlsClientSessionCacheSize;
+   BaseSecurity::TlsClientSessionCacheSize = 2;
+
+   SSL_SESSION* a = SSL_SESSION_new();
+   SSL_SESSION* b = SSL_SESSION_new();
+   client.storeClientSession("a", a);
+   client.storeClientSession("b", b);
+   assert(client.findClientSession("a") == a);
+   assert(client.findClientSession("b") == b);
+
+   // replacing the session of a destination doesn't push another one out
+   SSL_SESSION* b2 = SSL_SESSION_new();
+   client.storeClientSession("b", b2);
+   assert(client.findClientSession("a") == a);
+   assert(client.findClientSession("b") == b2);
+
+   // a new destination does, once the cache is full
+   SSL_SESSION* c = SSL_SESSION_new();
+   client.storeClientSession("c", c);
+   assert(client.findClientSession("c") == c);
+   assert((client.findClientSession("a") != 0) + (client.findClientSession("b") != 0) == 1);
+
+   // expired sessions are the first to go
+   SSL_SESSION_set_time(c, (long)time(0) - 100);
+   SSL_SESSION_set_timeout(c, 10);
+   SSL_SESSION* d = SSL_SESSION_new();
+   client.storeClientSession("d", d);
+   assert(client.findClientSession("c") == 0);
+   assert(client.findClientSession("d") == d);
+   assert((client.findClientSession("a") != 0) + (client.findClientSession("b") != 0) == 1);
+
+   client.removeClientSession("d");
+   assert(client.findClientSession("d") == 0);
+   client.removeClientSession("d");
+
+   BaseSecurity::TlsClientSessionCacheSize = cacheSize;
+}
+
+int
+main(int argc, char* argv[])
+{
+#ifndef _WIN32
+   signal(SIGPIPE, SIG_IGN);
+#endif
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   // creating a Security initializes OpenSSL
+   {
+      Security security(Data::Empty);
+   }
+
+   const Data serverDir = makeDirectory();
+   const Data clientDir = makeDirectory();
+   makeCertificate(serverDir, clientDir);
+
+   // TLS 1.3 tickets come after the handshake, and are used once
+   BaseSecurity::TlsTicketKeyLifetime = 1;
+#ifdef TLS1_3_VERSION
+   testTicketRotation(serverDir, clientDir, resipTestPort(5061), TLS1_3_VERSION);
+#endif
+   testTicketRotation(serverDir, clientDir, resipTestPort(5062), TLS1_2_VERSION);
+
+   BaseSecurity::TlsTicketKeyLifetime = 0;
+#ifdef TLS1_3_VERSION
+   testSessionCache(serverDir, clientDir, resipTestPort(5063), TLS1_3_VERSION);
+#endif
+   testSessionCache(serverDir, clientDir, resipTestPort(5064), TLS1_2_VERSION);
+
+   testClientSessionCache(clientDir);
+
+   removeDirectory(serverDir);
+   removeDirectory(clientDir);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ *
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
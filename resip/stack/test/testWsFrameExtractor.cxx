@@ -0,0 +1,321 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "assert.h"
+
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Timer.hxx"
+#include "resip/stack/WsFrameExtractor.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+static const UInt8 key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+// Appends one WebSocket frame carrying payload to out
+static void
+addFrame(vector<UInt8>& out, const Data& payload, bool final, bool masked, UInt8 opcode = 1)
+{
+   out.push_back((final ? 0x80 : 0) | opcode);
+   UInt64 len = payload.size();
+   UInt8 maskBit = masked ? 0x80 : 0;
+   if (len < 126)
+   {
+      out.push_back(maskBit | (UInt8)len);
+   }
+   else if (len < 65536)
+   {
+      out.push_back(maskBit | 126);
+      out.push_back((UInt8)(len >> 8));
+      out.push_back((UInt8)len);
+   }
+   else
+   {
+      out.push_back(maskBit | 127);
+      for (int shift = 56; shift >= 0; shift -= 8)
+      {
+         out.push_back((UInt8)(len >> shift));
+      }
+   }
+   if (masked)
+   {
+      out.insert(out.end(), key, key + 4);
+   }
+   for (Data::size_type i = 0; i < payload.size(); ++i)
+   {
+      out.push_back((UInt8)payload[i] ^ (masked ? key[i & 3] : 0));
+   }
+}
+
+// Feeds input in chunks of chunk bytes and collects the messages
+static void
+extract(WsFrameExtractor& extractor, vector<UInt8>& input, size_t chunk, vector<Data>& messages)
+{
+   for (size_t pos = 0; pos < input.size(); pos += chunk)
+   {
+      size_t len = input.size() - pos < chunk ? input.size() - pos : chunk;
+      bool drop = false;
+      auto_ptr<Data> msg = extractor.processBytes(&input[pos], len, drop);
+      assert(!drop);
+      while (msg.get())
+      {
+         // the buffer is null terminated, for MsgHeaderScanner
+         assert(msg->data()[msg->size()] == 0);
+         messages.push_back(Data(msg->data(), msg->size()));
+         delete [] msg->data();
+         msg = extractor.processBytes(0, 0, drop);
+      }
+   }
+}
+
+static Data
+makePayload(size_t len, int seed)
+{
+   Data d;
+   for (size_t i = 0; i < len; ++i)
+   {
+      d += (char)('a' + (i * 7 + seed) % 26);
+   }
+   return d;
+}
+
+static void
+referenceUnmask(UInt8* dst, const UInt8* src, size_t len, const UInt8 k[4], size_t offset)
+{
+   for (size_t i = 0; i < len; ++i)
+   {
+      dst[i] = src[i] ^ k[(offset + i) & 3];
+   }
+}
+
+static void
+testUnmask()
+{
+   UInt8 src[300];
+   for (size_t i = 0; i < sizeof(src); ++i)
+   {
+      src[i] = (UInt8)(i * 13 + 5);
+   }
+   for (size_t len = 0; len < 140; ++len)
+   {
+      for (size_t offset = 0; offset < 4; ++offset)
+      {
+         for (size_t misalign = 0; misalign < 3; ++misalign)
+         {
+            UInt8 expected[300];
+            UInt8 got[300];
+            referenceUnmask(expected, src + misalign, len, key, offset);
+            WsFrameExtractor::unmask(got + misalign, src + misalign, len, key, offset);
+            assert(memcmp(expected, got + misalign, len) == 0);
+
+            // in place
+            memcpy(got, src + misalign, len);
+            WsFrameExtractor::unmask(got, got, len, key, offset);
+            assert(memcmp(expected, got, len) == 0);
+         }
+      }
+   }
+}
+
+static void
+testFrames()
+{
+   const Data small("REGISTER sip:example.com SIP/2.0\r\n\r\n");
+   const Data medium(makePayload(3000, 1));    // 16 bit length
+   const Data large(makePayload(70000, 2));    // 64 bit length
+
+   vector<UInt8> input;
+   addFrame(input, small, true, true);
+   addFrame(input, medium, true, true);
+   addFrame(input, large, true, false);
+   // one message in three frames
+   addFrame(input, medium.substr(0, 1000), false, true);
+   addFrame(input, medium.substr(1000, 1500), false, true, 0);
+   addFrame(input, medium.substr(2500), true, true, 0);
+   // an empty frame
+   addFrame(input, Data::Empty, true, true);
+
+   const size_t chunks[] = { 1, 3, 7, 100, 1500, 4096, input.size() };
+   for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c)
+   {
+      WsFrameExtractor extractor(100000);
+      vector<Data> messages;
+      extract(extractor, input, chunks[c], messages);
+      assert(messages.size() == 5);
+      assert(messages[0] == small);
+      assert(messages[1] == medium);
+      assert(messages[2] == large);
+      assert(messages[3] == medium);
+      assert(messages[4].empty());
+   }
+
+   // too big, for one frame or for the frames of one message together
+   {
+      WsFrameExtractor extractor(2000);
+      vector<UInt8> big;
+      addFrame(big, medium, true, true);
+      bool drop = false;
+      auto_ptr<Data> msg = extractor.processBytes(&big[0], big.size(), drop);
+      assert(drop && !msg.get());
+   }
+   {
+      WsFrameExtractor extractor(2000);
+      vector<UInt8> big;
+      addFrame(big, medium.substr(0, 1500), false, true);
+      addFrame(big, medium.substr(1500, 1000), true, true, 0);
+      bool drop = false;
+      auto_ptr<Data> msg = extractor.processBytes(&big[0], big.size(), drop);
+      assert(drop && !msg.get());
+   }
+
+   // 64 bit lengths that don't fit in 32 bits mustn't wrap the size checks:
+   // a continuation of 0xffffffff bytes after a 1 byte fragment, and lengths
+   // of 4 GB and more that would truncate to something small
+   {
+      WsFrameExtractor extractor(100000);
+      vector<UInt8> big;
+      addFrame(big, Data("x"), false, true);
+      big.push_back(0x80);
+      big.push_back(0x80 | 127);
+      const UInt8 len[8] = { 0, 0, 0, 0, 0xff, 0xff, 0xff, 0xff };
+      big.insert(big.end(), len, len + 8);
+      big.insert(big.end(), key, key + 4);
+      big.insert(big.end(), 4000, 'x');
+      bool drop = false;
+      auto_ptr<Data> msg = extractor.processBytes(&big[0], big.size(), drop);
+      assert(drop && !msg.get());
+   }
+   const UInt64 hugeLengths[] = { 0x100000000ULL, 0x100000005ULL, 0x8000000000000010ULL };
+   for (size_t n = 0; n < sizeof(hugeLengths) / sizeof(hugeLengths[0]); ++n)
+   {
+      WsFrameExtractor extractor(0xfffffff0);
+      vector<UInt8> big;
+      big.push_back(0x81);
+      big.push_back(127);
+      for (int shift = 56; shift >= 0; shift -= 8)
+      {
+         big.push_back((UInt8)(hugeLengths[n] >> shift));
+      }
+      big.insert(big.end(), 4000, 'x');
+      bool drop = false;
+      auto_ptr<Data> msg = extractor.processBytes(&big[0], big.size(), drop);
+      assert(drop && !msg.get());
+   }
+}
+
+static void
+benchmark()
+{
+   const size_t sizes[] = { 1024, 2048, 4096 };
+   for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+   {
+      const size_t size = sizes[s];
+      const int frames = 20000;
+      vector<UInt8> src(size);
+      vector<UInt8> dst(size);
+      for (size_t i = 0; i < size; ++i)
+      {
+         src[i] = (UInt8)i;
+      }
+
+      UInt64 start = Timer::getTimeMicroSec();
+      for (int n = 0; n < frames; ++n)
+      {
+         referenceUnmask(&dst[0], &src[0], size, key, n);
+         src[n % size] = dst[0];
+      }
+      UInt64 bytewise = Timer::getTimeMicroSec() - start;
+
+      start = Timer::getTimeMicroSec();
+      for (int n = 0; n < frames; ++n)
+      {
+         WsFrameExtractor::unmask(&dst[0], &src[0], size, key, n);
+         src[n % size] = dst[0];
+      }
+      UInt64 vectorized = Timer::getTimeMicroSec() - start;
+
+      // whole frames through the extractor, 64 to a read
+      vector<UInt8> input;
+      const Data payload(makePayload(size, 3));
+      for (int n = 0; n < 64; ++n)
+      {
+         addFrame(input, payload, true, true);
+      }
+      WsFrameExtractor extractor(100000);
+      start = Timer::getTimeMicroSec();
+      int got = 0;
+      for (int n = 0; n < frames / 64; ++n)
+      {
+         bool drop = false;
+         auto_ptr<Data> msg = extractor.processBytes(&input[0], input.size(), drop);
+         while (msg.get())
+         {
+            ++got;
+            delete [] msg->data();
+            msg = extractor.processBytes(0, 0, drop);
+         }
+      }
+      UInt64 extracted = Timer::getTimeMicroSec() - start;
+      assert(got == (frames / 64) * 64);
+
+      cerr << size << " byte frames: unmask " << (double)bytewise * 1000 / frames
+           << " ns bytewise, " << (double)vectorized * 1000 / frames
+           << " ns vectorized; processBytes " << (double)extracted * 1000 / got
+           << " ns per frame" << endl;
+   }
+}
+
+int
+main(int argc, char* argv[])
+{
+   testUnmask();
+   testFrames();
+   benchmark();
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ *
+ * Copyright 2013 Daniel Pocock.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. Neither the name of the author(s) nor the names of any contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR(S) AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR(S) OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * ====================================================================
+ *
+ *
+ */
@@ -11,6 +11,7 @@
 
 #include "rutil/compat.hxx"
 #include "rutil/Timer.hxx"
+#include "rutil/MpscRing.hxx"
 
 namespace resip
 {
@@ -116,6 +117,10 @@ class FifoStatsInterface
    (aka template hoist) 
    AbstractFifo's get operations are all threadsafe; AbstractFifo does not 
    define any put operations (these are defined in subclasses).
+
+   A fifo with a single consumer thread can additionally be given a
+   lock-free ring (see enableLockFreeAdd()) that producers use instead of
+   the mutex; the consumer moves its contents onto the locked queue.
    @note Users of the resip stack will not need to interact with this class 
       directly in most cases. Look at Fifo and TimeLimitFifo instead.
 
@@ -134,11 +139,28 @@ class AbstractFifo : public FifoStatsInterface
             mLastSampleTakenMicroSec(0),
             mCounter(0),
             mAverageServiceTimeMicroSec(0),
-            mSize(0)
+            mSize(0),
+            mRing(0)
       {}
 
       virtual ~AbstractFifo()
       {
+         delete mRing;
+      }
+
+      /**
+         @brief lets producers add through a lock-free ring of ringSize
+         entries; they only fall back to the mutex while the ring is full.
+         Must be called before the fifo is shared between threads, and only
+         for fifos that have a single consumer. A no-op if the compiler
+         has no <atomic>.
+       **/
+      void enableLockFreeAdd(unsigned int ringSize)
+      {
+#ifdef RESIP_HAS_STD_ATOMIC
+         resip_assert(!mRing);
+         mRing = new MpscRing<T>(ringSize);
+#endif
       }
 
       /** 
@@ -147,6 +169,10 @@ class AbstractFifo : public FifoStatsInterface
        **/
       bool empty() const
       {
+         if(mRing && mRing->size())
+         {
+            return false;
+         }
          Lock lock(mMutex); (void)lock;
          return mFifo.empty();
       }
@@ -161,7 +187,7 @@ class AbstractFifo : public FifoStatsInterface
       virtual unsigned int size() const
       {
          Lock lock(mMutex); (void)lock;
-         return (unsigned int)mFifo.size();
+         return (unsigned int)(mFifo.size() + (mRing ? mRing->size() : 0));
       }
 
       /**
@@ -171,6 +197,10 @@ class AbstractFifo : public FifoStatsInterface
        
       bool messageAvailable() const
       {
+         if(mRing && mRing->size())
+         {
+            return true;
+         }
          Lock lock(mMutex); (void)lock;
          return !mFifo.empty();
       }
@@ -187,12 +217,12 @@ class AbstractFifo : public FifoStatsInterface
 
       virtual size_t getCountDepth() const
       {
-         return mSize;
+         return mSize + (mRing ? mRing->size() : 0);
       }
 
       virtual time_t expectedWaitTimeMilliSec() const
       {
-         return ((mAverageServiceTimeMicroSec*mSize)+500)/1000;
+         return ((mAverageServiceTimeMicroSec*getCountDepth())+500)/1000;
       }
 
       virtual time_t averageServiceTimeMicroSec() const
@@ -216,12 +246,13 @@ class AbstractFifo : public FifoStatsInterface
       T getNext()
       {
          Lock lock(mMutex); (void)lock;
+         drainRing();
          onFifoPolled();
 
          // Wait util there are messages available.
          while (mFifo.empty())
          {
-            mCondition.wait(mMutex);
+            waitForMessages(0);
          }
 
          // Return the first message on the fifo.
@@ -253,6 +284,7 @@ class AbstractFifo : public FifoStatsInterface
          if(ms < 0)
          {
             Lock lock(mMutex); (void)lock;
+            drainRing();
             onFifoPolled();
             if (mFifo.empty())	// WATCHOUT: Do not test mSize instead
               return false;
@@ -264,6 +296,7 @@ class AbstractFifo : public FifoStatsInterface
          const UInt64 begin(Timer::getTimeMs());
          const UInt64 end(begin + (unsigned int)(ms)); // !kh! ms should've been unsigned :(
          Lock lock(mMutex); (void)lock;
+         drainRing();
          onFifoPolled();
 
          // Wait until there are messages available
@@ -282,7 +315,7 @@ class AbstractFifo : public FifoStatsInterface
             unsigned int timeout((unsigned int)(end - now));
                     
             // bail if total wait time exceeds limit
-            bool signaled = mCondition.wait(mMutex, timeout);
+            bool signaled = waitForMessages(timeout);
             if (!signaled)
             {
                return false;
@@ -302,11 +335,12 @@ class AbstractFifo : public FifoStatsInterface
       void getMultiple(Messages& other, unsigned int max)
       {
          Lock lock(mMutex); (void)lock;
+         drainRing();
          onFifoPolled();
          resip_assert(other.empty());
          while (mFifo.empty())
          {
-            mCondition.wait(mMutex);
+            waitForMessages(0);
          }
 
          if(mFifo.size() <= max)
@@ -338,6 +372,7 @@ class AbstractFifo : public FifoStatsInterface
          const UInt64 begin(Timer::getTimeMs());
          const UInt64 end(begin + (unsigned int)(ms)); // !kh! ms should've been unsigned :(
          Lock lock(mMutex); (void)lock;
+         drainRing();
          onFifoPolled();
 
          // Wait until there are messages available
@@ -356,7 +391,7 @@ class AbstractFifo : public FifoStatsInterface
             unsigned int timeout((unsigned int)(end - now));
                     
             // bail if total wait time exceeds limit
-            bool signaled = mCondition.wait(mMutex, timeout);
+            bool signaled = waitForMessages(timeout);
             if (!signaled)
             {
                return false;
@@ -384,6 +419,8 @@ class AbstractFifo : public FifoStatsInterface
       size_t add(const T& item)
       {
          Lock lock(mMutex); (void)lock;
+         // anything still in the ring is older than item
+         drainRing();
          mFifo.push_back(item);
          mCondition.signal();
          onMessagePushed(1);
@@ -393,6 +430,7 @@ class AbstractFifo : public FifoStatsInterface
       size_t addMultiple(Messages& items)
       {
          Lock lock(mMutex); (void)lock;
+         drainRing();
          size_t size=items.size();
          if(mFifo.empty())
          {
@@ -413,6 +451,72 @@ class AbstractFifo : public FifoStatsInterface
          return mFifo.size();
       }
 
+      /**
+         @brief lock-free add; only available after enableLockFreeAdd()
+         @param previous set to the number of items that were in the ring
+         @retval false if there is no ring or it is full; use add() then
+      */
+      bool addLockFree(const T& item, size_t& previous)
+      {
+         if(!mRing || !mRing->push(item, previous))
+         {
+            return false;
+         }
+         if(mRing->consumerWaiting())
+         {
+            Lock lock(mMutex); (void)lock;
+            mCondition.signal();
+         }
+         return true;
+      }
+
+      /// moves everything in the ring onto mFifo; caller holds mMutex
+      void drainRing()
+      {
+         if(mRing)
+         {
+            size_t num = mRing->popAll(mFifo);
+            if(num)
+            {
+               onMessagePushed((int)num);
+            }
+         }
+      }
+
+      /**
+         waits on mCondition (forever if ms is 0); caller holds mMutex.
+         With a ring, producers only signal after the consumer has said it
+         is going to sleep, so check the ring once more after saying so.
+      */
+      bool waitForMessages(unsigned int ms)
+      {
+         if(mRing)
+         {
+            mRing->setConsumerWaiting(true);
+            drainRing();
+            if(!mFifo.empty())
+            {
+               mRing->setConsumerWaiting(false);
+               return true;
+            }
+         }
+         bool signaled = true;
+         if(ms)
+         {
+            signaled = mCondition.wait(mMutex, ms);
+         }
+         else
+         {
+            mCondition.wait(mMutex);
+         }
+         if(mRing)
+         {
+            mRing->setConsumerWaiting(false);
+            drainRing();
+         }
+         return signaled;
+      }
+
       /** @brief container for FIFO items */
       Messages mFifo;
       /** @brief access serialization lock */
@@ -427,6 +531,8 @@ class AbstractFifo : public FifoStatsInterface
       // size; we maintain this count so that it can be queried without locking, 
       // in situations where it being off by a small amount is ok.
       UInt32 mSize;
+      /// optional lock-free ring producers add to, see enableLockFreeAdd()
+      MpscRing<T>* mRing;
 
       virtual void onFifoPolled()
       {
@@ -0,0 +1,182 @@
+#ifndef ArenaPool_Include_Guard
+#define ArenaPool_Include_Guard
+
+#include <limits>
+#include <memory>
+#include <stddef.h>
+
+#include "rutil/PoolBase.hxx"
+
+namespace resip
+{
+/**
+   A growable arena meant for use in short-lifetime objects, like DinkyPool.
+   The first S bytes come from a buffer inside the ArenaPool itself; once
+   that is used up, further allocations are carved out of heap chunks of
+   ChunkSize bytes (or larger, for a bigger allocation). At most MaxChunks
+   chunks are taken, after which it falls back to the system new/delete.
+
+   As with DinkyPool, deallocating an arena allocated object does _not_ free
+   up room; all chunks are released in one go when the ArenaPool goes away.
+   MaxChunks bounds how much an object that keeps being modified can waste.
+*/
+template<unsigned int S, unsigned int ChunkSize=4096, unsigned int MaxChunks=16>
+class ArenaPool : public PoolBase
+{
+   public:
+      ArenaPool() :
+         count(0),
+         mChunks(0),
+         mChunkCount(0),
+         mChunkUsed(0),
+         mChunkBytes(0),
+         heapBytes(0)
+      {}
+
+      ~ArenaPool()
+      {
+         while(mChunks)
+         {
+            Chunk* next = mChunks->mNext;
+            ::operator delete(mChunks);
+            mChunks = next;
+         }
+      }
+
+      void* allocate(size_t size)
+      {
+         if((8*count)+size <= S)
+         {
+            void* result=mBuf[count];
+            count+=(size+7)/8;
+            return result;
+         }
+
+         const size_t rounded = (size+7) & ~(size_t)7;
+         if(mChunks && mChunkUsed + rounded <= mChunks->mSize)
+         {
+            void* result = mChunks->data() + mChunkUsed;
+            mChunkUsed += rounded;
+            return result;
+         }
+
+         if(mChunkCount < MaxChunks)
+         {
+            const size_t chunkSize = rounded > ChunkSize ? rounded : ChunkSize;
+            Chunk* chunk = static_cast<Chunk*>(::operator new(sizeof(Chunk) + chunkSize));
+            chunk->mNext = mChunks;
+            chunk->mSize = chunkSize;
+            mChunks = chunk;
+            ++mChunkCount;
+            mChunkBytes += chunkSize;
+            mChunkUsed = rounded;
+            return chunk->data();
+         }
+
+         heapBytes += size;
+         return ::operator new(size);
+      }
+
+      void deallocate(void* ptr)
+      {
+         if(ptr >= (void*)mBuf[0] && ptr < (void*)mBuf[(S+7)/8])
+         {
+            return;
+         }
+         for(const Chunk* chunk = mChunks; chunk; chunk = chunk->mNext)
+         {
+            if(ptr >= (const void*)chunk->data() &&
+               ptr < (const void*)(chunk->data() + chunk->mSize))
+            {
+               return;
+            }
+         }
+         ::operator delete(ptr);
+      }
+
+      size_t max_size() const
+      {
+         return std::numeric_limits<size_t>::max();
+      }
+
+      size_t getHeapBytes() const { return heapBytes; }
+      size_t getPoolBytes() const { return count*8; }
+      size_t getPoolSizeBytes() const { return sizeof(mBuf); }
+      size_t getChunkBytes() const { return mChunkBytes; }
+      size_t getChunkCount() const { return mChunkCount; }
+
+   private:
+      // disabled
+      ArenaPool& operator=(const ArenaPool& rhs);
+      ArenaPool(const ArenaPool& other);
+
+      // header of a heap chunk; the usable space follows it (the header is
+      // a multiple of 8 bytes, so that space stays 8-byte aligned)
+      struct Chunk
+      {
+         Chunk* mNext;
+         size_t mSize;
+
+         char* data() { return reinterpret_cast<char*>(this + 1); }
+         const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+      };
+
+      size_t count; // 8-byte chunks alloced so far
+      char mBuf[(S+7)/8][8]; // 8-byte chunks for alignment
+      Chunk* mChunks; // most recent first; only the first one has room left
+      size_t mChunkCount;
+      size_t mChunkUsed; // bytes used in mChunks
+      size_t mChunkBytes;
+      size_t heapBytes;
+};
+
+}
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,502 @@
+#if defined(HAVE_CONFIG_H)
+#include "config.h"
+#endif
+
+#include "rutil/AsyncLogWriter.hxx"
+
+#ifdef RESIP_ASYNC_LOG
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <thread>
+
+#include "rutil/Lock.hxx"
+#include "rutil/Logger.hxx"
+
+using namespace resip;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::SIP
+
+#ifdef IOV_MAX
+static const size_t IovBatch = IOV_MAX;
+#else
+static const size_t IovBatch = 1024;
+#endif
+
+/**
+   Byte ring written by one thread and read by the writer thread. Each
+   line is stored as an 8 byte header followed by the line and a '\n',
+   padded to a multiple of 8. A line that would straddle the end of the
+   buffer is preceded by a Skip header that sends the reader back to the
+   start.
+*/
+class AsyncLogWriter::Ring
+{
+   public:
+      explicit Ring(unsigned int bytes) :
+         mHead(0),
+         mTail(0),
+         mOrphaned(false)
+      {
+         size_t size = 4096;
+         while (size < bytes)
+         {
+            size <<= 1;
+         }
+         mMask = size - 1;
+         mBuffer = new char[size];
+      }
+
+      ~Ring()
+      {
+         delete [] mBuffer;
+      }
+
+      /// @param halfFull set if the ring is more than half full afterwards
+      /// @retval false if there is no room for the line
+      bool push(int level, const char* data, size_t length, bool& halfFull)
+      {
+         const size_t record = sizeof(Header) + ((length + 1 + 7) & ~size_t(7));
+         const UInt64 head = mHead.load(std::memory_order_relaxed);
+         const UInt64 tail = mTail.load(std::memory_order_acquire);
+         size_t offset = (size_t)(head & mMask);
+         const size_t skip = (size() - offset < record) ? size() - offset : 0;
+         if (skip + record > size() - (size_t)(head - tail))
+         {
+            return false;
+         }
+         if (skip)
+         {
+            header(offset)->mLength = Skip;
+            offset = 0;
+         }
+         Header* h = header(offset);
+         h->mLength = (UInt32)length;
+         h->mLevel = level;
+         memcpy(mBuffer + offset + sizeof(Header), data, length);
+         mBuffer[offset + sizeof(Header) + length] = '\n';
+
+         const UInt64 newHead = head + skip + record;
+         mHead.store(newHead, std::memory_order_release);
+         halfFull = (size_t)(newHead - tail) > size() / 2;
+         return true;
+      }
+
+      // reader side
+      UInt64 tail() const { return mTail.load(std::memory_order_relaxed); }
+      UInt64 head() const { return mHead.load(std::memory_order_acquire); }
+      bool empty() const { return tail() == head(); }
+
+      /// Steps pos over the next line before head.
+      /// @param length of the line, without the '\n'
+      bool next(UInt64& pos, UInt64 head, const char*& data, UInt32& length, int& level) const
+      {
+         if (pos == head)
+         {
+            return false;
+         }
+         size_t offset = (size_t)(pos & mMask);
+         if (header(offset)->mLength == Skip)
+         {
+            pos += size() - offset;
+            offset = 0;
+         }
+         const Header* h = header(offset);
+         data = mBuffer + offset + sizeof(Header);
+         length = h->mLength;
+         level = h->mLevel;
+         pos += sizeof(Header) + ((length + 1 + 7) & ~size_t(7));
+         return true;
+      }
+
+      /// Gives everything before pos back to the producer.
+      void release(UInt64 pos) { mTail.store(pos, std::memory_order_release); }
+
+      void orphan() { mOrphaned.store(true, std::memory_order_release); }
+      bool orphaned() const { return mOrphaned.load(std::memory_order_acquire); }
+
+   private:
+      struct Header
+      {
+         UInt32 mLength;
+         Int32 mLevel;
+      };
+      static const UInt32 Skip = 0xFFFFFFFF;
+
+      size_t size() const { return mMask + 1; }
+      Header* header(size_t offset) const { return reinterpret_cast<Header*>(mBuffer + offset); }
+
+      char* mBuffer;
+      size_t mMask;
+      std::atomic<UInt64> mHead;
+      std::atomic<UInt64> mTail;
+      std::atomic<bool> mOrphaned;
+};
+
+AsyncLogWriter::AsyncLogWriter() :
+   mRingBytes(1 << 20),
+   mDropped(0),
+   mPosting(0),
+   mWakePending(false),
+   mWriter(0),
+   mDropsReported(0),
+   mType(Log::Cout),
+   mGeneration(0),
+   mFd(-1),
+   mLineCount(0),
+   mByteCount(0)
+{
+   ThreadIf::tlsKeyCreate(mRingKey, orphanRing);
+}
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+   stop();
+   ThreadIf::tlsKeyDelete(mRingKey);
+   for (std::vector<Ring*>::iterator i = mRings.begin(); i != mRings.end(); ++i)
+   {
+      delete *i;
+   }
+   closeFile();
+}
+
+void
+AsyncLogWriter::start(unsigned int ringBytes)
+{
+   resip_assert(!mWriter);
+   mRingBytes.store(ringBytes, std::memory_order_relaxed);
+   mWriter = new Writer(*this);
+   mWriter->run();
+}
+
+void
+AsyncLogWriter::stop()
+{
+   // a post() that saw Log::mAsync still set has to finish before the
+   // writer's last drain, or its line would be left in the ring
+   while (mPosting.load() != 0)
+   {
+      std::this_thread::yield();
+   }
+   if (mWriter)
+   {
+      mWriter->shutdown();
+      wake();
+      mWriter->join();
+      delete mWriter;
+      mWriter = 0;
+   }
+}
+
+bool
+AsyncLogWriter::post(Log::Level level, const Data& line)
+{
+   // Log::disableAsync() clears Log::mAsync before stop() waits for
+   // mPosting to drop to 0, so either stop() waits for us or we see it
+   // cleared
+   mPosting.fetch_add(1);
+   if (!Log::mAsync.load())
+   {
+      mPosting.fetch_sub(1);
+      return false;
+   }
+   bool halfFull = false;
+   if (!getRing()->push(level, line.data(), line.size(), halfFull))
+   {
+      mDropped.fetch_add(1, std::memory_order_relaxed);
+      halfFull = true;
+   }
+   if (halfFull)
+   {
+      wake();
+   }
+   mPosting.fetch_sub(1);
+   return true;
+}
+
+AsyncLogWriter::Ring*
+AsyncLogWriter::getRing()
+{
+   Ring* ring = static_cast<Ring*>(ThreadIf::tlsGetValue(mRingKey));
+   if (!ring)
+   {
+      ring = new Ring(mRingBytes.load(std::memory_order_relaxed));
+      ThreadIf::tlsSetValue(mRingKey, ring);
+      Lock lock(mRingsMutex);
+      mRings.push_back(ring);
+   }
+   return ring;
+}
+
+void
+AsyncLogWriter::orphanRing(void* ring)
+{
+   // the thread is exiting; the writer deletes the ring once it is empty
+   static_cast<Ring*>(ring)->orphan();
+}
+
+void
+AsyncLogWriter::wake()
+{
+   if (!mWakePending.exchange(true))
+   {
+      Lock lock(mWakeMutex);
+      mWake.signal();
+   }
+}
+
+void
+AsyncLogWriter::Writer::thread()
+{
+   bool idle = false;
+   while (!isShutdown())
+   {
+      if (idle)
+      {
+         Lock lock(mOwner.mWakeMutex);
+         if (!mOwner.mWakePending.load())
+         {
+            mOwner.mWake.wait(mOwner.mWakeMutex, 10);
+         }
+      }
+      mOwner.mWakePending.store(false);
+      idle = !mOwner.drain();
+   }
+   mOwner.drain();
+}
+
+bool
+AsyncLogWriter::drain()
+{
+   unsigned int maxLines;
+   unsigned int maxBytes;
+   bool keepAll;
+   {
+      Lock lock(Log::_mutex);
+      Log::ThreadData& data = Log::mDefaultLoggerData;
+      if (data.mType != mType || data.mGeneration != mGeneration ||
+          data.mLogFileName != mFileName)
+      {
+         closeFile();
+         mType = data.mType;
+         mGeneration = data.mGeneration;
+         mFileName = data.mLogFileName;
+         if (mType == Log::Syslog)
+         {
+            openlog(Log::mAppName.empty() ? 0 : Log::mAppName.c_str(), LOG_NDELAY | LOG_PID, Log::mSyslogFacility);
+         }
+      }
+      maxLines = data.maxLineCount();
+      maxBytes = data.maxByteCount();
+      keepAll = data.keepAllLogFiles();
+   }
+
+   {
+      Lock lock(mRingsMutex);
+      mDraining = mRings;
+   }
+
+   bool wrote = false;
+   for (std::vector<Ring*>::iterator i = mDraining.begin(); i != mDraining.end(); ++i)
+   {
+      // check orphaned() first, nothing gets pushed after it is set
+      const bool orphaned = (*i)->orphaned();
+      if (!(*i)->empty())
+      {
+         write(**i, maxLines, maxBytes, keepAll);
+         wrote = true;
+      }
+      else if (orphaned)
+      {
+         Lock lock(mRingsMutex);
+         mRings.erase(std::find(mRings.begin(), mRings.end(), *i));
+         delete *i;
+      }
+   }
+
+   const UInt64 dropped = mDropped.load(std::memory_order_relaxed);
+   if (dropped != mDropsReported)
+   {
+      WarningLog(<< "Dropped " << (dropped - mDropsReported) << " log lines, log ring full");
+      mDropsReported = dropped;
+   }
+   return wrote;
+}
+
+void
+AsyncLogWriter::write(Ring& ring, unsigned int maxLines, unsigned int maxBytes, bool keepAll)
+{
+   UInt64 pos = ring.tail();
+   const UInt64 head = ring.head();
+   const char* data;
+   UInt32 length;
+   int level;
+
+   int fd = (mType == Log::Cerr) ? 2 : 1;
+   while (ring.next(pos, head, data, length, level))
+   {
+      if (mType == Log::Syslog)
+      {
+         ::syslog(Log::mSyslogFacility | syslogPriority(level), "%.*s", (int)length, data);
+         continue;
+      }
+      if (mType == Log::File)
+      {
+         if (mFd < 0 ||
+             (maxLines && mLineCount >= maxLines) ||
+             (maxBytes && mByteCount + length + 1 >= maxBytes))
+         {
+            writeFd(fd);
+            openFile(keepAll);
+         }
+         ++mLineCount;
+         mByteCount += length + 1;
+         fd = mFd;
+      }
+      struct iovec v;
+      v.iov_base = const_cast<char*>(data);
+      v.iov_len = length + 1;
+      mIov.push_back(v);
+      if (mIov.size() == IovBatch)
+      {
+         writeFd(fd);
+      }
+   }
+   writeFd(fd);
+   ring.release(pos);
+}
+
+void
+AsyncLogWriter::writeFd(int fd)
+{
+   struct iovec* iov = mIov.empty() ? 0 : &mIov[0];
+   int count = (int)mIov.size();
+   while (fd >= 0 && count > 0)
+   {
+      ssize_t n = ::writev(fd, iov, count);
+      if (n < 0)
+      {
+         if (errno == EINTR)
+         {
+            continue;
+         }
+         break;
+      }
+      while (count > 0 && (size_t)n >= iov->iov_len)
+      {
+         n -= iov->iov_len;
+         ++iov;
+         --count;
+      }
+      if (count > 0)
+      {
+         iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+         iov->iov_len -= n;
+      }
+   }
+   mIov.clear();
+}
+
+void
+AsyncLogWriter::openFile(bool keepAll)
+{
+   Data logFileName(mFileName != "" ? mFileName : "resiprocate.log");
+   if (mFd >= 0)
+   {
+      closeFile();
+      Log::rotateLogFile(logFileName, keepAll);
+   }
+   mFd = ::open(logFileName.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+   mLineCount = 0;
+   mByteCount = 0;
+   struct stat st;
+   if (mFd >= 0 && fstat(mFd, &st) == 0)
+   {
+      mByteCount = (size_t)st.st_size;
+   }
+}
+
+void
+AsyncLogWriter::closeFile()
+{
+   if (mFd >= 0)
+   {
+      ::close(mFd);
+      mFd = -1;
+   }
+}
+
+int
+AsyncLogWriter::syslogPriority(int level)
+{
+   // same mapping as SysLogBuf
+   switch (level)
+   {
+      case Log::Info:
+         return LOG_INFO;
+      case Log::Warning:
+         return LOG_WARNING;
+      case Log::Err:
+         return LOG_ERR;
+      case Log::Crit:
+         return LOG_CRIT;
+      default:
+         return LOG_DEBUG;
+   }
+}
+
+#endif // RESIP_ASYNC_LOG
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,161 @@
+#if !defined(RESIP_ASYNCLOGWRITER_HXX)
+#define RESIP_ASYNCLOGWRITER_HXX
+
+#include "rutil/MpscRing.hxx"
+
+#if defined(RESIP_HAS_STD_ATOMIC) && !defined(WIN32)
+#  define RESIP_ASYNC_LOG
+#endif
+
+#ifdef RESIP_ASYNC_LOG
+
+#include <sys/uio.h>
+#include <vector>
+
+#include "rutil/Condition.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Log.hxx"
+#include "rutil/Mutex.hxx"
+#include "rutil/ThreadIf.hxx"
+
+namespace resip
+{
+
+/**
+   @internal
+   @brief Writes the default logger's lines on a thread of its own, see
+   Log::enableAsync().
+
+   Each thread that logs gets a single-producer/single-consumer byte ring
+   of its own, found through a thread local key, so post() never takes a
+   lock once the ring exists. The writer thread collects whatever the rings
+   hold, hands it to the output in one writev() (or one syslog() per line)
+   and only then gives the space back to the producers. Lines of one thread
+   are written in order; lines of different threads may not be. A ring that
+   passes half full wakes the writer early; otherwise it polls every 10ms.
+
+   The output is taken from Log::mDefaultLoggerData on every batch, so
+   Log::initialize() and Log::reset() work as they do in synchronous mode.
+   The writer keeps its own file descriptor and does the same line and
+   byte count rotation as Log::ThreadData::Instance().
+*/
+class AsyncLogWriter
+{
+   public:
+      AsyncLogWriter();
+      ~AsyncLogWriter();
+
+      /// @param ringBytes size of the ring of each thread that logs
+      void start(unsigned int ringBytes);
+      /// Called once Log::mAsync is false: waits for the post() calls
+      /// under way, writes out all that has been posted, then stops the
+      /// writer thread.
+      void stop();
+
+      /// Called by Log::Guard, from any thread.  Returns false, without
+      /// posting, once Log::mAsync is false; the caller then logs the line
+      /// synchronously.
+      bool post(Log::Level level, const Data& line);
+
+      UInt64 dropCount() const { return mDropped.load(std::memory_order_relaxed); }
+
+   private:
+      class Ring;
+
+      class Writer : public ThreadIf
+      {
+         public:
+            explicit Writer(AsyncLogWriter& owner) : mOwner(owner) {}
+            virtual void thread();
+         private:
+            AsyncLogWriter& mOwner;
+      };
+
+      Ring* getRing();
+      void wake();
+      /// @return true if anything was written
+      bool drain();
+      void write(Ring& ring, unsigned int maxLines, unsigned int maxBytes, bool keepAll);
+      void writeFd(int fd);
+      void openFile(bool keepAll);
+      void closeFile();
+      static void orphanRing(void* ring);
+      static int syslogPriority(int level);
+
+      ThreadIf::TlsKey mRingKey;
+      Mutex mRingsMutex; // guards mRings
+      std::vector<Ring*> mRings;
+      std::atomic<unsigned int> mRingBytes;
+      std::atomic<UInt64> mDropped;
+      std::atomic<unsigned int> mPosting; // post() calls under way
+
+      Mutex mWakeMutex;
+      Condition mWake;
+      std::atomic<bool> mWakePending;
+      Writer* mWriter;
+
+      // only touched by the writer thread
+      std::vector<Ring*> mDraining;
+      std::vector<struct iovec> mIov;
+      UInt64 mDropsReported;
+      Log::Type mType;
+      unsigned int mGeneration;
+      Data mFileName;
+      int mFd;
+      unsigned int mLineCount;
+      size_t mByteCount;
+};
+
+}
+
+#endif // RESIP_ASYNC_LOG
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,128 @@
+#if !defined(RESIP_CHARCLASS_HXX)
+#define RESIP_CHARCLASS_HXX
+
+namespace resip
+{
+
+/**
+   @brief The membership table of a character class, for
+      ParseBuffer::skipChars() and ParseBuffer::skipToOneOf().
+
+   A plain aggregate, so a constant one is initialized by the compiler
+   rather than by a constructor at run time.
+*/
+struct CharTable
+{
+      bool operator[](unsigned char c) const
+      {
+         return mMember[c];
+      }
+
+      bool mMember[256];
+};
+
+/**
+   @brief Builds the CharTable of up to ten characters at compile time.
+
+   CharClass<'\r', '\n', '\t', ' ', ';'>::Table is the table of those five
+   characters. A std::bitset<256> built with Data::toBitset has to be filled
+   in at run time (std::bitset has no constant way to set bits before
+   C++23), so a function-local one pays for a guarded initialization on
+   every call and a namespace-scope one runs a static constructor. This
+   table is constant-initialized, so neither happens.
+
+   Unused arguments default to -1, which is no character; pass characters
+   above 0x7f as unsigned values.
+*/
+template <int C0, int C1 = -1, int C2 = -1, int C3 = -1, int C4 = -1,
+          int C5 = -1, int C6 = -1, int C7 = -1, int C8 = -1, int C9 = -1>
+class CharClass
+{
+   public:
+      static const CharTable Table;
+};
+
+#define RESIP_CHARCLASS_IS(c, i) ((c) != -1 && (unsigned char)(c) == (i))
+#define RESIP_CHARCLASS_MEMBER(i)                                        \
+   (RESIP_CHARCLASS_IS(C0, i) || RESIP_CHARCLASS_IS(C1, i) ||            \
+    RESIP_CHARCLASS_IS(C2, i) || RESIP_CHARCLASS_IS(C3, i) ||            \
+    RESIP_CHARCLASS_IS(C4, i) || RESIP_CHARCLASS_IS(C5, i) ||            \
+    RESIP_CHARCLASS_IS(C6, i) || RESIP_CHARCLASS_IS(C7, i) ||            \
+    RESIP_CHARCLASS_IS(C8, i) || RESIP_CHARCLASS_IS(C9, i))
+#define RESIP_CHARCLASS_ROW4(i)                                          \
+   RESIP_CHARCLASS_MEMBER(i), RESIP_CHARCLASS_MEMBER((i) + 1),           \
+   RESIP_CHARCLASS_MEMBER((i) + 2), RESIP_CHARCLASS_MEMBER((i) + 3)
+#define RESIP_CHARCLASS_ROW16(i)                                         \
+   RESIP_CHARCLASS_ROW4(i), RESIP_CHARCLASS_ROW4((i) + 4),               \
+   RESIP_CHARCLASS_ROW4((i) + 8), RESIP_CHARCLASS_ROW4((i) + 12)
+#define RESIP_CHARCLASS_ROW64(i)                                         \
+   RESIP_CHARCLASS_ROW16(i), RESIP_CHARCLASS_ROW16((i) + 16),            \
+   RESIP_CHARCLASS_ROW16((i) + 32), RESIP_CHARCLASS_ROW16((i) + 48)
+
+template <int C0, int C1, int C2, int C3, int C4,
+          int C5, int C6, int C7, int C8, int C9>
+const CharTable CharClass<C0, C1, C2, C3, C4, C5, C6, C7, C8, C9>::Table =
+{
+   {
+      RESIP_CHARCLASS_ROW64(0), RESIP_CHARCLASS_ROW64(64),
+      RESIP_CHARCLASS_ROW64(128), RESIP_CHARCLASS_ROW64(192)
+   }
+};
+
+#undef RESIP_CHARCLASS_ROW64
+#undef RESIP_CHARCLASS_ROW16
+#undef RESIP_CHARCLASS_ROW4
+#undef RESIP_CHARCLASS_MEMBER
+#undef RESIP_CHARCLASS_IS
+
+} // namespace resip
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
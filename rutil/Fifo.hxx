@@ -89,6 +89,7 @@ void
 Fifo<Msg>::clear()
 {
    Lock lock(mMutex); (void)lock;
+   this->drainRing();
    while ( ! mFifo.empty() )
    {
       delete mFifo.front();
@@ -101,6 +102,17 @@ template <class Msg>
 size_t
 Fifo<Msg>::add(Msg* msg)
 {
+   size_t queued = 0;
+   if(this->addLockFree(msg, queued))
+   {
+      if(queued==0 && mInterruptor)
+      {
+         // Only do this when the ring goes from empty to not empty.
+         mInterruptor->handleProcessNotification();
+      }
+      // does not count what the consumer has already moved off the ring
+      return queued + 1;
+   }
    size_t size = AbstractFifo<Msg*>::add(msg);
    if(size==1 && mInterruptor)
    {
@@ -19,6 +19,7 @@
 #include "rutil/ThreadIf.hxx"
 #include "rutil/Subsystem.hxx"
 #include "rutil/SysLogStream.hxx"
+#include "rutil/AsyncLogWriter.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
 using namespace resip;
@@ -64,6 +65,22 @@ const char
 Log::mDescriptions[][32] = {"NONE", "EMERG", "ALERT", "CRIT", "ERR", "WARNING", "NOTICE", "INFO", "DEBUG", "STACK", "CERR", ""}; 
 
 Mutex Log::_mutex;
+AsyncLogWriter* Log::mAsyncWriter = 0;
+#ifdef RESIP_HAS_STD_ATOMIC
+std::atomic<bool> Log::mAsync(false);
+#else
+volatile bool Log::mAsync = false;
+#endif
+
+#ifdef RESIP_ASYNC_LOG
+// Writes out what is left in the rings at exit; defined after Log::_mutex so
+// that it is destroyed before it.
+static class AsyncLogStopper
+{
+   public:
+      ~AsyncLogStopper() { Log::disableAsync(); }
+} asyncLogStopper;
+#endif
 
 extern "C"
 {
@@ -108,6 +125,12 @@ LogStaticInitializer::~LogStaticInitializer()
 
       ThreadIf::tlsKeyDelete(*Log::mLocalLoggerKey);
       delete Log::mLocalLoggerKey;
+
+#ifdef RESIP_ASYNC_LOG
+      // stopped by the AsyncLogStopper, Log::_mutex is gone by now
+      delete Log::mAsyncWriter;
+      Log::mAsyncWriter = 0;
+#endif
    }
 }
 
@@ -768,6 +791,55 @@ Log::Instance(unsigned int bytesToWrite)
    return getLoggerData().Instance(bytesToWrite);
 }
 
+void
+Log::enableAsync(unsigned int ringBytes)
+{
+#ifdef RESIP_ASYNC_LOG
+   Lock lock(_mutex);
+   if (mAsync)
+   {
+      return;
+   }
+   if (!mAsyncWriter)
+   {
+      mAsyncWriter = new AsyncLogWriter;
+   }
+   // the writer opens the log file itself, don't keep a second stream on it
+   mDefaultLoggerData.reset();
+   mAsyncWriter->start(ringBytes);
+   mAsync = true;
+#endif
+}
+
+void
+Log::disableAsync()
+{
+#ifdef RESIP_ASYNC_LOG
+   {
+      Lock lock(_mutex);
+      if (!mAsync)
+      {
+         return;
+      }
+      mAsync = false;
+   }
+   // not under _mutex, the writer takes it; stop() waits for the lines
+   // being posted as mAsync went false, and writes out all of the rings
+   mAsyncWriter->stop();
+#endif
+}
+
+UInt64
+Log::asyncDropCount()
+{
+#ifdef RESIP_ASYNC_LOG
+   Lock lock(_mutex);
+   return mAsyncWriter ? mAsyncWriter->dropCount() : 0;
+#else
+   return 0;
+#endif
+}
+
 void 
 Log::reset()
 {
@@ -944,6 +1016,14 @@ Log::Guard::~Guard()
       return;
    }
 
+#ifdef RESIP_ASYNC_LOG
+   if (mAsync && &getLoggerData() == &mDefaultLoggerData &&
+       mAsyncWriter->post(mLevel, mData))
+   {
+      return;
+   }
+#endif
+
    resip::Lock lock(resip::Log::_mutex);
    // !dlb! implement VSDebugWindow as an external logger
    if (logType == resip::Log::VSDebugWindow)
@@ -990,26 +1070,9 @@ Log::ThreadData::Instance(unsigned int bytesToWrite)
             Data logFileName(mLogFileName != "" ? mLogFileName : "resiprocate.log");
             if (mLogger)
             {
-               if (keepAllLogFiles())
-               {
-                  char buffer[256];
-                  Data ts(Data::Borrow, buffer, sizeof(buffer));
-                  Data oldLogFileName(logFileName + "_" + timestamp(ts));
-
-                  delete mLogger;
-
-                  // Keep all log files, rename the log file with timestamp
-                  rename(logFileName.c_str(), oldLogFileName.c_str());
-               }
-               else
-               {
-                  Data oldLogFileName(logFileName + ".old");
-                  delete mLogger;
-                  // Keep one backup file: Delete .old file, Rename log file to .old
-                  // Could be expanded in the future to keep X backup log files
-                  remove(oldLogFileName.c_str());
-                  rename(logFileName.c_str(), oldLogFileName.c_str());
-               }
+               delete mLogger;
+               mLogger = 0;
+               rotateLogFile(logFileName, keepAllLogFiles());
             }
             mLogger = new std::ofstream(logFileName.c_str(), std::ios_base::out | std::ios_base::app);
             mLineCount = 0;
@@ -1027,6 +1090,27 @@ Log::ThreadData::reset()
 {
    delete mLogger;
    mLogger = NULL;
+   ++mGeneration;
+}
+
+void
+Log::rotateLogFile(const Data& logFileName, bool keepAllLogFiles)
+{
+   if (keepAllLogFiles)
+   {
+      Data oldLogFileName(logFileName + "_" + timestamp());
+
+      // Keep all log files, rename the log file with timestamp
+      rename(logFileName.c_str(), oldLogFileName.c_str());
+   }
+   else
+   {
+      Data oldLogFileName(logFileName + ".old");
+      // Keep one backup file: Delete .old file, Rename log file to .old
+      // Could be expanded in the future to keep X backup log files
+      remove(oldLogFileName.c_str());
+      rename(logFileName.c_str(), oldLogFileName.c_str());
+   }
 }
 
 #ifndef WIN32
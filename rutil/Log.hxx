@@ -14,6 +14,7 @@
 #include "rutil/Lock.hxx"
 #include "rutil/HashMap.hxx"
 #include "rutil/ThreadIf.hxx"
+#include "rutil/MpscRing.hxx" // for RESIP_HAS_STD_ATOMIC
 #include <iostream>
 
 // !ipse! I think that this remark is no more valid with recent changes,
@@ -42,6 +43,7 @@ extern "C"
 namespace resip
 {
 
+class AsyncLogWriter;
 class ExternalLogger;
 class Subsystem;
 
@@ -257,6 +259,25 @@ class Log
       static int setThreadLocalLogger(LocalLoggerId loggerId);
 
 
+      /** @brief Takes the writing of log lines off the threads that log.
+         Each thread formats its lines into a ring of ringBytes bytes of its
+         own and a writer thread writes them out in batches: with writev()
+         for Cout, Cerr and File, one syslog() call per line for Syslog.
+         A line that does not fit in its thread's ring is dropped and counted
+         (see asyncDropCount()) instead of making the thread wait.
+
+         Applies to the default logger only; threads with a thread local
+         logger and external loggers keep logging synchronously. Lines still
+         in the rings when the process dies are lost. A no-op on WIN32 and
+         without C++11 atomics.
+      */
+      static void enableAsync(unsigned int ringBytes = 1 << 20);
+      /// Writes out every line logged so far and goes back to synchronous logging.
+      static void disableAsync();
+      static bool isAsync() { return mAsync; }
+      /// Lines dropped because a ring was full, since the process started.
+      static UInt64 asyncDropCount();
+
       static std::ostream& Instance(unsigned int bytesToWrite);
       static bool isLogging(Log::Level level, const Subsystem&);
       static void OutputToWin32DebugWindow(const Data& result);      
@@ -274,6 +295,17 @@ class Log
       static unsigned int MaxByteCount;
       static bool KeepAllLogFiles;
 
+      /// Moves logFileName out of the way, before a new one is started.
+      static void rotateLogFile(const Data& logFileName, bool keepAllLogFiles);
+
+      friend class AsyncLogWriter;
+      static AsyncLogWriter* mAsyncWriter;
+#ifdef RESIP_HAS_STD_ATOMIC
+      static std::atomic<bool> mAsync;
+#else
+      static volatile bool mAsync; // never set, there is no async mode
+#endif
+
       class ThreadData
       {
          public:
@@ -289,7 +321,8 @@ class Log
                  mId(id),
                  mType(type),
                  mLogger(NULL),
-                 mLineCount(0)
+                 mLineCount(0),
+                 mGeneration(0)
             {
                if (logFileName)
                {
@@ -340,6 +373,8 @@ class Log
             Data mLogFileName;
             std::ostream* mLogger;
             unsigned int mLineCount;
+            friend class AsyncLogWriter;
+            unsigned int mGeneration; ///< bumped by reset(), tells AsyncLogWriter to reopen
       };
 
       static ThreadData mDefaultLoggerData; ///< Default logger settings.
@@ -98,6 +98,39 @@ MD5Stream::bytesTaken()
    return MD5Buffer::bytesTaken();
 }
 
+MD5Hash::MD5Hash()
+{
+   MD5Init(&mContext);
+}
+
+void
+MD5Hash::update(const char* data, size_t len)
+{
+   MD5Update(&mContext, reinterpret_cast<unsigned const char*>(data), (unsigned int)len);
+}
+
+void
+MD5Hash::getHex(char hex[HexLength]) const
+{
+   static const char hexDigits[] = "0123456789abcdef";
+   unsigned char bin[16];
+   MD5Context tmp = mContext;
+   MD5Final(bin, &tmp);
+   for (int i = 0; i < 16; ++i)
+   {
+      hex[2*i] = hexDigits[bin[i] >> 4];
+      hex[2*i+1] = hexDigits[bin[i] & 0x0f];
+   }
+}
+
+Data
+MD5Hash::getHex() const
+{
+   char hex[HexLength];
+   getHex(hex);
+   return Data(hex, HexLength);
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
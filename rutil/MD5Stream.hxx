@@ -50,6 +50,36 @@ class MD5Stream : private MD5Buffer, public std::ostream
       //MD5Buffer mStreambuf;
 };
 
+/**
+   @brief Accumulates data directly into an MD5 context, without the
+    std::ostream machinery of MD5Stream.  Intended for hot paths (such as
+    digest verification) that hash a handful of known fields.
+ */
+class MD5Hash
+{
+   public:
+      enum { HexLength = 32 };
+
+      MD5Hash();
+
+      void update(const char* data, size_t len);
+      void update(const Data& data) { update(data.data(), data.size()); }
+      void update(char c) { update(&c, 1); }
+
+      /** Writes the lowercase hexadecimal digest of the data accumulated so
+          far into hex (not null terminated).  The hash may be updated
+          further afterwards.
+       */
+      void getHex(char hex[HexLength]) const;
+      /** @returns the MD5 hexadecimal representation of the data accumulated
+          so far.
+       */
+      Data getHex() const;
+
+   private:
+      MD5Context mContext;
+};
+
 }
 
 #endif
@@ -0,0 +1,254 @@
+#if !defined(RESIP_MPSCRING_HXX)
+#define RESIP_MPSCRING_HXX
+
+#include <map> // force include of <bits/c++config.h>, see HashMap.hxx
+#include <stddef.h>
+
+#include "rutil/ResipAssert.h"
+
+#if (defined(__cplusplus) && (__cplusplus >= 201103L)) || (defined(WIN32) && defined(_MSC_VER) && (_MSC_VER >= 1900)) || (defined(_LIBCPP_VERSION) && (_LIBCPP_VERSION >= 1000))
+#  define RESIP_HAS_STD_ATOMIC
+#  include <atomic>
+#endif
+
+namespace resip
+{
+
+#ifdef RESIP_HAS_STD_ATOMIC
+
+/**
+   @internal
+   @brief Bounded multi-producer/single-consumer ring of T.
+
+   push() is lock-free and may be called from any number of threads; it
+   fails when the ring is full. popAll() must only ever be called by one
+   thread at a time (AbstractFifo serializes it with its mutex). Each cell
+   carries a sequence number that tells whether it is free, being written,
+   or ready to be read, so producers only contend on the enqueue position.
+   The number of items is the distance between the enqueue and dequeue
+   positions; the consumer advances the dequeue position before it frees
+   any cell, so a producer can never claim a cell ahead of it and size()
+   never exceeds the capacity.
+
+   The ring also carries a "consumer is about to sleep" flag. A consumer
+   sets it before its final check for items and then blocks; a producer
+   checks it after publishing an item and wakes the consumer only if it is
+   set. That way the uncontended path never touches a mutex.
+*/
+template <class T>
+class MpscRing
+{
+   public:
+      /// @param capacity rounded up to a power of two
+      explicit MpscRing(unsigned int capacity) :
+         mEnqueuePos(0),
+         mDequeuePos(0),
+         mConsumerWaiting(false)
+      {
+         size_t size = 2;
+         while (size < capacity)
+         {
+            size <<= 1;
+         }
+         mMask = size - 1;
+         mCapacity = size;
+         mCells = new Cell[size];
+         for (size_t i = 0; i < size; ++i)
+         {
+            mCells[i].mSequence.store(i, std::memory_order_relaxed);
+         }
+      }
+
+      ~MpscRing()
+      {
+         delete [] mCells;
+      }
+
+      /// @param previous number of items in the ring before this one
+      /// @retval false if the ring is full
+      bool push(const T& item, size_t& previous)
+      {
+         Cell* cell;
+         size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+         for (;;)
+         {
+            cell = &mCells[pos & mMask];
+            size_t seq = cell->mSequence.load(std::memory_order_acquire);
+            long dif = (long)(seq - pos);
+            if (dif == 0)
+            {
+               if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+               {
+                  break;
+               }
+            }
+            else if (dif < 0)
+            {
+               return false;
+            }
+            else
+            {
+               pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+         }
+         size_t dequeuePos = mDequeuePos.load();
+         previous = pos > dequeuePos ? pos - dequeuePos : 0;
+         cell->mItem = item;
+         cell->mSequence.store(pos + 1, std::memory_order_release);
+         return true;
+      }
+
+      /// single consumer only; appends everything available to out
+      /// @return number of items moved
+      template <class Container>
+      size_t popAll(Container& out)
+      {
+         const size_t start = mDequeuePos.load(std::memory_order_relaxed);
+         size_t num = 0;
+         for (;;)
+         {
+            Cell* cell = &mCells[(start + num) & mMask];
+            size_t seq = cell->mSequence.load(std::memory_order_acquire);
+            if ((long)(seq - (start + num + 1)) < 0)
+            {
+               break;
+            }
+            out.push_back(cell->mItem);
+            ++num;
+         }
+         if (num)
+         {
+            // publish the new position before any of the cells are reusable
+            mDequeuePos.store(start + num);
+            for (size_t i = 0; i < num; ++i)
+            {
+               mCells[(start + i) & mMask].mSequence.store(start + i + mMask + 1, std::memory_order_release);
+            }
+         }
+         return num;
+      }
+
+      /// approximate when producers are active (it counts items still
+      /// being written), but never more than capacity()
+      size_t size() const
+      {
+         // the enqueue position first: the dequeue position read after it
+         // is at least as far on as it was then, so the difference can't
+         // exceed the capacity (though it can be "negative")
+         size_t enqueuePos = mEnqueuePos.load();
+         size_t dequeuePos = mDequeuePos.load();
+         return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+      }
+
+      size_t capacity() const
+      {
+         return mCapacity;
+      }
+
+      /// consumer side; call with true before the last check for items
+      void setConsumerWaiting(bool waiting)
+      {
+         mConsumerWaiting.store(waiting);
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+
+      /// producer side; call after a successful push()
+      bool consumerWaiting() const
+      {
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+         return mConsumerWaiting.load();
+      }
+
+   private:
+      struct Cell
+      {
+         std::atomic<size_t> mSequence;
+         T mItem;
+      };
+
+      // keep the producers' and the consumer's hot fields on separate
+      // cache lines
+      char mPad0[64];
+      std::atomic<size_t> mEnqueuePos;
+      char mPad1[64];
+      std::atomic<size_t> mDequeuePos;  // only the consumer moves it
+      std::atomic<bool> mConsumerWaiting;
+      Cell* mCells;
+      size_t mMask;
+      size_t mCapacity;
+
+      MpscRing(const MpscRing&);
+      MpscRing& operator=(const MpscRing&);
+};
+
+#else
+
+// Without <atomic> there is no lock-free ring; AbstractFifo never creates
+// one and always takes its mutex.
+template <class T>
+class MpscRing
+{
+   public:
+      explicit MpscRing(unsigned int) { resip_assert(0); }
+      bool push(const T&, size_t&) { return false; }
+      template <class Container>
+      size_t popAll(Container&) { return 0; }
+      size_t size() const { return 0; }
+      size_t capacity() const { return 0; }
+      void setConsumerWaiting(bool) {}
+      bool consumerWaiting() const { return false; }
+};
+
+#endif
+
+} // namespace resip
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -1,8 +1,11 @@
 #include "rutil/ResipAssert.h"
 
+#include <string.h>
+
 #include "rutil/Logger.hxx"
 #include "rutil/ParseBuffer.hxx"
 #include "rutil/ParseException.hxx"
+#include "rutil/Simd.hxx"
 #include "rutil/DataStream.hxx"
 #include "rutil/WinLeakCheck.hxx"
 
@@ -14,6 +17,159 @@ const char* ParseBuffer::ParamTerm = ";?"; // maybe include "@>,"?
 const char* ParseBuffer::Whitespace = " \t\r\n";
 const Data ParseBuffer::Pointer::msg("dereferenced ParseBuffer eof");
 
+namespace
+{
+
+// The sets of characters the skip functions search for are small -
+// delimiters, whitespace, quotes.  Each member is compared against a
+// block of characters at once; bigger sets are searched for a character
+// at a time.
+class SearchSet
+{
+   public:
+      enum { MaxChars = 8 };
+
+      SearchSet() : mSize(0) {}
+      explicit SearchSet(const char* cs) : mSize(0) { add(cs); }
+
+      bool add(char c)
+      {
+         if (mSize == MaxChars)
+         {
+            mSize = MaxChars + 1;  // too many
+         }
+         else if (mSize < MaxChars)
+         {
+            mChars[mSize++] = c;
+         }
+         return mSize <= MaxChars;
+      }
+      bool add(const char* cs)
+      {
+         while (*cs && add(*cs++));
+         return mSize <= MaxChars;
+      }
+      bool add(const Data& cs)
+      {
+         for (Data::size_type i = 0; i < cs.size() && add(cs[i]); i++);
+         return mSize <= MaxChars;
+      }
+      bool contains(char c) const
+      {
+         for (unsigned int i = 0; i < mSize; i++)
+         {
+            if (mChars[i] == c)
+            {
+               return true;
+            }
+         }
+         return false;
+      }
+
+      // Returns the first character in [pos, end) that is a member of the
+      // set (or, if member is false, is not), or end.
+      const char* find(const char* pos, const char* end, bool member) const;
+
+   private:
+      char mChars[MaxChars];
+      unsigned int mSize;
+};
+
+const SearchSet WhitespaceSet(" \t\r\n");
+
+#if defined(RESIP_SIMD_SSE2)
+
+inline unsigned int
+matchBits(__m128i block, const __m128i* chars, unsigned int numChars)
+{
+   __m128i match = _mm_cmpeq_epi8(block, chars[0]);
+   for (unsigned int i = 1; i < numChars; i++)
+   {
+      match = _mm_or_si128(match, _mm_cmpeq_epi8(block, chars[i]));
+   }
+   return (unsigned int)_mm_movemask_epi8(match);
+}
+
+#if defined(RESIP_SIMD_AVX2)
+inline unsigned int
+matchBits(__m256i block, const __m256i* chars, unsigned int numChars)
+{
+   __m256i match = _mm256_cmpeq_epi8(block, chars[0]);
+   for (unsigned int i = 1; i < numChars; i++)
+   {
+      match = _mm256_or_si256(match, _mm256_cmpeq_epi8(block, chars[i]));
+   }
+   return (unsigned int)_mm256_movemask_epi8(match);
+}
+#endif
+
+#endif
+
+const char*
+SearchSet::find(const char* pos, const char* end, bool member) const
+{
+   resip_assert(mSize > 0 && mSize <= MaxChars);
+#if defined(RESIP_SIMD_SSE2)
+   if (end - pos >= 16)
+   {
+#if defined(RESIP_SIMD_AVX2)
+      if (end - pos >= 32)
+      {
+         __m256i chars[MaxChars];
+         for (unsigned int i = 0; i < mSize; i++)
+         {
+            chars[i] = _mm256_set1_epi8(mChars[i]);
+         }
+         const unsigned int flip = member ? 0 : 0xFFFFFFFFu;
+         do
+         {
+            unsigned int bits = matchBits(_mm256_loadu_si256((const __m256i*)pos), chars, mSize) ^ flip;
+            if (bits)
+            {
+               return pos + lowestBitIndex(bits);
+            }
+            pos += 32;
+         } while (end - pos >= 32);
+      }
+#endif
+      __m128i chars[MaxChars];
+      for (unsigned int i = 0; i < mSize; i++)
+      {
+         chars[i] = _mm_set1_epi8(mChars[i]);
+      }
+      const unsigned int flip = member ? 0 : 0xFFFFu;
+      while (end - pos >= 16)
+      {
+         unsigned int bits = matchBits(_mm_loadu_si128((const __m128i*)pos), chars, mSize) ^ flip;
+         if (bits)
+         {
+            return pos + lowestBitIndex(bits);
+         }
+         pos += 16;
+      }
+      if (pos < end)
+      {
+         // the last block overlaps characters already searched; skip them
+         const char* last = end - 16;
+         unsigned int bits = matchBits(_mm_loadu_si128((const __m128i*)last), chars, mSize) ^ flip;
+         bits &= 0xFFFFu << (pos - last);
+         return bits ? last + lowestBitIndex(bits) : end;
+      }
+      return end;
+   }
+#endif
+   for (; pos < end; pos++)
+   {
+      if (contains(*pos) == member)
+      {
+         return pos;
+      }
+   }
+   return end;
+}
+
+}
+
 ParseBuffer::ParseBuffer(const char* buff, size_t len, 
                          const Data& errorContext)
    : mBuff(buff),
@@ -115,40 +271,17 @@ ParseBuffer::CurrentPosition
 ParseBuffer::skipNonWhitespace()
 {
    assertNotEof();
-   while (mPosition < mEnd)
-   {
-      switch (*mPosition)
-      {
-         case ' ' :
-         case '\t' : 
-         case '\r' : 
-         case '\n' : 
-            return CurrentPosition(*this);
-         default : 
-            mPosition++;
-      }
-   }
+   mPosition = WhitespaceSet.find(mPosition, mEnd, true);
    return CurrentPosition(*this);
 }
 
 ParseBuffer::CurrentPosition
 ParseBuffer::skipWhitespace()
 {
-   while (mPosition < mEnd)
+   // usually there is none, or a single space
+   if (mPosition < mEnd && WhitespaceSet.contains(*mPosition))
    {
-      switch (*mPosition)
-      {
-         case ' ' :
-         case '\t' : 
-         case '\r' : 
-         case '\n' : 
-         {
-            mPosition++;
-            break;
-         }
-         default : 
-            return CurrentPosition(*this);
-      }
+      mPosition = WhitespaceSet.find(mPosition + 1, mEnd, false);
    }
    return CurrentPosition(*this);
 }
@@ -239,71 +372,50 @@ ParseBuffer::skipToTermCRLF()
    return CurrentPosition(*this);
 }
 
+// memchr finds candidates for the first character a block at a time
+static const char*
+findChars(const char* pos, const char* end, const char* cs, size_t l)
+{
+   while ((size_t)(end - pos) >= l)
+   {
+      const char* first = (const char*)memchr(pos, cs[0], (end - pos) - l + 1);
+      if (first == 0)
+      {
+         break;
+      }
+      if (memcmp(first + 1, cs + 1, l - 1) == 0)
+      {
+         return first;
+      }
+      pos = first + 1;
+   }
+   return end;
+}
+
 ParseBuffer::CurrentPosition
 ParseBuffer::skipToChars(const char* cs)
 {
    resip_assert(cs);
-   unsigned int l = (unsigned int)strlen(cs);
-
-   const char* rpos;
-   const char* cpos;
-   // Checking mPosition >= mEnd - l +1 is unnecessary because there won't be
-   // enough bytes left to find [cs].
-   while (mPosition < mEnd - l + 1)
+   size_t l = strlen(cs);
+   if (l > 0)
    {
-      rpos = mPosition;
-      cpos = cs;
-      for (unsigned int i = 0; i < l; i++)
-      {
-         if (*cpos++ != *rpos++)
-         {
-            mPosition++;
-            goto skip;
-         }
-      }
-      return CurrentPosition(*this);
-     skip: ;
+      // Advances to the end if there is no match.
+      mPosition = findChars(mPosition, mEnd, cs, l);
    }
-   // Advance to the end since we didn't find a match.
-   mPosition = mEnd;
    return CurrentPosition(*this);
 }
 
 ParseBuffer::CurrentPosition
 ParseBuffer::skipToChars(const Data& sub)
 {
-   const char* begSub = sub.mBuf;
-   const char* endSub = sub.mBuf + sub.mSize;
-   if(begSub == endSub)
+   if(sub.empty())
    {
       fail(__FILE__, __LINE__, "ParseBuffer::skipToChars() called with an "
                                  "empty string. Don't do this!");
    }
 
-   while (true)
-   {
-next:
-     const char* searchPos = mPosition;
-     const char* subPos = sub.mBuf;
-
-     while (subPos != endSub) 
-     {
-         if (searchPos == mEnd)
-         {
-            // nope
-            mPosition = mEnd;
-            return CurrentPosition(*this);
-         }
-         if (*subPos++ != *searchPos++)
-         {
-            // nope, but try the next position
-            ++mPosition;
-            goto next;
-         }
-     }
-     // found a match
-     return CurrentPosition(*this);
-   }
+   mPosition = findChars(mPosition, mEnd, sub.data(), sub.size());
+   return CurrentPosition(*this);
 }
 
 bool 
@@ -335,6 +447,13 @@ ParseBuffer::oneOf(char c, const Data& cs)
 ParseBuffer::CurrentPosition
 ParseBuffer::skipToOneOf(const char* cs)
 {
+   SearchSet set;
+   if (set.add(cs) && *cs)
+   {
+      mPosition = set.find(mPosition, mEnd, true);
+      return CurrentPosition(*this);
+   }
+
    while (mPosition < mEnd)
    {
       if (oneOf(*mPosition, cs))
@@ -353,6 +472,13 @@ ParseBuffer::CurrentPosition
 ParseBuffer::skipToOneOf(const char* cs1,
                          const char* cs2)
 {
+   SearchSet set;
+   if (set.add(cs1) && set.add(cs2) && (*cs1 || *cs2))
+   {
+      mPosition = set.find(mPosition, mEnd, true);
+      return CurrentPosition(*this);
+   }
+
    while (mPosition < mEnd)
    {
       if (oneOf(*mPosition, cs1) ||
@@ -371,6 +497,13 @@ ParseBuffer::skipToOneOf(const char* cs1,
 ParseBuffer::CurrentPosition
 ParseBuffer::skipToOneOf(const Data& cs)
 {
+   SearchSet set;
+   if (set.add(cs) && !cs.empty())
+   {
+      mPosition = set.find(mPosition, mEnd, true);
+      return CurrentPosition(*this);
+   }
+
    while (mPosition < mEnd)
    {
       if (oneOf(*mPosition, cs))
@@ -389,6 +522,13 @@ ParseBuffer::CurrentPosition
 ParseBuffer::skipToOneOf(const Data& cs1,
                          const Data& cs2)
 {
+   SearchSet set;
+   if (set.add(cs1) && set.add(cs2) && !(cs1.empty() && cs2.empty()))
+   {
+      mPosition = set.find(mPosition, mEnd, true);
+      return CurrentPosition(*this);
+   }
+
    while (mPosition < mEnd)
    {
       if (oneOf(*mPosition, cs1) ||
@@ -407,20 +547,24 @@ ParseBuffer::skipToOneOf(const Data& cs1,
 const char*
 ParseBuffer::skipToEndQuote(char quote)
 {
+   SearchSet set;
+   set.add(quote);
+   set.add('\\');
    while (mPosition < mEnd)
    {
+      mPosition = set.find(mPosition, mEnd, true);
+      if (mPosition == mEnd)
+      {
+         break;
+      }
       // !dlb! mark character encoding
       if (*mPosition == '\\')
       {
          mPosition += 2;
       }
-      else if (*mPosition == quote)
-      {
-         return mPosition;
-      }
       else
       {
-         mPosition++;
+         return mPosition;
       }
    }
 
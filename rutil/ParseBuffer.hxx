@@ -1,6 +1,7 @@
 #if !defined(RESIP_PARSEBUFFER_HXX)
 #define RESIP_PARSEBUFFER_HXX 
 
+#include "rutil/CharClass.hxx"
 #include "rutil/Data.hxx"
 #include "rutil/ParseException.hxx"
 
@@ -148,37 +149,24 @@ class ParseBuffer
       CurrentPosition skipToOneOf(const Data& cs);
       CurrentPosition skipToOneOf(const Data& cs1, const Data& cs2);
 
-      // std::bitset based parse function
+      // std::bitset and CharTable based parse functions
+      // Both are already tables of the character class; a CharTable from
+      // CharClass is built at compile time, see CharClass.hxx.
       CurrentPosition skipChars(const std::bitset<256>& cs)
       {
-         while (mPosition < mEnd)
-         {
-            if (cs.test((unsigned char)(*mPosition)))
-            {
-               mPosition++;
-            }
-            else
-            {
-               return CurrentPosition(*this);
-            }
-         }
-         return CurrentPosition(*this);
+         return skipCharsIn(cs);
+      }
+      CurrentPosition skipChars(const CharTable& cs)
+      {
+         return skipCharsIn(cs);
       }
-
       CurrentPosition skipToOneOf(const std::bitset<256>& cs)
       {
-         while (mPosition < mEnd)
-         {
-            if (cs.test((unsigned char)(*mPosition)))
-            {
-               return CurrentPosition(*this);
-            }
-            else
-            {
-               mPosition++;
-            }
-         }
-         return CurrentPosition(*this);
+         return skipToOneOfIn(cs);
+      }
+      CurrentPosition skipToOneOf(const CharTable& cs)
+      {
+         return skipToOneOfIn(cs);
       }
 
       const char* skipToEndQuote(char quote = '"');
@@ -261,6 +249,25 @@ class ParseBuffer
       static const char* Whitespace;
       static const char* ParamTerm;
    private:
+      // operator[] on either table skips the range check bitset::test()
+      // does, which can't fail for a char
+      template <class Table> CurrentPosition skipCharsIn(const Table& cs)
+      {
+         while (mPosition < mEnd && cs[(unsigned char)(*mPosition)])
+         {
+            mPosition++;
+         }
+         return CurrentPosition(*this);
+      }
+      template <class Table> CurrentPosition skipToOneOfIn(const Table& cs)
+      {
+         while (mPosition < mEnd && !cs[(unsigned char)(*mPosition)])
+         {
+            mPosition++;
+         }
+         return CurrentPosition(*this);
+      }
+
       friend class ParseBuffer::CurrentPosition;
       const char* mBuff;
       const char* mPosition;
@@ -0,0 +1,101 @@
+#if !defined(RESIP_SIMD_HXX)
+#define RESIP_SIMD_HXX
+
+/*
+   Which x86 vector instructions the code may use. This is decided when
+   compiling, from the -m flags (or /arch on MSVC) the build passes, and is
+   not checked again at run time: a binary built with -mavx2 needs a CPU
+   with AVX2.
+
+   RESIP_SIMD_SSE2 is defined when SSE2 is available, which is always the
+   case on x86-64. RESIP_SIMD_AVX2 is defined as well when AVX2 is.
+   The matching intrinsics headers are included here.
+*/
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESIP_SIMD_SSE2
+#if defined(__AVX2__)
+#define RESIP_SIMD_AVX2
+#endif
+#endif
+
+#if defined(RESIP_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(RESIP_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+#if defined(RESIP_SIMD_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace resip
+{
+
+#if defined(RESIP_SIMD_SSE2)
+
+/// Returns the position of the lowest bit set in bits, which must not be
+/// 0; turns the mask from a _mm_movemask_epi8() match into an offset.
+inline unsigned int
+lowestBitIndex(unsigned int bits)
+{
+#if defined(_MSC_VER)
+   unsigned long index;
+   _BitScanForward(&index, bits);
+   return index;
+#else
+   return __builtin_ctz(bits);
+#endif
+}
+
+#endif
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,567 @@
+#if !defined(RESIP_TIMERWHEEL_HXX)
+#define RESIP_TIMERWHEEL_HXX 
+
+#include <vector>
+
+#include "rutil/compat.hxx"
+#include "rutil/ResipAssert.h"
+
+namespace resip
+{
+
+/**
+   @brief Hierarchical hashed timing wheel with millisecond resolution.
+
+   Stores values of type T (which must be copyable and assignable) keyed
+   by an absolute expiry time, as returned by Timer::getTimeMs(). The
+   root wheel has one slot per millisecond for the next 256ms; each of the
+   four outer wheels has 64 slots, each slot covering the whole span of
+   the wheel below, which gives a range of 2^32ms (about 49 days).
+   Anything later than that waits in an overflow list, and anything added
+   with a time expire() has already passed goes to a due list that the
+   next expire() empties first. Entries are moved (cascaded) one wheel down
+   whenever the wheel below wraps.
+
+   add() and cancel() are O(1). expire() hands every due entry to a
+   handler, one slot at a time, and skips over empty stretches of time.
+   nextExpiry() is exact unless entries have been cancelled. In that case
+   it may be early, but never late.
+
+   Entries live in a node pool that only grows and never moves them, so
+   the reference handed to an expire() handler stays valid even if the
+   handler adds new entries.
+   Not thread safe.
+*/
+template <class T>
+class TimerWheel
+{
+   public:
+      /// Identifies one add()ed entry; stays unique after the entry expired
+      /// or was cancelled, so a stale handle is harmless. 0 is never used.
+      typedef UInt64 Handle;
+
+      explicit TimerWheel(UInt64 now=0) :
+         mCurrent(now),
+         mSize(0),
+         mFree(Nil),
+         mNextValid(false),
+         mNext(0)
+      {
+         for (unsigned int i = 0; i < NumSlots; ++i)
+         {
+            mHeads[i] = Nil;
+            mMin[i] = 0;
+         }
+         for (unsigned int i = 0; i < Levels+2; ++i)
+         {
+            mCount[i] = 0;
+         }
+      }
+
+      Handle add(UInt64 when, const T& value)
+      {
+         UInt32 idx;
+         if (mFree != Nil)
+         {
+            idx = mFree;
+            mFree = mNodes[idx].mNext;
+            mNodes[idx].mValue = value;
+         }
+         else
+         {
+            idx = (UInt32)mNodes.size();
+            mNodes.push_back(Node(value));
+         }
+         Node& node = mNodes[idx];
+         node.mWhen = when;
+         place(idx);
+         ++mSize;
+
+         if (mNextValid && when < mNext)
+         {
+            mNext = when;
+         }
+         return (UInt64(node.mGeneration) << 32) | idx;
+      }
+
+      /// @retval the pending entry identified by handle, or 0 if it already
+      /// expired or was cancelled
+      const T* find(Handle handle) const
+      {
+         UInt32 idx = (UInt32)(handle & 0xffffffff);
+         if (idx >= mNodes.size() || 
+             mNodes[idx].mSlot == Nil ||
+             mNodes[idx].mGeneration != (UInt32)(handle >> 32))
+         {
+            return 0;
+         }
+         return &mNodes[idx].mValue;
+      }
+
+      /// @retval true if the entry was still pending and has been removed
+      bool cancel(Handle handle)
+      {
+         if (!find(handle))
+         {
+            return false;
+         }
+         UInt32 idx = (UInt32)(handle & 0xffffffff);
+         unlink(idx);
+         release(idx);
+         --mSize;
+         // mMin of the slot is left alone; it is a lower bound now
+         mNextValid = false;
+         return true;
+      }
+
+      /// Calls handler(value) for every entry due at or before now, in order
+      /// of expiry, and removes it.
+      template <class Handler>
+      void expire(UInt64 now, Handler& handler)
+      {
+         mNextValid = false;
+         while (mHeads[DueSlot] != Nil)
+         {
+            UInt32 idx = mHeads[DueSlot];
+            unlink(idx);
+            --mSize;
+            handler(mNodes[idx].mValue);
+            release(idx);
+         }
+         if (mSize == 0)
+         {
+            if (now >= mCurrent)
+            {
+               mCurrent = now + 1;
+            }
+            return;
+         }
+
+         while (mCurrent <= now)
+         {
+            if ((mCurrent & (RootSize-1)) == 0)
+            {
+               cascade();
+            }
+
+            UInt32 slot = (UInt32)(mCurrent & (RootSize-1));
+            while (mHeads[slot] != Nil)
+            {
+               UInt32 idx = mHeads[slot];
+               unlink(idx);
+               --mSize;
+               handler(mNodes[idx].mValue);
+               release(idx);
+            }
+            ++mCurrent;
+
+            if (mCount[0] == 0)
+            {
+               // Nothing can fire before the next wheel that has entries
+               // cascades, so jump straight to its next slot boundary.
+               unsigned int level = 1;
+               while (level <= Levels && mCount[level] == 0)
+               {
+                  ++level;
+               }
+               if (level > Levels)
+               {
+                  mCurrent = now + 1;
+                  break;
+               }
+               UInt64 span = UInt64(1) << shift(level);
+               UInt64 boundary = (mCurrent + span - 1) & ~(span - 1);
+               mCurrent = resipMin(boundary, now + 1);
+            }
+         }
+      }
+
+      /// @retval time of the earliest entry
+      /// @note only meaningful if !empty()
+      UInt64 nextExpiry() const
+      {
+         if (!mNextValid)
+         {
+            mNext = computeNext();
+            mNextValid = true;
+         }
+         return mNext;
+      }
+
+      /// @retval the entry that will expire next (0 if empty); like
+      /// nextExpiry() this may be off after cancel(). Linear in the number
+      /// of entries sharing its slot, so meant for diagnostics.
+      const T* top() const
+      {
+         if (mSize == 0)
+         {
+            return 0;
+         }
+         UInt32 slot = earliestSlot();
+         const Node* best = 0;
+         for (UInt32 idx = mHeads[slot]; idx != Nil; idx = mNodes[idx].mNext)
+         {
+            if (!best || mNodes[idx].mWhen < best->mWhen)
+            {
+               best = &mNodes[idx];
+            }
+         }
+         return best ? &best->mValue : 0;
+      }
+
+      /// Calls handler(value) for every pending entry and removes them all.
+      template <class Handler>
+      void clear(Handler& handler)
+      {
+         for (unsigned int slot = 0; slot < NumSlots; ++slot)
+         {
+            while (mHeads[slot] != Nil)
+            {
+               UInt32 idx = mHeads[slot];
+               unlink(idx);
+               handler(mNodes[idx].mValue);
+               release(idx);
+            }
+         }
+         mSize = 0;
+         mNextValid = false;
+      }
+
+      void clear()
+      {
+         NullHandler handler;
+         clear(handler);
+      }
+
+      size_t size() const { return mSize; }
+      bool empty() const { return mSize == 0; }
+
+   private:
+      enum
+      {
+         RootBits = 8,
+         LevelBits = 6,
+         Levels = 5, // root wheel + 4 outer wheels; level Levels is overflow
+         RootSize = 1 << RootBits,
+         LevelSize = 1 << LevelBits,
+         OverflowSlot = RootSize + (Levels-1)*LevelSize,
+         DueSlot = OverflowSlot + 1, // level Levels+1
+         NumSlots = DueSlot + 1
+      };
+      static const UInt32 Nil = 0xffffffff;
+
+      class Node
+      {
+         public:
+            explicit Node(const T& value) :
+               mValue(value), mWhen(0), mPrev(Nil), mNext(Nil),
+               mSlot(Nil), mGeneration(1)
+            {}
+            T mValue;
+            UInt64 mWhen;
+            UInt32 mPrev;
+            UInt32 mNext;
+            UInt32 mSlot; // Nil while on the free list
+            UInt32 mGeneration;
+      };
+
+      // Grows a chunk at a time; unlike a std::vector, existing nodes never
+      // move, and indexing is cheaper than a std::deque of big nodes.
+      class NodePool
+      {
+         public:
+            NodePool() : mSize(0) {}
+            Node& operator[](UInt32 idx) { return mChunks[idx >> ChunkBits][idx & (ChunkSize-1)]; }
+            const Node& operator[](UInt32 idx) const { return mChunks[idx >> ChunkBits][idx & (ChunkSize-1)]; }
+            size_t size() const { return mSize; }
+            void push_back(const Node& node)
+            {
+               if ((mSize & (ChunkSize-1)) == 0)
+               {
+                  mChunks.push_back(std::vector<Node>());
+                  mChunks.back().reserve(ChunkSize);
+               }
+               mChunks.back().push_back(node);
+               ++mSize;
+            }
+         private:
+            enum { ChunkBits = 10, ChunkSize = 1 << ChunkBits };
+            std::vector<std::vector<Node> > mChunks;
+            size_t mSize;
+      };
+
+      class NullHandler
+      {
+         public:
+            void operator()(const T&) {}
+      };
+
+      // number of low bits of the tick consumed below this level
+      static unsigned int shift(unsigned int level)
+      {
+         return level == 0 ? 0 : RootBits + (level-1)*LevelBits;
+      }
+
+      static unsigned int levelOf(UInt32 slot)
+      {
+         if (slot < RootSize)
+         {
+            return 0;
+         }
+         if (slot == OverflowSlot)
+         {
+            return Levels;
+         }
+         if (slot == DueSlot)
+         {
+            return Levels+1;
+         }
+         return 1 + (slot - RootSize) / LevelSize;
+      }
+
+      void place(UInt32 idx)
+      {
+         Node& node = mNodes[idx];
+         UInt64 tick = node.mWhen;
+         UInt64 delta = tick - mCurrent;
+         UInt32 slot = OverflowSlot;
+         if (tick < mCurrent)
+         {
+            slot = DueSlot;
+         }
+         else if (delta < RootSize)
+         {
+            slot = (UInt32)(tick & (RootSize-1));
+         }
+         else
+         {
+            for (unsigned int level = 1; level < Levels; ++level)
+            {
+               if (delta < (UInt64(1) << shift(level+1)))
+               {
+                  slot = RootSize + (level-1)*LevelSize + 
+                     (UInt32)((tick >> shift(level)) & (LevelSize-1));
+                  break;
+               }
+            }
+         }
+
+         if (mHeads[slot] == Nil || node.mWhen < mMin[slot])
+         {
+            mMin[slot] = node.mWhen;
+         }
+         node.mSlot = slot;
+         node.mPrev = Nil;
+         node.mNext = mHeads[slot];
+         if (node.mNext != Nil)
+         {
+            mNodes[node.mNext].mPrev = idx;
+         }
+         mHeads[slot] = idx;
+         ++mCount[levelOf(slot)];
+      }
+
+      void unlink(UInt32 idx)
+      {
+         Node& node = mNodes[idx];
+         resip_assert(node.mSlot != Nil);
+         if (node.mPrev != Nil)
+         {
+            mNodes[node.mPrev].mNext = node.mNext;
+         }
+         else
+         {
+            mHeads[node.mSlot] = node.mNext;
+         }
+         if (node.mNext != Nil)
+         {
+            mNodes[node.mNext].mPrev = node.mPrev;
+         }
+         --mCount[levelOf(node.mSlot)];
+         node.mSlot = Nil;
+      }
+
+      void release(UInt32 idx)
+      {
+         Node& node = mNodes[idx];
+         ++node.mGeneration;
+         if (node.mGeneration == 0)
+         {
+            node.mGeneration = 1;
+         }
+         node.mNext = mFree;
+         mFree = idx;
+      }
+
+      void replaceSlot(UInt32 slot)
+      {
+         UInt32 idx = mHeads[slot];
+         mHeads[slot] = Nil;
+         while (idx != Nil)
+         {
+            UInt32 next = mNodes[idx].mNext;
+            --mCount[levelOf(slot)];
+            place(idx);
+            idx = next;
+         }
+      }
+
+      // called when mCurrent reaches a root wheel boundary; moves the
+      // entries of every outer slot whose span starts here one wheel down
+      void cascade()
+      {
+         for (unsigned int level = 1; level < Levels; ++level)
+         {
+            UInt32 index = (UInt32)((mCurrent >> shift(level)) & (LevelSize-1));
+            replaceSlot(RootSize + (level-1)*LevelSize + index);
+            if (index != 0)
+            {
+               return;
+            }
+         }
+         // the top wheel wrapped; anything in overflow may fit now
+         replaceSlot(OverflowSlot);
+      }
+
+      // first non-empty slot of the given outer level, in expiry order
+      UInt32 firstSlot(unsigned int level) const
+      {
+         UInt32 base = RootSize + (level-1)*LevelSize;
+         UInt32 index = (UInt32)((mCurrent >> shift(level)) & (LevelSize-1));
+         // Unless mCurrent sits on this wheel's boundary (slot about to be
+         // cascaded), the current slot only holds entries one full
+         // revolution ahead, so it is searched last.
+         if ((mCurrent & ((UInt64(1) << shift(level)) - 1)) != 0)
+         {
+            index = (index + 1) & (LevelSize-1);
+         }
+         for (unsigned int i = 0; i < LevelSize; ++i)
+         {
+            UInt32 slot = base + ((index + i) & (LevelSize-1));
+            if (mHeads[slot] != Nil)
+            {
+               return slot;
+            }
+         }
+         return Nil;
+      }
+
+      UInt32 earliestSlot() const
+      {
+         if (mHeads[DueSlot] != Nil)
+         {
+            return DueSlot;
+         }
+
+         UInt32 best = Nil;
+         UInt64 bestWhen = 0;
+         if (mCount[0])
+         {
+            UInt32 start = (UInt32)(mCurrent & (RootSize-1));
+            for (unsigned int i = 0; i < RootSize; ++i)
+            {
+               UInt32 slot = (start + i) & (RootSize-1);
+               if (mHeads[slot] != Nil)
+               {
+                  best = slot;
+                  bestWhen = mCurrent + i;
+                  break;
+               }
+            }
+         }
+         for (unsigned int level = 1; level <= Levels; ++level)
+         {
+            if (mCount[level] == 0)
+            {
+               continue;
+            }
+            UInt32 slot = level == Levels ? (UInt32)OverflowSlot : firstSlot(level);
+            if (best == Nil || mMin[slot] < bestWhen)
+            {
+               best = slot;
+               bestWhen = mMin[slot];
+            }
+         }
+         return best;
+      }
+
+      UInt64 computeNext() const
+      {
+         UInt32 slot = earliestSlot();
+         if (slot == Nil)
+         {
+            return 0;
+         }
+         if (slot < RootSize)
+         {
+            return mCurrent + ((slot - (UInt32)(mCurrent & (RootSize-1))) & (RootSize-1));
+         }
+         return mMin[slot];
+      }
+
+      // next tick to be processed by expire(); cascades for it are pending
+      // if it sits on a boundary
+      UInt64 mCurrent;
+      size_t mSize;
+      NodePool mNodes;
+      UInt32 mFree;
+      UInt32 mHeads[NumSlots];
+      // earliest mWhen added to each slot since it was last empty
+      UInt64 mMin[NumSlots];
+      // entries per level, including overflow and due
+      size_t mCount[Levels+2];
+      mutable bool mNextValid;
+      mutable UInt64 mNext;
+};
+
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
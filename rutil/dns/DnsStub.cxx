@@ -43,6 +43,8 @@ int DnsStub::mDnsTimeout = 0;
 int DnsStub::mDnsTries = 0;
 unsigned int DnsStub::mDnsFeatures = 0;
 
+static Data typeToData(int rr);
+
 void
 DnsResultSink::onLogDnsResult(const DNSResult<DnsHostRecord>& rr)
 {
@@ -115,6 +117,10 @@ DnsStub::~DnsStub()
    {
       delete *it;
    }
+   for (set<PrefetchQuery*>::iterator it = mPrefetchQueries.begin(); it != mPrefetchQueries.end(); ++it)
+   {
+      delete *it;
+   }
 
    setPollGrp(0);
    delete mDnsProvider;
@@ -143,6 +149,21 @@ DnsStub::processFifo()
       command->execute();
       delete command;
    }
+   startPrefetches();
+}
+
+void
+DnsStub::startPrefetches()
+{
+   RRCache::PrefetchList prefetches;
+   mRRCache.getPrefetches(prefetches);
+   for (RRCache::PrefetchList::const_iterator it = prefetches.begin(); it != prefetches.end(); ++it)
+   {
+      StackLog(<< "Prefetching " << it->first << " " << typeToData(it->second));
+      PrefetchQuery* query = new PrefetchQuery(*this, it->first, it->second);
+      mPrefetchQueries.insert(query);
+      lookupRecords(it->first, it->second, query);
+   }
 }
 
 void
@@ -525,12 +546,14 @@ DnsStub::Query::go()
       }
       else
       {
+         mStub.mRRCache.countLookup(false, false);
          StackLog (<< targetToQuery << " not cached. Doing external dns lookup");
          mStub.lookupRecords(targetToQuery, mRRType, this);
       }
    }
    else // is cached
    {
+      mStub.mRRCache.countLookup(true, status != 0 || records.empty());
       if (mTransform && !records.empty())
       {
          mTransform->transform(mTarget, mRRType, records);
@@ -655,6 +678,15 @@ DnsStub::Query::process(int status, const unsigned char* abuf, const int alen)
    int ancount = DNS_HEADER_ANCOUNT(abuf);
    if (ancount == 0)
    {
+      // NODATA; cached like a failure (RFC 2308 section 5)
+      try
+      {
+         mStub.cacheTTL(mTarget, mRRType, 0, abuf, alen);
+      }
+      catch (BaseException& e)
+      {
+         InfoLog(<< "Couldn't parse empty response to lookup for " << mTarget << ": " << e.getMessage());
+      }
       mResultConverter->notifyUser(mTarget, 0, mStub.errorMessage(0), Empty, mSink);
    }
    else
@@ -692,6 +724,37 @@ DnsStub::Query::onDnsRaw(int status, const unsigned char* abuf, int alen)
    process(status, abuf, alen);
 }
 
+DnsStub::PrefetchQuery::PrefetchQuery(DnsStub& stub, const Data& target, int rrType)
+   : mStub(stub),
+     mTarget(target),
+     mRRType(rrType)
+{
+}
+
+void
+DnsStub::PrefetchQuery::onDnsRaw(int status, const unsigned char* abuf, int alen)
+{
+   // A failed refresh leaves the cached set alone until it expires; the next
+   // lookup after that goes to the network as usual.
+   if (status == 0 && DNS_HEADER_ANCOUNT(abuf) > 0)
+   {
+      try
+      {
+         mStub.cache(mTarget, abuf, alen);
+      }
+      catch (BaseException& e)
+      {
+         ErrLog(<< "Couldn't parse prefetch response for " << mTarget << ": " << e.getMessage());
+      }
+   }
+   else
+   {
+      DebugLog(<< "Prefetch of " << mTarget << " " << typeToData(mRRType) << " failed: " << mStub.errorMessage(status));
+   }
+   mStub.mPrefetchQueries.erase(this);
+   delete this;
+}
+
 void
 DnsStub::Query::followCname(const unsigned char* aptr, const unsigned char*abuf, const int alen, bool& bGotAnswers, bool& bDeleteThis, Data& targetToQuery)
 {
@@ -895,6 +958,12 @@ DnsStub::setDnsCacheSize(int size)
    mRRCache.setSize(size);
 }
 
+void
+DnsStub::setDnsCachePrefetchWindow(int percent)
+{
+   mRRCache.setPrefetchWindow(percent);
+}
+
 /* ====================================================================
  * The Vovida Software License, Version 1.0 
  * 
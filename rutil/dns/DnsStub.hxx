@@ -179,6 +179,10 @@ class DnsStub : public ExternalDnsHandler
       void getDnsCacheDump(std::pair<unsigned long, unsigned long> key, GetDnsCacheDumpHandler* handler);
       void setDnsCacheTTL(int ttl);
       void setDnsCacheSize(int size);
+      void setDnsCachePrefetchWindow(int percent);
+      // Not synchronized with the thread running the stub; the counters only
+      // ever grow, so a stale read is harmless for reporting.
+      const RRCache::Stats& getDnsCacheStats() const { return mRRCache.getStats(); }
       void reloadDnsServers();
       bool checkDnsChange();
       bool supportedType(int);
@@ -213,6 +217,7 @@ class DnsStub : public ExternalDnsHandler
 
   private:
       void processFifo();
+      void startPrefetches();
 
    protected:
       void cache(const Data& key, in_addr addr);
@@ -282,6 +287,20 @@ class DnsStub : public ExternalDnsHandler
             bool mFollowCname;
       };
 
+      // Refreshes a cached record set ahead of its expiry; nobody waits for
+      // the answer, it only goes into the cache.
+      class PrefetchQuery : public DnsRawSink
+      {
+         public:
+            PrefetchQuery(DnsStub& stub, const Data& target, int rrType);
+            void onDnsRaw(int status, const unsigned char* abuf, int alen);
+
+         private:
+            DnsStub& mStub;
+            Data mTarget;
+            int mRRType;
+      };
+
    private:
       DnsStub(const DnsStub&);   // disable copy ctor.
       DnsStub& operator=(const DnsStub&);
@@ -467,6 +486,7 @@ class DnsStub : public ExternalDnsHandler
       ExternalDns* mDnsProvider;
       FdPollGrp* mPollGrp;
       std::set<Query*> mQueries;
+      std::set<PrefetchQuery*> mPrefetchQueries;
 
       std::vector<Data> mEnumSuffixes; // where to do enum lookups
       std::map<Data,Data> mEnumDomains;
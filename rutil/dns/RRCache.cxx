@@ -23,7 +23,6 @@
 #endif
 #endif
 
-#include <set>
 #include <vector>
 #include <list>
 #include <map>
@@ -49,8 +48,10 @@ using namespace std;
 RRCache::RRCache() 
    : mHead(),
      mLruHead(LruListType::makeList(&mHead)),
+     mCount(0),
      mUserDefinedTTL(DEFAULT_USER_DEFINED_TTL),
-     mSize(DEFAULT_SIZE)
+     mSize(DEFAULT_SIZE),
+     mPrefetchWindow(DEFAULT_PREFETCH_WINDOW)
 {
    mFactoryMap[T_CNAME] = &mCnameRecordFactory;
    mFactoryMap[T_NAPTR] = &mNaptrRecordFacotry;
@@ -69,23 +70,20 @@ RRCache::~RRCache()
 void 
 RRCache::updateCacheFromHostFile(const DnsHostRecord &record)
 {
-   //FactoryMap::iterator it = mFactoryMap.find(T_A);
-   RRList* key = new RRList(record, 3600);         
-   RRSet::iterator lb = mRRSet.lower_bound(key);
-   if (lb != mRRSet.end() &&
-       !(mRRSet.key_comp()(key, *lb)))
+   RRList* list = find(record.name(), T_A);
+   if (list)
    {
-      (*lb)->update(record, 3600);
-      touch(*lb);
+      unschedule(list);
+      list->update(record, 3600);
+      schedule(list, false);
+      touch(list);
    }
    else
    {
-      RRList* val = new RRList(record, 3600);
-      mRRSet.insert(val);
-      mLruHead->push_back(val);
-      purge();
+      list = new RRList(record, 3600);
+      schedule(list, false);
+      insert(list);
    }
-   delete key;
 }
 
 void 
@@ -97,22 +95,27 @@ RRCache::updateCache(const Data& target,
    Data domain = (*begin).domain();
    FactoryMap::iterator it = mFactoryMap.find(rrType);
    resip_assert(it != mFactoryMap.end());
-   RRList* key = new RRList(domain, rrType);         
-   RRSet::iterator lb = mRRSet.lower_bound(key);
-   if (lb != mRRSet.end() &&
-       !(mRRSet.key_comp()(key, *lb)))
+   bool prefetch = (rrType == T_NAPTR || rrType == T_SRV || rrType == T_A || rrType == T_AAAA);
+   RRList* list = find(domain, rrType);
+   if (list && list->status() != 0)
    {
-      (*lb)->update(it->second, begin, end, mUserDefinedTTL);
-      touch(*lb);
+      // replaces a cached failure
+      remove(list);
+      list = 0;
+   }
+   if (list)
+   {
+      unschedule(list);
+      list->update(it->second, begin, end, mUserDefinedTTL);
+      schedule(list, prefetch);
+      touch(list);
    }
    else
    {
-      RRList* val = new RRList(it->second, domain, rrType, begin, end, mUserDefinedTTL);
-      mRRSet.insert(val);
-      mLruHead->push_back(val);
-      purge();
+      list = new RRList(it->second, domain, rrType, begin, end, mUserDefinedTTL);
+      schedule(list, prefetch);
+      insert(list);
    }
-   delete key;
 }
 
 void 
@@ -133,17 +136,14 @@ RRCache::cacheTTL(const Data& target,
       ttl = mUserDefinedTTL;
    }
 
-   RRList* val = new RRList(target, rrType, ttl, status);
-   RRSet::iterator it = mRRSet.find(val);
-   if (it != mRRSet.end())
+   RRList* old = find(target, rrType);
+   if (old)
    {
-      (*it)->remove();
-      delete *it;
-      mRRSet.erase(it);
+      remove(old);
    }
-   mRRSet.insert(val);
-   mLruHead->push_back(val);
-   purge();
+   RRList* list = new RRList(target, rrType, ttl, status);
+   schedule(list, false);
+   insert(list);
 }
 
 bool 
@@ -155,29 +155,54 @@ RRCache::lookup(const Data& target,
 {
    records.clear();
    status = 0;
-   RRList* key = new RRList(target, type);
-   RRSet::iterator it = mRRSet.find(key);
-   delete key;
-   if (it == mRRSet.end())
+   RRList* list = find(target, type);
+   if (!list)
    {
       return false;
    }
-   else
+
+   UInt64 now = Timer::getTimeSecs();
+   if (now >= list->absoluteExpiry())
    {
-      if (Timer::getTimeSecs() >= (*it)->absoluteExpiry())
-      {
-         delete *it;
-         mRRSet.erase(it);
-         return false;
-      }
-      else
+      ++mStats.expired;
+      remove(list);
+      return false;
+   }
+
+   records = list->records(protocol);
+   status = list->status();
+   touch(list);
+   if (list->refreshAfter() && now >= list->refreshAfter() && !list->refreshPending())
+   {
+      list->refreshPending() = true;
+      mPrefetches.push_back(std::make_pair(list->key(), type));
+      ++mStats.prefetches;
+   }
+   return true;
+}
+
+void
+RRCache::countLookup(bool hit, bool negative)
+{
+   if (hit)
+   {
+      ++mStats.hits;
+      if (negative)
       {
-         records = (*it)->records(protocol);
-         status = (*it)->status();
-         touch(*it);
-         return true;
+         ++mStats.negativeHits;
       }
    }
+   else
+   {
+      ++mStats.misses;
+   }
+}
+
+void
+RRCache::getPrefetches(PrefetchList& prefetches)
+{
+   prefetches.clear();
+   prefetches.swap(mPrefetches);
 }
 
 void 
@@ -186,6 +211,68 @@ RRCache::clearCache()
     cleanup();
 }
 
+RRList*
+RRCache::find(const Data& key, int rrType) const
+{
+   TypeMap::const_iterator t = mRRSet.find(rrType);
+   if (t == mRRSet.end())
+   {
+      return 0;
+   }
+   NameMap::const_iterator it = t->second.find(Data(key).lowercase());
+   return it == t->second.end() ? 0 : it->second;
+}
+
+// list must have been scheduled already
+void
+RRCache::insert(RRList* list)
+{
+   NameMap& names = mRRSet[list->rrType()];
+   resip_assert(names.find(Data(list->key()).lowercase()) == names.end());
+   names[Data(list->key()).lowercase()] = list;
+   ++mCount;
+   mLruHead->push_back(list);
+   purge();
+}
+
+void
+RRCache::remove(RRList* list)
+{
+   mRRSet[list->rrType()].erase(Data(list->key()).lowercase());
+   --mCount;
+   unschedule(list);
+   list->remove();
+   delete list;
+}
+
+void
+RRCache::schedule(RRList* list, bool prefetch)
+{
+   UInt64 now = Timer::getTimeSecs();
+   list->refreshPending() = false;
+   list->refreshAfter() = 0;
+   if (prefetch && mPrefetchWindow > 0 && list->absoluteExpiry() > now)
+   {
+      UInt64 window = (list->absoluteExpiry() - now) * mPrefetchWindow / 100;
+      list->refreshAfter() = list->absoluteExpiry() - window;
+   }
+   mExpiry.insert(ExpiryMap::value_type(list->absoluteExpiry(), list));
+}
+
+void
+RRCache::unschedule(RRList* list)
+{
+   std::pair<ExpiryMap::iterator, ExpiryMap::iterator> bucket = mExpiry.equal_range(list->absoluteExpiry());
+   for (ExpiryMap::iterator it = bucket.first; it != bucket.second; ++it)
+   {
+      if (it->second == list)
+      {
+         mExpiry.erase(it);
+         return;
+      }
+   }
+}
+
 void 
 RRCache::touch(RRList* node)
 {
@@ -196,12 +283,18 @@ RRCache::touch(RRList* node)
 void 
 RRCache::cleanup()
 {
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); it++)
+   for (TypeMap::iterator t = mRRSet.begin(); t != mRRSet.end(); ++t)
    {
-      (*it)->remove();
-      delete *it;
+      for (NameMap::iterator it = t->second.begin(); it != t->second.end(); ++it)
+      {
+         it->second->remove();
+         delete it->second;
+      }
    }
    mRRSet.clear();
+   mExpiry.clear();
+   mPrefetches.clear();
+   mCount = 0;
 }
 
 int 
@@ -220,36 +313,43 @@ RRCache::getTTL(const RROverlay& overlay)
    free(name);
    pPos += len;
    pPos += 16; // skip four 32 bit entities.
-   return DNS__32BIT(pPos);         
+   int minimum = DNS__32BIT(pPos);
+   // RFC 2308 section 5: the negative TTL is the lesser of the SOA MINIMUM
+   // field and the TTL of the SOA record itself.
+   return overlay.ttl() < minimum ? overlay.ttl() : minimum;
+}
+
+void
+RRCache::purgeExpired(UInt64 now)
+{
+   while (!mExpiry.empty() && mExpiry.begin()->first <= now)
+   {
+      ++mStats.expired;
+      remove(mExpiry.begin()->second);
+   }
 }
 
 void 
 RRCache::purge()
 {
-   if (mRRSet.size() < mSize) return;
-   RRList* lst = *(mLruHead->begin());
-   RRSet::iterator it = mRRSet.find(lst);
-   resip_assert(it != mRRSet.end());
-   lst->remove();
-   delete *it;
-   mRRSet.erase(it);
+   if (mCount < mSize) return;
+   purgeExpired(Timer::getTimeSecs());
+   while (mCount >= mSize && mCount > 1)
+   {
+      ++mStats.evicted;
+      remove(*(mLruHead->begin()));
+   }
 }
 
 void 
 RRCache::logCache()
 {
-   UInt64 now = Timer::getTimeSecs();
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
+   purgeExpired(Timer::getTimeSecs());
+   for (TypeMap::iterator t = mRRSet.begin(); t != mRRSet.end(); ++t)
    {
-      if (now >= (*it)->absoluteExpiry())
-      {
-         delete *it;
-         mRRSet.erase(it++);
-      }
-      else
+      for (NameMap::iterator it = t->second.begin(); it != t->second.end(); ++it)
       {
-         (*it)->log();
-         ++it;
+         it->second->log();
       }
    }
 }
@@ -257,19 +357,13 @@ RRCache::logCache()
 void 
 RRCache::getCacheDump(Data& dnsCacheDump)
 {
-   UInt64 now = Timer::getTimeSecs();
+   purgeExpired(Timer::getTimeSecs());
    DataStream strm(dnsCacheDump);
-   for (std::set<RRList*, CompareT>::iterator it = mRRSet.begin(); it != mRRSet.end(); )
+   for (TypeMap::iterator t = mRRSet.begin(); t != mRRSet.end(); ++t)
    {
-      if (now >= (*it)->absoluteExpiry())
-      {
-         delete *it;
-         mRRSet.erase(it++);
-      }
-      else
+      for (NameMap::iterator it = t->second.begin(); it != t->second.end(); ++it)
       {
-         (*it)->encodeRRList(strm);
-         ++it;
+         it->second->encodeRRList(strm);
       }
    }
    strm.flush();
@@ -2,9 +2,11 @@
 #define RESIP_RRCACHE_HXX
 
 #include <map>
-#include <set>
 #include <memory>
+#include <utility>
+#include <vector>
 
+#include "rutil/HashMap.hxx"
 #include "rutil/dns/RRFactory.hxx"
 #include "rutil/dns/DnsResourceRecord.hxx"
 #include "rutil/dns/DnsAAAARecord.hxx"
@@ -18,6 +20,17 @@ namespace resip
 {
 class RROverlay;
 
+/**
+   Cache of resource record sets, keyed by record type and (case-insensitive)
+   owner name. Entries leave the cache when they expire, or least recently
+   used first when the cache is full. Failed lookups are cached as per
+   RFC 2308, using the SOA from the authority section of the response.
+
+   A hit on a NAPTR, SRV, A or AAAA set in the last part of its lifetime (see
+   setPrefetchWindow()) queues that set to be fetched again; the owner picks
+   these up with getPrefetches() and feeds the answers back through
+   updateCache(), so that a name in steady use does not expire between hits.
+*/
 class RRCache
 {
    public:
@@ -26,11 +39,27 @@ class RRCache
       typedef RRList::Records Result;
       typedef std::vector<RROverlay>::const_iterator Itr;
       typedef std::vector<Data> DataArr;
+      typedef std::vector<std::pair<Data, int> > PrefetchList; // target, rrType
+
+      class Stats
+      {
+         public:
+            Stats() : hits(0), negativeHits(0), misses(0), prefetches(0), expired(0), evicted(0) {}
+            unsigned int hits; // includes negativeHits
+            unsigned int negativeHits;
+            unsigned int misses;
+            unsigned int prefetches;
+            unsigned int expired;
+            unsigned int evicted;
+      };
 
       RRCache();
       ~RRCache();
       void setTTL(int ttl) { if (ttl > 0) mUserDefinedTTL = ttl * MIN_TO_SEC; }
       void setSize(int size) { mSize = size; }
+      // percentage of a record set's TTL, counted back from its expiry, in
+      // which a hit triggers a prefetch; 0 disables prefetching
+      void setPrefetchWindow(int percent) { if (percent >= 0 && percent <= 100) mPrefetchWindow = percent; }
       // Update existing cache record, or add a new one
       void updateCache(const Data& target,
                        const int rrType,
@@ -43,6 +72,14 @@ class RRCache
                     const int status,
                     RROverlay overlay);
       bool lookup(const Data& target, const int type, const int proto, Result& records, int& status);
+      // Counts the outcome of a lookup on behalf of a client, as opposed to
+      // the lookups made while following CNAMEs or collecting answers.
+      void countLookup(bool hit, bool negative);
+      // Moves the record sets queued for prefetch since the last call into
+      // prefetches.
+      void getPrefetches(PrefetchList& prefetches);
+      const Stats& getStats() const { return mStats; }
+      unsigned int size() const { return mCount; }
       void clearCache();
       void logCache();
       void getCacheDump(Data& dnsCacheDump);
@@ -52,37 +89,36 @@ class RRCache
       static const int DEFAULT_USER_DEFINED_TTL = 10; // in seconds.
 
       static const int DEFAULT_SIZE = 512;
-      class CompareT  : public std::binary_function<const RRList*, const RRList*, bool>
-      {
-         public:
-            bool operator()(RRList* lhs, RRList* rhs) const
-            {
-               if (lhs->rrType() < rhs->rrType())
-               {
-                  return true;
-               }
-               else if (lhs->rrType() > rhs->rrType())
-               {
-                  return false;
-               }
-               else
-               {
-                  return (Data(lhs->key())).lowercase() < (Data(rhs->key())).lowercase();
-               }
-            }
-      };
+      static const int DEFAULT_PREFETCH_WINDOW = 10; // percent of TTL
 
+      RRList* find(const Data& key, int rrType) const;
+      void insert(RRList* list);
+      void remove(RRList* list);
+      void schedule(RRList* list, bool prefetch);
+      void unschedule(RRList* list);
       void touch(RRList* node);
       void cleanup();
       int getTTL(const RROverlay& overlay);
+      void purgeExpired(UInt64 now);
       void purge();
 
       RRList mHead;
       LruListType* mLruHead;                     
       Result Empty;
 
-      typedef std::set<RRList*, CompareT> RRSet;
-      RRSet mRRSet;
+      // lowercased owner name -> record set, one map per record type
+      typedef HashMap<Data, RRList*> NameMap;
+      typedef std::map<int, NameMap> TypeMap;
+      TypeMap mRRSet;
+      unsigned int mCount;
+
+      // absolute expiry (secs) -> record set; entries expiring in the same
+      // second share a bucket
+      typedef std::multimap<UInt64, RRList*> ExpiryMap;
+      ExpiryMap mExpiry;
+
+      PrefetchList mPrefetches;
+      Stats mStats;
 
       RRFactory<DnsHostRecord> mHostRecordFactory;
       RRFactory<DnsSrvRecord> mSrvRecordFactory;
@@ -95,6 +131,7 @@ class RRCache
       
       int mUserDefinedTTL; // used when the ttl in RR is 0 or less than default(60). in seconds.
       unsigned int mSize;
+      int mPrefetchWindow;
 };
 
 }
@@ -52,6 +52,12 @@ class RRList : public IntrusiveListElement<RRList*>
       int rrType() const { return mRRType; }
       UInt64 absoluteExpiry() const { return mAbsoluteExpiry; }
       UInt64& absoluteExpiry() { return mAbsoluteExpiry; }
+      // Maintained by RRCache: a hit at or after refreshAfter() asks for the
+      // list to be fetched again before it expires; 0 means never.
+      UInt64 refreshAfter() const { return mRefreshAfter; }
+      UInt64& refreshAfter() { return mRefreshAfter; }
+      bool refreshPending() const { return mRefreshPending; }
+      bool& refreshPending() { return mRefreshPending; }
       void log();
       EncodeStream& encodeRRList(EncodeStream& strm);
 
@@ -73,6 +79,8 @@ class RRList : public IntrusiveListElement<RRList*>
 
       int mStatus; // dns query status.
       UInt64 mAbsoluteExpiry;
+      UInt64 mRefreshAfter;
+      bool mRefreshPending;
 
       RecordItr find(const Data&);
       void clear();
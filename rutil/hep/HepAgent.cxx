@@ -3,19 +3,242 @@
 #endif
 
 #include <stdexcept>
+#include <vector>
 
 #include "rutil/hep/ResipHep.hxx"
 #include "rutil/hep/HepAgent.hxx"
+#include "rutil/Condition.hxx"
 #include "rutil/DataStream.hxx"
+#include "rutil/Lock.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Timer.hxx"
+
+#if defined(HAVE_SENDMMSG)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
 
 using namespace resip;
 using namespace std;
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
+const char HepAgent::zeroes[sizeof(struct hep_generic)] = {0};
+
+// max packets encoded and handed to the kernel at once by the capture thread
+static const unsigned int CaptureBatchSize = 64;
+
+/// A payload waiting for the capture thread
+class HepAgent::Capture
+{
+   public:
+      TransportType mType;
+      GenericIPAddress mSource;
+      GenericIPAddress mDestination;
+      HEPEventType mEventType;
+      Data mPayload;
+      Data mCorrelationId;
+      UInt64 mTimestamp;
+};
+
+class HepAgent::CaptureThread : public ThreadIf
+{
+   public:
+      CaptureThread(HepAgent& agent, unsigned int queueSize)
+         : mAgent(agent),
+#ifdef RESIP_HAS_STD_ATOMIC
+           mRing(queueSize),
+#endif
+           mBuffers(CaptureBatchSize),
+           mDropsReported(0),
+           mLastReport(0)
+      {
+#if defined(HAVE_SENDMMSG)
+         mHdrs.resize(CaptureBatchSize);
+         mIov.resize(CaptureBatchSize);
+#endif
+      }
+
+      virtual ~CaptureThread()
+      {
+#ifdef RESIP_HAS_STD_ATOMIC
+         // anything added after the thread stopped
+         std::vector<Capture*> leftover;
+         mRing.popAll(leftover);
+         for(size_t i = 0; i < leftover.size(); ++i)
+         {
+            delete leftover[i];
+         }
+#endif
+      }
+
+#ifdef RESIP_HAS_STD_ATOMIC
+      /// @retval false if the queue is full
+      bool add(Capture* capture)
+      {
+         size_t previous;
+         if(!mRing.push(capture, previous))
+         {
+            return false;
+         }
+         if(mRing.consumerWaiting())
+         {
+            Lock lock(mMutex);
+            mCondition.signal();
+         }
+         return true;
+      }
+#endif
+
+      virtual void thread()
+      {
+#ifdef RESIP_HAS_STD_ATOMIC
+         std::vector<Capture*> batch;
+         std::vector<Capture*> pending;
+         for(;;)
+         {
+            if(mRing.popAll(pending) == 0)
+            {
+               if(isShutdown())
+               {
+                  break;
+               }
+               Lock lock(mMutex);
+               mRing.setConsumerWaiting(true);
+               if(mRing.size() == 0)
+               {
+                  mCondition.wait(mMutex, 100);
+               }
+               mRing.setConsumerWaiting(false);
+               continue;
+            }
+            for(size_t i = 0; i < pending.size(); i += CaptureBatchSize)
+            {
+               size_t end = i + CaptureBatchSize < pending.size() ? i + CaptureBatchSize : pending.size();
+               batch.assign(pending.begin() + i, pending.begin() + end);
+               sendBatch(batch);
+            }
+            pending.clear();
+            reportDrops();
+         }
+#endif
+      }
+
+      virtual void shutdown()
+      {
+         ThreadIf::shutdown();
+         Lock lock(mMutex);
+         mCondition.signal();
+      }
+
+   private:
+      /// Logs, at most once a second, how much capture() has dropped.
+      void reportDrops()
+      {
+         UInt64 dropped = mAgent.mDropped;
+         UInt64 now = Timer::getTimeMs();
+         if(dropped != mDropsReported && now >= mLastReport + 1000)
+         {
+            WarningLog(<< "HEP capture queue full, dropped " << (dropped - mDropsReported) << " packets");
+            mDropsReported = dropped;
+            mLastReport = now;
+         }
+      }
+
+      /// Encodes batch (and deletes it) and sends it, with one sendmmsg()
+      /// where available.
+      void sendBatch(std::vector<Capture*>& batch)
+      {
+         size_t num = 0;
+         for(size_t i = 0; i < batch.size(); ++i)
+         {
+            Capture* c = batch[i];
+            if(mAgent.encode<Data>(mBuffers[num], c->mType, c->mSource, c->mDestination,
+                                   c->mEventType, c->mPayload, c->mCorrelationId, c->mTimestamp))
+            {
+               ++num;
+            }
+            else
+            {
+               ++mAgent.mSendErrors;
+            }
+            delete c;
+         }
+         batch.clear();
+
+#if defined(HAVE_SENDMMSG)
+         for(size_t i = 0; i < num; ++i)
+         {
+            mIov[i].iov_base = const_cast<char*>(mBuffers[i].data());
+            mIov[i].iov_len = mBuffers[i].size();
+            memset(&mHdrs[i], 0, sizeof(mHdrs[i]));
+            mHdrs[i].msg_hdr.msg_name = &mAgent.mDestination.address;
+            mHdrs[i].msg_hdr.msg_namelen = mAgent.mDestination.length();
+            mHdrs[i].msg_hdr.msg_iov = &mIov[i];
+            mHdrs[i].msg_hdr.msg_iovlen = 1;
+         }
+         size_t done = 0;
+         bool waited = false;
+         while(done < num)
+         {
+            int count = sendmmsg(mAgent.mSocket, &mHdrs[done], (unsigned int)(num - done), 0);
+            if(count < 0)
+            {
+               int e = getErrno();
+               if((e == EAGAIN || e == EWOULDBLOCK) && !waited)
+               {
+                  // the socket is non-blocking for the synchronous senders;
+                  // this thread can afford to wait a little for the kernel
+                  FdSet fdset;
+                  fdset.setWrite(mAgent.mSocket);
+                  fdset.selectMilliSeconds(100);
+                  waited = true;
+                  continue;
+               }
+               // only the first datagram of the remainder failed
+               ErrLog(<< "sending to HOMER " << mAgent.mDestination << " failed (" << e << "): " << strerror(e));
+               ++mAgent.mSendErrors;
+               ++done;
+               continue;
+            }
+            mAgent.mSent += count;
+            done += count;
+         }
+#else
+         for(size_t i = 0; i < num; ++i)
+         {
+            mAgent.send(mBuffers[i]);
+         }
+#endif
+      }
+
+      HepAgent& mAgent;
+#ifdef RESIP_HAS_STD_ATOMIC
+      MpscRing<Capture*> mRing;
+#endif
+      Mutex mMutex;
+      Condition mCondition;
+      std::vector<Data> mBuffers;
+      UInt64 mDropsReported;
+      UInt64 mLastReport;
+#if defined(HAVE_SENDMMSG)
+      std::vector<struct mmsghdr> mHdrs;
+      std::vector<struct iovec> mIov;
+#endif
+};
+
 HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID)
-   : mCaptureHost(captureHost), mCapturePort(capturePort), mCaptureAgentID(captureAgentID)
+   : mCaptureHost(captureHost), mCapturePort(capturePort), mCaptureAgentID(captureAgentID),
+     mSamplePercent(100),
+     mSampleCounter(0),
+     mCaptureThread(0),
+     mQueued(0),
+     mSampledOut(0),
+     mDropped(0),
+     mSent(0),
+     mSendErrors(0)
 {
 #ifdef USE_IPV6
    struct sockaddr_in6 myaddr;
@@ -98,8 +321,109 @@ HepAgent::HepAgent(const Data &captureHost, int capturePort, int captureAgentID)
 
 HepAgent::~HepAgent()
 {
+   stopCaptureThread();
+}
+
+void
+HepAgent::startCaptureThread(unsigned int queueSize)
+{
+#ifdef RESIP_HAS_STD_ATOMIC
+   if(!mCaptureThread)
+   {
+      mCaptureThread = new CaptureThread(*this, queueSize);
+      mCaptureThread->run();
+      InfoLog(<<"HEP capture thread started, queue size " << queueSize);
+   }
+#else
+   WarningLog(<<"no C++11 atomics, HEP capture stays synchronous");
+#endif
+}
+
+void
+HepAgent::stopCaptureThread()
+{
+   if(mCaptureThread)
+   {
+      mCaptureThread->shutdown();
+      mCaptureThread->join();
+      delete mCaptureThread;
+      mCaptureThread = 0;
+   }
+}
+
+bool
+HepAgent::capture(const TransportType type, const GenericIPAddress& source, const GenericIPAddress& destination, const HEPEventType eventType, const Data& payload, const Data& correlationId)
+{
+   if(mSamplePercent < 100)
+   {
+      UInt64 n = correlationId.empty() ? mSampleCounter++ : correlationId.hash();
+      if(n % 100 >= mSamplePercent)
+      {
+         ++mSampledOut;
+         return false;
+      }
+   }
+
+#ifdef RESIP_HAS_STD_ATOMIC
+   if(mCaptureThread)
+   {
+      Capture* c = new Capture;
+      c->mType = type;
+      c->mSource = source;
+      c->mDestination = destination;
+      c->mEventType = eventType;
+      c->mPayload = payload;
+      c->mCorrelationId = correlationId;
+      c->mTimestamp = hepUnixTimestamp();
+      if(!mCaptureThread->add(c))
+      {
+         delete c;
+         ++mDropped;
+         return false;
+      }
+      ++mQueued;
+      return true;
+   }
+#endif
+
+   ++mQueued;
+   sendToHOMER<Data>(type, source, destination, eventType, payload, correlationId);
+   return true;
+}
+
+HepAgent::CaptureStats
+HepAgent::getCaptureStats() const
+{
+   CaptureStats stats;
+   stats.mQueued = mQueued;
+   stats.mSampledOut = mSampledOut;
+   stats.mDropped = mDropped;
+   stats.mSent = mSent;
+   stats.mSendErrors = mSendErrors;
+   return stats;
 }
 
+void
+HepAgent::send(const Data& buf)
+{
+   if(sendto(mSocket, buf.data(), buf.size(), 0, &mDestination.address, mDestination.length()) < 0)
+   {
+      int e = getErrno();
+      ++mSendErrors;
+#if defined(WIN32)
+      ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << ")");
+#else
+      ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << "): " << strerror(e));
+#endif
+   }
+   else
+   {
+      ++mSent;
+      DebugLog(<< "packet sent to HOMER " << mDestination);
+   }
+}
+
+
 /* ====================================================================
  *
  * Copyright 2016 Daniel Pocock http://danielpocock.com  All rights reserved.
@@ -8,6 +8,7 @@
 #include "rutil/hep/ResipHep.hxx"
 #include "rutil/DataStream.hxx"
 #include "rutil/Logger.hxx"
+#include "rutil/MpscRing.hxx"
 
 #define RESIPROCATE_SUBSYSTEM Subsystem::TRANSPORT
 
@@ -23,10 +24,63 @@ class HepAgent
          RTCP_JSON = 5
       } HEPEventType;
 
+      /// Counters of the capture thread, see startCaptureThread().
+      class CaptureStats
+      {
+         public:
+            CaptureStats() : mQueued(0), mSampledOut(0), mDropped(0), mSent(0), mSendErrors(0) {}
+            UInt64 mQueued;      ///< taken by capture()
+            UInt64 mSampledOut;  ///< left out by setSamplePercent()
+            UInt64 mDropped;     ///< lost because the queue was full
+            UInt64 mSent;
+            UInt64 mSendErrors;
+      };
+
       HepAgent(const Data &captureHost, int capturePort, int captureAgentID);
       virtual ~HepAgent();
+
       template <class T>
       void sendToHOMER(const TransportType type, const GenericIPAddress& source, const GenericIPAddress& destination, const HEPEventType eventType, const T& msg, const Data& correlationId)
+      {
+         Data buf;
+         if(encode(buf, type, source, destination, eventType, msg, correlationId, hepUnixTimestamp()))
+         {
+            send(buf);
+         }
+      }
+
+      /**
+         Starts a thread that does the HEP encapsulation and sending of what
+         is passed to capture(), many packets per sendmmsg() where available.
+         capture() then only copies the payload into a queue of queueSize
+         entries; when the queue is full the packet is dropped and counted,
+         the caller never waits. Without C++11 atomics there is no thread
+         and capture() sends synchronously.
+      */
+      void startCaptureThread(unsigned int queueSize = 4096);
+      /// Sends what is still queued and stops the capture thread.
+      void stopCaptureThread();
+
+      /// Only capture percent (0-100) of the calls. The choice is made on the
+      /// correlation ID, so a call is either captured whole or not at all.
+      void setSamplePercent(unsigned int percent) { mSamplePercent = percent > 100 ? 100 : percent; }
+
+      /// Queues payload for the capture thread, or sends it if there is none.
+      /// @return false if the payload was sampled out or dropped
+      bool capture(const TransportType type, const GenericIPAddress& source, const GenericIPAddress& destination, const HEPEventType eventType, const Data& payload, const Data& correlationId);
+
+      CaptureStats getCaptureStats() const;
+
+   private:
+      class Capture;
+      class CaptureThread;
+      friend class CaptureThread;
+
+      void send(const Data& buf);
+
+      /// Builds the HEP packet for msg, captured at timestamp, into buf.
+      template <class T>
+      bool encode(Data& buf, const TransportType type, const GenericIPAddress& source, const GenericIPAddress& destination, const HEPEventType eventType, const T& msg, const Data& correlationId, UInt64 timestamp)
       {
          struct hep_generic *hg;
          hep_chunk_ip4_t src_ip4, dst_ip4;
@@ -36,8 +90,8 @@ class HepAgent
          hep_chunk_ip6_t src_ip6, dst_ip6;
 #endif
 
-         char *data = new char[sizeof(struct hep_generic)];
-         Data buf(Data::Take, data, sizeof(struct hep_generic));
+         buf.clear();
+         buf.append(zeroes, sizeof(struct hep_generic));
          hg = (struct hep_generic *)buf.data();
          DebugLog(<< "buf.size() == " << buf.size());
          DataStream stream(buf);
@@ -107,7 +161,7 @@ class HepAgent
             {
             default:
                ErrLog(<<"unhandled address family");
-               return;
+               return false;
             }
          }
          stream.flush();
@@ -137,7 +191,7 @@ class HepAgent
                break;
             default:
                ErrLog(<<"unhandled TransportType");
-               return;
+               return false;
          }
          /* Proto ID */
          hg->ip_proto.chunk.vendor_id = htons(0x0000);
@@ -156,7 +210,7 @@ class HepAgent
          hg->dst_port.data = htons(destinationPort);
          hg->dst_port.chunk.length = htons(sizeof(hg->dst_port));
 
-         UInt64 now = hepUnixTimestamp();
+         UInt64 now = timestamp;
 
          /* TIMESTAMP SEC */
          hg->time_sec.chunk.vendor_id = htons(0x0000);
@@ -215,27 +269,30 @@ class HepAgent
          hg = (struct hep_generic *)buf.data();
          hg->header.length = htons(afterPayload);
 
-         if(sendto(mSocket, buf.data(), buf.size(), 0, &mDestination.address, mDestination.length()) < 0)
-         {
-            int e = getErrno();
-#if defined(WIN32)
-            ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << ")");
-#else
-            ErrLog(<< "sending to HOMER " << mDestination << " failed (" << e << "): " << strerror(e));
-#endif
-         }
-         else
-         {
-            DebugLog(<< "packet sent to HOMER " << mDestination);
-         }
+         return true;
       }
 
-   private:
+      static const char zeroes[sizeof(struct hep_generic)];
+
       Data mCaptureHost;
       int mCapturePort;
       int mCaptureAgentID;
       GenericIPAddress mDestination;
       Socket mSocket;
+
+#ifdef RESIP_HAS_STD_ATOMIC
+      typedef std::atomic<UInt64> Counter;
+#else
+      typedef UInt64 Counter; // approximate if capture() is called by several threads
+#endif
+      volatile unsigned int mSamplePercent;
+      Counter mSampleCounter;
+      CaptureThread* mCaptureThread;
+      Counter mQueued;
+      Counter mSampledOut;
+      Counter mDropped;
+      Counter mSent;
+      Counter mSendErrors;
 };
 
 
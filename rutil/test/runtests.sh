@@ -26,6 +26,7 @@ for i in \
 	testSHA1Stream \
 	testParseBuffer \
 	testThreadIf \
+	testTimerWheel \
 	testXMLCursor;
 do
     if test ! -x $i; then
@@ -0,0 +1,265 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "assert.h"
+
+#include "rutil/AsyncLogWriter.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/ThreadIf.hxx"
+#include "rutil/Time.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+#ifdef RESIP_ASYNC_LOG
+
+static const int Threads = 4;
+static const int LinesPerThread = 20000;
+
+class LogThread : public ThreadIf
+{
+   public:
+      LogThread(int id) : mId(id) {}
+
+      void thread()
+      {
+         for (int i = 0; i < LinesPerThread; ++i)
+         {
+            InfoLog(<< "async thread=" << mId << " line=" << i << " .");
+         }
+      }
+
+   private:
+      int mId;
+};
+
+static void
+readLines(const char* fileName, vector<Data>& lines)
+{
+   lines.clear();
+   ifstream in(fileName);
+   string line;
+   while (getline(in, line))
+   {
+      lines.push_back(Data(line));
+   }
+}
+
+// every line arrives, whole, and each thread's lines stay in order
+static void
+testAllWritten()
+{
+   const char* fileName = "testAsyncLogger.txt";
+   remove(fileName);
+   Log::initialize(Log::File, Log::Info, "testAsyncLogger", fileName);
+   Log::enableAsync();
+   assert(Log::isAsync());
+
+   vector<LogThread*> threads;
+   for (int t = 0; t < Threads; ++t)
+   {
+      threads.push_back(new LogThread(t));
+      threads.back()->run();
+   }
+   for (int t = 0; t < Threads; ++t)
+   {
+      threads[t]->join();
+      delete threads[t];
+   }
+   Log::disableAsync();
+   assert(!Log::isAsync());
+
+   vector<Data> lines;
+   readLines(fileName, lines);
+
+   vector<int> next(Threads, 0);
+   int written = 0;
+   for (vector<Data>::const_iterator i = lines.begin(); i != lines.end(); ++i)
+   {
+      const char* found = strstr(i->c_str(), "async thread=");
+      if (!found)
+      {
+         continue;
+      }
+      int id = -1;
+      int line = -1;
+      char end = 0;
+      assert(sscanf(found, "async thread=%d line=%d %c", &id, &line, &end) == 3);
+      assert(end == '.');
+      assert(id >= 0 && id < Threads);
+      if (Log::asyncDropCount() == 0)
+      {
+         assert(line == next[id]);
+      }
+      else
+      {
+         assert(line >= next[id]);
+      }
+      next[id] = line + 1;
+      ++written;
+   }
+   cerr << "wrote " << written << " lines, dropped " << Log::asyncDropCount() << endl;
+   assert(written + Log::asyncDropCount() == (UInt64)(Threads * LinesPerThread));
+   remove(fileName);
+}
+
+// a ring too small to keep up drops lines, and counts them, instead of blocking
+static void
+testDropped()
+{
+   const char* fileName = "testAsyncLoggerDropped.txt";
+   remove(fileName);
+   Log::initialize(Log::File, Log::Info, "testAsyncLogger", fileName);
+   const UInt64 droppedBefore = Log::asyncDropCount();
+   Log::enableAsync(4096);
+
+   const int total = 100000;
+   for (int i = 0; i < total; ++i)
+   {
+      InfoLog(<< "dropped line=" << i);
+   }
+   Log::disableAsync();
+
+   vector<Data> lines;
+   readLines(fileName, lines);
+   int written = 0;
+   int notices = 0;
+   for (vector<Data>::const_iterator i = lines.begin(); i != lines.end(); ++i)
+   {
+      if (i->find("dropped line=") != Data::npos)
+      {
+         ++written;
+      }
+      else if (i->find("log ring full") != Data::npos)
+      {
+         ++notices;
+      }
+   }
+   const UInt64 dropped = Log::asyncDropCount() - droppedBefore;
+   cerr << "wrote " << written << " lines, dropped " << dropped << endl;
+   assert(dropped > 0);
+   assert(notices > 0);
+   assert(written + dropped == (UInt64)total);
+   remove(fileName);
+}
+
+// lines logged while the mode is being switched are written, either by
+// the writer or synchronously, and none are left behind in a ring
+static void
+testSwitching()
+{
+   const char* fileName = "testAsyncLoggerSwitching.txt";
+   remove(fileName);
+   Log::initialize(Log::File, Log::Info, "testAsyncLogger", fileName);
+   const UInt64 droppedBefore = Log::asyncDropCount();
+
+   vector<LogThread*> threads;
+   for (int t = 0; t < Threads; ++t)
+   {
+      threads.push_back(new LogThread(t));
+      threads.back()->run();
+   }
+   for (int n = 0; n < 50; ++n)
+   {
+      Log::enableAsync();
+      sleepMs(1);
+      Log::disableAsync();
+      sleepMs(1);
+   }
+   for (int t = 0; t < Threads; ++t)
+   {
+      threads[t]->join();
+      delete threads[t];
+   }
+
+   vector<Data> lines;
+   readLines(fileName, lines);
+   int written = 0;
+   for (vector<Data>::const_iterator i = lines.begin(); i != lines.end(); ++i)
+   {
+      if (i->find("async thread=") != Data::npos)
+      {
+         ++written;
+      }
+   }
+   const UInt64 dropped = Log::asyncDropCount() - droppedBefore;
+   cerr << "wrote " << written << " lines, dropped " << dropped << endl;
+   assert(written + dropped == (UInt64)(Threads * LinesPerThread));
+   remove(fileName);
+}
+
+int
+main(int argc, char* argv[])
+{
+   testAllWritten();
+   testDropped();
+   testSwitching();
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+#else
+
+int
+main(int argc, char* argv[])
+{
+   cerr << "Asynchronous logging is not available in this build" << endl;
+   return 0;
+}
+
+#endif
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -4,8 +4,14 @@
 #include "rutil/FiniteFifo.hxx"
 #include "rutil/TimeLimitFifo.hxx"
 #include "rutil/Data.hxx"
+#include "rutil/ParseBuffer.hxx"
 #include "rutil/ThreadIf.hxx"
 #include "rutil/Timer.hxx"
+#include "rutil/MpscRing.hxx"
+#include <vector>
+#ifdef RESIP_HAS_STD_ATOMIC
+#include <thread>
+#endif
 #ifndef WIN32
 #include <unistd.h>
 #endif
@@ -146,6 +152,67 @@ void Producer::thread()
    }
 }
 
+class RingProducer: public ThreadIf
+{
+  public:
+      RingProducer(Fifo<Foo>& f, int id, int count) :
+         mFifo(f), mId(id), mCount(count)
+      {}
+      virtual ~RingProducer()
+      {
+         shutdown();
+         join();
+      }
+
+      void thread()
+      {
+         for (int n = 0; n < mCount; n++)
+         {
+            mFifo.add(new Foo(Data(mId) + ":" + Data(n)));
+         }
+      }
+
+   private:
+      Fifo<Foo>& mFifo;
+      int mId;
+      int mCount;
+};
+
+#ifdef RESIP_HAS_STD_ATOMIC
+// pushes straight into a ring, retrying while it is full, and checks the
+// ring never claims to hold more than it can
+class RawRingProducer: public ThreadIf
+{
+  public:
+      RawRingProducer(MpscRing<int>& r, int count) :
+         mRing(r), mCount(count)
+      {}
+      virtual ~RawRingProducer()
+      {
+         shutdown();
+         join();
+      }
+
+      void thread()
+      {
+         for (int n = 0; n < mCount; n++)
+         {
+            size_t previous;
+            while (!mRing.push(n, previous))
+            {
+               std::this_thread::yield();
+            }
+            assert(previous < mRing.capacity());
+            assert(mRing.size() <= mRing.capacity());
+         }
+      }
+
+   private:
+      MpscRing<int>& mRing;
+      int mCount;
+};
+#endif
+
 bool
 isNear(int value, int reference, int epsilon=250)
 {
@@ -171,6 +238,94 @@ main()
       assert(abs(offMark) < 200);
    }
 
+   {
+      cerr << "!! test lock-free add, several producers one consumer" << endl;
+      const int producers = 4;
+      const int count = 50000;
+      Fifo<Foo> fifo;
+      // small, so that producers also take the locked path when it is full
+      fifo.enableLockFreeAdd(64);
+
+      RingProducer* prods[producers];
+      for (int i = 0; i < producers; i++)
+      {
+         prods[i] = new RingProducer(fifo, i, count);
+      }
+      for (int i = 0; i < producers; i++)
+      {
+         prods[i]->run();
+      }
+
+      int next[producers] = { 0 };
+      int received = 0;
+      while (received < producers*count)
+      {
+         Foo* foo = fifo.getNext(5000);
+         assert(foo);
+         // each producer's messages must come out in the order it added them
+         Data id;
+         ParseBuffer pb(foo->mVal);
+         const char* anchor = pb.position();
+         pb.skipToChar(':');
+         pb.data(id, anchor);
+         pb.skipChar();
+         int producer = id.convertInt();
+         int n = pb.integer();
+         assert(producer >= 0 && producer < producers);
+         assert(n == next[producer]);
+         ++next[producer];
+         ++received;
+         delete foo;
+      }
+      assert(fifo.empty());
+      assert(fifo.size() == 0);
+      assert(fifo.getNext(RESIP_FIFO_NOWAIT) == 0);
+
+      for (int i = 0; i < producers; i++)
+      {
+         delete prods[i];
+      }
+   }
+
+#ifdef RESIP_HAS_STD_ATOMIC
+   {
+      cerr << "!! test ring size stays within capacity, several producers" << endl;
+      const int producers = 4;
+      const int count = 50000;
+      MpscRing<int> ring(16);
+
+      RawRingProducer* prods[producers];
+      for (int i = 0; i < producers; i++)
+      {
+         prods[i] = new RawRingProducer(ring, count);
+      }
+      for (int i = 0; i < producers; i++)
+      {
+         prods[i]->run();
+      }
+
+      std::vector<int> items;
+      size_t received = 0;
+      while (received < (size_t)producers*count)
+      {
+         assert(ring.size() <= ring.capacity());
+         items.clear();
+         size_t num = ring.popAll(items);
+         assert(ring.size() <= ring.capacity());
+         received += num;
+         if (!num)
+         {
+            std::this_thread::yield();
+         }
+      }
+      for (int i = 0; i < producers; i++)
+      {
+         delete prods[i];
+      }
+      assert(ring.size() == 0);
+   }
+#endif
+
    Fifo<Foo> f;
    FiniteFifo<Foo> ff(5);
 
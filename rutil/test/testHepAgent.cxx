@@ -0,0 +1,216 @@
+#include <cstring>
+#include <iostream>
+#include "assert.h"
+
+#include "rutil/Data.hxx"
+#include "rutil/GenericIPAddress.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/Socket.hxx"
+#include "rutil/Timer.hxx"
+#include "rutil/hep/HepAgent.hxx"
+#include "rutil/hep/ResipHep.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+// A HOMER stand-in on the loopback interface
+class Collector
+{
+   public:
+      Collector()
+      {
+         mFd = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+         assert(mFd != INVALID_SOCKET);
+         struct sockaddr_in addr;
+         memset(&addr, 0, sizeof(addr));
+         addr.sin_family = AF_INET;
+         addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+         addr.sin_port = 0;
+         assert(::bind(mFd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+         socklen_t len = sizeof(addr);
+         assert(::getsockname(mFd, (struct sockaddr*)&addr, &len) == 0);
+         mPort = ntohs(addr.sin_port);
+         int size = 4 * 1024 * 1024;
+         ::setsockopt(mFd, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size));
+         makeSocketNonBlocking(mFd);
+      }
+
+      ~Collector()
+      {
+         closeSocket(mFd);
+      }
+
+      /// Reads until nothing arrives for 200ms; checks each packet is HEP3
+      /// and counts those whose payload contains marker.
+      int receive(const char* marker)
+      {
+         int count = 0;
+         for (;;)
+         {
+            FdSet fdset;
+            fdset.setRead(mFd);
+            if (fdset.selectMilliSeconds(200) <= 0)
+            {
+               return count;
+            }
+            char buf[4096];
+            int n = (int)::recv(mFd, buf, sizeof(buf), 0);
+            if (n <= 0)
+            {
+               continue;
+            }
+            assert(n > (int)sizeof(struct hep_generic));
+            assert(memcmp(buf, "HEP3", 4) == 0);
+            const struct hep_generic* hg = (const struct hep_generic*)buf;
+            assert(ntohs(hg->header.length) == n);
+            if (Data(Data::Share, buf, n).find(marker) != Data::npos)
+            {
+               ++count;
+            }
+         }
+      }
+
+      int port() const { return mPort; }
+
+   private:
+      Socket mFd;
+      int mPort;
+};
+
+static GenericIPAddress
+loopback(int port)
+{
+   struct sockaddr_in addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   addr.sin_port = htons(port);
+   return GenericIPAddress(addr);
+}
+
+int
+main(int argc, char* argv[])
+{
+   initNetwork();
+   Collector collector;
+   HepAgent agent("127.0.0.1", collector.port(), 2001);
+   const GenericIPAddress a(loopback(5060));
+   const GenericIPAddress b(loopback(5080));
+
+   // synchronous, without a capture thread
+   assert(agent.capture(UDP, a, b, HepAgent::SIP, "INVITE sync", "call-sync"));
+   assert(collector.receive("INVITE sync") == 1);
+   assert(agent.getCaptureStats().mSent == 1);
+
+   // through the capture thread, in batches
+   agent.startCaptureThread(1024);
+   const int total = 500;
+   int queued = 0;
+   for (int i = 0; i < total; ++i)
+   {
+      if (agent.capture(UDP, a, b, HepAgent::SIP, "INVITE async " + Data(i), "call-" + Data(i)))
+      {
+         ++queued;
+      }
+   }
+   int received = collector.receive("INVITE async ");
+   HepAgent::CaptureStats stats = agent.getCaptureStats();
+   cerr << "queued " << queued << " dropped " << stats.mDropped << " received " << received << endl;
+   assert(queued + (int)stats.mDropped == total);
+   assert(received == queued);
+   assert(stats.mSent == (UInt64)queued + 1);
+
+   // sampling is by correlation ID: all or nothing for a call
+   agent.setSamplePercent(30);
+   int calls = 0;
+   for (int i = 0; i < 200; ++i)
+   {
+      const Data callId("sampled-" + Data(i));
+      bool first = agent.capture(UDP, a, b, HepAgent::SIP, "INVITE sampled", callId);
+      bool second = agent.capture(UDP, b, a, HepAgent::SIP, "SIP/2.0 200 OK sampled", callId);
+      assert(first == second);
+      if (first)
+      {
+         ++calls;
+      }
+   }
+   cerr << "sampled " << calls << " of 200 calls" << endl;
+   assert(calls > 20 && calls < 100);
+   assert(collector.receive("sampled") == 2 * calls);
+
+   // a queue that is too small drops instead of blocking
+   agent.stopCaptureThread();
+   agent.setSamplePercent(100);
+   agent.startCaptureThread(2);
+   const UInt64 droppedBefore = agent.getCaptureStats().mDropped;
+   queued = 0;
+   for (int i = 0; i < 10000; ++i)
+   {
+      if (agent.capture(UDP, a, b, HepAgent::SIP, "INVITE burst", Data::Empty))
+      {
+         ++queued;
+      }
+   }
+   agent.stopCaptureThread();
+   received = collector.receive("INVITE burst");
+   stats = agent.getCaptureStats();
+   cerr << "burst queued " << queued << " dropped " << (stats.mDropped - droppedBefore) << endl;
+   assert(stats.mDropped > droppedBefore);
+   assert(queued + (int)(stats.mDropped - droppedBefore) == 10000);
+   assert(received == queued);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -35,6 +35,62 @@ main()
       }      
    }
 
+   {
+      MD5Hash hash;
+      assert(hash.getHex() == "d41d8cd98f00b204e9800998ecf8427e");
+      hash.update(Data("qwertyuiop"));
+      assert(hash.getHex() == "6eea9b7ef19179a06954edd0f6c05ceb");
+   }
+
+   {
+      // RFC 2617 section 3.5: A1 for Mufasa, then the response
+      MD5Hash a1;
+      a1.update(Data("Mufasa"));
+      a1.update(':');
+      a1.update(Data("testrealm@host.com"));
+      a1.update(':');
+      a1.update("Circle Of Life", 14);
+      assert(a1.getHex() == "939e7578ed9e3c518a452acee763bce9");
+
+      MD5Hash a2;
+      a2.update(Data("GET:/dir/index.html"));
+
+      MD5Hash response;
+      response.update(a1.getHex());
+      response.update(Data(":dcd98b7102dd2f0e8b11d0f600bfb0c093:00000001:0a4f113b:auth:"));
+      response.update(a2.getHex());
+      char hex[MD5Hash::HexLength];
+      response.getHex(hex);
+      assert(Data(hex, MD5Hash::HexLength) == "6629fae49393a05397450978507c4ef1");
+   }
+
+   {
+      // Matches MD5Stream however the data is split up, and getHex() doesn't
+      // end the hash
+      MD5Stream str;
+      MD5Hash hash;
+      Data data;
+      for (int i = 0; i < 1000; ++i)
+      {
+         Data chunk(i);
+         str << chunk;
+         if (i % 2)
+         {
+            hash.update(chunk);
+         }
+         else
+         {
+            for (Data::size_type c = 0; c < chunk.size(); ++c)
+            {
+               hash.update(chunk[c]);
+            }
+         }
+         data += chunk;
+         assert(hash.getHex() == str.getHex());
+         assert(hash.getHex() == data.md5());
+      }
+   }
+
    cerr << "All OK" << endl;
 
    return 0;
@@ -0,0 +1,468 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <bitset>
+#include <vector>
+#include "assert.h"
+
+#include "rutil/CharClass.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/ParseBuffer.hxx"
+#include "rutil/ParseException.hxx"
+#include "rutil/Timer.hxx"
+
+using namespace resip;
+using namespace std;
+
+// The character-at-a-time loops the ParseBuffer primitives used to be, to
+// check the block-at-a-time versions against, and to time them against.
+namespace reference
+{
+
+static bool
+oneOf(char c, const char* cs)
+{
+   while (*cs)
+   {
+      if (c == *(cs++))
+      {
+         return true;
+      }
+   }
+   return false;
+}
+
+static const char*
+skipToOneOf(const char* pos, const char* end, const char* cs)
+{
+   while (pos < end && !oneOf(*pos, cs))
+   {
+      pos++;
+   }
+   return pos;
+}
+
+static const char*
+skipToOneOf(const char* pos, const char* end, const std::bitset<256>& cs)
+{
+   while (pos < end && !cs.test((unsigned char)*pos))
+   {
+      pos++;
+   }
+   return pos;
+}
+
+static const char*
+skipChars(const char* pos, const char* end, const std::bitset<256>& cs)
+{
+   while (pos < end && cs.test((unsigned char)*pos))
+   {
+      pos++;
+   }
+   return pos;
+}
+
+static bool
+isWhitespace(char c)
+{
+   switch (c)
+   {
+      case ' ' :
+      case '\t' :
+      case '\r' :
+      case '\n' :
+         return true;
+      default :
+         return false;
+   }
+}
+
+static const char*
+skipWhitespace(const char* pos, const char* end)
+{
+   while (pos < end && isWhitespace(*pos))
+   {
+      pos++;
+   }
+   return pos;
+}
+
+static const char*
+skipNonWhitespace(const char* pos, const char* end)
+{
+   while (pos < end && !isWhitespace(*pos))
+   {
+      pos++;
+   }
+   return pos;
+}
+
+static const char*
+skipToChars(const char* pos, const char* end, const char* cs)
+{
+   size_t l = strlen(cs);
+   for (; pos + l <= end; pos++)
+   {
+      if (memcmp(pos, cs, l) == 0)
+      {
+         return pos;
+      }
+   }
+   return end;
+}
+
+// 0 if the quote is missing
+static const char*
+skipToEndQuote(const char* pos, const char* end, char quote)
+{
+   while (pos < end)
+   {
+      if (*pos == '\\')
+      {
+         pos += 2;
+      }
+      else if (*pos == quote)
+      {
+         return pos;
+      }
+      else
+      {
+         pos++;
+      }
+   }
+   return 0;
+}
+
+}
+
+static const char*
+skipToEndQuote(ParseBuffer& pb)
+{
+   try
+   {
+      return pb.skipToEndQuote();
+   }
+   catch (ParseException&)
+   {
+      return 0;
+   }
+}
+
+// Random text of all lengths and alignments, with the characters being
+// searched for scattered through it.
+static void
+testAgainstReference()
+{
+   const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789.-_ \t\r\n;=?>,:@\"\\<";
+   const std::bitset<256> delimiters(Data::toBitset(" \t\r\n;=?>"));
+   const std::bitset<256> token(Data::toBitset("abcdefghijklmnopqrstuvwxyz0123456789.-_"));
+   const std::bitset<256> empty;
+   const CharTable& delimiterTable = CharClass<' ', '\t', '\r', '\n', ';', '=', '?', '>'>::Table;
+   for (int c = 0; c < 256; c++)
+   {
+      assert(delimiterTable[(unsigned char)c] == delimiters[c]);
+   }
+   assert(!CharClass<'a'>::Table[0xff]);
+   assert(CharClass<0xff>::Table[0xff]);
+   char text[200];
+   srand(4475);
+   for (int run = 0; run < 20000; run++)
+   {
+      size_t len = rand() % 150;
+      int density = 1 + rand() % 40;  // one in density characters is a delimiter
+      for (size_t i = 0; i < len; i++)
+      {
+         text[i] = rand() % density ? alphabet[rand() % 39] : alphabet[39 + rand() % 15];
+      }
+      text[len] = '!';  // beyond the end, never a match
+      const char* end = text + len;
+      for (size_t start = 0; start <= len; start += 1 + rand() % 8)
+      {
+         const char* pos = text + start;
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToOneOf(" \t\r\n;=?>") == reference::skipToOneOf(pos, end, " \t\r\n;=?>"));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToOneOf(ParseBuffer::Whitespace, ";=?>,:@\"<") ==
+                   reference::skipToOneOf(pos, end, " \t\r\n;=?>,:@\"<"));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToOneOf(Data(";"), Data(">")) == reference::skipToOneOf(pos, end, ";>"));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToOneOf(delimiters) == reference::skipToOneOf(pos, end, delimiters));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToOneOf(token) == reference::skipToOneOf(pos, end, token));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToOneOf(empty) == end);
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToOneOf(delimiterTable) == reference::skipToOneOf(pos, end, delimiters));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipChars(delimiterTable) == reference::skipChars(pos, end, delimiters));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipChars(token) == reference::skipChars(pos, end, token));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipWhitespace() == reference::skipWhitespace(pos, end));
+         }
+         if (pos < end)
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipNonWhitespace() == reference::skipNonWhitespace(pos, end));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToChars("\r\n") == reference::skipToChars(pos, end, "\r\n"));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(pb.skipToChars(Data("a;")) == reference::skipToChars(pos, end, "a;"));
+         }
+         {
+            ParseBuffer pb(pos, end - pos);
+            assert(skipToEndQuote(pb) == reference::skipToEndQuote(pos, end, '"'));
+         }
+      }
+   }
+}
+
+// Header values as they appear in real messages, parsed the way the stack
+// parses them.
+static const char* values[] =
+{
+   "SIP/2.0/UDP 192.168.2.220:5060;branch=z9hG4bK-c87542-da4d3e6a.0-1--c87542-;rport=5060;received=192.168.2.220",
+   "\"Alice Liddell, Wonderland Division\" <sip:alice@atlanta.example.com;transport=tls>;tag=9fxced76sl",
+   "<sip:bob@client.biloxi.example.com:5061;transport=tls;ob>;+sip.instance=\"<urn:uuid:f81d4fae-7dec-11d0-a765-00a0c91e6bf6>\";reg-id=1;expires=3600",
+   "Digest username=\"bob\", realm=\"biloxi.example.com\", nonce=\"dcd98b7102dd2f0e8b11d0f600bfb0c093\", uri=\"sip:bob@biloxi.example.com\", response=\"245f23415f11432b3434341c022\"",
+   "a84b4c76e66710@pc33.atlanta.example.com",
+   "m=audio 49170 RTP/AVP 0 8 97 101",
+};
+
+struct Primitive
+{
+      const char* name;
+      // both return where they stopped; the return values are summed to
+      // keep the work from being optimized away
+      size_t (*parse)(const char* text, size_t len);
+      size_t (*referenceParse)(const char* text, size_t len);
+};
+
+static const std::bitset<256>&
+paramDelimiters()
+{
+   static const std::bitset<256> delimiters(Data::toBitset("\r\n\t ;=?>"));
+   return delimiters;
+}
+
+static size_t
+toOneOf(const char* text, size_t len)
+{
+   ParseBuffer pb(text, len);
+   return pb.skipToOneOf(";>,\"") - text;
+}
+static size_t
+toOneOfReference(const char* text, size_t len)
+{
+   return reference::skipToOneOf(text, text + len, ";>,\"") - text;
+}
+
+static size_t
+toOneOfBitset(const char* text, size_t len)
+{
+   ParseBuffer pb(text, len);
+   return pb.skipToOneOf(paramDelimiters()) - text;
+}
+static size_t
+toOneOfBitsetReference(const char* text, size_t len)
+{
+   return reference::skipToOneOf(text, text + len, paramDelimiters()) - text;
+}
+
+static size_t
+toOneOfCharClass(const char* text, size_t len)
+{
+   ParseBuffer pb(text, len);
+   return pb.skipToOneOf(CharClass<'\r', '\n', '\t', ' ', ';', '=', '?', '>'>::Table) - text;
+}
+
+static size_t
+whitespace(const char* text, size_t len)
+{
+   // a token and the whitespace after it, through the value
+   ParseBuffer pb(text, len);
+   size_t n = 0;
+   while (!pb.eof())
+   {
+      pb.skipNonWhitespace();
+      n += pb.skipWhitespace() - text;
+   }
+   return n;
+}
+static size_t
+whitespaceReference(const char* text, size_t len)
+{
+   const char* pos = text;
+   const char* end = text + len;
+   size_t n = 0;
+   while (pos < end)
+   {
+      pos = reference::skipNonWhitespace(pos, end);
+      pos = reference::skipWhitespace(pos, end);
+      n += pos - text;
+   }
+   return n;
+}
+
+static size_t
+toChars(const char* text, size_t len)
+{
+   ParseBuffer pb(text, len);
+   return pb.skipToChars("\r\n") - text;
+}
+static size_t
+toCharsReference(const char* text, size_t len)
+{
+   return reference::skipToChars(text, text + len, "\r\n") - text;
+}
+
+static size_t
+toEndQuote(const char* text, size_t len)
+{
+   // every quoted string in the value
+   ParseBuffer pb(text, len);
+   size_t n = 0;
+   while (!pb.eof())
+   {
+      pb.skipToChar('"');
+      if (!pb.eof())
+      {
+         pb.skipChar();
+         n += pb.skipToEndQuote() - text;
+         pb.skipChar();
+      }
+   }
+   return n;
+}
+static size_t
+toEndQuoteReference(const char* text, size_t len)
+{
+   const char* pos = text;
+   const char* end = text + len;
+   size_t n = 0;
+   while (pos < end)
+   {
+      pos = (const char*)memchr(pos, '"', end - pos);
+      if (pos == 0)
+      {
+         break;
+      }
+      pos = reference::skipToEndQuote(pos + 1, end, '"');
+      n += pos - text;
+      pos++;
+   }
+   return n;
+}
+
+static void
+benchmark(int runs)
+{
+   static const Primitive primitives[] =
+   {
+      { "skipToOneOf(const char*)", toOneOf, toOneOfReference },
+      { "skipToOneOf(bitset)", toOneOfBitset, toOneOfBitsetReference },
+      { "skipToOneOf(CharClass)", toOneOfCharClass, toOneOfBitsetReference },
+      { "skip(Non)Whitespace", whitespace, whitespaceReference },
+      { "skipToChars", toChars, toCharsReference },
+      { "skipToEndQuote", toEndQuote, toEndQuoteReference },
+   };
+   size_t numValues = sizeof(values) / sizeof(*values);
+   for (size_t p = 0; p < sizeof(primitives) / sizeof(*primitives); p++)
+   {
+      UInt64 elapsed[2];
+      size_t sums[2] = { 0, 0 };
+      for (int impl = 0; impl < 2; impl++)
+      {
+         size_t (*parse)(const char*, size_t) = impl ? primitives[p].referenceParse : primitives[p].parse;
+         UInt64 start = Timer::getTimeMicroSec();
+         for (int run = 0; run < runs; run++)
+         {
+            for (size_t v = 0; v < numValues; v++)
+            {
+               sums[impl] += parse(values[v], strlen(values[v]));
+            }
+         }
+         elapsed[impl] = Timer::getTimeMicroSec() - start;
+      }
+      assert(sums[0] == sums[1]);
+      cerr << primitives[p].name << ": "
+           << (double)elapsed[0] * 1000 / (runs * numValues) << " ns per value, was "
+           << (double)elapsed[1] * 1000 / (runs * numValues) << " ns" << endl;
+   }
+}
+
+int
+main(int argc, char** argv)
+{
+   testAgainstReference();
+   benchmark(argc > 1 ? atoi(argv[1]) : 200000);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * ====================================================================
+ */
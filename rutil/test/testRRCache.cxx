@@ -0,0 +1,247 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "assert.h"
+
+#ifndef WIN32
+#include <arpa/nameser.h>
+#endif
+
+#include "rutil/BaseException.hxx"
+#include "rutil/Data.hxx"
+#include "rutil/Logger.hxx"
+#include "rutil/dns/RRCache.hxx"
+#include "rutil/dns/RROverlay.hxx"
+
+using namespace resip;
+using namespace std;
+
+#define RESIPROCATE_SUBSYSTEM Subsystem::TEST
+
+#ifndef T_A
+#define T_A 1
+#endif
+#ifndef T_SOA
+#define T_SOA 6
+#endif
+
+// Builds a response holding a single resource record and returns the
+// offset of that record in msg.
+static size_t
+makeResponse(vector<unsigned char>& msg, const Data& name, int type, unsigned int ttl,
+             const unsigned char* rdata, unsigned short rdlen)
+{
+   static const unsigned char header[] = { 0x12, 0x34, 0x81, 0x80, 0, 0, 0, 1, 0, 0, 0, 0 };
+   msg.assign(header, header + sizeof(header));
+   size_t rr = msg.size();
+
+   const char* label = name.c_str();
+   while (*label)
+   {
+      const char* dot = strchr(label, '.');
+      size_t len = dot ? size_t(dot - label) : strlen(label);
+      msg.push_back((unsigned char)len);
+      msg.insert(msg.end(), label, label + len);
+      label += len + (dot ? 1 : 0);
+   }
+   msg.push_back(0);
+
+   msg.push_back((unsigned char)(type >> 8));
+   msg.push_back((unsigned char)type);
+   msg.push_back(0);
+   msg.push_back(1); // IN
+   msg.push_back((unsigned char)(ttl >> 24));
+   msg.push_back((unsigned char)(ttl >> 16));
+   msg.push_back((unsigned char)(ttl >> 8));
+   msg.push_back((unsigned char)ttl);
+   msg.push_back((unsigned char)(rdlen >> 8));
+   msg.push_back((unsigned char)rdlen);
+   msg.insert(msg.end(), rdata, rdata + rdlen);
+   return rr;
+}
+
+static void
+cacheA(RRCache& cache, const Data& name, unsigned int ttl, unsigned char lastOctet)
+{
+   const unsigned char addr[] = { 192, 0, 2, lastOctet };
+   vector<unsigned char> msg;
+   size_t rr = makeResponse(msg, name, T_A, ttl, addr, sizeof(addr));
+   vector<RROverlay> overlays;
+   overlays.push_back(RROverlay(&msg[rr], &msg[0], (int)msg.size()));
+   cache.updateCache(name, T_A, overlays.begin(), overlays.end());
+}
+
+static void
+cacheFailure(RRCache& cache, const Data& name, int type, int status, unsigned int soaTtl, unsigned int minimum)
+{
+   // mname and rname both point back at the question-less owner name
+   unsigned char soa[24] = { 0xc0, 0x0c, 0xc0, 0x0c };
+   for (int i = 0; i < 4; ++i)
+   {
+      soa[20 + i] = (unsigned char)(minimum >> (24 - 8 * i));
+   }
+   vector<unsigned char> msg;
+   size_t rr = makeResponse(msg, name, T_SOA, soaTtl, soa, sizeof(soa));
+   cache.cacheTTL(name, type, status, RROverlay(&msg[rr], &msg[0], (int)msg.size()));
+}
+
+int
+main(int argc, char* argv[])
+{
+   Log::initialize(Log::Cout, argc > 1 ? Log::toLevel(argv[1]) : Log::Warning, argv[0]);
+
+   RRCache::Result records;
+   int status = 0;
+
+   {
+      // lookups ignore case; nothing is prefetched early in the lifetime
+      RRCache cache;
+      cacheA(cache, "example.com", 300, 1);
+      assert(cache.size() == 1);
+      assert(cache.lookup("EXAMPLE.com", T_A, RRCache::Protocol::Sip, records, status));
+      assert(records.size() == 1 && status == 0);
+      assert(!cache.lookup("example.net", T_A, RRCache::Protocol::Sip, records, status));
+      assert(records.empty());
+
+      cacheA(cache, "Example.COM", 300, 2);
+      assert(cache.size() == 1);
+
+      RRCache::PrefetchList prefetches;
+      cache.getPrefetches(prefetches);
+      assert(prefetches.empty());
+      assert(cache.getStats().prefetches == 0);
+   }
+
+   {
+      // with the window covering the whole TTL, the first hit asks for a
+      // refresh and later hits do not, until the answer has come back
+      RRCache cache;
+      cache.setPrefetchWindow(100);
+      cacheA(cache, "example.com", 300, 1);
+      assert(cache.lookup("example.com", T_A, RRCache::Protocol::Sip, records, status));
+      assert(cache.lookup("example.com", T_A, RRCache::Protocol::Sip, records, status));
+
+      RRCache::PrefetchList prefetches;
+      cache.getPrefetches(prefetches);
+      assert(prefetches.size() == 1);
+      assert(prefetches[0].first == "example.com" && prefetches[0].second == T_A);
+      cache.getPrefetches(prefetches);
+      assert(prefetches.empty());
+
+      cacheA(cache, "example.com", 300, 3);
+      assert(cache.lookup("example.com", T_A, RRCache::Protocol::Sip, records, status));
+      cache.getPrefetches(prefetches);
+      assert(prefetches.size() == 1);
+      assert(cache.getStats().prefetches == 2);
+
+      cache.setPrefetchWindow(0);
+      cacheA(cache, "example.com", 300, 4);
+      assert(cache.lookup("example.com", T_A, RRCache::Protocol::Sip, records, status));
+      cache.getPrefetches(prefetches);
+      assert(prefetches.empty());
+   }
+
+   {
+      // failures are cached, never prefetched, and give way to an answer
+      RRCache cache;
+      cache.setPrefetchWindow(100);
+      cacheFailure(cache, "missing.example.com", T_A, 4, 3600, 60);
+      assert(cache.lookup("missing.example.com", T_A, RRCache::Protocol::Sip, records, status));
+      assert(records.empty() && status == 4);
+      assert(!cache.lookup("missing.example.com", T_SRV, RRCache::Protocol::Sip, records, status));
+
+      RRCache::PrefetchList prefetches;
+      cache.getPrefetches(prefetches);
+      assert(prefetches.empty());
+
+      cacheA(cache, "missing.example.com", 300, 1);
+      assert(cache.size() == 1);
+      assert(cache.lookup("missing.example.com", T_A, RRCache::Protocol::Sip, records, status));
+      assert(records.size() == 1 && status == 0);
+   }
+
+   {
+      // a full cache evicts the least recently used set
+      RRCache cache;
+      cache.setSize(4);
+      cacheA(cache, "host0.example.com", 300, 1);
+      cacheA(cache, "host1.example.com", 300, 1);
+      cacheA(cache, "host2.example.com", 300, 1);
+      assert(cache.lookup("host0.example.com", T_A, RRCache::Protocol::Sip, records, status));
+      cacheA(cache, "host3.example.com", 300, 1);
+      cacheA(cache, "host4.example.com", 300, 1);
+      assert(cache.size() == 3);
+      assert(cache.getStats().evicted == 2);
+      assert(cache.lookup("host0.example.com", T_A, RRCache::Protocol::Sip, records, status));
+      assert(!cache.lookup("host1.example.com", T_A, RRCache::Protocol::Sip, records, status));
+      assert(!cache.lookup("host2.example.com", T_A, RRCache::Protocol::Sip, records, status));
+      assert(cache.lookup("host4.example.com", T_A, RRCache::Protocol::Sip, records, status));
+
+      cache.clearCache();
+      assert(cache.size() == 0);
+      assert(!cache.lookup("host4.example.com", T_A, RRCache::Protocol::Sip, records, status));
+   }
+
+   {
+      RRCache cache;
+      cache.countLookup(true, false);
+      cache.countLookup(true, true);
+      cache.countLookup(false, false);
+      assert(cache.getStats().hits == 2);
+      assert(cache.getStats().negativeHits == 1);
+      assert(cache.getStats().misses == 1);
+   }
+
+   resipCerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Copyright (c) 2000 Vovida Networks, Inc.  All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */
@@ -0,0 +1,312 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <set>
+#include <vector>
+
+#include "rutil/Timer.hxx"
+#include "rutil/TimerWheel.hxx"
+
+using namespace resip;
+using namespace std;
+
+typedef TimerWheel<int> Wheel;
+
+class Collector
+{
+   public:
+      void operator()(const int& id) { mFired.push_back(id); }
+      vector<int> mFired;
+};
+
+class Counter
+{
+   public:
+      Counter() : mCount(0) {}
+      void operator()(const int&) { ++mCount; }
+      unsigned int mCount;
+};
+
+// shaped like a TransactionTimer: a transaction id, a type and the expiry
+class BenchTimer
+{
+   public:
+      BenchTimer(UInt64 when, const Data& tid) : mWhen(when), mType(Timer::TimerE1), mTransactionId(tid) {}
+      bool operator>(const BenchTimer& rhs) const { return mWhen > rhs.mWhen; }
+      UInt64 mWhen;
+      Timer::Type mType;
+      Data mTransactionId;
+};
+
+// re-arms every timer that fires, from inside expire()
+class BenchRearm
+{
+   public:
+      BenchRearm(TimerWheel<BenchTimer>& wheel, const vector<UInt64>& delays) :
+         mWheel(wheel), mDelays(delays), mNow(0), mNext(0) {}
+      void operator()(const BenchTimer& t)
+      {
+         mWheel.add(mNow + mDelays[mNext++ % mDelays.size()], t);
+      }
+      TimerWheel<BenchTimer>& mWheel;
+      const vector<UInt64>& mDelays;
+      UInt64 mNow;
+      unsigned int mNext;
+};
+
+static UInt64
+randomDelay()
+{
+   // mostly SIP-ish timers, some long ones, a few beyond the wheel's range
+   switch (rand() % 10)
+   {
+      case 0: return rand() % 300;
+      case 1: return UInt64(rand() % 100) * 3600000; // up to 100h
+      case 2: return UInt64(rand() % 3) << 32;        // overflow
+      case 3: return 32000;
+      default: return 500 << (rand() % 4);
+   }
+}
+
+// Drives the wheel and a reference multimap over the same random schedule
+// and checks that entries fire at the same points, in time order.
+static void
+checkAgainstReference(UInt64 start)
+{
+   Wheel wheel(start);
+   multimap<UInt64, int> reference;
+   map<int, Wheel::Handle> handles;
+   UInt64 now = start;
+   int nextId = 0;
+   bool cancelled = false;
+
+   for (int round = 0; round < 20000; ++round)
+   {
+      int adds = rand() % 4;
+      for (int i = 0; i < adds; ++i)
+      {
+         UInt64 when = now + randomDelay();
+         if (rand() % 50 == 0 && now > start + 10)
+         {
+            when = now - 5; // already due
+         }
+         handles[nextId] = wheel.add(when, nextId);
+         reference.insert(make_pair(when, nextId));
+         ++nextId;
+      }
+
+      if (rand() % 5 == 0 && !handles.empty())
+      {
+         map<int, Wheel::Handle>::iterator h = handles.lower_bound(rand() % nextId);
+         if (h != handles.end())
+         {
+            bool pending = false;
+            for (multimap<UInt64, int>::iterator r = reference.begin(); r != reference.end(); ++r)
+            {
+               if (r->second == h->first)
+               {
+                  reference.erase(r);
+                  pending = true;
+                  break;
+               }
+            }
+            assert(wheel.cancel(h->second) == pending);
+            cancelled = cancelled || pending;
+            assert(!wheel.cancel(h->second));
+            handles.erase(h);
+         }
+      }
+
+      assert(wheel.size() == reference.size());
+      if (!reference.empty())
+      {
+         // never late; exact unless something was cancelled
+         UInt64 due = reference.begin()->first;
+         assert(wheel.nextExpiry() <= due);
+         assert(cancelled || wheel.nextExpiry() == due);
+         assert(wheel.top());
+      }
+
+      // advance by a random step; sometimes jump far ahead
+      UInt64 before = now;
+      UInt64 step = (rand() % 100 == 0) ? UInt64(rand()) * 64 : rand() % 200;
+      now += step;
+
+      Collector collector;
+      wheel.expire(now, collector);
+      UInt64 last = 0;
+      for (vector<int>::iterator i = collector.mFired.begin(); i != collector.mFired.end(); ++i)
+      {
+         multimap<UInt64, int>::iterator r = reference.begin();
+         for (; r != reference.end() && r->second != *i; ++r)
+         {
+         }
+         assert(r != reference.end());
+         assert(r->first <= now);
+         // entries added after their time fire first, in no particular order
+         assert(r->first >= last || r->first <= before);
+         last = resipMax(last, r->first);
+         reference.erase(r);
+         handles.erase(*i);
+      }
+      // nothing that is due may be left behind
+      assert(reference.empty() || reference.begin()->first > now);
+   }
+
+   Counter counter;
+   wheel.clear(counter);
+   assert(counter.mCount == reference.size());
+   assert(wheel.empty());
+}
+
+// Benchmark: a transaction-like load of timers re-armed as they fire,
+// against the std::priority_queue TimerQueue used to be based on.
+static void
+benchmark(unsigned int live, unsigned int rounds)
+{
+   vector<UInt64> delays;
+   for (unsigned int i = 0; i < live * 2; ++i)
+   {
+      delays.push_back(500 << (rand() % 4));
+   }
+   vector<Data> tids;
+   for (unsigned int i = 0; i < live; ++i)
+   {
+      tids.push_back(Data("z9hG4bK-524287-1---") + Data(i));
+   }
+
+   UInt64 begin = Timer::getTimeMs();
+   {
+      priority_queue<BenchTimer, vector<BenchTimer>, greater<BenchTimer> > heap;
+      UInt64 now = 0;
+      unsigned int d = 0;
+      for (unsigned int i = 0; i < live; ++i)
+      {
+         heap.push(BenchTimer(now + delays[d++ % delays.size()], tids[i]));
+      }
+      for (unsigned int r = 0; r < rounds; ++r)
+      {
+         now += 10;
+         while (!heap.empty() && !(heap.top().mWhen > now))
+         {
+            BenchTimer t(now + delays[d++ % delays.size()], heap.top().mTransactionId);
+            heap.pop();
+            heap.push(t);
+         }
+      }
+   }
+   UInt64 heapMs = Timer::getTimeMs() - begin;
+
+   begin = Timer::getTimeMs();
+   {
+      TimerWheel<BenchTimer> wheel(0);
+      BenchRearm rearm(wheel, delays);
+      for (unsigned int i = 0; i < live; ++i)
+      {
+         wheel.add(delays[rearm.mNext++ % delays.size()], BenchTimer(0, tids[i]));
+      }
+      for (unsigned int r = 0; r < rounds; ++r)
+      {
+         rearm.mNow += 10;
+         wheel.expire(rearm.mNow, rearm);
+      }
+   }
+   UInt64 wheelMs = Timer::getTimeMs() - begin;
+
+   cerr << live << " live timers, " << rounds << " rounds of 10ms: "
+        << "priority_queue " << heapMs << "ms, "
+        << "TimerWheel " << wheelMs << "ms" << endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+   srand(1);
+
+   {
+      Wheel wheel(1000);
+      assert(wheel.empty());
+      Wheel::Handle a = wheel.add(1500, 1);
+      Wheel::Handle b = wheel.add(1200, 2);
+      wheel.add(1200, 3);
+      assert(a != b && a != 0 && b != 0);
+      assert(wheel.size() == 3);
+      assert(wheel.nextExpiry() == 1200);
+      assert(wheel.cancel(b));
+      assert(!wheel.cancel(b));
+      assert(wheel.find(b) == 0);
+      assert(*wheel.find(a) == 1);
+
+      Collector c;
+      wheel.expire(1199, c);
+      assert(c.mFired.empty());
+      wheel.expire(1200, c);
+      assert(c.mFired.size() == 1 && c.mFired[0] == 3);
+      assert(wheel.nextExpiry() == 1500);
+      wheel.expire(1000000, c);
+      assert(c.mFired.size() == 2 && c.mFired[1] == 1);
+      assert(wheel.empty());
+      assert(wheel.find(a) == 0);
+   }
+
+   // start points just before the wheels wrap exercise the cascades
+   checkAgainstReference(0);
+   checkAgainstReference((UInt64(1) << 32) - 300);
+   checkAgainstReference(Timer::getTimeMs());
+
+   unsigned int live = argc > 1 ? atoi(argv[1]) : 100000;
+   benchmark(live, 1000);
+
+   cerr << "All OK" << endl;
+   return 0;
+}
+
+/* ====================================================================
+ * The Vovida Software License, Version 1.0 
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ * 
+ * 3. The names "VOCAL", "Vovida Open Communication Application Library",
+ *    and "Vovida Open Communication Application Library (VOCAL)" must
+ *    not be used to endorse or promote products derived from this
+ *    software without prior written permission. For written
+ *    permission, please contact vocal@vovida.org.
+ *
+ * 4. Products derived from this software may not be called "VOCAL", nor
+ *    may "VOCAL" appear in their name, without prior written
+ *    permission of Vovida Networks, Inc.
+ * 
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE, TITLE AND
+ * NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL VOVIDA
+ * NETWORKS, INC. OR ITS CONTRIBUTORS BE LIABLE FOR ANY DIRECT DAMAGES
+ * IN EXCESS OF $1,000, NOR FOR ANY INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+ * OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ * 
+ * ====================================================================
+ * 
+ * This software consists of voluntary contributions made by Vovida
+ * Networks, Inc. and many individuals on behalf of Vovida Networks,
+ * Inc.  For more information on Vovida Networks, Inc., please see
+ * <http://www.vovida.org/>.
+ *
+ */